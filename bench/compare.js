@@ -0,0 +1,46 @@
+// Compare two benchmark result files from bench/run.js.
+//
+//   node bench/compare.js baseline.json current.json [--threshold 0.1]
+//
+// Prints the median time ratio of every case and exits with 1 if any case
+// got slower than the threshold (default 10%).
+const fs = require("fs");
+
+const args = process.argv.slice(2);
+let threshold = 0.1;
+const files = [];
+for (let i = 0; i < args.length; i++) {
+  if (args[i] === "--threshold") {
+    threshold = Number(args[++i]);
+  } else {
+    files.push(args[i]);
+  }
+}
+if (files.length !== 2) {
+  console.error("Usage: node compare.js baseline.json current.json " +
+                "[--threshold 0.1]");
+  process.exit(2);
+}
+
+const [baseline, current] =
+    files.map((f) => JSON.parse(fs.readFileSync(f, "utf8")));
+if (baseline.options.scale !== current.options.scale) {
+  console.error("Warning: results were generated with different scales.");
+}
+
+let regressions = 0;
+for (const name of Object.keys(current.results)) {
+  const before = baseline.results[name];
+  const after = current.results[name];
+  if (!before) {
+    console.log(`${name.padEnd(28)} ${after.median_ms.toFixed(3)} ms (new)`);
+    continue;
+  }
+  const ratio = after.median_ms / before.median_ms;
+  const slower = ratio > 1 + threshold;
+  if (slower) regressions++;
+  console.log(`${name.padEnd(28)} ${before.median_ms.toFixed(3)} ms -> ` +
+              `${after.median_ms.toFixed(3)} ms  x${ratio.toFixed(2)}` +
+              (slower ? "  REGRESSION" : ""));
+}
+process.exit(regressions > 0 ? 1 : 0);
@@ -0,0 +1,151 @@
+// Deterministic synthetic layouts for benchmarks.
+//
+// The same seed and options always produce the same library, so results of
+// different builds are comparable.
+
+// mulberry32: small seeded PRNG, returns floats in [0, 1)
+function make_random(seed) {
+  let state = seed >>> 0;
+  return () => {
+    state = (state + 0x6d2b79f5) >>> 0;
+    let t = state;
+    t = Math.imul(t ^ (t >>> 15), t | 1);
+    t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+    return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+  };
+}
+
+const DEFAULT_OPTIONS = {
+  seed: 1,
+  // leaf rectangles in a single flat cell
+  rectangles: 1000000,
+  // hierarchy of depth levels, each cell placing fanout copies of the next
+  depth: 6,
+  fanout: 4,
+  // columns x rows AREF of a small cell
+  aref_columns: 1000,
+  aref_rows: 1000,
+  // FlexPaths with path_points points each
+  paths: 100,
+  path_points: 10000,
+  // rings built from ellipses with tolerance curve_tolerance
+  curves: 1000,
+  curve_tolerance: 1e-4,
+};
+
+// Scale all counts of DEFAULT_OPTIONS by scale (at least 1 of each)
+function scaled_options(scale, overrides = {}) {
+  const options = Object.assign({}, DEFAULT_OPTIONS);
+  for (const key of ["rectangles", "paths", "curves"]) {
+    options[key] = Math.max(1, Math.round(options[key] * scale));
+  }
+  const side = Math.max(1, Math.round(1000 * Math.sqrt(scale)));
+  options.aref_columns = side;
+  options.aref_rows = side;
+  return Object.assign(options, overrides);
+}
+
+// Build a library with one cell per feature plus a TOP cell referencing all
+// of them.  Returns {library, top, cells} where cells maps feature name to
+// cell.  Everything must be released with release_layout.
+function generate(gdstk, options = DEFAULT_OPTIONS) {
+  const random = make_random(options.seed);
+  const cells = {};
+  const objects = [];
+  const keep = (obj) => {
+    objects.push(obj);
+    return obj;
+  };
+
+  // millions of rectangles on a few layers
+  const rects = keep(new gdstk.Cell("RECTS"));
+  for (let i = 0; i < options.rectangles; i++) {
+    const x = random() * 10000;
+    const y = random() * 10000;
+    const w = 0.1 + random() * 2;
+    const h = 0.1 + random() * 2;
+    rects.add(keep(gdstk.rectangle([x, y], [x + w, y + h], i % 4, 0)));
+  }
+  cells.rectangles = rects;
+
+  // deep hierarchy
+  let child = keep(new gdstk.Cell(`H${options.depth}`));
+  for (let i = 0; i < 8; i++) {
+    child.add(keep(gdstk.rectangle([i, 0], [i + 0.5, 4], 10, 0)));
+  }
+  for (let level = options.depth - 1; level >= 0; level--) {
+    const parent = keep(new gdstk.Cell(`H${level}`));
+    const pitch = 10 * Math.pow(options.fanout, options.depth - level - 1);
+    for (let i = 0; i < options.fanout; i++) {
+      parent.add(keep(new gdstk.Reference(child, [i * pitch, 0], 0, 1, false,
+                                          1, 1, null)));
+    }
+    child = parent;
+  }
+  cells.hierarchy = child;
+
+  // large AREF
+  const unit = keep(new gdstk.Cell("UNIT"));
+  unit.add(keep(gdstk.rectangle([0, 0], [0.5, 0.5], 20, 0)));
+  unit.add(keep(gdstk.rectangle([0.6, 0], [0.8, 0.9], 21, 0)));
+  const aref = keep(new gdstk.Cell("AREF"));
+  aref.add(keep(new gdstk.Reference(unit, [0, 0], 0, 1, false,
+                                    options.aref_columns, options.aref_rows,
+                                    [1, 1])));
+  cells.aref = aref;
+
+  // long FlexPaths (random walks)
+  const paths = keep(new gdstk.Cell("PATHS"));
+  for (let i = 0; i < options.paths; i++) {
+    const points = [];
+    let x = random() * 10000;
+    let y = random() * 10000;
+    for (let j = 0; j < options.path_points; j++) {
+      if (j % 2 === 0) {
+        x += 1 + random() * 5;
+      } else {
+        y += (random() - 0.5) * 10;
+      }
+      points.push([x, y]);
+    }
+    paths.add(keep(new gdstk.FlexPath(points, 0.2 + random() * 0.5)));
+  }
+  cells.paths = paths;
+
+  // curved polygons: rings with many vertices
+  const curves = keep(new gdstk.Cell("CURVES"));
+  for (let i = 0; i < options.curves; i++) {
+    const r = 5 + random() * 20;
+    curves.add(keep(gdstk.ellipse([random() * 10000, random() * 10000], r,
+                                  r * (0.3 + random() * 0.5), 0, 0,
+                                  options.curve_tolerance, 30, 0)));
+  }
+  cells.curves = curves;
+
+  const top = keep(new gdstk.Cell("TOP"));
+  for (const name of Object.keys(cells)) {
+    top.add(keep(new gdstk.Reference(cells[name])));
+  }
+
+  const library = keep(new gdstk.Library("BENCH", 1e-6, 1e-9));
+  for (const obj of objects) {
+    if (obj instanceof gdstk.Cell) library.add(obj);
+  }
+  return {library, top, cells, objects};
+}
+
+// Delete all js handles of a generated layout
+function release_layout(layout) {
+  for (let i = layout.objects.length - 1; i >= 0; i--) {
+    layout.objects[i].delete();
+  }
+  layout.objects.length = 0;
+}
+
+module.exports = {
+  DEFAULT_OPTIONS,
+  generate,
+  make_random,
+  release_layout,
+  scaled_options,
+};
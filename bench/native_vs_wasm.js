@@ -0,0 +1,68 @@
+// Run the benchmark suite against the wasm package and the native addon and
+// print the speedup of the addon for each case.
+//
+//   node bench/native_vs_wasm.js [--wasm packages/gdstk.js]
+//                                [--native build-node/index.js]
+//                                [--out results.json] [run.js options...]
+//
+// Each build runs in its own node process (bench/run.js), so neither heap
+// affects the other.  Remaining options (--scale, --iterations, --filter) are
+// passed to run.js.
+const {execFileSync} = require("child_process");
+const fs = require("fs");
+const path = require("path");
+
+function parse_args(argv) {
+  const args = {
+    wasm: path.join(__dirname, "..", "packages", "gdstk.js"),
+    native: path.join(__dirname, "..", "build-node", "index.js"),
+    out: null,
+    forward: [],
+  };
+  for (let i = 0; i < argv.length; i += 2) {
+    const key = argv[i].replace(/^--/, "");
+    if (key === "wasm" || key === "native" || key === "out") {
+      args[key] = argv[i + 1];
+    } else {
+      args.forward.push(argv[i], argv[i + 1]);
+    }
+  }
+  return args;
+}
+
+function run(package_path, forward) {
+  console.error(`# ${package_path}`);
+  const output = execFileSync(
+      process.execPath,
+      [path.join(__dirname, "run.js"), "--package", package_path, ...forward],
+      {stdio: ["ignore", "pipe", "inherit"], maxBuffer: 64 * 1024 * 1024});
+  return JSON.parse(output.toString());
+}
+
+const args = parse_args(process.argv.slice(2));
+const wasm = run(args.wasm, args.forward);
+const native = run(args.native, args.forward);
+
+const rows = [];
+for (const name of Object.keys(wasm.results)) {
+  if (!(name in native.results)) continue;
+  const w = wasm.results[name].median_ms;
+  const n = native.results[name].median_ms;
+  rows.push({name, wasm_ms: w, native_ms: n, speedup: n > 0 ? w / n : null});
+}
+
+console.log(
+    `${"case".padEnd(28)} ${"wasm ms".padStart(10)} ${"native ms".padStart(10)}` +
+    ` ${"speedup".padStart(8)}`);
+for (const row of rows) {
+  const speedup = row.speedup === null ? "-" : row.speedup.toFixed(2) + "x";
+  console.log(
+      `${row.name.padEnd(28)} ${row.wasm_ms.toFixed(3).padStart(10)} ` +
+      `${row.native_ms.toFixed(3).padStart(10)} ${speedup.padStart(8)}`);
+}
+
+if (args.out) {
+  fs.writeFileSync(args.out,
+                   JSON.stringify({schema: 1, wasm, native, rows}, null, 2) +
+                       "\n");
+}
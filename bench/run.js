@@ -0,0 +1,357 @@
+// Benchmark suite for the wasm build in packages/.
+//
+//   node bench/run.js [--scale s] [--iterations n] [--filter regex]
+//                     [--out results.json] [--package path/to/gdstk.js]
+//
+// Prints one line per case to stderr and writes JSON results (stdout unless
+// --out is given) for regression tracking between versions.  Compare two
+// runs with bench/compare.js.
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+const {generate, release_layout, scaled_options} = require("./layout.js");
+
+function parse_args(argv) {
+  const args = {
+    scale: 0.1,
+    iterations: 5,
+    filter: null,
+    out: null,
+    package: path.join(__dirname, "..", "packages", "gdstk.js"),
+  };
+  for (let i = 0; i < argv.length; i++) {
+    const key = argv[i].replace(/^--/, "");
+    if (!(key in args)) throw new Error(`Unknown option ${argv[i]}`);
+    const value = argv[++i];
+    args[key] = typeof args[key] === "number" ? Number(value) : value;
+  }
+  return args;
+}
+
+function delete_all(objects) {
+  for (const obj of objects) obj.delete();
+}
+
+function summarize(times) {
+  const sorted = times.slice().sort((a, b) => a - b);
+  const mean = times.reduce((s, t) => s + t, 0) / times.length;
+  const variance =
+      times.reduce((s, t) => s + (t - mean) * (t - mean), 0) / times.length;
+  return {
+    iterations: times.length,
+    min_ms: sorted[0],
+    median_ms: sorted[Math.floor(sorted.length / 2)],
+    mean_ms: mean,
+    stddev_ms: Math.sqrt(variance),
+    max_ms: sorted[sorted.length - 1],
+  };
+}
+
+// Each case is {name, setup?, run, teardown?}.  setup and teardown are not
+// timed; run receives the value returned by setup and may return a value for
+// teardown.  One untimed warm up run precedes the iterations.
+function make_cases(gdstk, layout) {
+  const {library, top, cells} = layout;
+  const flat = (cell) => cell.get_polygons();
+  const curves = flat(cells.curves);
+  const all_rects = flat(cells.rectangles);
+  const rects = all_rects.slice(0, 100000);
+  delete_all(all_rects.slice(rects.length));
+  const grid = [];
+  for (let i = 0; i < 1000; i++) {
+    for (let j = 0; j < 100; j++) grid.push([i * 10, j * 100]);
+  }
+  // large polygons, as produced by curved layouts before GDSII export
+  const large = [];
+  for (let k = 0; k < 2; k++) {
+    const points = [];
+    for (let i = 0; i < 100000; i++) {
+      const t = (2 * Math.PI * i) / 100000;
+      const r = 1000 + 20 * Math.sin(50 * t + k);
+      points.push([r * Math.cos(t), r * Math.sin(t)]);
+    }
+    large.push(new gdstk.Polygon(points, 0, 0));
+  }
+  // plain js copies of points, read through the PointsArray proxy
+  const to_array = (polygon) => {
+    const points = polygon.points;
+    const result = [];
+    for (let i = 0; i < points.length; i++) {
+      result.push([points[i][0], points[i][1]]);
+    }
+    return result;
+  };
+  const point_arrays = rects.map(to_array);
+  // window with a tenth of the top cell extent in each direction
+  const [top_min, top_max] = top.bounding_box();
+  const edited = cells.curves.polygons[0];
+  const window_size = [0.1 * (top_max[0] - top_min[0]),
+                       0.1 * (top_max[1] - top_min[1])];
+  const window_min = [0.5 * (top_min[0] + top_max[0] - window_size[0]),
+                      0.5 * (top_min[1] + top_max[1] - window_size[1])];
+  const window = [window_min, [window_min[0] + window_size[0],
+                               window_min[1] + window_size[1]]];
+
+  library.write_gds("bench_in.gds");
+  library.write_oas("bench_in.oas");
+
+  const cases = [
+    {name: "write_gds", run: () => library.write_gds("bench_out.gds")},
+    {name: "write_oas", run: () => library.write_oas("bench_out.oas")},
+    {
+      name: "write_oas_trapezoids",
+      run: () => library.write_oas("bench_out.oas", 6, true, true, 0, false,
+                                   null, true),
+    },
+    {
+      name: "read_gds",
+      run: () => gdstk.read_gds("bench_in.gds"),
+      teardown: (lib) => lib.delete(),
+    },
+    {
+      name: "read_oas",
+      run: () => gdstk.read_oas("bench_in.oas"),
+      teardown: (lib) => lib.delete(),
+    },
+    {
+      name: "library_delete",
+      setup: () => gdstk.read_gds("bench_in.gds"),
+      run: (lib) => lib.delete(),
+    },
+    {name: "get_polygons", run: () => flat(top), teardown: delete_all},
+    {
+      name: "get_polygons_aref",
+      run: () => flat(cells.aref),
+      teardown: delete_all,
+    },
+    {
+      name: "get_polygons_hierarchy",
+      run: () => flat(cells.hierarchy),
+      teardown: delete_all,
+    },
+    {
+      // transformed points written straight into typed arrays
+      name: "get_polygons_packed",
+      run: () => top.get_polygons_packed(),
+    },
+    {
+      name: "get_repeated_polygons_aref",
+      run: () => cells.aref.get_repeated_polygons(),
+      teardown: delete_all,
+    },
+    {name: "get_instances", run: () => top.get_instances()},
+    {name: "area", run: () => top.area(true)},
+    {name: "area_exact", run: () => top.area(true, true)},
+    {name: "bounding_box", run: () => top.bounding_box()},
+    {
+      // only CURVES and its ancestors are recomputed after the edit
+      name: "bounding_box_edit",
+      run: () => {
+        edited.translate(0, 0);
+        return top.bounding_box();
+      },
+    },
+    {
+      name: "query_window",
+      run: () => top.query(window),
+      teardown: (result) => {
+        delete_all(result.polygons);
+        delete_all(result.labels);
+      },
+    },
+    {
+      name: "boolean_or",
+      run: () => gdstk.boolean(rects, curves, "or"),
+      teardown: delete_all,
+    },
+    {
+      name: "boolean_not",
+      run: () => gdstk.boolean(rects, curves, "not"),
+      teardown: delete_all,
+    },
+    {
+      // rectilinear operands go through the Manhattan scanline
+      name: "boolean_manhattan",
+      run: () => gdstk.boolean(rects.slice(0, rects.length / 2),
+                               rects.slice(rects.length / 2), "xor"),
+      teardown: delete_all,
+    },
+    {
+      // one small operation per polygon, each with fresh scratch storage
+      name: "boolean_small",
+      run: () => {
+        const result = [];
+        for (let i = 0; i < curves.length; i++)
+          result.push(...gdstk.boolean(curves[i], rects[i % rects.length], "or"));
+        return result;
+      },
+      teardown: delete_all,
+    },
+    {
+      // the same operations sharing a GeometryContext
+      name: "boolean_small_context",
+      run: () => {
+        const context = new gdstk.GeometryContext();
+        const result = [];
+        for (let i = 0; i < curves.length; i++)
+          result.push(...context.boolean(curves[i], rects[i % rects.length], "or"));
+        context.delete();
+        return result;
+      },
+      teardown: delete_all,
+    },
+    {
+      name: "boolean_or_tiled",
+      run: () => gdstk.boolean(rects, curves, "or", {tile_size: "auto"}),
+      teardown: delete_all,
+    },
+    {
+      name: "boolean_layers",
+      run: () => cells.rectangles.boolean_layers([1, 0], [2, 0], "or"),
+      teardown: delete_all,
+    },
+    {
+      name: "boolean_layers_aref",
+      run: () => cells.aref.boolean_layers([20, 0], [21, 0], "or"),
+      teardown: delete_all,
+    },
+    {
+      name: "boolean_layers_aref_hierarchical",
+      run: () => cells.aref.boolean_layers([20, 0], [21, 0], "or",
+                                           {hierarchical: true}),
+      teardown: delete_all,
+    },
+    {
+      name: "offset_layer_hierarchical",
+      run: () => cells.hierarchy.offset_layer([10, 0], 0.1,
+                                              {hierarchical: true}),
+      teardown: delete_all,
+    },
+    {
+      name: "offset",
+      run: () => gdstk.offset(curves, 0.5),
+      teardown: delete_all,
+    },
+    {
+      name: "offset_manhattan",
+      run: () => gdstk.offset(rects, 0.1, "miter", 2, 1e-3, false, 0, 0),
+      teardown: delete_all,
+    },
+    {
+      name: "fracture",
+      run: () => {
+        const result = [];
+        for (const p of curves) result.push(...p.fracture());
+        return result;
+      },
+      teardown: delete_all,
+    },
+    {
+      name: "fracture_trapezoids",
+      run: () => {
+        const result = [];
+        for (const p of curves) result.push(...p.fracture(0, 1e-3, "trapezoids"));
+        return result;
+      },
+      teardown: delete_all,
+    },
+    {
+      name: "fracture_large",
+      run: () => {
+        const result = [];
+        for (const p of large) result.push(...p.fracture(199, 1e-3));
+        return result;
+      },
+      teardown: delete_all,
+    },
+    {name: "inside", run: () => gdstk.inside(grid, curves)},
+    {
+      name: "paths_to_polygons",
+      run: () => flat(cells.paths),
+      teardown: delete_all,
+    },
+    // binding marshaling: js arrays -> native and back
+    {
+      name: "marshal_polygon_from_array",
+      run: () => point_arrays.map((points) => new gdstk.Polygon(points)),
+      teardown: delete_all,
+    },
+    {
+      name: "marshal_read_points",
+      run: () => rects.map(to_array),
+    },
+    {
+      name: "marshal_cell_polygons",
+      run: () => cells.rectangles.polygons,
+      teardown: delete_all,
+    },
+  ];
+
+  const release = () => {
+    delete_all(curves);
+    delete_all(rects);
+  };
+  return {cases, release};
+}
+
+function run_case(c, iterations) {
+  const times = [];
+  for (let i = 0; i <= iterations; i++) {
+    const input = c.setup ? c.setup() : undefined;
+    const start = process.hrtime.bigint();
+    const output = c.run(input);
+    const elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+    if (c.teardown) c.teardown(output);
+    // first run is warm up
+    if (i > 0) times.push(elapsed);
+  }
+  return summarize(times);
+}
+
+async function main() {
+  const args = parse_args(process.argv.slice(2));
+  const Gdstk = require(path.resolve(args.package));
+  const gdstk = await Gdstk();
+  const filter = args.filter ? new RegExp(args.filter) : null;
+
+  const options = scaled_options(args.scale);
+  const results = {};
+
+  const start = process.hrtime.bigint();
+  const layout = generate(gdstk, options);
+  results.generate = summarize([Number(process.hrtime.bigint() - start) / 1e6]);
+
+  const {cases, release} = make_cases(gdstk, layout);
+  for (const c of cases) {
+    if (filter && !filter.test(c.name)) continue;
+    results[c.name] = run_case(c, args.iterations);
+    console.error(
+        `${c.name.padEnd(28)} ${results[c.name].median_ms.toFixed(3)} ms`);
+  }
+  release();
+  release_layout(layout);
+
+  const report = {
+    schema: 1,
+    date: new Date().toISOString(),
+    package: path.resolve(args.package),
+    node: process.version,
+    platform: `${os.platform()}-${os.arch()}`,
+    cpu: os.cpus().length > 0 ? os.cpus()[0].model : "",
+    threads: gdstk.thread_count(),
+    options: Object.assign({scale: args.scale}, options),
+    memory: gdstk.memory_stats(),
+    results,
+  };
+  const json = JSON.stringify(report, null, 2);
+  if (args.out) {
+    fs.writeFileSync(args.out, json + "\n");
+  } else {
+    console.log(json);
+  }
+}
+
+main().catch((e) => {
+  console.error(e);
+  process.exit(1);
+});
@@ -0,0 +1,62 @@
+// Fill the wasm heap with a synthetic layout past the wasm32 limit.
+//
+//   node examples/large_layout.js [gigabytes] [path/to/gdstk.js] [wasm32|wasm64]
+//
+// A wasm64 build (-DUSE_MEMORY64=ON, node >= 24 or
+// --experimental-wasm-memory64) must get past 4GB with exact sizes, a wasm32
+// build must fail cleanly once its heap is close to 4GB.  Without the last
+// argument, any failure is an error.
+const path = require("path");
+
+const target = Number(process.argv[2] || 5) * 2 ** 30;
+const Gdstk = require(process.argv[3] ||
+                      path.join(__dirname, "..", "packages", "gdstk.js"));
+const variant = process.argv[4] || "wasm64";
+
+Gdstk().then((gdstk) => {
+  if (!(gdstk.memory_stats().heap_size > 0)) {
+    console.log("No wasm heap to fill (native addon?)");
+    process.exit(1);
+  }
+  const cell = new gdstk.Cell("TOP");
+  // 10k points per polygon, 16 bytes each
+  const points = [];
+  for (let i = 0; i < 10000; i++) {
+    const a = (2 * Math.PI * i) / 10000;
+    points.push([Math.cos(a), Math.sin(a)]);
+  }
+  const polygon = new gdstk.Polygon(points);
+
+  let count = 0;
+  let heap_size = 0;
+  try {
+    while ((heap_size = gdstk.memory_stats().heap_size) < target) {
+      for (let i = 0; i < 100; i++) {
+        const p = polygon.copy();
+        p.translate([count % 1000, Math.floor(count / 1000)]);
+        cell.add(p);
+        count++;
+      }
+    }
+  } catch (e) {
+    console.log(`Failed after ${count} polygons, heap ${heap_size / 2 ** 30} GB: ${e}`);
+    // The wasm32 heap stops at 4GB: the failure is expected close to it
+    process.exit(variant === "wasm32" && heap_size > 3.5 * 2 ** 30 ? 0 : 1);
+  }
+  if (variant === "wasm32") {
+    console.log(`wasm32 heap reached ${heap_size / 2 ** 30} GB`);
+    process.exit(1);
+  }
+
+  const stats = gdstk.memory_stats();
+  console.log(`heap ${stats.heap_size / 2 ** 30} GB, ${count} polygons`);
+
+  // sizes must not be truncated to 32 bits
+  const total = cell.polygons.reduce((n, p) => n + p.size, 0);
+  if (total !== count * 10000) {
+    console.log(`Wrong point count ${total}, expected ${count * 10000}`);
+    process.exit(1);
+  }
+  const area = cell.area(false);
+  console.log(`area ${area}`);
+});
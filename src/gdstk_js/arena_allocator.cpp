@@ -0,0 +1,580 @@
+#include "arena_allocator.h"
+
+#include <string.h>
+
+#ifdef GDSTK_CUSTOM_ALLOCATOR
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <mutex>
+#include <new>
+
+namespace {
+
+using gdstk::MemoryCategory;
+
+const int NUM_CATEGORIES = (int)MemoryCategory::Count;
+
+// Slabs and arenas carve objects out of CHUNK_SIZE aligned chunks.  A chunk
+// starts with its header, so the owner of any pointer is found by masking
+// its address, once the page table confirms the region is one of ours.
+const uint64_t CHUNK_BITS = 16;
+const uint64_t CHUNK_SIZE = (uint64_t)1 << CHUNK_BITS;
+const uint64_t ALIGNMENT = 16;
+
+// Requests up to this size are served by slabs
+const uint64_t MAX_SLAB_SIZE = 256;
+const uint64_t NUM_SIZE_CLASSES = MAX_SLAB_SIZE / ALIGNMENT;
+
+// Larger arena requests go to the large allocation path
+const uint64_t MAX_ARENA_SIZE = CHUNK_SIZE / 4;
+
+enum struct ChunkKind { Slab, Arena };
+
+struct FreeObject {
+  FreeObject *next;
+};
+
+struct Chunk {
+  ChunkKind kind;
+  MemoryCategory category;
+  uint64_t size;  // object size for slabs
+  // Arena chunks: live allocations (see ARENA_BIAS).  Whoever brings it to
+  // zero frees the chunk.
+  std::atomic<uint64_t> live;
+  // Slab chunks, under the lock of their size class: objects handed out
+  // (thread caches included), freed objects, start of the untouched space,
+  // and links in the size class list of chunks with room
+  uint64_t used;
+  FreeObject *free_list;
+  uint8_t *bump;
+  Chunk *prev;
+  Chunk *next;
+};
+
+const uint64_t HEADER_SIZE =
+    (sizeof(Chunk) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+// Large allocations are prefixed with their size and category
+struct LargeHeader {
+  uint64_t size;
+  MemoryCategory category;
+};
+
+const uint64_t LARGE_HEADER_SIZE =
+    (sizeof(LargeHeader) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+inline uint64_t align(uint64_t size) {
+  return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+// Accounting -----------------------------------------------------------------
+struct Counters {
+  std::atomic<int64_t> live_bytes;
+  std::atomic<int64_t> peak_bytes;
+  std::atomic<int64_t> live_allocations;
+  std::atomic<int64_t> total_allocations;
+};
+
+Counters counters[NUM_CATEGORIES];
+std::atomic<int64_t> reserved_bytes;
+
+// Relaxed atomics only: peak is a best effort maximum
+void account(MemoryCategory category, int64_t bytes, int64_t allocations) {
+  Counters &c = counters[(int)category];
+  if (allocations > 0) {
+    c.total_allocations.fetch_add(allocations, std::memory_order_relaxed);
+  }
+  if (allocations != 0) {
+    c.live_allocations.fetch_add(allocations, std::memory_order_relaxed);
+  }
+  if (bytes == 0) return;
+  int64_t live =
+      c.live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  int64_t peak = c.peak_bytes.load(std::memory_order_relaxed);
+  while (live > peak && !c.peak_bytes.compare_exchange_weak(
+                            peak, live, std::memory_order_relaxed)) {
+  }
+}
+
+thread_local MemoryCategory current_category = MemoryCategory::Default;
+
+inline MemoryCategory category_or(MemoryCategory fallback) {
+  return current_category == MemoryCategory::Default ? fallback
+                                                     : current_category;
+}
+
+// Two level table with one byte per chunk sized region of the address space
+// (a single leaf covers all of wasm32)
+const uint64_t LEAF_BITS = 16;
+const uint64_t LEAF_SIZE = (uint64_t)1 << LEAF_BITS;
+#ifdef __wasm__
+const uint64_t ADDRESS_BITS = sizeof(void *) == 4 ? 32 : 40;
+#else
+const uint64_t ADDRESS_BITS = sizeof(void *) == 4 ? 32 : 48;
+#endif
+const uint64_t ROOT_SIZE = (uint64_t)1
+                           << (ADDRESS_BITS - CHUNK_BITS - LEAF_BITS);
+
+std::atomic<std::atomic<uint8_t> *> page_table[ROOT_SIZE];
+
+std::atomic<uint8_t> *page_leaf(uintptr_t address, bool create) {
+  uint64_t index = (uint64_t)address >> (CHUNK_BITS + LEAF_BITS);
+  if (index >= ROOT_SIZE) return nullptr;
+  std::atomic<uint8_t> *leaf = page_table[index].load(std::memory_order_acquire);
+  if (leaf || !create) return leaf;
+  auto fresh = (std::atomic<uint8_t> *)calloc(LEAF_SIZE, sizeof(uint8_t));
+  if (page_table[index].compare_exchange_strong(leaf, fresh,
+                                                std::memory_order_acq_rel)) {
+    return fresh;
+  }
+  free(fresh);
+  return leaf;
+}
+
+bool set_page(Chunk *chunk, uint8_t value) {
+  uintptr_t address = (uintptr_t)chunk;
+  std::atomic<uint8_t> *leaf = page_leaf(address, true);
+  if (!leaf) return false;
+  leaf[(address >> CHUNK_BITS) & (LEAF_SIZE - 1)].store(
+      value, std::memory_order_release);
+  return true;
+}
+
+Chunk *find_chunk(const void *ptr) {
+  uintptr_t address = (uintptr_t)ptr;
+  std::atomic<uint8_t> *leaf = page_leaf(address, false);
+  if (!leaf ||
+      !leaf[(address >> CHUNK_BITS) & (LEAF_SIZE - 1)].load(
+          std::memory_order_acquire)) {
+    return nullptr;
+  }
+  return (Chunk *)(address & ~(uintptr_t)(CHUNK_SIZE - 1));
+}
+
+Chunk *new_chunk(ChunkKind kind, MemoryCategory category) {
+  void *memory = nullptr;
+  if (posix_memalign(&memory, CHUNK_SIZE, CHUNK_SIZE) != 0) return nullptr;
+  Chunk *chunk = (Chunk *)memory;
+  chunk->kind = kind;
+  chunk->category = category;
+  chunk->size = 0;
+  new (&chunk->live) std::atomic<uint64_t>(0);
+  chunk->used = 0;
+  chunk->free_list = nullptr;
+  chunk->bump = (uint8_t *)chunk + HEADER_SIZE;
+  chunk->prev = nullptr;
+  chunk->next = nullptr;
+  if (!set_page(chunk, 1)) {
+    free(chunk);
+    return nullptr;
+  }
+  reserved_bytes.fetch_add(CHUNK_SIZE, std::memory_order_relaxed);
+  return chunk;
+}
+
+void free_chunk(Chunk *chunk) {
+  set_page(chunk, 0);
+  free(chunk);
+  reserved_bytes.fetch_sub(CHUNK_SIZE, std::memory_order_relaxed);
+}
+
+// Size class slabs, one set per category ------------------------------------
+// Each thread keeps up to CACHE_SIZE free objects per size class, so most
+// allocations and frees take no lock.  Refills and flushes move half a cache
+// at once under the size class lock.  A slab chunk whose objects all came
+// back is freed, except for one spare per size class.
+const uint32_t CACHE_SIZE = 64;
+const uint64_t MAX_EMPTY_CHUNKS = 1;
+
+struct SizeClass {
+  std::mutex mutex;
+  Chunk *partial = nullptr;  // chunks with room
+  uint64_t empty = 0;        // chunks of partial with no object used
+};
+
+SizeClass size_classes[NUM_CATEGORIES][NUM_SIZE_CLASSES];
+
+inline bool has_room(const Chunk *chunk) {
+  return chunk->free_list ||
+         chunk->bump + chunk->size <= (uint8_t *)chunk + CHUNK_SIZE;
+}
+
+void link_chunk(SizeClass &size_class, Chunk *chunk) {
+  chunk->prev = nullptr;
+  chunk->next = size_class.partial;
+  if (chunk->next) chunk->next->prev = chunk;
+  size_class.partial = chunk;
+}
+
+void unlink_chunk(SizeClass &size_class, Chunk *chunk) {
+  if (chunk->prev) {
+    chunk->prev->next = chunk->next;
+  } else {
+    size_class.partial = chunk->next;
+  }
+  if (chunk->next) chunk->next->prev = chunk->prev;
+}
+
+// Take up to count objects, returned as a list
+FreeObject *take_objects(SizeClass &size_class, MemoryCategory category,
+                         uint64_t object_size, uint32_t &count) {
+  std::lock_guard<std::mutex> lock(size_class.mutex);
+  FreeObject *list = nullptr;
+  uint32_t taken = 0;
+  while (taken < count) {
+    Chunk *chunk = size_class.partial;
+    if (!chunk) {
+      chunk = new_chunk(ChunkKind::Slab, category);
+      if (!chunk) break;
+      chunk->size = object_size;
+      link_chunk(size_class, chunk);
+      size_class.empty++;
+    }
+    if (chunk->used == 0) size_class.empty--;
+    while (taken < count && has_room(chunk)) {
+      FreeObject *object = chunk->free_list;
+      if (object) {
+        chunk->free_list = object->next;
+      } else {
+        object = (FreeObject *)chunk->bump;
+        chunk->bump += object_size;
+      }
+      object->next = list;
+      list = object;
+      chunk->used++;
+      taken++;
+    }
+    if (!has_room(chunk)) unlink_chunk(size_class, chunk);
+  }
+  count = taken;
+  return list;
+}
+
+// Give back count objects of list to their chunks
+void return_objects(SizeClass &size_class, FreeObject *list, uint32_t count) {
+  std::lock_guard<std::mutex> lock(size_class.mutex);
+  for (; count > 0; count--) {
+    FreeObject *object = list;
+    list = object->next;
+    Chunk *chunk = (Chunk *)((uintptr_t)object & ~(uintptr_t)(CHUNK_SIZE - 1));
+    if (!has_room(chunk)) link_chunk(size_class, chunk);
+    object->next = chunk->free_list;
+    chunk->free_list = object;
+    if (--chunk->used > 0) continue;
+    if (size_class.empty < MAX_EMPTY_CHUNKS) {
+      size_class.empty++;
+    } else {
+      unlink_chunk(size_class, chunk);
+      free_chunk(chunk);
+    }
+  }
+}
+
+struct ThreadCache {
+  FreeObject *objects[NUM_CATEGORIES][NUM_SIZE_CLASSES];
+  uint32_t count[NUM_CATEGORIES][NUM_SIZE_CLASSES];
+
+  ~ThreadCache() {
+    for (int i = 0; i < NUM_CATEGORIES; i++) {
+      for (uint64_t j = 0; j < NUM_SIZE_CLASSES; j++) {
+        if (count[i][j] > 0) {
+          return_objects(size_classes[i][j], objects[i][j], count[i][j]);
+        }
+        objects[i][j] = nullptr;
+        count[i][j] = 0;
+      }
+    }
+  }
+};
+
+thread_local ThreadCache thread_cache;
+
+void *slab_allocate(uint64_t size, MemoryCategory category) {
+  uint64_t index = size == 0 ? 0 : (size - 1) / ALIGNMENT;
+  uint64_t object_size = (index + 1) * ALIGNMENT;
+  ThreadCache &cache = thread_cache;
+  FreeObject *&objects = cache.objects[(int)category][index];
+  uint32_t &count = cache.count[(int)category][index];
+  if (!objects) {
+    count = CACHE_SIZE / 2;
+    objects = take_objects(size_classes[(int)category][index], category,
+                           object_size, count);
+    if (!objects) return nullptr;
+  }
+  FreeObject *object = objects;
+  objects = object->next;
+  count--;
+  account(category, object_size, 1);
+  return object;
+}
+
+void slab_free(Chunk *chunk, void *ptr) {
+  uint64_t index = chunk->size / ALIGNMENT - 1;
+  MemoryCategory category = chunk->category;
+  account(category, -(int64_t)chunk->size, -1);
+  ThreadCache &cache = thread_cache;
+  FreeObject *&objects = cache.objects[(int)category][index];
+  uint32_t &count = cache.count[(int)category][index];
+  FreeObject *object = (FreeObject *)ptr;
+  object->next = objects;
+  objects = object;
+  if (++count <= CACHE_SIZE) return;
+  // Keep the most recently freed half
+  FreeObject *last = objects;
+  for (uint32_t i = 1; i < CACHE_SIZE / 2; i++) last = last->next;
+  FreeObject *flushed = last->next;
+  last->next = nullptr;
+  return_objects(size_classes[(int)category][index], flushed,
+                 count - CACHE_SIZE / 2);
+  count = CACHE_SIZE / 2;
+}
+
+// Large allocations ----------------------------------------------------------
+void *large_allocate(uint64_t size, MemoryCategory category, bool clear) {
+  uint64_t total = LARGE_HEADER_SIZE + size;
+  void *memory = clear ? calloc(1, total) : malloc(total);
+  if (!memory) return nullptr;
+  LargeHeader *header = (LargeHeader *)memory;
+  header->size = size;
+  header->category = category;
+  account(category, size, 1);
+  return (uint8_t *)memory + LARGE_HEADER_SIZE;
+}
+
+inline LargeHeader *large_header(void *ptr) {
+  return (LargeHeader *)((uint8_t *)ptr - LARGE_HEADER_SIZE);
+}
+
+void large_free(void *ptr) {
+  LargeHeader *header = large_header(ptr);
+  account(header->category, -(int64_t)header->size, -1);
+  free(header);
+}
+
+void *large_reallocate(void *ptr, uint64_t size) {
+  LargeHeader *header = large_header(ptr);
+  MemoryCategory category = header->category;
+  int64_t old_size = header->size;
+  header = (LargeHeader *)realloc(header, LARGE_HEADER_SIZE + size);
+  if (!header) return nullptr;
+  header->size = size;
+  account(category, (int64_t)size - old_size, 0);
+  return (uint8_t *)header + LARGE_HEADER_SIZE;
+}
+
+thread_local utils::Arena *current_arena = nullptr;
+
+}  // namespace
+
+// Arenas ---------------------------------------------------------------------
+// Only the thread owning the scope allocates from an arena; frees may come
+// from any thread.  The arena holds only the chunk it bump allocates from, so
+// every other chunk goes back to the heap with its last allocation, and an
+// object kept alive pins its own chunk, not the whole load.  Arena memory is
+// accounted as Library, by chunk.
+namespace {
+// While the arena allocates from a chunk, its live counter starts from
+// ARENA_BIAS instead of counting each allocation; the arena settles the
+// difference when it moves on, so bump allocation needs no atomics.
+const uint64_t ARENA_BIAS = (uint64_t)1 << 48;
+
+void release_arena_chunk(Chunk *chunk, uint64_t count) {
+  if (chunk->live.fetch_sub(count, std::memory_order_acq_rel) != count) return;
+  free_chunk(chunk);
+  account(MemoryCategory::Library, -(int64_t)CHUNK_SIZE, 0);
+}
+}  // namespace
+
+class utils::Arena {
+ public:
+  ~Arena() {
+    if (chunk) release_arena_chunk(chunk, ARENA_BIAS - allocations);
+  }
+
+  // Zero sized requests still get their own address
+  void *allocate(uint64_t size) {
+    size = align(size > 0 ? size : 1);
+    if (top + size > end) {
+      Chunk *fresh = new_chunk(ChunkKind::Arena, MemoryCategory::Library);
+      if (!fresh) return nullptr;
+      fresh->live.store(ARENA_BIAS, std::memory_order_relaxed);
+      account(MemoryCategory::Library, CHUNK_SIZE, 0);
+      if (chunk) release_arena_chunk(chunk, ARENA_BIAS - allocations);
+      chunk = fresh;
+      allocations = 0;
+      top = (uint8_t *)chunk + HEADER_SIZE;
+      end = (uint8_t *)chunk + CHUNK_SIZE;
+    }
+    last = top;
+    top += size;
+    allocations++;
+    account(MemoryCategory::Library, 0, 1);
+    return last;
+  }
+
+  // Grow the most recent allocation in place if it fits
+  bool extend(void *ptr, uint64_t size) {
+    if (ptr != last || (uint8_t *)ptr + align(size) > end) return false;
+    top = (uint8_t *)ptr + align(size);
+    return true;
+  }
+
+  Chunk *chunk = nullptr;
+  uint64_t allocations = 0;  // made from chunk
+  uint8_t *top = nullptr;
+  uint8_t *end = nullptr;
+  uint8_t *last = nullptr;
+};
+
+utils::ArenaScope::ArenaScope()
+    : arena_(new Arena()), previous_(current_arena) {
+  current_arena = arena_;
+}
+
+utils::ArenaScope::~ArenaScope() {
+  current_arena = previous_;
+  delete arena_;
+}
+
+bool utils::get_memory_stats(MemoryStats stats[NUM_CATEGORIES]) {
+  for (int i = 0; i < NUM_CATEGORIES; i++) {
+    stats[i].live_bytes = counters[i].live_bytes.load(std::memory_order_relaxed);
+    stats[i].peak_bytes = counters[i].peak_bytes.load(std::memory_order_relaxed);
+    stats[i].live_allocations =
+        counters[i].live_allocations.load(std::memory_order_relaxed);
+    stats[i].total_allocations =
+        counters[i].total_allocations.load(std::memory_order_relaxed);
+  }
+  return true;
+}
+
+int64_t utils::get_reserved_bytes() {
+  return reserved_bytes.load(std::memory_order_relaxed);
+}
+
+// gdstk allocator hooks -------------------------------------------------------
+gdstk::MemoryCategory gdstk::set_memory_category(MemoryCategory category) {
+  MemoryCategory previous = current_category;
+  current_category = category;
+  return previous;
+}
+
+// Chunk allocation failures fall back to the large allocation path.  Thread
+// locals are read once (each read is a call in a shared object).
+void *gdstk::allocate(uint64_t size) {
+  utils::Arena *arena = current_arena;
+  if (arena && size <= MAX_ARENA_SIZE) {
+    void *result = arena->allocate(size);
+    if (result) return result;
+  }
+  MemoryCategory category = category_or(MemoryCategory::Geometry);
+  void *result = nullptr;
+  if (!arena && size <= MAX_SLAB_SIZE) result = slab_allocate(size, category);
+  return result ? result : large_allocate(size, category, false);
+}
+
+void *gdstk::allocate_clear(uint64_t size) {
+  if (size > MAX_SLAB_SIZE && !current_arena) {
+    return large_allocate(size, category_or(MemoryCategory::Geometry), true);
+  }
+  void *ptr = allocate(size);
+  if (ptr) memset(ptr, 0, size);
+  return ptr;
+}
+
+void gdstk::free_allocation(void *ptr) {
+  if (!ptr) return;
+  Chunk *chunk = find_chunk(ptr);
+  if (!chunk) {
+    large_free(ptr);
+  } else if (chunk->kind == ChunkKind::Slab) {
+    slab_free(chunk, ptr);
+  } else {
+    account(MemoryCategory::Library, 0, -1);
+    release_arena_chunk(chunk, 1);
+  }
+}
+
+void *gdstk::reallocate(void *ptr, uint64_t size) {
+  if (!ptr) return allocate(size);
+  Chunk *chunk = find_chunk(ptr);
+  if (!chunk) return large_reallocate(ptr, size);
+
+  uint64_t old_size;
+  if (chunk->kind == ChunkKind::Slab) {
+    if (size <= chunk->size) return ptr;
+    old_size = chunk->size;
+  } else {
+    if (current_arena && current_arena->extend(ptr, size)) return ptr;
+    // Arena sizes are not recorded: copy up to the requested size, bounded by
+    // the end of the chunk (the old allocation is never larger)
+    old_size = (uint8_t *)chunk + CHUNK_SIZE - (uint8_t *)ptr;
+  }
+
+  void *result = allocate(size);
+  if (!result) return nullptr;
+  memcpy(result, ptr, size < old_size ? size : old_size);
+  free_allocation(ptr);
+  return result;
+}
+
+// C++ heap (binding maps, std containers, clipper) ----------------------------
+// Never placed in arenas: containers outlive loads and would pin them.  The
+// native addon keeps the system heap (GDSTK_JS_SYSTEM_CPP_HEAP).
+#ifndef GDSTK_JS_SYSTEM_CPP_HEAP
+namespace {
+void *cpp_allocate(size_t size) {
+  MemoryCategory category = category_or(MemoryCategory::Bindings);
+  void *result = nullptr;
+  if (size <= MAX_SLAB_SIZE) result = slab_allocate(size, category);
+  if (!result) result = large_allocate(size, category, false);
+  if (!result) throw std::bad_alloc();
+  return result;
+}
+
+void cpp_free(void *ptr) {
+  if (!ptr) return;
+  Chunk *chunk = find_chunk(ptr);
+  if (!chunk) {
+    large_free(ptr);
+  } else {
+    slab_free(chunk, ptr);
+  }
+}
+}  // namespace
+
+void *operator new(size_t size) { return cpp_allocate(size); }
+void *operator new[](size_t size) { return cpp_allocate(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return cpp_allocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return cpp_allocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+void operator delete(void *ptr) noexcept { cpp_free(ptr); }
+void operator delete[](void *ptr) noexcept { cpp_free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { cpp_free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { cpp_free(ptr); }
+#endif  // GDSTK_JS_SYSTEM_CPP_HEAP
+
+#else  // GDSTK_CUSTOM_ALLOCATOR
+
+bool utils::get_memory_stats(
+    MemoryStats stats[(int)gdstk::MemoryCategory::Count]) {
+  memset(stats, 0, sizeof(MemoryStats) * (int)gdstk::MemoryCategory::Count);
+  return false;
+}
+
+int64_t utils::get_reserved_bytes() { return 0; }
+
+#endif  // GDSTK_CUSTOM_ALLOCATOR
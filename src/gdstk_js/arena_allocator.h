@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "gdstk/allocator.h"
+
+namespace utils {
+
+class Arena;
+
+// While an ArenaScope is alive, gdstk allocations made by the current thread
+// are bump allocated from a fresh arena.  Freeing arena memory only
+// decrements a counter of its chunk, and each chunk goes back to the heap
+// once the arena moved past it and its last allocation was freed: tearing
+// down a loaded library releases its chunks as it goes, and objects kept
+// alive by js only pin their own chunks.  Used around bulk loads (read_gds,
+// read_oas) whose objects are released together.
+//
+// Outside arenas, small allocations come from size class slabs (through per
+// thread caches, empty slab chunks are freed) and larger ones from malloc.  Without GDSTK_CUSTOM_ALLOCATOR this is a no-op and gdstk
+// uses plain malloc.
+class ArenaScope {
+ public:
+  ArenaScope();
+  ~ArenaScope();
+  ArenaScope(const ArenaScope &) = delete;
+  ArenaScope &operator=(const ArenaScope &) = delete;
+
+ private:
+  Arena *arena_;
+  Arena *previous_;
+};
+
+#ifndef GDSTK_CUSTOM_ALLOCATOR
+inline ArenaScope::ArenaScope() : arena_(nullptr), previous_(nullptr) {}
+inline ArenaScope::~ArenaScope() {}
+#endif
+
+// Heap accounting of one gdstk::MemoryCategory.  Arenas are accounted by
+// chunk, slabs by size class and everything else by requested size.
+struct MemoryStats {
+  int64_t live_bytes;
+  int64_t peak_bytes;
+  int64_t live_allocations;
+  int64_t total_allocations;
+};
+
+// Copy the counters of every category into stats, indexed by
+// gdstk::MemoryCategory.  Returns false (and zeroes stats) without
+// GDSTK_CUSTOM_ALLOCATOR.
+bool get_memory_stats(MemoryStats stats[(int)gdstk::MemoryCategory::Count]);
+
+// Bytes held by slab and arena chunks, used or not
+int64_t get_reserved_bytes();
+
+}  // namespace utils
@@ -0,0 +1,161 @@
+#include "async_job.h"
+
+#include <emscripten.h>
+
+#include <exception>
+
+#include "thread_pool.h"
+
+using emscripten::val;
+
+// Poll job until finished, forwarding progress, then settle the Promise.
+// Work starts on the first tick so the Promise is returned (and an abort
+// signal can fire) before any blocking work.
+EM_JS(EM_VAL, run_async_job,
+      (EM_VAL job_handle, EM_VAL progress_handle, EM_VAL signal_handle), {
+  const job = Emval.toValue(job_handle);
+  const on_progress = Emval.toValue(progress_handle);
+  const signal = Emval.toValue(signal_handle);
+  const promise = new Promise((resolve, reject) => {
+    const abort = () => job.cancel();
+    if (signal) {
+      if (signal.aborted) job.cancel();
+      signal.addEventListener("abort", abort);
+    }
+    let done = -1;
+    let total = -1;
+    const report = () => {
+      const d = job.done();
+      const t = job.total();
+      if (on_progress && (d !== done || t !== total)) {
+        done = d;
+        total = t;
+        on_progress(d, t);
+      }
+    };
+    let callback_error = null;
+    const step = () => {
+      try {
+        report();
+      } catch (e) {
+        // a failing progress callback stops the job and rejects with its error
+        if (callback_error === null) callback_error = e;
+        job.cancel();
+      }
+      if (!job.finished()) {
+        setTimeout(step, 16);
+        return;
+      }
+      if (signal) signal.removeEventListener("abort", abort);
+      if (callback_error !== null) {
+        reject(callback_error);
+      } else if (job.cancelled()) {
+        const e = new Error("The operation was aborted.");
+        e.name = "AbortError";
+        reject(e);
+      } else {
+        const result = job.result();
+        const error = job.error();
+        if (error) {
+          reject(new Error(error));
+        } else {
+          resolve(result);
+        }
+      }
+      job.delete();
+    };
+    setTimeout(() => {
+      job.start();
+      step();
+    }, 0);
+  });
+  return Emval.toHandle(promise);
+});
+
+namespace {
+const char *error_message(gdstk::ErrorCode error_code) {
+  switch (error_code) {
+    case gdstk::ErrorCode::ChecksumError:
+      return "Checksum error.";
+    case gdstk::ErrorCode::OutputFileOpenError:
+      return "Unable to open output file.";
+    case gdstk::ErrorCode::InputFileOpenError:
+      return "Unable to open input file.";
+    case gdstk::ErrorCode::InputFileError:
+      return "Error reading input file.";
+    case gdstk::ErrorCode::FileError:
+      return "File error.";
+    case gdstk::ErrorCode::InvalidFile:
+      return "Invalid or corrupted file.";
+    case gdstk::ErrorCode::InsufficientMemory:
+      return "Insufficient memory.";
+    case gdstk::ErrorCode::ZlibError:
+      return "Zlib error.";
+    default:
+      return nullptr;
+  }
+}
+}  // namespace
+
+val utils::AsyncJob::run(Work work, Finish finish, const val &options) {
+  auto job = std::make_shared<AsyncJob>(std::move(work), std::move(finish));
+  val on_progress = val::undefined();
+  val signal = val::undefined();
+  if (!options.isNull() && !options.isUndefined()) {
+    on_progress = options["progress"];
+    signal = options["signal"];
+  }
+  return val::take_ownership(run_async_job(
+      val(job).as_handle(), on_progress.as_handle(), signal.as_handle()));
+}
+
+utils::AsyncJob::AsyncJob(Work work, Finish finish)
+    : work_(std::move(work)), finish_(std::move(finish)) {
+  progress_.done = 0;
+  progress_.total = 0;
+  progress_.cancel = false;
+}
+
+void utils::AsyncJob::start() {
+  if (started_.exchange(true)) return;
+  // The js wrapper holds the job until it is finished, so the reference taken
+  // here is dropped before signalling: the job (and anything captured by work
+  // and finish) is always destroyed on the js thread.
+  auto self = shared_from_this();
+  ThreadPool::instance().submit([self]() mutable {
+    AsyncJob *job = self.get();
+    self.reset();
+    gdstk::set_progress(&job->progress_);
+    if (job->progress_.cancel) {
+      job->error_code_ = gdstk::ErrorCode::Cancelled;
+    } else {
+      try {
+        job->error_code_ = job->work_();
+      } catch (const std::exception &e) {
+        job->error_ = e.what();
+      } catch (...) {
+        job->error_ = "Unknown error.";
+      }
+    }
+    gdstk::set_progress(nullptr);
+    job->finished_.store(true, std::memory_order_release);
+  });
+}
+
+bool utils::AsyncJob::cancelled() const {
+  return error_code_ == gdstk::ErrorCode::Cancelled;
+}
+
+val utils::AsyncJob::result() {
+  if (error_.empty()) {
+    const char *message = error_message(error_code_);
+    if (message) error_ = message;
+  }
+  if (!error_.empty() || cancelled()) return val::undefined();
+  try {
+    return finish_();
+  } catch (const std::exception &e) {
+    error_ = e.what();
+  }
+  return val::undefined();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <emscripten/val.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "gdstk.h"
+
+namespace utils {
+
+// Long running native operation settled through a js Promise.
+//
+// work runs on utils::ThreadPool (inline on the js thread without pthreads)
+// with a gdstk::Progress installed, so core loops report progress and stop
+// early when cancelled.  It must only touch native data.  finish runs on the
+// js thread after work succeeded and converts the result to js; binding state
+// (keep alive maps, vals) may only be touched there.
+//
+// The js side polls the job from a timer: progress callbacks and the Promise
+// settlement always happen on the js thread.
+class AsyncJob : public std::enable_shared_from_this<AsyncJob> {
+ public:
+  typedef std::function<gdstk::ErrorCode()> Work;
+  typedef std::function<emscripten::val()> Finish;
+
+  // Start job and return its Promise.  options is null or an object with
+  // optional members progress (function(done, total)) and signal
+  // (AbortSignal).  The Promise rejects with an Error named "AbortError" when
+  // cancelled and with an Error for exceptions and gdstk errors (warnings
+  // are ignored, like the synchronous versions do).
+  static emscripten::val run(Work work, Finish finish,
+                             const emscripten::val &options);
+
+  AsyncJob(Work work, Finish finish);
+
+  // Methods below are called by the js glue only
+  void start();
+  void cancel() { progress_.cancel = true; }
+  bool finished() const { return finished_.load(std::memory_order_acquire); }
+  double done() const { return (double)progress_.done; }
+  double total() const { return (double)progress_.total; }
+  bool cancelled() const;
+  // Run finish and return its value, or undefined if the job failed
+  emscripten::val result();
+  // Error message, empty if none
+  const std::string &error() const { return error_; }
+
+ private:
+  Work work_;
+  Finish finish_;
+  gdstk::Progress progress_;
+  gdstk::ErrorCode error_code_{gdstk::ErrorCode::NoError};
+  std::string error_;
+  std::atomic<bool> started_{false};
+  std::atomic<bool> finished_{false};
+};
+
+}  // namespace utils
@@ -1,5 +1,7 @@
 #include "binding_utils.h"
 
+#include <algorithm>
+#include <functional>
 #include <unordered_map>
 
 val vec2_to_js_array(const Vec2 &vec);
@@ -12,6 +14,7 @@ const val utils::gdstk_array2js_array_by_ref(const Array<Vec2> &array) {
 }
 
 const val utils::gdstk_array2js_array_by_value(const Array<Vec2> &array) {
+  gdstk::TraceSpan span("marshal:to_js");
   auto js_array = val::array();
   for (uint64_t it = 0; it < array.count; ++it) {
     js_array.call<void>("push", vec2_to_js_array(*(array.items + it)));
@@ -20,7 +23,8 @@ const val utils::gdstk_array2js_array_by_value(const Array<Vec2> &array) {
 }
 
 std::shared_ptr<Array<Vec2>> utils::js_array2gdstk_arrayvec2(const val &array) {
-  auto length = array["length"].as<size_t>();
+  gdstk::TraceSpan span("marshal:from_js");
+  auto length = utils::js_length(array);
   auto gdstk_array = make_gdstk_array<Vec2>();
   for (size_t i = 0; i < length; i++) {
     gdstk_array->append(js_array2vec2(array[i]));
@@ -53,6 +57,95 @@ std::unordered_map<Library *, std::unordered_set<std::shared_ptr<Cell>>>
 std::unordered_map<Library *, std::unordered_set<std::shared_ptr<RawCell>>>
     utils::LIB_KEEP_ALIVE_RAWCELL;
 
+std::unordered_set<Cell *> utils::MODIFIED_CELLS;
+std::vector<const void *> utils::MODIFIED_ADDRESSES;
+
+namespace {
+
+// True if any of the sorted addresses lies in [begin, end)
+bool any_address_in(const std::vector<const void *> &addresses,
+                    const void *begin, const void *end) {
+  auto it = std::lower_bound(addresses.begin(), addresses.end(), begin,
+                             std::less<const void *>());
+  return it != addresses.end() && std::less<const void *>()(*it, end);
+}
+
+template <class T>
+bool any_address_in(const std::vector<const void *> &addresses, const T *item,
+                    uint64_t count) {
+  return count > 0 && any_address_in(addresses, item, item + count);
+}
+
+// True if any of the sorted addresses lies in an element of cell
+bool cell_holds_address(const Cell *cell,
+                        const std::vector<const void *> &addresses) {
+  for (uint64_t i = 0; i < cell->polygon_array.count; i++) {
+    const Polygon *polygon = cell->polygon_array[i];
+    if (any_address_in(addresses, polygon, 1) ||
+        any_address_in(addresses, polygon->point_array.items,
+                       polygon->point_array.count))
+      return true;
+  }
+  for (uint64_t i = 0; i < cell->flexpath_array.count; i++) {
+    const FlexPath *path = cell->flexpath_array[i];
+    if (any_address_in(addresses, path, 1) ||
+        any_address_in(addresses, path->spine.point_array.items,
+                       path->spine.point_array.count) ||
+        any_address_in(addresses, path->elements, path->num_elements))
+      return true;
+  }
+  for (uint64_t i = 0; i < cell->robustpath_array.count; i++) {
+    if (any_address_in(addresses, cell->robustpath_array[i], 1)) return true;
+  }
+  for (uint64_t i = 0; i < cell->reference_array.count; i++) {
+    if (any_address_in(addresses, cell->reference_array[i], 1)) return true;
+  }
+  for (uint64_t i = 0; i < cell->label_array.count; i++) {
+    if (any_address_in(addresses, cell->label_array[i], 1)) return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+void utils::flush_modified() {
+  if (MODIFIED_CELLS.empty() && MODIFIED_ADDRESSES.empty()) return;
+  gdstk::TraceSpan span("cache:invalidate");
+  std::sort(MODIFIED_ADDRESSES.begin(), MODIFIED_ADDRESSES.end(),
+            std::less<const void *>());
+
+  // Every live cell is registered in CELL_KEEP_ALIVE_GEOM
+  std::unordered_map<Cell *, std::vector<Cell *>> parents;
+  std::vector<Cell *> stack;
+  for (auto &item : CELL_KEEP_ALIVE_GEOM) {
+    Cell *cell = item.first;
+    for (uint64_t i = 0; i < cell->reference_array.count; i++) {
+      const Reference *reference = cell->reference_array[i];
+      if (reference->type == ReferenceType::Cell)
+        parents[reference->cell].push_back(cell);
+    }
+    if (MODIFIED_CELLS.count(cell) > 0 ||
+        (!MODIFIED_ADDRESSES.empty() &&
+         cell_holds_address(cell, MODIFIED_ADDRESSES)))
+      stack.push_back(cell);
+  }
+
+  std::unordered_set<Cell *> cleared;
+  while (!stack.empty()) {
+    Cell *cell = stack.back();
+    stack.pop_back();
+    if (!cleared.insert(cell).second) continue;
+    cell->clear_geometry_info();
+    cell->clear_index();
+    auto it = parents.find(cell);
+    if (it != parents.end())
+      stack.insert(stack.end(), it->second.begin(), it->second.end());
+  }
+
+  MODIFIED_CELLS.clear();
+  MODIFIED_ADDRESSES.clear();
+}
+
 // point array containor ------------------------------------------------------
 
 // shared_ptr deleter ---------------------------------------------------------
@@ -84,12 +177,38 @@ void utils::FlexPathDeleter::operator()(FlexPath *flexpath) const {
   gdstk::free_allocation(flexpath);
 }
 
-void utils::RobustPathDeleter::operator()(RobustPath *flexpath) const {
-  throw std::runtime_error("Not implemented yet");
+void utils::RobustPathDeleter::operator()(RobustPath *robustpath) const {
+  robustpath->clear();
+  gdstk::free_allocation(robustpath);
 }
 
+namespace {
+// Free the elements of array that js never saw, the others go with their
+// shared_ptr in entries
+template <typename T, typename Entries>
+void delete_unshared(const Array<T *> &array, const Entries &entries) {
+  for (uint64_t i = 0; i < array.count; i++) {
+    T *element = array[i];
+    if (entries.count(element) == 0) utils::element_deleter(element)(element);
+  }
+}
+}  // namespace
+
 void utils::CellDeleter::operator()(Cell *cell) const {
-  utils::CELL_KEEP_ALIVE_GEOM.erase(cell);
+  // Deleting references may delete other cells, which erase their own
+  // entries: take ours out first
+  GeomPtr geom;
+  auto it = utils::CELL_KEEP_ALIVE_GEOM.find(cell);
+  if (it != utils::CELL_KEEP_ALIVE_GEOM.end()) {
+    geom = std::move(it->second);
+    utils::CELL_KEEP_ALIVE_GEOM.erase(it);
+  }
+  utils::MODIFIED_CELLS.erase(cell);
+  delete_unshared(cell->polygon_array, geom.polygons);
+  delete_unshared(cell->reference_array, geom.references);
+  delete_unshared(cell->flexpath_array, geom.flexpaths);
+  delete_unshared(cell->robustpath_array, geom.robustpaths);
+  delete_unshared(cell->label_array, geom.labels);
   cell->clear();
   gdstk::free_allocation(cell);
 }
@@ -121,3 +240,8 @@ void utils::LibraryDeleter::operator()(Library *library) const {
   library->clear();
   gdstk::free_allocation(library);
 }
+
+void utils::GeometryContextDeleter::operator()(GeometryContext *context) const {
+  context->clear();
+  gdstk::free_allocation(context);
+}
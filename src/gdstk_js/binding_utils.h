@@ -3,8 +3,11 @@
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <stdexcept>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "gdstk.h"
 
@@ -34,6 +37,7 @@ using BendFunction = gdstk::BendFunction;
 using JoinFunction = gdstk::JoinFunction;
 using EndFunction = gdstk::EndFunction;
 using ParametricVec2 = gdstk::ParametricVec2;
+using ParametricVec2Batch = gdstk::ParametricVec2Batch;
 using CurveInstruction = gdstk::CurveInstruction;
 using RobustPath = gdstk::RobustPath;
 using RobustPathElement = gdstk::RobustPathElement;
@@ -47,12 +51,17 @@ using Anchor = gdstk::Anchor;
 using Property = gdstk::Property;
 using PropertyValue = gdstk::PropertyValue;
 using PropertyType = gdstk::PropertyType;
+using GeometryContext = gdstk::GeometryContext;
 
 namespace utils {
 
 // shared_ptr container -------------------------------------------------------
 
 // *******************  WARNNING: thread race zone started  **********************
+// Everything below holds emscripten::val handles or js owned shared_ptr, so it
+// must only be accessed from the js thread.  Work running on
+// utils::ThreadPool receives plain gdstk data prepared by the caller and must
+// never touch these containers.
 
 // global containor to hold emscripten val of js function
 extern std::unordered_map<FlexPathElement *, val> JOIN_FUNC_SET;
@@ -69,7 +78,9 @@ struct GeomPtr {
   std::unordered_map<Label *, std::shared_ptr<Label>> labels;
 };
 
-// containors keep cell contains polygon/path/reference object alive
+// containors keep cell contains polygon/path/reference object alive.  Only
+// elements handed to js have an entry (see keep_alive), the cell owns the
+// others and CellDeleter frees them.
 extern std::unordered_map<Cell *, GeomPtr> CELL_KEEP_ALIVE_GEOM;
 
 // containors keep reference to cell/rawcell object alive
@@ -83,6 +94,21 @@ extern std::unordered_map<Library *, std::unordered_set<std::shared_ptr<Cell>>>
 extern std::unordered_map<Library *,
                           std::unordered_set<std::shared_ptr<RawCell>>>
     LIB_KEEP_ALIVE_RAWCELL;
+// Pending modifications for the persistent geometry information and spatial
+// indices of cells (gdstk::Cell::cached_bounding_box and get_index).  Bindings
+// that change a cell call cell_modified, and bindings that change the geometry
+// of an element (or of anything stored in it, like its points) call
+// geometry_modified with its address.  Both only record the change;
+// flush_modified, called before the caches are used, finds the cells holding
+// the modified addresses and clears the caches of those cells and all their
+// ancestors.
+extern std::unordered_set<Cell *> MODIFIED_CELLS;
+extern std::vector<const void *> MODIFIED_ADDRESSES;
+inline void cell_modified(Cell *cell) { MODIFIED_CELLS.insert(cell); }
+inline void geometry_modified(const void *address) {
+  MODIFIED_ADDRESSES.push_back(address);
+}
+void flush_modified();
 // *******************  WARNNING: thread race zone end  **********************
 
 
@@ -128,17 +154,89 @@ struct LibraryDeleter {
   void operator()(Library *library) const;
 };
 
+struct GeometryContextDeleter {
+  void operator()(GeometryContext *context) const;
+};
+
 // empty deleter for disable shared_ptr delete pointer
 struct nodelete {
   template <typename T>
   void operator()(T *t) const {}
 };
 
+// Element entries of CELL_KEEP_ALIVE_GEOM (js thread only) --------------------
+// Loaded cells hold many more elements than js ever looks at, so elements of
+// a cell get their shared_ptr when first handed to js, not when added.
+inline auto &geom_entries(GeomPtr &geom, Polygon *) { return geom.polygons; }
+inline auto &geom_entries(GeomPtr &geom, Reference *) {
+  return geom.references;
+}
+inline auto &geom_entries(GeomPtr &geom, FlexPath *) { return geom.flexpaths; }
+inline auto &geom_entries(GeomPtr &geom, RobustPath *) {
+  return geom.robustpaths;
+}
+inline auto &geom_entries(GeomPtr &geom, Label *) { return geom.labels; }
+
+inline PolygonDeleter element_deleter(Polygon *) { return {}; }
+inline ReferenceDeleter element_deleter(Reference *) { return {}; }
+inline FlexPathDeleter element_deleter(FlexPath *) { return {}; }
+inline RobustPathDeleter element_deleter(RobustPath *) { return {}; }
+inline LabelDeleter element_deleter(Label *) { return {}; }
+
+// shared_ptr of an element of cell, registered on first use
+template <typename T>
+std::shared_ptr<T> keep_alive(Cell *cell, T *element) {
+  auto &entries = geom_entries(CELL_KEEP_ALIVE_GEOM[cell], element);
+  auto it = entries.find(element);
+  if (it != entries.end()) return it->second;
+  auto ptr = std::shared_ptr<T>(element, element_deleter(element));
+  entries.emplace(element, ptr);
+  return ptr;
+}
+
+// Release an element just taken out of the arrays of cell: drop its entry,
+// or free it if js never saw it
+template <typename T>
+void release(Cell *cell, T *element) {
+  auto &entries = geom_entries(CELL_KEEP_ALIVE_GEOM[cell], element);
+  if (entries.erase(element) == 0) element_deleter(element)(element);
+}
+
+// Counts and indices cross the js boundary as double, exact up to 2^53 in both
+// wasm32 and wasm64 builds: int truncates above 2^31, and uint64_t (or size_t
+// with MEMORY64) would become a BigInt.
+inline double js_size(uint64_t count) { return (double)count; }
+
+inline uint64_t js_length(const val &array) {
+  return (uint64_t)array["length"].as<double>();
+}
+
+// Count argument passed as a number or, as in earlier releases, a BigInt
+inline uint64_t js_count(const val &value) {
+  double count = value.typeOf().as<std::string>() == "bigint"
+                     ? val::global("Number")(value).as<double>()
+                     : value.as<double>();
+  if (!(count >= 0)) throw std::runtime_error("Count must be non-negative.");
+  return (uint64_t)count;
+}
+
+// Convert a js index, returns false if out of [0, count)
+inline bool js_index(double index, uint64_t count, uint64_t &result) {
+  if (!(index >= 0) || index >= (double)count) return false;
+  result = (uint64_t)index;
+  return true;
+}
+
+// True if value is an instance of the bound class Expression
+inline bool is_expression(const val &value) {
+  return value.instanceof(val::module_property("Expression"));
+}
+
 struct ArrayDeleter {
   template <typename T>
   void operator()(Array<T> *array) const {
     array->clear();
-    delete array;
+    gdstk::free_allocation(array);
   }
 };
 
@@ -150,6 +248,7 @@ std::shared_ptr<Array<T>> make_gdstk_array() {
 
 template <typename T>
 const val gdstk_array2js_array_by_value(const Array<T> &array) {
+  gdstk::TraceSpan span("marshal:to_js");
   auto js_array = val::array();
   for (uint64_t it = 0; it < array.count; ++it) {
     js_array.call<void>("push", val(*(array.items + it)));
@@ -161,6 +260,7 @@ const val gdstk_array2js_array_by_value(const Array<Vec2> &array);
 
 template <typename T>
 const val gdstk_array2js_array_by_ref(const Array<T *> &array) {
+  gdstk::TraceSpan span("marshal:to_js");
   auto js_array = val::array();
   for (size_t i = 0; i < array.count; i++) {
     // convert raw pointer to shared_ptr to auto dellocate
@@ -173,6 +273,7 @@ const val gdstk_array2js_array_by_ref(const Array<T *> &array) {
 template <typename T, typename Deleter>
 const val gdstk_array2js_array_by_ref(const Array<T *> &array,
                                       const Deleter &deleter) {
+  gdstk::TraceSpan span("marshal:to_js");
   auto js_array = val::array();
   for (size_t i = 0; i < array.count; i++) {
     // convert raw pointer to shared_ptr
@@ -188,7 +289,8 @@ const val gdstk_array2js_array_by_ref(const Array<Vec2> &array);
 // convert js array data to gdstk Array by value or reference
 template <typename T>
 std::shared_ptr<Array<T>> js_array2gdstk_array(const val &array) {
-  auto length = array["length"].as<size_t>();
+  gdstk::TraceSpan span("marshal:from_js");
+  auto length = utils::js_length(array);
   auto gdstk_array = make_gdstk_array<T>();
   for (size_t i = 0; i < length; i++) {
     gdstk_array->append(array[i].as<T>(allow_raw_pointers()));
@@ -0,0 +1,383 @@
+#include "expression.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace {
+
+const size_t MAX_STACK = 64;
+
+struct Function1 {
+  const char *name;
+  double (*function)(double);
+};
+
+struct Function2 {
+  const char *name;
+  double (*function)(double, double);
+};
+
+const Function1 FUNCTIONS1[] = {
+    {"sin", [](double x) { return std::sin(x); }},
+    {"cos", [](double x) { return std::cos(x); }},
+    {"tan", [](double x) { return std::tan(x); }},
+    {"asin", [](double x) { return std::asin(x); }},
+    {"acos", [](double x) { return std::acos(x); }},
+    {"atan", [](double x) { return std::atan(x); }},
+    {"sinh", [](double x) { return std::sinh(x); }},
+    {"cosh", [](double x) { return std::cosh(x); }},
+    {"tanh", [](double x) { return std::tanh(x); }},
+    {"sqrt", [](double x) { return std::sqrt(x); }},
+    {"exp", [](double x) { return std::exp(x); }},
+    {"log", [](double x) { return std::log(x); }},
+    {"log10", [](double x) { return std::log10(x); }},
+    {"abs", [](double x) { return std::fabs(x); }},
+    {"floor", [](double x) { return std::floor(x); }},
+    {"ceil", [](double x) { return std::ceil(x); }},
+};
+
+const Function2 FUNCTIONS2[] = {
+    {"atan2", [](double y, double x) { return std::atan2(y, x); }},
+    {"pow", [](double x, double y) { return std::pow(x, y); }},
+    {"min", [](double x, double y) { return x < y ? x : y; }},
+    {"max", [](double x, double y) { return x > y ? x : y; }},
+    {"hypot", [](double x, double y) { return std::hypot(x, y); }},
+};
+
+}  // namespace
+
+// Recursive descent parser emitting postfix code with constant folding
+class utils::Expression::Parser {
+ public:
+  Parser(const std::string &source,
+         const std::unordered_map<std::string, double> &constants)
+      : source_(source), constants_(constants) {}
+
+  int parse(Program *programs) {
+    skip_space();
+    int components = 1;
+    if (peek() == '[') {
+      pos_++;
+      program_ = programs;
+      expression();
+      expect(',');
+      program_ = programs + 1;
+      depth_ = 0;
+      expression();
+      expect(']');
+      components = 2;
+    } else {
+      program_ = programs;
+      expression();
+    }
+    if (pos_ < source_.size()) error("unexpected character");
+    return components;
+  }
+
+ private:
+  [[noreturn]] void error(const char *msg) const {
+    throw std::runtime_error("Invalid expression \"" + source_ + "\": " + msg +
+                             " at position " + std::to_string(pos_) + ".");
+  }
+
+  void skip_space() {
+    while (pos_ < source_.size() && std::isspace((unsigned char)source_[pos_]))
+      pos_++;
+  }
+
+  char peek() {
+    skip_space();
+    return pos_ < source_.size() ? source_[pos_] : '\0';
+  }
+
+  void expect(char c) {
+    if (peek() != c) {
+      std::string msg = std::string("expected '") + c + "'";
+      error(msg.c_str());
+    }
+    pos_++;
+  }
+
+  void push(OpCode op, double value = 0) {
+    Instruction instr;
+    instr.op = op;
+    instr.value = value;
+    program_->push_back(instr);
+    if (op == OpCode::Constant || op == OpCode::Parameter) {
+      if (++depth_ > MAX_STACK) error("expression too deeply nested");
+    }
+  }
+
+  bool last_constants(size_t n) const {
+    if (program_->size() < n) return false;
+    for (size_t i = program_->size() - n; i < program_->size(); i++)
+      if ((*program_)[i].op != OpCode::Constant) return false;
+    return true;
+  }
+
+  void unary_op(OpCode op, double (*function)(double) = nullptr) {
+    if (last_constants(1)) {
+      double &a = program_->back().value;
+      a = op == OpCode::Neg ? -a : function(a);
+      return;
+    }
+    Instruction instr;
+    instr.op = op;
+    instr.function1 = function;
+    program_->push_back(instr);
+  }
+
+  void binary_op(OpCode op, double (*function)(double, double) = nullptr) {
+    depth_--;
+    if (last_constants(2)) {
+      double b = program_->back().value;
+      program_->pop_back();
+      double &a = program_->back().value;
+      switch (op) {
+        case OpCode::Add:
+          a += b;
+          break;
+        case OpCode::Sub:
+          a -= b;
+          break;
+        case OpCode::Mul:
+          a *= b;
+          break;
+        case OpCode::Div:
+          a /= b;
+          break;
+        case OpCode::Pow:
+          a = std::pow(a, b);
+          break;
+        default:
+          a = function(a, b);
+      }
+      return;
+    }
+    Instruction instr;
+    instr.op = op;
+    instr.function2 = function;
+    program_->push_back(instr);
+  }
+
+  void expression() {
+    term();
+    while (true) {
+      char c = peek();
+      if (c == '+') {
+        pos_++;
+        term();
+        binary_op(OpCode::Add);
+      } else if (c == '-') {
+        pos_++;
+        term();
+        binary_op(OpCode::Sub);
+      } else {
+        return;
+      }
+    }
+  }
+
+  void term() {
+    unary();
+    while (true) {
+      char c = peek();
+      if (c == '*' && source_.compare(pos_, 2, "**") != 0) {
+        pos_++;
+        unary();
+        binary_op(OpCode::Mul);
+      } else if (c == '/') {
+        pos_++;
+        unary();
+        binary_op(OpCode::Div);
+      } else {
+        return;
+      }
+    }
+  }
+
+  void unary() {
+    char c = peek();
+    if (c == '-') {
+      pos_++;
+      unary();
+      unary_op(OpCode::Neg);
+    } else if (c == '+') {
+      pos_++;
+      unary();
+    } else {
+      power();
+    }
+  }
+
+  // right associative, binds tighter than unary minus on its left
+  void power() {
+    primary();
+    if (peek() == '^') {
+      pos_++;
+    } else if (source_.compare(pos_, 2, "**") == 0) {
+      pos_ += 2;
+    } else {
+      return;
+    }
+    unary();
+    binary_op(OpCode::Pow);
+  }
+
+  void primary() {
+    char c = peek();
+    if (c == '(') {
+      pos_++;
+      expression();
+      expect(')');
+    } else if (std::isdigit((unsigned char)c) || c == '.') {
+      const char *start = source_.c_str() + pos_;
+      char *end;
+      double value = std::strtod(start, &end);
+      if (end == start) error("invalid number");
+      pos_ += end - start;
+      push(OpCode::Constant, value);
+    } else if (std::isalpha((unsigned char)c) || c == '_') {
+      size_t start = pos_;
+      while (pos_ < source_.size() &&
+             (std::isalnum((unsigned char)source_[pos_]) ||
+              source_[pos_] == '_'))
+        pos_++;
+      std::string name = source_.substr(start, pos_ - start);
+      if (peek() == '(') {
+        call(name);
+      } else {
+        identifier(name);
+      }
+    } else {
+      error("expected a number, name or '('");
+    }
+  }
+
+  void identifier(const std::string &name) {
+    auto it = constants_.find(name);
+    if (it != constants_.end()) {
+      push(OpCode::Constant, it->second);
+    } else if (name == "t" || name == "u") {
+      push(OpCode::Parameter);
+    } else if (name == "pi") {
+      push(OpCode::Constant, M_PI);
+    } else if (name == "e") {
+      push(OpCode::Constant, M_E);
+    } else {
+      std::string msg = "unknown name '" + name + "'";
+      error(msg.c_str());
+    }
+  }
+
+  void call(const std::string &name) {
+    expect('(');
+    for (const Function1 &f : FUNCTIONS1) {
+      if (name == f.name) {
+        expression();
+        expect(')');
+        unary_op(OpCode::Call1, f.function);
+        return;
+      }
+    }
+    for (const Function2 &f : FUNCTIONS2) {
+      if (name == f.name) {
+        expression();
+        expect(',');
+        expression();
+        expect(')');
+        binary_op(OpCode::Call2, f.function);
+        return;
+      }
+    }
+    std::string msg = "unknown function '" + name + "'";
+    error(msg.c_str());
+  }
+
+  const std::string &source_;
+  const std::unordered_map<std::string, double> &constants_;
+  size_t pos_{0};
+  size_t depth_{0};
+  Program *program_{nullptr};
+};
+
+utils::Expression::Expression(
+    const std::string &source,
+    const std::unordered_map<std::string, double> &constants)
+    : source_(source) {
+  Parser parser(source_, constants);
+  components_ = parser.parse(programs_);
+}
+
+double utils::Expression::run(const Program &program, double t) const {
+  double stack[MAX_STACK];
+  double *top = stack;
+  for (const Instruction &instr : program) {
+    switch (instr.op) {
+      case OpCode::Constant:
+        *top++ = instr.value;
+        break;
+      case OpCode::Parameter:
+        *top++ = t;
+        break;
+      case OpCode::Add:
+        top--;
+        top[-1] += *top;
+        break;
+      case OpCode::Sub:
+        top--;
+        top[-1] -= *top;
+        break;
+      case OpCode::Mul:
+        top--;
+        top[-1] *= *top;
+        break;
+      case OpCode::Div:
+        top--;
+        top[-1] /= *top;
+        break;
+      case OpCode::Pow:
+        top--;
+        top[-1] = std::pow(top[-1], *top);
+        break;
+      case OpCode::Neg:
+        top[-1] = -top[-1];
+        break;
+      case OpCode::Call1:
+        top[-1] = instr.function1(top[-1]);
+        break;
+      case OpCode::Call2:
+        top--;
+        top[-1] = instr.function2(top[-1], *top);
+        break;
+    }
+  }
+  return stack[0];
+}
+
+double utils::Expression::eval(double t) const {
+  return run(programs_[0], t);
+}
+
+gdstk::Vec2 utils::Expression::eval_vec2(double t) const {
+  if (components_ == 1) return gdstk::Vec2{run(programs_[0], t), 0};
+  return gdstk::Vec2{run(programs_[0], t), run(programs_[1], t)};
+}
+
+gdstk::Vec2 utils::eval_expression_vec2(double u, void *expression) {
+  return ((const Expression *)expression)->eval_vec2(u);
+}
+
+void utils::eval_expression_vec2_batch(const double *u, uint64_t count,
+                                       gdstk::Vec2 *result, void *expression) {
+  const Expression *expr = (const Expression *)expression;
+  for (uint64_t i = 0; i < count; i++) {
+    result[i] = expr->eval_vec2(u[i]);
+  }
+}
+
+double utils::eval_expression_double(double u, void *expression) {
+  return ((const Expression *)expression)->eval(u);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "gdstk.h"
+
+namespace utils {
+
+// Small math expression compiled to a stack bytecode, evaluated natively
+// without calling back into js.
+//
+// Source is a scalar expression or a 2-component vector "[x, y]" of the
+// parameter t (u is accepted as an alias).  Supported syntax: numbers,
+// + - * / ^ (or **), parentheses, constants pi and e, names bound through
+// constants, and functions sin, cos, tan, asin, acos, atan, atan2, sinh,
+// cosh, tanh, sqrt, exp, log, log10, abs, floor, ceil, pow, min, max, hypot.
+//
+// Compilation errors throw std::runtime_error.  Evaluation is const and
+// thread safe.
+class Expression {
+ public:
+  Expression(const std::string &source,
+             const std::unordered_map<std::string, double> &constants = {});
+
+  const std::string &source() const { return source_; }
+
+  // Number of components: 1 for scalar expressions, 2 for "[x, y]"
+  int components() const { return components_; }
+
+  double eval(double t) const;
+  gdstk::Vec2 eval_vec2(double t) const;
+
+ private:
+  enum struct OpCode { Constant, Parameter, Add, Sub, Mul, Div, Pow, Neg, Call1, Call2 };
+
+  struct Instruction {
+    OpCode op;
+    union {
+      double value;
+      double (*function1)(double);
+      double (*function2)(double, double);
+    };
+  };
+
+  typedef std::vector<Instruction> Program;
+
+  class Parser;
+
+  double run(const Program &program, double t) const;
+
+  std::string source_;
+  int components_{1};
+  Program programs_[2];
+};
+
+// Adapters to use an Expression as gdstk parametric function data
+gdstk::Vec2 eval_expression_vec2(double u, void *expression);
+void eval_expression_vec2_batch(const double *u, uint64_t count,
+                                gdstk::Vec2 *result, void *expression);
+double eval_expression_double(double u, void *expression);
+
+}  // namespace utils
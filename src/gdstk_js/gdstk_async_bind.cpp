@@ -0,0 +1,20 @@
+#include "async_job.h"
+#include "binding_utils.h"
+
+// ----------------------------------------------------------------------------
+// Handle used by the Promise glue of *_async functions, not meant to be
+// constructed from js
+void gdstk_async_bind() {
+  class_<utils::AsyncJob>("AsyncJob")
+      .smart_ptr<std::shared_ptr<utils::AsyncJob>>("AsyncJob_shared_ptr")
+      .function("start", &utils::AsyncJob::start)
+      .function("cancel", &utils::AsyncJob::cancel)
+      .function("finished", &utils::AsyncJob::finished)
+      .function("done", &utils::AsyncJob::done)
+      .function("total", &utils::AsyncJob::total)
+      .function("cancelled", &utils::AsyncJob::cancelled)
+      .function("result", &utils::AsyncJob::result)
+      .function("error", optional_override([](const utils::AsyncJob &self) {
+                  return self.error();
+                }));
+}
@@ -168,7 +168,7 @@ Vec2 to_vec2(const val& obj) {
 std::shared_ptr<Array<Vec2>> to_array_vec2(const val& array) {
   if (array.isArray()) {
     auto points_array = utils::make_gdstk_array<Vec2>();
-    auto length = array["length"].as<int>();
+    auto length = utils::js_length(array);
     for (size_t i = 0; i < length; i++) {
       points_array->append(to_vec2(array[i]));
     }
@@ -215,6 +215,27 @@ val vec2_to_js_array(const Vec2& vec) {
   return array;
 };
 
+void eval_parametric_vec2_batch(const double* u, uint64_t count, Vec2* result,
+                                val* function) {
+  // copy parameters to a js owned array, so function can keep it
+  val js_u = val::global("Float64Array").new_(typed_memory_view(count, u));
+  val r = function->operator()(js_u);
+  auto length = utils::js_length(r);
+  if (length == count && count > 0 && !r[0].isNumber()) {
+    for (uint64_t i = 0; i < count; i++) {
+      result[i] = to_vec2(r[i]);
+    }
+  } else if (length == 2 * count) {
+    // view is created after the call, memory growth can't detach it
+    val view(typed_memory_view(2 * count, (double*)result));
+    view.call<void>("set", r);
+  } else {
+    throw std::runtime_error(
+        "Parametric batch function must return one point or two coordinates "
+        "for each parameter value.");
+  }
+}
+
 // ----------------------------------------------------------------------------
 
 FlexPathElementArray::FlexPathElementArray(FlexPathElement* elem_ptr,
@@ -228,6 +249,7 @@ uint32_t FlexPathElementArray::get_layer(size_t idx) {
 
 void FlexPathElementArray::set_layer(size_t idx, uint32_t layer) {
   assert(idx < length_ && idx >= 0);
+  utils::geometry_modified(address_ + idx);
   gdstk::set_layer((address_ + idx)->tag, layer);
 }
 
@@ -238,6 +260,7 @@ uint32_t FlexPathElementArray::get_type(size_t idx) {
 
 void FlexPathElementArray::set_type(size_t idx, uint32_t type) {
   assert(idx < length_ && idx >= 0);
+  utils::geometry_modified(address_ + idx);
   gdstk::set_type((address_ + idx)->tag, type);
 }
 
@@ -247,6 +270,7 @@ double FlexPathElementArray::get_width(size_t idx) {
 }
 void FlexPathElementArray::set_width(size_t idx, double width) {
   assert(idx < length_ && idx >= 0);
+  utils::geometry_modified(address_ + idx);
   auto& array = (address_ + idx)->half_width_and_offset;
   for (size_t i = 0; i < array.count; i++) {
     array[i].e[0] = width * 0.5;
@@ -259,13 +283,14 @@ double FlexPathElementArray::get_offset(size_t idx) {
 }
 void FlexPathElementArray::set_offset(size_t idx, double offset) {
   assert(idx < length_ && idx >= 0);
+  utils::geometry_modified(address_ + idx);
   auto& array = (address_ + idx)->half_width_and_offset;
   for (size_t i = 0; i < array.count; i++) {
     array[i].e[1] = offset;
   }
 }
 
-int FlexPathElementArray::length() const { return length_; }
+uint64_t FlexPathElementArray::length() const { return length_; }
 
 // ----------------------------------------------------------------------------
 void gdstk_base_bind() {
@@ -286,8 +311,16 @@ void gdstk_base_bind() {
           throw std::runtime_error("Constructing Point only accepte array");
         }
       }))
-      .property("x", &Vec2::x)
-      .property("y", &Vec2::y);
+      .property("x", optional_override([](const Vec2& self) { return self.x; }),
+                optional_override([](Vec2& self, double x) {
+                  utils::geometry_modified(&self);
+                  self.x = x;
+                }))
+      .property("y", optional_override([](const Vec2& self) { return self.y; }),
+                optional_override([](Vec2& self, double y) {
+                  utils::geometry_modified(&self);
+                  self.y = y;
+                }));
 
   class_<Array<Vec2>>("PointsArray")
       .smart_ptr<std::shared_ptr<Array<Vec2>>>("PointsArray_shared_ptr")
@@ -302,20 +335,22 @@ void gdstk_base_bind() {
         auto points_array = std::shared_ptr<Array<Vec2>>(
             (Array<Vec2>*)gdstk::allocate_clear(sizeof(Array<Vec2>)),
             utils::ArrayDeleter());
-        auto length = array["length"].as<int>();
+        auto length = utils::js_length(array);
         for (size_t i = 0; i < length; i++) {
           points_array->append(to_vec2(array[i]));
         }
         return points_array;
       }))
       .property("length", optional_override([](const Array<Vec2>& self) {
-                  return int(self.count);
+                  return utils::js_size(self.count);
                 }))
       .function("push",
                 optional_override([](Array<Vec2>& self, const val& point) {
+                  utils::geometry_modified(&self);
                   self.append(to_vec2(point));
                 }))
       .function("pop", optional_override([](Array<Vec2>& self) {
+                  utils::geometry_modified(&self);
                   if (self.count > 0) {
                     Vec2 r = self[self.count - 1];
                     self.remove(self.count - 1);
@@ -324,17 +359,20 @@ void gdstk_base_bind() {
                   return val::null();
                 }))
       .function(
-          "get", optional_override([](Array<Vec2>& self, int idx) {
-            if (idx < 0 || idx >= self.count) {
+          "get", optional_override([](Array<Vec2>& self, double index) {
+            uint64_t idx;
+            if (!utils::js_index(index, self.count, idx)) {
               return val::null();
             }
             auto point =
                 std::shared_ptr<Vec2>(&self.operator[](idx), utils::nodelete());
             return val::take_ownership(make_vec2_proxy(val(point).as_handle()));
           }))
-      .function("set", optional_override([](Array<Vec2>& self, int idx,
+      .function("set", optional_override([](Array<Vec2>& self, double index,
                                             const val& point) {
-                  if (idx < 0 || idx >= self.count) {
+                  utils::geometry_modified(&self);
+                  uint64_t idx;
+                  if (!utils::js_index(index, self.count, idx)) {
                     throw std::runtime_error("set point array out of range");
                   }
                   self.operator[](idx) = to_vec2(point);
@@ -351,7 +389,7 @@ void gdstk_base_bind() {
           []() { return std::shared_ptr<FlexPathElementArray>(); }))
       .property("length",
                 optional_override([](const FlexPathElementArray& self) {
-                  return self.length();
+                  return utils::js_size(self.length());
                 }))
       .function("get_layer", &FlexPathElementArray::get_layer)
       .function("set_layer", &FlexPathElementArray::set_layer)
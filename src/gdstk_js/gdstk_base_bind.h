@@ -16,6 +16,27 @@ val pathoffsets_to_js_proxy(std::shared_ptr<FlexPathElementArray> elem_array);
 
 val vec2_to_js_array(const Vec2& vec);
 
+// gdstk::ParametricVec2Batch adapter: call js function once with a
+// Float64Array of parameters, it returns an array of points or a flat array of
+// coordinates [x0, y0, x1, y1, ...]
+void eval_parametric_vec2_batch(const double* u, uint64_t count, Vec2* result,
+                                val* function);
+
+// Boolean operation between the shapes of 2 layers ([layer, datatype]) of
+// the flattened cells, always tiled (see the tile_size option of boolean,
+// 'auto' by default), or computed per cell with option hierarchical.
+// Defined in gdstk_function_bind.cpp.
+val boolean_layers(const Array<Cell*>& cells, const val& spec1,
+                   const val& spec2, const val& operation, double precision,
+                   int layer, int datatype, const val& options);
+
+// Offset of the union of the shapes of a layer ([layer, datatype]) of the
+// flattened cells, or computed per cell with option hierarchical.  Defined in
+// gdstk_function_bind.cpp.
+val offset_layer(const Array<Cell*>& cells, const val& spec, double distance,
+                 const val& join, double tolerance, double precision,
+                 int layer, int datatype, const val& options);
+
 struct FlexPathElementArray {
  public:
   FlexPathElementArray(FlexPathElement* elem_ptr, uint64_t length);
@@ -30,7 +51,7 @@ struct FlexPathElementArray {
   double get_offset(size_t idx);
   void set_offset(size_t idx, double offset);
 
-  int length() const;
+  uint64_t length() const;
 
  private:
   FlexPathElement* address_{nullptr};
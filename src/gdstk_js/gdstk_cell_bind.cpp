@@ -1,8 +1,11 @@
+#include <algorithm>
 #include <set>
 #include <unordered_map>
 
+#include "async_job.h"
 #include "binding_utils.h"
 #include "gdstk_base_bind.h"
+#include "thread_pool.h"
 
 namespace {
 std::string make_key(Tag tag) {
@@ -31,40 +34,31 @@ static bool filter_check(int8_t operation, bool a, bool b) {
 }
 // ----------------------------------------------------------------------------
 
-val cell_area(Cell &self, bool by_spec = false) {
-  Array<Polygon *> array = {0};
-  self.get_polygons(true, true, -1, false, 0, array);
+// Areas are computed hierarchically (see gdstk::Cell::area), without
+// flattening the cell
+val cell_area(Cell &self, bool by_spec = false, bool exact = false,
+              double precision = 1e-3) {
+  if (precision <= 0) {
+    throw std::runtime_error("Precision must be positive.");
+  }
+  Array<gdstk::TagArea> areas = {0};
+  // NOTE: return ErrorCode ignored here
+  self.area(exact, 1 / precision, areas);
 
   val result = val::null();
   if (by_spec) {
     result = val::object();
-    for (uint64_t i = 0; i < array.count; i++) {
-      Polygon *poly = array[i];
-      double area = poly->area();
-      auto key = make_key(poly->tag);
-      // has no key
-      if (result[key.c_str()].isUndefined()) {
-        result.set(key.c_str(), area);
-      }
-      // key exist
-      else {
-        result.set(key.c_str(), result[key.c_str()].as<double>() + area);
-      }
+    for (uint64_t i = 0; i < areas.count; i++) {
+      result.set(make_key(areas[i].tag).c_str(), areas[i].area);
     }
   } else {
     double area = 0;
-    for (uint64_t i = 0; i < array.count; i++) {
-      Polygon *poly = array[i];
-      area += poly->area();
+    for (uint64_t i = 0; i < areas.count; i++) {
+      area += areas[i].area;
     }
     result = val(area);
   }
-
-  for (uint64_t i = 0; i < array.count; i++) {
-    array[i]->clear();
-    free_allocation(array[i]);
-  }
-  array.clear();
+  areas.clear();
   return result;
 }
 
@@ -86,9 +80,76 @@ val cell_get_polygons(Cell &self, bool apply_repetitions = true,
     datatype = js_datatype.as<uint32_t>();
   }
 
+  Tag tag = gdstk::make_tag(layer, datatype);
+  Array<Polygon *> array = {0};
+  self.get_polygons(apply_repetitions, include_paths, 0, filter, tag, array);
+
+  // Top level references are flattened concurrently into their own arrays,
+  // then appended in order so the result matches a sequential traversal
+  if (depth != 0 && self.reference_array.count > 0) {
+    uint64_t count = self.reference_array.count;
+    Array<Polygon *> *parts =
+        (Array<Polygon *> *)gdstk::allocate_clear(count * sizeof(Array<Polygon *>));
+    int64_t next_depth = depth > 0 ? depth - 1 : -1;
+    utils::ThreadPool::instance().parallel_for(count, [&](size_t i) {
+      self.reference_array[i]->get_polygons(apply_repetitions, include_paths,
+                                            next_depth, filter, tag, parts[i]);
+    });
+    for (uint64_t i = 0; i < count; i++) {
+      array.extend(parts[i]);
+      parts[i].clear();
+    }
+    gdstk::free_allocation(parts);
+  }
+
+  auto r = utils::gdstk_array2js_array_by_ref(array, utils::PolygonDeleter());
+
+  array.clear();
+  return r;
+}
+
+// Polygons of get_polygons without expanding repetitions (see
+// gdstk::Cell::get_repeated_polygons)
+val cell_get_repeated_polygons(Cell &self, bool include_paths = true,
+                               const val &js_depth = val::null(),
+                               const val &js_layer = val::null(),
+                               const val &js_datatype = val::null()) {
+  int64_t depth = -1;
+  if (!js_depth.isNull()) {
+    depth = js_depth.as<int>();
+  }
+
+  uint32_t layer = 0;
+  uint32_t datatype = 0;
+  bool filter = (!js_layer.isNull()) && (!js_datatype.isNull());
+  if (filter) {
+    layer = js_layer.as<uint32_t>();
+    datatype = js_datatype.as<uint32_t>();
+  }
+
+  Tag tag = gdstk::make_tag(layer, datatype);
+  const gdstk::Transformation identity = gdstk::identity_transformation();
+  const gdstk::Repetition none = {};
   Array<Polygon *> array = {0};
-  self.get_polygons(apply_repetitions, include_paths, depth, filter,
-                    gdstk::make_tag(layer, datatype), array);
+  self.get_repeated_polygons(include_paths, 0, filter, tag, identity, none,
+                             array);
+
+  // Top level references are processed concurrently, as in cell_get_polygons
+  if (depth != 0 && self.reference_array.count > 0) {
+    uint64_t count = self.reference_array.count;
+    Array<Polygon *> *parts =
+        (Array<Polygon *> *)gdstk::allocate_clear(count * sizeof(Array<Polygon *>));
+    int64_t next_depth = depth > 0 ? depth - 1 : -1;
+    utils::ThreadPool::instance().parallel_for(count, [&](size_t i) {
+      self.reference_array[i]->get_repeated_polygons(
+          include_paths, next_depth, filter, tag, identity, none, parts[i]);
+    });
+    for (uint64_t i = 0; i < count; i++) {
+      array.extend(parts[i]);
+      parts[i].clear();
+    }
+    gdstk::free_allocation(parts);
+  }
 
   auto r = utils::gdstk_array2js_array_by_ref(array, utils::PolygonDeleter());
 
@@ -96,6 +157,241 @@ val cell_get_polygons(Cell &self, bool apply_repetitions = true,
   return r;
 }
 
+// Polygons packed into flat buffers by pack_polygon: polygon i has points
+// [starts[i], starts[i + 1]) and tag (tags[2 * i], tags[2 * i + 1])
+struct PackedPolygons {
+  Array<Vec2> points = {0};
+  Array<uint32_t> starts = {0};
+  Array<uint32_t> tags = {0};
+
+  void clear() {
+    points.clear();
+    starts.clear();
+    tags.clear();
+  }
+};
+
+// gdstk::PolygonVisitor writing the transformed points straight into the
+// packed buffers, so no Polygon is copied
+static void pack_polygon(const Polygon &polygon,
+                         const gdstk::Transformation &transformation,
+                         void *data) {
+  PackedPolygons *packed = (PackedPolygons *)data;
+  packed->starts.append((uint32_t)packed->points.count);
+  packed->tags.append(gdstk::get_layer(polygon.tag));
+  packed->tags.append(gdstk::get_type(polygon.tag));
+  uint64_t count = polygon.point_array.count;
+  packed->points.ensure_slots(count);
+  const Vec2 *src = polygon.point_array.items;
+  Vec2 *dst = packed->points.items + packed->points.count;
+  for (uint64_t i = count; i > 0; i--) *dst++ = transformation.apply(*src++);
+  packed->points.count += count;
+}
+
+val cell_get_polygons_packed(Cell &self, bool include_paths = true,
+                             const val &js_depth = val::null(),
+                             const val &js_layer = val::null(),
+                             const val &js_datatype = val::null()) {
+  int64_t depth = -1;
+  if (!js_depth.isNull()) {
+    depth = js_depth.as<int>();
+  }
+
+  uint32_t layer = 0;
+  uint32_t datatype = 0;
+  bool filter = (!js_layer.isNull()) && (!js_datatype.isNull());
+  if (filter) {
+    layer = js_layer.as<uint32_t>();
+    datatype = js_datatype.as<uint32_t>();
+  }
+
+  Tag tag = gdstk::make_tag(layer, datatype);
+  const gdstk::Transformation identity = gdstk::identity_transformation();
+  PackedPolygons packed;
+  self.visit_polygons(true, include_paths, 0, filter, tag, identity,
+                      pack_polygon, &packed);
+
+  // Top level references are packed concurrently, as in cell_get_polygons
+  if (depth != 0 && self.reference_array.count > 0) {
+    uint64_t count = self.reference_array.count;
+    PackedPolygons *parts = new PackedPolygons[count];
+    int64_t next_depth = depth > 0 ? depth - 1 : -1;
+    utils::ThreadPool::instance().parallel_for(count, [&](size_t i) {
+      self.reference_array[i]->visit_polygons(true, include_paths, next_depth,
+                                              filter, tag, identity,
+                                              pack_polygon, parts + i);
+    });
+    for (uint64_t i = 0; i < count; i++) {
+      PackedPolygons &part = parts[i];
+      uint32_t shift = (uint32_t)packed.points.count;
+      packed.starts.ensure_slots(part.starts.count);
+      for (uint64_t j = 0; j < part.starts.count; j++) {
+        packed.starts.append_unsafe(part.starts[j] + shift);
+      }
+      packed.tags.extend(part.tags);
+      packed.points.extend(part.points);
+      part.clear();
+    }
+    delete[] parts;
+  }
+  if (packed.points.count > UINT32_MAX) {
+    packed.clear();
+    throw std::runtime_error("Too many points for a packed polygon buffer.");
+  }
+  packed.starts.append((uint32_t)packed.points.count);
+
+  val result = val::object();
+  result.set("points", val::global("Float64Array")
+                           .new_(typed_memory_view(2 * packed.points.count,
+                                                   (double *)packed.points.items)));
+  result.set("offsets",
+             val::global("Uint32Array")
+                 .new_(typed_memory_view(packed.starts.count,
+                                         packed.starts.items)));
+  result.set("tags", val::global("Uint32Array")
+                         .new_(typed_memory_view(packed.tags.count,
+                                                 packed.tags.items)));
+  packed.clear();
+  return result;
+}
+
+// Instances of one cell, with any of its references (to find the js object of
+// the cell) and 5 values per instance: x, y, rotation, magnification and
+// x_reflection (0 or 1)
+struct CellInstances {
+  const Reference *reference;
+  Array<double> transforms;
+};
+
+struct InstanceCollector {
+  std::unordered_map<const Cell *, uint64_t> index;
+  Array<CellInstances> cells = {0};
+
+  void clear() {
+    for (uint64_t i = 0; i < cells.count; i++) cells[i].transforms.clear();
+    cells.clear();
+  }
+};
+
+// gdstk::InstanceVisitor grouping instances by cell, in order of first
+// appearance
+static void collect_instance(const Reference &reference,
+                             const gdstk::Transformation &transformation,
+                             void *data) {
+  InstanceCollector *collector = (InstanceCollector *)data;
+  auto inserted =
+      collector->index.emplace(reference.cell, collector->cells.count);
+  if (inserted.second) {
+    collector->cells.append(CellInstances{&reference, {0}});
+  }
+  Array<double> &transforms =
+      collector->cells[inserted.first->second].transforms;
+  transforms.ensure_slots(5);
+  transforms.append_unsafe(transformation.origin.x);
+  transforms.append_unsafe(transformation.origin.y);
+  transforms.append_unsafe(transformation.rotation);
+  transforms.append_unsafe(transformation.magnification);
+  transforms.append_unsafe(transformation.x_reflection ? 1 : 0);
+}
+
+val cell_get_instances(Cell &self, const val &js_depth = val::null()) {
+  int64_t depth = -1;
+  if (!js_depth.isNull()) {
+    depth = js_depth.as<int>();
+  }
+
+  InstanceCollector collector;
+  self.visit_instances(depth, gdstk::identity_transformation(),
+                       collect_instance, &collector);
+
+  val result = val::array();
+  for (uint64_t i = 0; i < collector.cells.count; i++) {
+    CellInstances &instances = collector.cells[i];
+    auto cell = utils::REF_KEEP_ALIVE_CELL.find(
+        const_cast<Reference *>(instances.reference));
+    if (cell == utils::REF_KEEP_ALIVE_CELL.end()) {
+      collector.clear();
+      throw std::runtime_error("No valid Cell found for Reference");
+    }
+    val item = val::object();
+    item.set("cell", val(cell->second));
+    item.set("transforms",
+             val::global("Float64Array")
+                 .new_(typed_memory_view(instances.transforms.count,
+                                         instances.transforms.items)));
+    result.call<void>("push", item);
+  }
+  collector.clear();
+  return result;
+}
+
+// Free the elements appended to array after its first count items.  They
+// are new copies js never saw, so this is safe on a pool thread.
+template <typename T>
+void truncate_elements(Array<T *> &array, uint64_t count) {
+  for (uint64_t i = count; i < array.count; i++) {
+    array[i]->clear();
+    gdstk::free_allocation(array[i]);
+  }
+  array.count = count;
+}
+
+// Cell flattened by a utils::AsyncJob.  Removed references are released on
+// the js thread when the job is destroyed.  A cancelled job puts the cell
+// back as it was and releases nothing.
+struct FlattenJob {
+  Cell *cell;
+  Array<Reference *> removed = {0};
+
+  ~FlattenJob() {
+    utils::cell_modified(cell);
+    for (size_t i = 0; i < removed.count; i++) {
+      utils::release(cell, removed[i]);
+    }
+    removed.clear();
+  }
+};
+
+// The cell must not be used from js until the returned Promise settles
+val cell_flatten_async(Cell &self, bool apply_repetitions = true,
+                       const val &options = val::null()) {
+  utils::cell_modified(&self);
+  auto job = std::make_shared<FlattenJob>();
+  job->cell = &self;
+  return utils::AsyncJob::run(
+      [=]() {
+        Cell *cell = job->cell;
+        Array<Reference *> references = {0};
+        references.copy_from(cell->reference_array);
+        const uint64_t polygon_count = cell->polygon_array.count;
+        const uint64_t flexpath_count = cell->flexpath_array.count;
+        const uint64_t robustpath_count = cell->robustpath_array.count;
+        const uint64_t label_count = cell->label_array.count;
+        cell->flatten(apply_repetitions, job->removed);
+        // flatten only leaves cell references behind when cancelled
+        bool cancelled = false;
+        for (uint64_t i = 0; i < cell->reference_array.count; i++) {
+          if (cell->reference_array[i]->type == ReferenceType::Cell) {
+            cancelled = true;
+            break;
+          }
+        }
+        if (!cancelled) {
+          references.clear();
+          return ErrorCode::NoError;
+        }
+        truncate_elements(cell->polygon_array, polygon_count);
+        truncate_elements(cell->flexpath_array, flexpath_count);
+        truncate_elements(cell->robustpath_array, robustpath_count);
+        truncate_elements(cell->label_array, label_count);
+        cell->reference_array.clear();
+        cell->reference_array = references;
+        job->removed.count = 0;
+        return ErrorCode::Cancelled;
+      },
+      []() { return val::undefined(); }, options);
+}
+
 val cell_get_paths(Cell &self, bool apply_repetitions = true,
                    const val &js_depth = val::null(),
                    const val &js_layer = val::null(),
@@ -164,6 +460,16 @@ val cell_get_labels(Cell &self, bool apply_repetitions = true,
   return result;
 }
 
+// Elements of a shallow copy are held by both cells
+template <typename T>
+void share_elements(const Array<T *> &array, Cell *from, Cell *to) {
+  for (uint64_t i = 0; i < array.count; i++) {
+    auto element = utils::keep_alive(from, array[i]);
+    utils::geom_entries(utils::CELL_KEEP_ALIVE_GEOM[to], array[i])
+        .emplace(array[i], element);
+  }
+}
+
 std::shared_ptr<Cell> cell_copy(Cell &self, const val &js_name,
                                 const Vec2 &translation = {0, 0},
                                 double rotation = 0, double magnification = 1,
@@ -178,6 +484,14 @@ std::shared_ptr<Cell> cell_copy(Cell &self, const val &js_name,
   auto cell = std::shared_ptr<Cell>((Cell *)gdstk::allocate_clear(sizeof(Cell)),
                                     utils::CellDeleter());
   cell->copy_from(self, name.c_str(), deep_copy > 0);
+  utils::CELL_KEEP_ALIVE_GEOM[cell.get()];
+  if (!deep_copy) {
+    share_elements(self.polygon_array, &self, cell.get());
+    share_elements(self.reference_array, &self, cell.get());
+    share_elements(self.flexpath_array, &self, cell.get());
+    share_elements(self.robustpath_array, &self, cell.get());
+    share_elements(self.label_array, &self, cell.get());
+  }
 
   Array<Polygon *> *polygon_array = &cell->polygon_array;
   if (deep_copy) {
@@ -189,8 +503,6 @@ std::shared_ptr<Cell> cell_copy(Cell &self, const val &js_name,
         polygon->repetition.transform(magnification, x_reflection > 0,
                                       rotation);
       }
-      utils::CELL_KEEP_ALIVE_GEOM[cell.get()].polygons.insert(
-          {polygon, utils::CELL_KEEP_ALIVE_GEOM[&self].polygons.at(polygon)});
     }
   }
 
@@ -204,9 +516,10 @@ std::shared_ptr<Cell> cell_copy(Cell &self, const val &js_name,
         reference->repetition.transform(magnification, x_reflection > 0,
                                         rotation);
       }
-      utils::CELL_KEEP_ALIVE_GEOM[cell.get()].references.insert(
-          {reference,
-           utils::CELL_KEEP_ALIVE_GEOM[&self].references.at(reference)});
+      auto target = utils::REF_KEEP_ALIVE_CELL.find(self.reference_array[i]);
+      if (target != utils::REF_KEEP_ALIVE_CELL.end()) {
+        utils::REF_KEEP_ALIVE_CELL[reference] = target->second;
+      }
     }
   }
 
@@ -218,8 +531,6 @@ std::shared_ptr<Cell> cell_copy(Cell &self, const val &js_name,
         path->transform(magnification, x_reflection > 0, rotation, translation);
         path->repetition.transform(magnification, x_reflection > 0, rotation);
       }
-      utils::CELL_KEEP_ALIVE_GEOM[cell.get()].flexpaths.insert(
-          {path, utils::CELL_KEEP_ALIVE_GEOM[&self].flexpaths.at(path)});
     }
   }
 
@@ -231,8 +542,6 @@ std::shared_ptr<Cell> cell_copy(Cell &self, const val &js_name,
         path->transform(magnification, x_reflection > 0, rotation, translation);
         path->repetition.transform(magnification, x_reflection > 0, rotation);
       }
-      utils::CELL_KEEP_ALIVE_GEOM[cell.get()].robustpaths.insert(
-          {path, utils::CELL_KEEP_ALIVE_GEOM[&self].robustpaths.at(path)});
     }
   }
 
@@ -245,8 +554,6 @@ std::shared_ptr<Cell> cell_copy(Cell &self, const val &js_name,
                          translation);
         label->repetition.transform(magnification, x_reflection > 0, rotation);
       }
-      utils::CELL_KEEP_ALIVE_GEOM[cell.get()].labels.insert(
-          {label, utils::CELL_KEEP_ALIVE_GEOM[&self].labels.at(label)});
     }
   }
 
@@ -261,7 +568,7 @@ void cell_filter(Cell &self, const val &spec, bool remove = true,
 
   gdstk::Set<Tag> tag_set = {0};
 
-  auto spec_length = spec["length"].as<int>();
+  auto spec_length = utils::js_length(spec);
   for (size_t i = 0; i < spec_length; i++) {
     auto layer = spec[i][0].as<int>();
     auto type = spec[i][1].as<int>();
@@ -274,7 +581,7 @@ void cell_filter(Cell &self, const val &spec, bool remove = true,
       Polygon *poly = self.polygon_array[i];
       if (tag_set.has_value(poly->tag) == (remove > 0)) {
         self.polygon_array.remove_unordered(i);
-        utils::CELL_KEEP_ALIVE_GEOM.at(&self).polygons.erase(poly);
+        utils::release(&self, poly);
       } else {
         ++i;
       }
@@ -292,9 +599,8 @@ void cell_filter(Cell &self, const val &spec, bool remove = true,
         if (tag_set.has_value(el->tag) == (remove > 0)) remove_count++;
       }
       if (remove_count == path->num_elements) {
-        utils::CELL_KEEP_ALIVE_GEOM.at(&self).flexpaths.erase(
-            self.flexpath_array[i]);
         self.flexpath_array.remove_unordered(i);
+        utils::release(&self, path);
       } else {
         if (remove_count > 0) {
           j = 0;
@@ -322,9 +628,8 @@ void cell_filter(Cell &self, const val &spec, bool remove = true,
         if (tag_set.has_value(el->tag) == (remove > 0)) remove_count++;
       }
       if (remove_count == path->num_elements) {
-        utils::CELL_KEEP_ALIVE_GEOM.at(&self).robustpaths.erase(
-            self.robustpath_array[i]);
         self.robustpath_array.remove_unordered(i);
+        utils::release(&self, path);
       } else {
         if (remove_count > 0) {
           j = 0;
@@ -350,7 +655,7 @@ void cell_filter(Cell &self, const val &spec, bool remove = true,
       Label *label = self.label_array[i];
       if (tag_set.has_value(label->tag) == (remove > 0)) {
         self.label_array.remove_unordered(i);
-        utils::CELL_KEEP_ALIVE_GEOM.at(&self).labels.erase(label);
+        utils::release(&self, label);
       } else {
         ++i;
       }
@@ -358,6 +663,54 @@ void cell_filter(Cell &self, const val &spec, bool remove = true,
   }
 }
 
+// Shapes and labels intersecting bbox ([[x0, y0], [x1, y1]]), returned as
+// {polygons, labels}.  Argument layers is null (all layers) or an array of
+// [layer, datatype] pairs (texttype for labels); depth is null for no limit.
+val cell_query(Cell &self, const val &bbox, const val &layers = val::null(),
+               const val &js_depth = val::null()) {
+  if (!bbox.isArray() || utils::js_length(bbox) != 2) {
+    throw std::runtime_error("Argument bbox must be [[x0, y0], [x1, y1]].");
+  }
+  Vec2 corner0 = to_vec2(bbox[0]);
+  Vec2 corner1 = to_vec2(bbox[1]);
+  Vec2 min = {std::min(corner0.x, corner1.x), std::min(corner0.y, corner1.y)};
+  Vec2 max = {std::max(corner0.x, corner1.x), std::max(corner0.y, corner1.y)};
+
+  int64_t depth = -1;
+  if (!js_depth.isNull() && !js_depth.isUndefined()) {
+    depth = js_depth.as<int>();
+  }
+
+  gdstk::Set<Tag> tag_set = {0};
+  bool filter = !layers.isNull() && !layers.isUndefined();
+  if (filter) {
+    if (!layers.isArray()) {
+      throw std::runtime_error(
+          "Argument layers must be null or a sequence of [layer, datatype].");
+    }
+    auto length = utils::js_length(layers);
+    for (size_t i = 0; i < length; i++) {
+      tag_set.add(gdstk::make_tag(layers[i][0].as<uint32_t>(),
+                                  layers[i][1].as<uint32_t>()));
+    }
+  }
+
+  Array<Polygon *> polygons = {0};
+  Array<Label *> labels = {0};
+  utils::flush_modified();
+  self.query(min, max, filter ? &tag_set : NULL, depth, polygons, labels);
+  tag_set.clear();
+
+  val result = val::object();
+  result.set("polygons", utils::gdstk_array2js_array_by_ref(
+                             polygons, utils::PolygonDeleter()));
+  result.set("labels",
+             utils::gdstk_array2js_array_by_ref(labels, utils::LabelDeleter()));
+  polygons.clear();
+  labels.clear();
+  return result;
+}
+
 }  // namespace
 
 // ----------------------------------------------------------------------------
@@ -389,48 +742,43 @@ void gdstk_cell_bind() {
                   memcpy(self.name, new_name.as<std::string>().c_str(), len);
                 }))
       .property("polygons", optional_override([](const Cell &self) {
+                  auto cell = &const_cast<Cell &>(self);
                   auto js_array = val::array();
-                  auto &poly_array =
-                      utils::CELL_KEEP_ALIVE_GEOM.at(&const_cast<Cell &>(self))
-                          .polygons;
                   for (size_t i = 0; i < self.polygon_array.count; i++) {
                     auto polygon = self.polygon_array[i];
-                    // convert raw pointer to shared_ptr
-                    js_array.call<void>("push", val(poly_array.at(polygon)));
+                    // shared_ptr registered on first use
+                    js_array.call<void>(
+                        "push", val(utils::keep_alive(cell, polygon)));
                   }
                   return js_array;
                 }))
       .property("references", optional_override([](const Cell &self) {
+                  auto cell = &const_cast<Cell &>(self);
                   auto js_array = val::array();
-                  auto &ref_array =
-                      utils::CELL_KEEP_ALIVE_GEOM.at(&const_cast<Cell &>(self))
-                          .references;
                   for (size_t i = 0; i < self.reference_array.count; i++) {
                     auto ref = self.reference_array[i];
-                    // convert raw pointer to shared_ptr
-                    js_array.call<void>("push", val(ref_array.at(ref)));
+                    // shared_ptr registered on first use
+                    js_array.call<void>(
+                        "push", val(utils::keep_alive(cell, ref)));
                   }
                   return js_array;
                 }))
       .property("paths", optional_override([](const Cell &self) {
+                  auto cell = &const_cast<Cell &>(self);
                   auto val_flexpath = val::array();
-                  auto &flex_array =
-                      utils::CELL_KEEP_ALIVE_GEOM.at(&const_cast<Cell &>(self))
-                          .flexpaths;
                   for (size_t i = 0; i < self.flexpath_array.count; i++) {
                     auto path = self.flexpath_array[i];
-                    // convert raw pointer to shared_ptr
-                    val_flexpath.call<void>("push", val(flex_array.at(path)));
+                    // shared_ptr registered on first use
+                    val_flexpath.call<void>(
+                        "push", val(utils::keep_alive(cell, path)));
                   }
 
                   auto val_robustpath = val::array();
-                  auto &robust_array =
-                      utils::CELL_KEEP_ALIVE_GEOM.at(&const_cast<Cell &>(self))
-                          .robustpaths;
                   for (size_t i = 0; i < self.robustpath_array.count; i++) {
                     auto path = self.robustpath_array[i];
-                    // convert raw pointer to shared_ptr
-                    val_flexpath.call<void>("push", val(robust_array.at(path)));
+                    // shared_ptr registered on first use
+                    val_flexpath.call<void>(
+                        "push", val(utils::keep_alive(cell, path)));
                   }
 
                   val result = val::array();
@@ -440,19 +788,19 @@ void gdstk_cell_bind() {
                   return result;
                 }))
       .property("labels", optional_override([](const Cell &self) {
+                  auto cell = &const_cast<Cell &>(self);
                   auto js_array = val::array();
-                  auto &label_array =
-                      utils::CELL_KEEP_ALIVE_GEOM.at(&const_cast<Cell &>(self))
-                          .labels;
                   for (size_t i = 0; i < self.label_array.count; i++) {
                     auto label = self.label_array[i];
-                    // convert raw pointer to shared_ptr
-                    js_array.call<void>("push", val(label_array.at(label)));
+                    // shared_ptr registered on first use
+                    js_array.call<void>(
+                        "push", val(utils::keep_alive(cell, label)));
                   }
                   return js_array;
                 }))
       // TODO:properties
       .function("add", optional_override([](Cell &self, const val &elements) {
+                  utils::cell_modified(&self);
                   std::string cons_name =
                       elements["constructor"]["name"].as<std::string>();
                   if (cons_name == "Polygon") {
@@ -486,8 +834,8 @@ void gdstk_cell_bind() {
                         {elements.as<Label *>(allow_raw_pointers()),
                          elements.as<std::shared_ptr<Label>>()});
                   } else if (elements.isArray()) {
-                    int length = elements["length"].as<int>();
-                    for (int i = 0; i < length; i++) {
+                    uint64_t length = utils::js_length(elements);
+                    for (uint64_t i = 0; i < length; i++) {
                       auto item = elements[i];
                       std::string cons =
                           item["constructor"]["name"].as<std::string>();
@@ -533,6 +881,68 @@ void gdstk_cell_bind() {
                         "RobustPath, Label or Reference.");
                   }
                 }))
+      .function("boolean_layers",
+                optional_override([](Cell &self, const val &spec1,
+                                     const val &spec2, const val &operation,
+                                     double precision, int layer, int datatype,
+                                     const val &options) {
+                  Cell *cell = &self;
+                  const Array<Cell *> cells = {1, 1, &cell};
+                  return boolean_layers(cells, spec1, spec2, operation,
+                                        precision, layer, datatype, options);
+                }))
+      .function("boolean_layers",
+                optional_override([](Cell &self, const val &spec1,
+                                     const val &spec2, const val &operation,
+                                     const val &options) {
+                  Cell *cell = &self;
+                  const Array<Cell *> cells = {1, 1, &cell};
+                  return boolean_layers(cells, spec1, spec2, operation, 1e-3,
+                                        0, 0, options);
+                }))
+      .function("boolean_layers",
+                optional_override([](Cell &self, const val &spec1,
+                                     const val &spec2, const val &operation) {
+                  Cell *cell = &self;
+                  const Array<Cell *> cells = {1, 1, &cell};
+                  return boolean_layers(cells, spec1, spec2, operation, 1e-3,
+                                        0, 0, val::null());
+                }))
+      .function("offset_layer",
+                optional_override([](Cell &self, const val &spec,
+                                     double distance, const val &join,
+                                     double tolerance, double precision,
+                                     int layer, int datatype,
+                                     const val &options) {
+                  Cell *cell = &self;
+                  const Array<Cell *> cells = {1, 1, &cell};
+                  return offset_layer(cells, spec, distance, join, tolerance,
+                                      precision, layer, datatype, options);
+                }))
+      .function("offset_layer",
+                optional_override([](Cell &self, const val &spec,
+                                     double distance, const val &options) {
+                  Cell *cell = &self;
+                  const Array<Cell *> cells = {1, 1, &cell};
+                  return offset_layer(cells, spec, distance, val("miter"), 2,
+                                      1e-3, 0, 0, options);
+                }))
+      .function("offset_layer",
+                optional_override(
+                    [](Cell &self, const val &spec, double distance) {
+                      Cell *cell = &self;
+                      const Array<Cell *> cells = {1, 1, &cell};
+                      return offset_layer(cells, spec, distance, val("miter"),
+                                          2, 1e-3, 0, 0, val::null());
+                    }))
+      .function("area", optional_override([](Cell &self, bool by_spec,
+                                              bool exact, double precision) {
+                  return cell_area(self, by_spec, exact, precision);
+                }))
+      .function("area",
+                optional_override([](Cell &self, bool by_spec, bool exact) {
+                  return cell_area(self, by_spec, exact);
+                }))
       .function("area", optional_override([](Cell &self, bool by_spec) {
                   return cell_area(self, by_spec);
                 }))
@@ -540,7 +950,8 @@ void gdstk_cell_bind() {
                 optional_override([](Cell &self) { return cell_area(self); }))
       .function("bounding_box", optional_override([](Cell &self) {
                   Vec2 min, max;
-                  self.bounding_box(min, max);
+                  utils::flush_modified();
+                  self.cached_bounding_box(min, max);
                   if (min.x > max.x) {
                     return val::null();
                   }
@@ -551,7 +962,8 @@ void gdstk_cell_bind() {
                 }))
       .function("convex_hull", optional_override([](Cell &self) {
                   Array<Vec2> points = {0};
-                  self.convex_hull(points);
+                  utils::flush_modified();
+                  self.cached_convex_hull(points);
                   auto r = utils::gdstk_array2js_array_by_value(points);
                   points.clear();
                   return r;
@@ -567,6 +979,33 @@ void gdstk_cell_bind() {
       .function("get_polygons", optional_override([](Cell &self) {
                   return cell_get_polygons(self);
                 }))
+      .function("get_repeated_polygons",
+                optional_override([](Cell &self, bool include_paths,
+                                     const val &depth, const val &layer,
+                                     const val &datatype) {
+                  return cell_get_repeated_polygons(self, include_paths, depth,
+                                                    layer, datatype);
+                }))
+      .function("get_repeated_polygons", optional_override([](Cell &self) {
+                  return cell_get_repeated_polygons(self);
+                }))
+      .function("get_polygons_packed",
+                optional_override([](Cell &self, bool include_paths,
+                                     const val &depth, const val &layer,
+                                     const val &datatype) {
+                  return cell_get_polygons_packed(self, include_paths, depth,
+                                                  layer, datatype);
+                }))
+      .function("get_polygons_packed", optional_override([](Cell &self) {
+                  return cell_get_polygons_packed(self);
+                }))
+      .function("get_instances",
+                optional_override([](Cell &self, const val &depth) {
+                  return cell_get_instances(self, depth);
+                }))
+      .function("get_instances", optional_override([](Cell &self) {
+                  return cell_get_instances(self);
+                }))
       .function("get_paths",
                 optional_override([](Cell &self, bool apply_repetitions,
                                      const val &depth, const val &layer,
@@ -589,21 +1028,33 @@ void gdstk_cell_bind() {
                 }))
       .function("flatten",
                 optional_override([](Cell &self, bool apply_repetitions) {
+                  utils::cell_modified(&self);
                   Array<Reference *> removed_reference = {0};
                   self.flatten(apply_repetitions, removed_reference);
                   for (size_t i = 0; i < removed_reference.count; i++) {
-                    utils::CELL_KEEP_ALIVE_GEOM[&self].references.erase(
-                        removed_reference[i]);
+                    utils::release(&self, removed_reference[i]);
                   }
                   removed_reference.clear();
                 }))
+      .function("flatten_async",
+                optional_override([](Cell &self, bool apply_repetitions,
+                                     const val &options) {
+                  return cell_flatten_async(self, apply_repetitions, options);
+                }))
+      .function("flatten_async",
+                optional_override([](Cell &self, const val &options) {
+                  return cell_flatten_async(self, true, options);
+                }))
+      .function("flatten_async", optional_override([](Cell &self) {
+                  return cell_flatten_async(self);
+                }))
       .function("flatten", optional_override([](Cell &self) {
+                  utils::cell_modified(&self);
                   bool apply_repetitions = true;
                   Array<Reference *> removed_reference = {0};
                   self.flatten(apply_repetitions, removed_reference);
                   for (size_t i = 0; i < removed_reference.count; i++) {
-                    utils::CELL_KEEP_ALIVE_GEOM[&self].references.erase(
-                        removed_reference[i]);
+                    utils::release(&self, removed_reference[i]);
                   }
                   removed_reference.clear();
                 }))
@@ -622,6 +1073,7 @@ void gdstk_cell_bind() {
       // TODO: .function("write_svg")
       .function(
           "remove", optional_override([](Cell &self, const val &elements) {
+            utils::cell_modified(&self);
             auto contr = elements["constructor"]["name"].as<std::string>();
             if (contr == "Polygon") {
               Polygon *polygon = elements.as<Polygon *>(allow_raw_pointers());
@@ -653,7 +1105,7 @@ void gdstk_cell_bind() {
               array->remove_item(label);
               utils::CELL_KEEP_ALIVE_GEOM.at(&self).labels.erase(label);
             } else if (elements.isArray()) {
-              auto len = elements["length"].as<uint32_t>();
+              auto len = utils::js_length(elements);
               for (size_t i = 0; i < len; i++) {
                 auto item = elements[i];
                 auto cons = item["constructor"]["name"].as<std::string>();
@@ -703,12 +1155,27 @@ void gdstk_cell_bind() {
       .function("filter",
                 optional_override([](Cell &self, const val &spec, bool remove,
                                      bool polygons, bool paths, bool labels) {
+                  utils::cell_modified(&self);
                   return cell_filter(self, spec, remove, polygons, paths,
                                      labels);
                 }))
       .function("filter", optional_override([](Cell &self, const val &spec) {
+                  utils::cell_modified(&self);
                   return cell_filter(self, spec);
                 }))
+      .function("query",
+                optional_override([](Cell &self, const val &bbox,
+                                     const val &layers, const val &depth) {
+                  return cell_query(self, bbox, layers, depth);
+                }))
+      .function("query",
+                optional_override([](Cell &self, const val &bbox,
+                                     const val &layers) {
+                  return cell_query(self, bbox, layers);
+                }))
+      .function("query", optional_override([](Cell &self, const val &bbox) {
+                  return cell_query(self, bbox);
+                }))
       .function(
           "dependencies", optional_override([](Cell &self, bool recursive) {
             gdstk::Map<Cell *> cell_map = {0};
@@ -1,6 +1,7 @@
 #include <unordered_map>
 
 #include "binding_utils.h"
+#include "expression.h"
 #include "gdstk.h"
 #include "gdstk_base_bind.h"
 
@@ -27,7 +28,7 @@ void curve_interpolation(Curve &self, const val &points,
   if (js_angles.isNull()) {
     memset(angle_constraints, 0, sizeof(bool) * (count + 1));
   } else {
-    if (js_angles["length"].as<int>() != count + 1) {
+    if (utils::js_length(js_angles) != count + 1) {
       free_allocation(tension);
       throw std::runtime_error(
           "Argument angles must be None or a sequence "
@@ -49,7 +50,7 @@ void curve_interpolation(Curve &self, const val &points,
     Vec2 *t = tension;
     for (uint64_t i = 0; i < count + 1; i++) (t++)->u = t_in;
   } else if (tension_in.isArray()) {
-    if (tension_in["length"].as<int>() != count + 1) {
+    if (utils::js_length(tension_in) != count + 1) {
       free_allocation(tension);
       throw std::runtime_error(
           "Argument tension_in must be a number or a "
@@ -69,7 +70,7 @@ void curve_interpolation(Curve &self, const val &points,
     Vec2 *t = tension;
     for (uint64_t i = 0; i < count + 1; i++) (t++)->v = t_out;
   } else if (tension_out.isArray()) {
-    if (tension_out["length"].as<int>() != count + 1) {
+    if (utils::js_length(tension_out) != count + 1) {
       free_allocation(tension);
       throw std::runtime_error(
           "Argument tension_out must be a number or a "
@@ -91,6 +92,32 @@ void curve_interpolation(Curve &self, const val &points,
   free_allocation(tension);
 }
 
+void curve_parametric(Curve &self, const val &curve_function, bool relative,
+                      bool batch) {
+  if (utils::is_expression(curve_function)) {
+    auto expression =
+        curve_function.as<utils::Expression *>(allow_raw_pointers());
+    if (expression->components() != 2) {
+      throw std::runtime_error(
+          "Curve expression must be a vector like \"[x(t), y(t)]\".");
+    }
+    self.parametric(
+        (ParametricVec2Batch)utils::eval_expression_vec2_batch,
+        (void *)expression, relative);
+    return;
+  }
+
+  utils::CURVE_FUNC_SET.erase(&self);
+  utils::CURVE_FUNC_SET.emplace(&self, curve_function);
+  void *func = (void *)(&(utils::CURVE_FUNC_SET.at(&self)));
+  if (batch) {
+    self.parametric((ParametricVec2Batch)eval_parametric_vec2_batch, func,
+                    relative);
+  } else {
+    self.parametric((ParametricVec2)eval_parametric_vec2, func, relative);
+  }
+}
+
 }  // namespace
 
 void gdstk_curve_bind() {
@@ -280,7 +307,7 @@ void gdstk_curve_bind() {
             if (radius.isNumber()) {
               radius_x = radius_y = radius.as<double>();
             } else if (radius.isArray()) {
-              if (radius["length"].as<int>() != 2) {
+              if (utils::js_length(radius) != 2) {
                 throw std::runtime_error(
                     "Argument radius must be a number of a sequence of 2 "
                     "numbers.");
@@ -302,7 +329,7 @@ void gdstk_curve_bind() {
                   if (radius.isNumber()) {
                     radius_x = radius_y = radius.as<double>();
                   } else if (radius.isArray()) {
-                    if (radius["length"].as<int>() != 2) {
+                    if (utils::js_length(radius) != 2) {
                       throw std::runtime_error(
                           "Argument radius must be a number of a sequence of 2 "
                           "numbers.");
@@ -326,24 +353,26 @@ void gdstk_curve_bind() {
       .function("parametric",
                 optional_override(
                     [](Curve &self, const val &curve_function, bool relative) {
-                      utils::CURVE_FUNC_SET.erase(&self);
-                      utils::CURVE_FUNC_SET.emplace(&self, curve_function);
-                      void *func = (void *)(&(utils::CURVE_FUNC_SET.at(&self)));
-                      self.parametric((ParametricVec2)eval_parametric_vec2,
-                                      func, relative);
+                      curve_parametric(self, curve_function, relative, false);
                     }))
       .function("parametric",
                 optional_override([](Curve &self, const val &curve_function) {
                   bool relative = true;
-                  utils::CURVE_FUNC_SET.erase(&self);
-                  utils::CURVE_FUNC_SET.emplace(&self, curve_function);
-                  void *func = (void *)(&(utils::CURVE_FUNC_SET.at(&self)));
-                  self.parametric((ParametricVec2)eval_parametric_vec2, func,
-                                  relative);
+                  curve_parametric(self, curve_function, relative, false);
+                }))
+      .function("parametric_batch",
+                optional_override(
+                    [](Curve &self, const val &curve_function, bool relative) {
+                      curve_parametric(self, curve_function, relative, true);
+                    }))
+      .function("parametric_batch",
+                optional_override([](Curve &self, const val &curve_function) {
+                  bool relative = true;
+                  curve_parametric(self, curve_function, relative, true);
                 }))
       .function("commands",
                 optional_override([](Curve &self, const val &path_commands) {
-                  auto count = path_commands["length"].as<int>();
+                  auto count = utils::js_length(path_commands);
                   CurveInstruction *instructions =
                       (CurveInstruction *)gdstk::allocate_clear(
                           sizeof(CurveInstruction) * count * 2);
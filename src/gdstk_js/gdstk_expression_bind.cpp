@@ -0,0 +1,49 @@
+#include "binding_utils.h"
+#include "expression.h"
+#include "gdstk_base_bind.h"
+
+namespace {
+std::shared_ptr<utils::Expression> make_expression(
+    const val &source, const val &js_constants = val::null()) {
+  if (!source.isString()) {
+    throw std::runtime_error("Argument source must be a string.");
+  }
+  std::unordered_map<std::string, double> constants;
+  if (!js_constants.isNull() && !js_constants.isUndefined()) {
+    auto keys = val::global("Object").call<val>("keys", js_constants);
+    auto length = utils::js_length(keys);
+    for (uint64_t i = 0; i < length; i++) {
+      auto key = keys[i].as<std::string>();
+      constants[key] = js_constants[key].as<double>();
+    }
+  }
+  return std::make_shared<utils::Expression>(source.as<std::string>(),
+                                             constants);
+}
+}  // namespace
+
+// ----------------------------------------------------------------------------
+void gdstk_expression_bind() {
+  class_<utils::Expression>("Expression")
+      .smart_ptr<std::shared_ptr<utils::Expression>>("Expression_shared_ptr")
+      .constructor(optional_override(
+          [](const val &source) { return make_expression(source); }))
+      .constructor(
+          optional_override([](const val &source, const val &constants) {
+            return make_expression(source, constants);
+          }))
+      .property("source", optional_override([](const utils::Expression &self) {
+                  return self.source();
+                }))
+      .property("components",
+                optional_override([](const utils::Expression &self) {
+                  return self.components();
+                }))
+      .function("eval",
+                optional_override([](const utils::Expression &self, double t) {
+                  if (self.components() == 2) {
+                    return vec2_to_js_array(self.eval_vec2(t));
+                  }
+                  return val(self.eval(t));
+                }));
+}
@@ -1,6 +1,7 @@
 #include <unordered_map>
 
 #include "binding_utils.h"
+#include "expression.h"
 #include "gdstk_base_bind.h"
 
 namespace {
@@ -100,7 +101,7 @@ void set_bend_function(FlexPathElement *el, const val &bend_func) {
 static int parse_flexpath_width(const FlexPath &flexpath, const val &js_width,
                                 double *width) {
   if (js_width.isArray()) {
-    if (js_width["length"].as<int>() < flexpath.num_elements) {
+    if (utils::js_length(js_width) < flexpath.num_elements) {
       throw std::runtime_error("Sequence width doesn't have enough elements.");
     }
     for (uint64_t i = 0; i < flexpath.num_elements; i++) {
@@ -123,7 +124,7 @@ static int parse_flexpath_width(const FlexPath &flexpath, const val &js_width,
 static int parse_flexpath_offset(const FlexPath &flexpath, const val &js_offset,
                                  double *offset) {
   if (js_offset.isArray()) {
-    if (js_offset["length"].as<int>() < flexpath.num_elements) {
+    if (utils::js_length(js_offset) < flexpath.num_elements) {
       throw std::runtime_error("Sequence offset doesn't have enough elements.");
     }
     for (uint64_t i = 0; i < flexpath.num_elements; i++) {
@@ -169,12 +170,12 @@ static std::shared_ptr<FlexPath> make_flexpath(
   // width and offset
   uint64_t num_elements = 1;
   if (width.isArray()) {
-    num_elements = width["length"].as<int>();
+    num_elements = utils::js_length(width);
     flexpath->num_elements = num_elements;
     flexpath->elements = (FlexPathElement *)gdstk::allocate_clear(
         num_elements * sizeof(FlexPathElement));
     if (!offset.isNull() && offset.isArray()) {
-      if (offset["length"].as<int>() != num_elements) {
+      if (utils::js_length(offset) != num_elements) {
         throw std::runtime_error(
             "Sequences width and offset must have the same length.");
       }
@@ -216,7 +217,7 @@ static std::shared_ptr<FlexPath> make_flexpath(
     }
   } else if (!offset.isNull() && offset.isArray()) {
     // Case 3: offset is a sequence, width a number
-    num_elements = offset["length"].as<int>();
+    num_elements = utils::js_length(offset);
     flexpath->num_elements = num_elements;
     flexpath->elements = (FlexPathElement *)gdstk::allocate_clear(
         num_elements * sizeof(FlexPathElement));
@@ -257,7 +258,7 @@ static std::shared_ptr<FlexPath> make_flexpath(
   // layer
   if (!layer.isNull()) {
     if (layer.isArray()) {
-      if (layer["length"].as<int>() != num_elements) {
+      if (utils::js_length(layer) != num_elements) {
         throw std::runtime_error(
             "List layer must have the same length as the number of paths.");
       }
@@ -276,7 +277,7 @@ static std::shared_ptr<FlexPath> make_flexpath(
   // datatype
   if (!datatype.isNull()) {
     if (datatype.isArray()) {
-      if (datatype["length"].as<int>() != num_elements) {
+      if (utils::js_length(datatype) != num_elements) {
         throw std::runtime_error(
             "List datatype must have the same length as the number of paths.");
       }
@@ -295,7 +296,7 @@ static std::shared_ptr<FlexPath> make_flexpath(
   // jointype
   if (!joins.isNull()) {
     if (joins.isArray()) {
-      if (joins["length"].as<int>() != num_elements) {
+      if (utils::js_length(joins) != num_elements) {
         throw std::runtime_error(
             "List joins must have the same length as the number of paths.");
       }
@@ -310,7 +311,7 @@ static std::shared_ptr<FlexPath> make_flexpath(
   // ends
   if (!ends.isNull()) {
     if (ends.isArray()) {
-      if (ends["length"].as<int>() != num_elements) {
+      if (utils::js_length(ends) != num_elements) {
         throw std::runtime_error(
             "List ends must have the same length as the number of paths.");
       }
@@ -325,7 +326,7 @@ static std::shared_ptr<FlexPath> make_flexpath(
   // bend radius
   if (!bend_radius.isNull()) {
     if (bend_radius.isArray()) {
-      if (bend_radius["length"].as<int>() != num_elements) {
+      if (utils::js_length(bend_radius) != num_elements) {
         throw std::runtime_error(
             "Sequence bend_radius must have the same length as the "
             "number of paths.");
@@ -353,7 +354,7 @@ static std::shared_ptr<FlexPath> make_flexpath(
   // bend function
   if (!bend_function.isNull()) {
     if (bend_function.isArray()) {
-      if (bend_function["length"].as<int>() != num_elements) {
+      if (utils::js_length(bend_function) != num_elements) {
         throw std::runtime_error(
             "Sequence bend_function must have the same length as "
             "the number of paths.");
@@ -397,7 +398,7 @@ void flexpath_interpolation(
   if (js_angles.isNull()) {
     memset(angle_constraints, 0, sizeof(bool) * (count + 1));
   } else {
-    if (js_angles["length"].as<int>() != count + 1) {
+    if (utils::js_length(js_angles) != count + 1) {
       gdstk::free_allocation(tension);
       throw std::runtime_error(
           "Argument angles must be None or a sequence with count "
@@ -422,7 +423,7 @@ void flexpath_interpolation(
     Vec2 *t = tension;
     for (uint64_t i = 0; i < count + 1; i++) (t++)->u = t_in;
   } else {
-    if (js_tension_in["length"].as<int>() != count + 1) {
+    if (utils::js_length(js_tension_in) != count + 1) {
       gdstk::free_allocation(tension);
       throw std::runtime_error(
           "Argument tension_in must be a number or a sequence with "
@@ -441,7 +442,7 @@ void flexpath_interpolation(
     Vec2 *t = tension;
     for (uint64_t i = 0; i < count + 1; i++) (t++)->v = t_out;
   } else {
-    if (js_tension_out["length"].as<int>() != count + 1) {
+    if (utils::js_length(js_tension_out) != count + 1) {
       gdstk::free_allocation(tension);
       throw std::runtime_error(
           "Argument tension_out must be a number or a sequence "
@@ -480,7 +481,7 @@ void flexpath_arc(FlexPath &self, const val &radius, double initial_angle,
 
   if (!radius.isArray()) {
     radius_x = radius_y = radius.as<double>();
-  } else if (radius["length"].as<int>() != 2) {
+  } else if (utils::js_length(radius) != 2) {
     throw std::runtime_error(
         "Argument radius must be a number of a sequence of 2 numbers.");
   } else {
@@ -512,6 +513,88 @@ void flexpath_arc(FlexPath &self, const val &radius, double initial_angle,
   gdstk::free_allocation(buffer);
 }
 
+void flexpath_parametric(FlexPath &self, const val &path_function,
+                         const val &js_width = val::null(),
+                         const val &js_offset = val::null(),
+                         bool relative = true, bool batch = false) {
+  ParametricVec2 function;
+  ParametricVec2Batch batch_function;
+  void *data;
+  bool native = false;
+  if (utils::is_expression(path_function)) {
+    auto expression =
+        path_function.as<utils::Expression *>(allow_raw_pointers());
+    if (expression->components() != 2) {
+      throw std::runtime_error(
+          "Path expression must be a vector like \"[x(t), y(t)]\".");
+    }
+    function = (ParametricVec2)utils::eval_expression_vec2;
+    batch_function = (ParametricVec2Batch)utils::eval_expression_vec2_batch;
+    data = (void *)expression;
+    native = true;
+  } else if (path_function.typeOf().as<std::string>() == "function") {
+    utils::PATH_FUNC_SET.erase(&self);
+    utils::PATH_FUNC_SET.emplace(&self, path_function);
+    function = (ParametricVec2)eval_parametric_vec2;
+    batch_function = (ParametricVec2Batch)eval_parametric_vec2_batch;
+    data = (void *)(&(utils::PATH_FUNC_SET.at(&self)));
+  } else {
+    throw std::runtime_error(
+        "Argument path_function must be callable or an Expression.");
+  }
+
+  utils::Expression *width_expression = NULL;
+  utils::Expression *offset_expression = NULL;
+  double *buffer =
+      (double *)gdstk::allocate(sizeof(double) * self.num_elements * 2);
+  double *width = NULL;
+  if (utils::is_expression(js_width)) {
+    width_expression = js_width.as<utils::Expression *>(allow_raw_pointers());
+  } else if (!js_width.isNull()) {
+    width = buffer;
+    parse_flexpath_width(self, js_width, width);
+  }
+  double *offset = NULL;
+  if (utils::is_expression(js_offset)) {
+    offset_expression =
+        js_offset.as<utils::Expression *>(allow_raw_pointers());
+  } else if (!js_offset.isNull()) {
+    offset = buffer + self.num_elements;
+    parse_flexpath_offset(self, js_offset, offset);
+  }
+
+  // Width and offset expressions are evaluated at the parameter of each new
+  // spine point, recorded by the sampling itself
+  Array<double> parameters = {0};
+  Array<double> *parameters_p =
+      width_expression || offset_expression ? &parameters : NULL;
+  const uint64_t first = self.spine.point_array.count;
+  if (batch || native) {
+    self.parametric(batch_function, data, width, offset, relative,
+                    parameters_p);
+  } else {
+    self.parametric(function, data, width, offset, relative, parameters_p);
+  }
+  gdstk::free_allocation(buffer);
+
+  for (uint64_t k = 0; k < parameters.count; k++) {
+    const double u = parameters[k];
+    const uint64_t j = first + k;
+    FlexPathElement *el = self.elements;
+    for (uint64_t i = 0; i < self.num_elements; i++, el++) {
+      Vec2 &half_width_and_offset = el->half_width_and_offset[j];
+      if (width_expression) {
+        half_width_and_offset.u = 0.5 * width_expression->eval(u);
+      }
+      if (offset_expression) {
+        half_width_and_offset.v =
+            (i - 0.5 * (self.num_elements - 1)) * offset_expression->eval(u);
+      }
+    }
+  }
+  parameters.clear();
+}
+
 }  // namespace
 
 // ----------------------------------------------------------------------------
@@ -566,7 +649,7 @@ void gdstk_flexpath_bind() {
                   return int(self.num_elements);
                 }))
       .property("size", optional_override([](const FlexPath &self) {
-                  return int(self.spine.point_array.count);
+                  return utils::js_size(self.spine.point_array.count);
                 }))
       .property("joins", optional_override([](const FlexPath &self) {
                   val r = val::array();
@@ -648,6 +731,7 @@ void gdstk_flexpath_bind() {
                   return self.spine.tolerance;
                 }),
                 optional_override([](FlexPath &self, double value) {
+                  utils::geometry_modified(&self);
                   self.spine.tolerance = value;
                 }))
       .property("simple_path", &FlexPath::simple_path)
@@ -661,6 +745,7 @@ void gdstk_flexpath_bind() {
             return new_repetition;
           }),
           optional_override([](FlexPath &self, const val &repetition) {
+            utils::geometry_modified(&self);
             if (repetition.isNull()) {
               self.repetition.clear();
             } else if (repetition["constructor"]["name"].as<std::string>() !=
@@ -679,6 +764,7 @@ void gdstk_flexpath_bind() {
             return arrayref_to_js_proxy(point_array);
           }),
           optional_override([](FlexPath &self, const val &new_points) {
+            utils::geometry_modified(&self);
             auto points_array = utils::js_array2gdstk_arrayvec2(new_points);
             self.spine.point_array.clear();
             self.spine.point_array.copy_from(*points_array);
@@ -775,6 +861,7 @@ void gdstk_flexpath_bind() {
           }))
       .function("set_datatypes",
                 optional_override([](FlexPath &self, const val &types) {
+                  utils::geometry_modified(&self);
                   auto types_array =
                       utils::js_array2gdstk_array<uint32_t>(types);
                   if (types_array->count != self.num_elements) {
@@ -788,8 +875,9 @@ void gdstk_flexpath_bind() {
                 }))
       .function("set_joins",
                 optional_override([](FlexPath &self, const val &joins) {
+                  utils::geometry_modified(&self);
                   assert(joins.isArray());
-                  auto join_count = joins["length"].as<int>();
+                  auto join_count = utils::js_length(joins);
                   if (join_count != self.num_elements) {
                     throw std::runtime_error(
                         "Length of sequence must match the number of paths.");
@@ -802,8 +890,9 @@ void gdstk_flexpath_bind() {
                 }))
       .function("set_ends",
                 optional_override([](FlexPath &self, const val &ends) {
+                  utils::geometry_modified(&self);
                   assert(ends.isArray());
-                  auto end_count = ends["length"].as<int>();
+                  auto end_count = utils::js_length(ends);
                   if (end_count != self.num_elements) {
                     throw std::runtime_error(
                         "Length of sequence must match the number of paths.");
@@ -816,8 +905,9 @@ void gdstk_flexpath_bind() {
                 }))
       .function("set_bend_radius",
                 optional_override([](FlexPath &self, const val &bend_radius) {
+                  utils::geometry_modified(&self);
                   assert(bend_radius.isArray());
-                  auto radius_count = bend_radius["length"].as<int>();
+                  auto radius_count = utils::js_length(bend_radius);
                   if (radius_count != self.num_elements) {
                     throw std::runtime_error(
                         "Length of sequence must match the number of paths.");
@@ -840,7 +930,7 @@ void gdstk_flexpath_bind() {
           "set_bend_function",
           optional_override([](FlexPath &self, const val &bend_functions) {
             assert(bend_functions.isArray());
-            auto func_count = bend_functions["length"].as<int>();
+            auto func_count = utils::js_length(bend_functions);
             if (func_count != self.num_elements) {
               throw std::runtime_error(
                   "Length of sequence must match the number of paths.");
@@ -861,6 +951,7 @@ void gdstk_flexpath_bind() {
                 optional_override([](FlexPath &self, const val &x,
                                      const val &js_width, const val &js_offset,
                                      bool relative) {
+                  utils::geometry_modified(&self);
                   double *buffer = (double *)gdstk::allocate(
                       sizeof(double) * self.num_elements * 2);
                   double *width = NULL;
@@ -885,6 +976,7 @@ void gdstk_flexpath_bind() {
                 }))
       .function("horizontal",
                 optional_override([](FlexPath &self, const val &x) {
+                  utils::geometry_modified(&self);
                   double *width = NULL;
                   double *offset = NULL;
                   bool relative = false;
@@ -899,6 +991,7 @@ void gdstk_flexpath_bind() {
                 optional_override([](FlexPath &self, const val &y,
                                      const val &js_width, const val &js_offset,
                                      bool relative) {
+                  utils::geometry_modified(&self);
                   double *buffer = (double *)gdstk::allocate(
                       sizeof(double) * self.num_elements * 2);
                   double *width = NULL;
@@ -921,6 +1014,7 @@ void gdstk_flexpath_bind() {
                   gdstk::free_allocation(buffer);
                 }))
       .function("vertical", optional_override([](FlexPath &self, const val &y) {
+                  utils::geometry_modified(&self);
                   double *width = NULL;
                   double *offset = NULL;
                   bool relative = false;
@@ -935,6 +1029,7 @@ void gdstk_flexpath_bind() {
           "segment", optional_override([](FlexPath &self, const val &xy,
                                           const val &js_width,
                                           const val &js_offset, bool relative) {
+            utils::geometry_modified(&self);
             double *buffer = (double *)gdstk::allocate(sizeof(double) *
                                                        self.num_elements * 2);
             double *width = NULL;
@@ -957,6 +1052,7 @@ void gdstk_flexpath_bind() {
             gdstk::free_allocation(buffer);
           }))
       .function("segment", optional_override([](FlexPath &self, const val &xy) {
+                  utils::geometry_modified(&self);
                   double *width = NULL;
                   double *offset = NULL;
                   bool relative = false;
@@ -971,6 +1067,7 @@ void gdstk_flexpath_bind() {
           "cubic", optional_override([](FlexPath &self, const val &xy,
                                         const val &js_width,
                                         const val &js_offset, bool relative) {
+            utils::geometry_modified(&self);
             double *buffer = (double *)gdstk::allocate(sizeof(double) *
                                                        self.num_elements * 2);
             double *width = NULL;
@@ -991,6 +1088,7 @@ void gdstk_flexpath_bind() {
           }))
       .function("cubic",
                 optional_override([](FlexPath &self, const val &points) {
+                  utils::geometry_modified(&self);
                   double *width = NULL;
                   double *offset = NULL;
                   bool relative = false;
@@ -1001,6 +1099,7 @@ void gdstk_flexpath_bind() {
                 optional_override([](FlexPath &self, const val &xy,
                                      const val &js_width, const val &js_offset,
                                      bool relative) {
+                  utils::geometry_modified(&self);
                   double *buffer = (double *)gdstk::allocate(
                       sizeof(double) * self.num_elements * 2);
                   double *width = NULL;
@@ -1020,6 +1119,7 @@ void gdstk_flexpath_bind() {
                 }))
       .function("cubic_smooth",
                 optional_override([](FlexPath &self, const val &xy) {
+                  utils::geometry_modified(&self);
                   double *width = NULL;
                   double *offset = NULL;
                   bool relative = false;
@@ -1031,6 +1131,7 @@ void gdstk_flexpath_bind() {
                 optional_override([](FlexPath &self, const val &xy,
                                      const val &js_width, const val &js_offset,
                                      bool relative) {
+                  utils::geometry_modified(&self);
                   double *buffer = (double *)gdstk::allocate(
                       sizeof(double) * self.num_elements * 2);
                   double *width = NULL;
@@ -1050,6 +1151,7 @@ void gdstk_flexpath_bind() {
                 }))
       .function("quadratic",
                 optional_override([](FlexPath &self, const val &xy) {
+                  utils::geometry_modified(&self);
                   double *width = NULL;
                   double *offset = NULL;
                   bool relative = false;
@@ -1060,6 +1162,7 @@ void gdstk_flexpath_bind() {
                 optional_override([](FlexPath &self, const val &xy,
                                      const val &js_width, const val &js_offset,
                                      bool relative) {
+                  utils::geometry_modified(&self);
                   double *buffer = (double *)gdstk::allocate(
                       sizeof(double) * self.num_elements * 2);
                   double *width = NULL;
@@ -1079,6 +1182,7 @@ void gdstk_flexpath_bind() {
                 }))
       .function("quadratic_smooth",
                 optional_override([](FlexPath &self, const val &xy) {
+                  utils::geometry_modified(&self);
                   double *width = NULL;
                   double *offset = NULL;
                   bool relative = false;
@@ -1089,6 +1193,7 @@ void gdstk_flexpath_bind() {
           "bezier", optional_override([](FlexPath &self, const val &xy,
                                          const val &js_width,
                                          const val &js_offset, bool relative) {
+            utils::geometry_modified(&self);
             double *buffer = (double *)gdstk::allocate(sizeof(double) *
                                                        self.num_elements * 2);
             double *width = NULL;
@@ -1107,6 +1212,7 @@ void gdstk_flexpath_bind() {
             gdstk::free_allocation(buffer);
           }))
       .function("bezier", optional_override([](FlexPath &self, const val &xy) {
+                  utils::geometry_modified(&self);
                   double *width = NULL;
                   double *offset = NULL;
                   bool relative = false;
@@ -1119,6 +1225,7 @@ void gdstk_flexpath_bind() {
                        const val &tension_in, const val &tension_out,
                        double initial_curl, double final_curl, bool cycle,
                        const val &width, const val &offset, bool relative) {
+                      utils::geometry_modified(&self);
                       flexpath_interpolation(self, points, angles, tension_in,
                                              tension_out, initial_curl,
                                              final_curl, cycle, width, offset,
@@ -1126,6 +1233,7 @@ void gdstk_flexpath_bind() {
                     }))
       .function("interpolation",
                 optional_override([](FlexPath &self, const val &points) {
+                  utils::geometry_modified(&self);
                   flexpath_interpolation(self, points);
                 }))
       .function("arc",
@@ -1133,17 +1241,20 @@ void gdstk_flexpath_bind() {
                                      double initial_angle, double final_angle,
                                      double rotation, const val &js_width,
                                      const val &js_offset) {
+                  utils::geometry_modified(&self);
                   flexpath_arc(self, radius, initial_angle, final_angle,
                                rotation, js_width, js_offset);
                 }))
       .function("arc",
                 optional_override([](FlexPath &self, const val &radius,
                                      double initial_angle, double final_angle) {
+                  utils::geometry_modified(&self);
                   flexpath_arc(self, radius, initial_angle, final_angle);
                 }))
       .function("turn", optional_override([](FlexPath &self, double radius,
                                              double angle, const val &js_width,
                                              const val &js_offset) {
+                  utils::geometry_modified(&self);
                   double *buffer = (double *)gdstk::allocate(
                       sizeof(double) * self.num_elements * 2);
                   double *width = NULL;
@@ -1167,6 +1278,7 @@ void gdstk_flexpath_bind() {
                 }))
       .function("turn", optional_override([](FlexPath &self, double radius,
                                              double angle) {
+                  utils::geometry_modified(&self);
                   double *width = NULL;
                   double *offset = NULL;
 
@@ -1179,48 +1291,33 @@ void gdstk_flexpath_bind() {
                 optional_override([](FlexPath &self, const val &path_function,
                                      const val &js_width, const val &js_offset,
                                      bool relative) {
-                  if (path_function.typeOf().as<std::string>() != "function") {
-                    throw std::runtime_error(
-                        "Argument path_function must be callable.");
-                  }
-
-                  double *buffer = (double *)gdstk::allocate(
-                      sizeof(double) * self.num_elements * 2);
-                  double *width = NULL;
-                  if (!js_width.isNull()) {
-                    width = buffer;
-                    parse_flexpath_width(self, js_width, width);
-                  }
-                  double *offset = NULL;
-                  if (!js_offset.isNull()) {
-                    offset = buffer + self.num_elements;
-                    parse_flexpath_offset(self, js_offset, offset);
-                  }
-
-                  utils::PATH_FUNC_SET.erase(&self);
-                  utils::PATH_FUNC_SET.emplace(&self, path_function);
-                  void *func = (void *)(&(utils::PATH_FUNC_SET.at(&self)));
-
-                  self.parametric((ParametricVec2)eval_parametric_vec2, func,
-                                  width, offset, relative);
-                  gdstk::free_allocation(buffer);
+                  utils::geometry_modified(&self);
+                  flexpath_parametric(self, path_function, js_width, js_offset,
+                                      relative, false);
                 }))
       .function("parametric",
                 optional_override([](FlexPath &self, const val &path_function) {
-                  double *width = NULL;
-                  double *offset = NULL;
-                  bool relative = true;
-
-                  utils::PATH_FUNC_SET.erase(&self);
-                  utils::PATH_FUNC_SET.emplace(&self, path_function);
-                  void *func = (void *)(&(utils::PATH_FUNC_SET.at(&self)));
-
-                  self.parametric((ParametricVec2)eval_parametric_vec2, func,
-                                  width, offset, relative);
+                  utils::geometry_modified(&self);
+                  flexpath_parametric(self, path_function);
+                }))
+      .function("parametric_batch",
+                optional_override([](FlexPath &self, const val &path_function,
+                                     const val &js_width, const val &js_offset,
+                                     bool relative) {
+                  utils::geometry_modified(&self);
+                  flexpath_parametric(self, path_function, js_width, js_offset,
+                                      relative, true);
+                }))
+      .function("parametric_batch",
+                optional_override([](FlexPath &self, const val &path_function) {
+                  utils::geometry_modified(&self);
+                  flexpath_parametric(self, path_function, val::null(),
+                                      val::null(), true, true);
                 }))
       .function("commands",
                 optional_override([](FlexPath &self, const val &path_commands) {
-                  auto count = path_commands["length"].as<int>();
+                  utils::geometry_modified(&self);
+                  auto count = utils::js_length(path_commands);
                   CurveInstruction *instructions =
                       (CurveInstruction *)gdstk::allocate_clear(
                           sizeof(CurveInstruction) * count * 2);
@@ -1252,37 +1349,46 @@ void gdstk_flexpath_bind() {
                 allow_raw_pointers())
       .function("translate",
                 optional_override([](FlexPath &self, double dx, double dy) {
+                  utils::geometry_modified(&self);
                   return self.translate({dx, dy});
                 }))
       .function("translate",
                 optional_override([](FlexPath &self, const val &dx) {
+                  utils::geometry_modified(&self);
                   return self.translate(to_vec2(dx));
                 }))
       .function("scale", optional_override(
                              [](FlexPath &self, double s, const val &center) {
+                               utils::geometry_modified(&self);
                                return self.scale(s, to_vec2(center));
                              }))
       .function("scale", optional_override([](FlexPath &self, double s) {
+                  utils::geometry_modified(&self);
                   Vec2 center{0, 0};
                   return self.scale(s, center);
                 }))
       .function("mirror", optional_override(
                               [](FlexPath &self, const val &p0, const val &p1) {
+                                utils::geometry_modified(&self);
                                 return self.mirror(to_vec2(p0), to_vec2(p1));
                               }))
       .function("mirror", optional_override([](FlexPath &self, const val &p0) {
+                  utils::geometry_modified(&self);
                   const Vec2 p1{0, 0};
                   return self.mirror(to_vec2(p0), p1);
                 }))
       .function("rotate", optional_override([](FlexPath &self, double angle,
                                                const val &center) {
+                  utils::geometry_modified(&self);
                   return self.rotate(angle, to_vec2(center));
                 }))
       .function("rotate", optional_override([](FlexPath &self, double angle) {
+                  utils::geometry_modified(&self);
                   Vec2 center{0, 0};
                   return self.rotate(angle, center);
                 }))
       .function("apply_repetition", optional_override([](FlexPath &self) {
+                  utils::geometry_modified(&self);
                   Array<FlexPath *> array = {0};
                   self.apply_repetition(array);
                   auto result = utils::gdstk_array2js_array_by_ref(
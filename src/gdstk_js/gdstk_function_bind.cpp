@@ -1,8 +1,17 @@
+#include <emscripten/heap.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 #include <iostream>
 #include <memory>
 
+#include "arena_allocator.h"
+#include "async_job.h"
 #include "binding_utils.h"
 #include "gdstk_base_bind.h"
+#include "thread_pool.h"
+#include "trace.h"
 
 // js function for upload gds file, save file to wasm memory and return name to
 // C++ as val type
@@ -49,9 +58,11 @@ static void parse_polygons(const val &polygons,
         ->to_polygons(false, 0, polygon_array);
   } else if (cons == "Reference") {
     polygons.as<Reference *>(allow_raw_pointers())
-        ->get_polygons(true, true, -1, false, 0, polygon_array);
+        ->visit_polygons(true, true, -1, false, 0,
+                         gdstk::identity_transformation(),
+                         gdstk::append_transformed_polygon, &polygon_array);
   } else if (polygons.isArray()) {
-    auto count = polygons["length"].as<int>();
+    int64_t count = utils::js_length(polygons);
     for (int64_t i = count - 1; i >= 0; i--) {
       auto cons = polygons[i]["constructor"]["name"].as<std::string>();
       if (cons == "Polygon") {
@@ -69,7 +80,9 @@ static void parse_polygons(const val &polygons,
       } else if (cons == "Reference") {
         polygons[i]
             .as<Reference *>(allow_raw_pointers())
-            ->get_polygons(true, true, -1, false, 0, polygon_array);
+            ->visit_polygons(true, true, -1, false, 0,
+                             gdstk::identity_transformation(),
+                             gdstk::append_transformed_polygon, &polygon_array);
       } else {
         std::string error = "Unable to parse item " + cons + " from sequnce " +
                             std::to_string(i);
@@ -205,12 +218,12 @@ val make_contour(const val &data, double level = 0, double length_scale = 1,
                  double precision = 0.01, int layer = 0, int datatype = 0) {
   assert(data.isArray());
   Array<Array<double>> matrix = {0};
-  auto rows = data["length"].as<int>();
-  auto cols = 0;
+  auto rows = utils::js_length(data);
+  uint64_t cols = 0;
   for (size_t i = 0; i < rows; i++) {
     Array<double> m_row = {0};
 
-    cols = (cols == 0) ? data[i]["length"].as<int>() : cols;
+    cols = (cols == 0) ? utils::js_length(data[i]) : cols;
     for (size_t j = 0; j < cols; j++) {
       m_row.append(data[i][j].as<double>());
     }
@@ -240,21 +253,33 @@ val make_contour(const val &data, double level = 0, double length_scale = 1,
   return r;
 }
 
+OffsetJoin parse_offset_join(const val &join) {
+  assert(join.isString());
+  auto join_str = join.as<std::string>();
+  if (join_str == "miter") return OffsetJoin::Miter;
+  if (join_str == "bevel") return OffsetJoin::Bevel;
+  if (join_str == "round") return OffsetJoin::Round;
+  throw std::runtime_error(
+      "Argument join must be one of 'miter', 'bevel', or 'round'.");
+}
+
+Operation parse_operation(const val &operation) {
+  assert(operation.isString());
+  auto operation_str = operation.as<std::string>();
+  if (operation_str == "or") return Operation::Or;
+  if (operation_str == "and") return Operation::And;
+  if (operation_str == "xor") return Operation::Xor;
+  if (operation_str == "not") return Operation::Not;
+  throw std::runtime_error(
+      "Argument operation must be one of 'or', 'and', "
+      "'xor', or 'not'.");
+}
+
 val make_offset(const val &polygons, double distance,
                 const val &join = val("miter"), double tolerance = 2,
                 double precision = 1e-3, bool use_union = false, int layer = 0,
-                int datatype = 0) {
-  assert(join.isString());
-  auto join_str = join.as<std::string>();
-  OffsetJoin offset_join = OffsetJoin::Miter;
-  if (join_str == "bevel")
-    offset_join = OffsetJoin::Bevel;
-  else if (join_str == "round")
-    offset_join = OffsetJoin::Round;
-  else {
-    throw std::runtime_error(
-        "Argument join must be one of 'miter', 'bevel', or 'round'.");
-  }
+                int datatype = 0, GeometryContext *context = NULL) {
+  OffsetJoin offset_join = parse_offset_join(join);
 
   if (tolerance <= 0) {
     throw std::runtime_error("Tolerance must be positive.");
@@ -269,7 +294,7 @@ val make_offset(const val &polygons, double distance,
 
   Array<Polygon *> result_array = {0};
   gdstk::offset(polygon_array, distance, offset_join, tolerance, 1 / precision,
-                use_union, result_array);
+                use_union, result_array, context);
   Tag tag = gdstk::make_tag(layer, datatype);
   for (size_t i = 0; i < result_array.count; i++) {
     result_array[i]->tag = tag;
@@ -286,24 +311,132 @@ val make_offset(const val &polygons, double distance,
   return r;
 }
 
-val make_boolean(const val &operand1, const val &operand2, const val &operation,
-                 double precision = 1e-3, int layer = 0, int datatype = 0) {
-  assert(operation.isString());
-  auto operation_str = operation.as<std::string>();
-  Operation oper;
-  if (operation_str == "or")
-    oper = Operation::Or;
-  else if (operation_str == "and")
-    oper = Operation::And;
-  else if (operation_str == "xor")
-    oper = Operation::Xor;
-  else if (operation_str == "not")
-    oper = Operation::Not;
-  else {
-    throw std::runtime_error(
-        "Argument operation must be one of 'or', 'and', "
-        "'xor', or 'not'.");
+// Tiling options of boolean operations: {tile_size: number | "auto",
+// merge: boolean}.  Return false if tile_size is not set (no tiling), and set
+// tile_size to 0 for "auto".
+bool parse_tile_options(const val &options, double &tile_size, bool &merge) {
+  if (options.isNull() || options.isUndefined()) return false;
+  const val size = options["tile_size"];
+  if (size.isNull() || size.isUndefined()) return false;
+  if (size.isString() && size.as<std::string>() == "auto") {
+    tile_size = 0;
+  } else if (size.isNumber() && size.as<double>() > 0) {
+    tile_size = size.as<double>();
+  } else {
+    throw std::runtime_error("Option tile_size must be positive or 'auto'.");
   }
+  const val merge_option = options["merge"];
+  merge = merge_option.isUndefined() || merge_option.as<bool>();
+  return true;
+}
+
+// Tiles per thread used for tile_size 'auto', so that uneven tiles still keep
+// all threads busy
+#define AUTO_TILES_PER_THREAD 4
+
+// gdstk::BooleanTiles with the tiles clipped concurrently on the thread pool.
+// A tile_size of 0 splits the operands in about AUTO_TILES_PER_THREAD tiles
+// per thread.  Without merge, result polygons are left cut at tile
+// boundaries.
+ErrorCode tiled_boolean(const Array<Polygon *> &polys1,
+                        const Array<Polygon *> &polys2, Operation operation,
+                        double scaling, double tile_size, bool merge,
+                        Array<Polygon *> &result) {
+  gdstk::TraceSpan span("boolean:tiled");
+  if (tile_size <= 0) {
+    Vec2 min = {DBL_MAX, DBL_MAX};
+    Vec2 max = {-DBL_MAX, -DBL_MAX};
+    const Array<Polygon *> *operands[] = {&polys1, &polys2};
+    for (auto operand : operands) {
+      for (uint64_t i = 0; i < operand->count; i++) {
+        Vec2 pmin, pmax;
+        operand->items[i]->bounding_box(pmin, pmax);
+        if (pmin.x < min.x) min.x = pmin.x;
+        if (pmin.y < min.y) min.y = pmin.y;
+        if (pmax.x > max.x) max.x = pmax.x;
+        if (pmax.y > max.y) max.y = pmax.y;
+      }
+    }
+    if (min.x > max.x) return ErrorCode::NoError;
+    const double side = std::ceil(std::sqrt(
+        (double)(AUTO_TILES_PER_THREAD * utils::ThreadPool::instance().size())));
+    tile_size = std::max(max.x - min.x, max.y - min.y) / side;
+    if (tile_size <= 0) tile_size = 1 / scaling;
+  }
+
+  gdstk::BooleanTiles tiles = {};
+  tiles.init(polys1, polys2, operation, scaling, tile_size);
+  uint64_t count = tiles.count();
+  Array<Polygon *> *parts =
+      (Array<Polygon *> *)gdstk::allocate_clear(count * sizeof(Array<Polygon *>));
+  Array<Polygon *> *borders =
+      merge ? (Array<Polygon *> *)gdstk::allocate_clear(
+                  count * sizeof(Array<Polygon *>))
+            : NULL;
+  ErrorCode *errors =
+      (ErrorCode *)gdstk::allocate_clear(count * sizeof(ErrorCode));
+  utils::ThreadPool::instance().parallel_for(count, [&](size_t i) {
+    errors[i] = tiles.run(i, parts[i], borders ? borders + i : NULL);
+  });
+
+  ErrorCode error_code = ErrorCode::NoError;
+  for (uint64_t i = 0; i < count; i++) {
+    if (errors[i] != ErrorCode::NoError) error_code = errors[i];
+    result.extend(parts[i]);
+    parts[i].clear();
+  }
+  if (merge) {
+    ErrorCode merge_error = tiles.merge(borders, result);
+    if (merge_error != ErrorCode::NoError) error_code = merge_error;
+    gdstk::free_allocation(borders);
+  }
+  gdstk::free_allocation(errors);
+  gdstk::free_allocation(parts);
+  tiles.clear();
+  return error_code;
+}
+
+// Union of both operands with gdstk::BalancedUnion, the unions of each level
+// running concurrently on the thread pool.  Return false, without touching
+// result, if the operands are too small to be split or need a single sweep.
+bool parallel_union(const Array<Polygon *> &polys1,
+                    const Array<Polygon *> &polys2, double scaling,
+                    Array<Polygon *> &result) {
+  uint64_t num_points = 0;
+  const Array<Polygon *> *operands[] = {&polys1, &polys2};
+  for (auto operand : operands) {
+    for (uint64_t i = 0; i < operand->count; i++) {
+      num_points += operand->items[i]->point_array.count;
+    }
+  }
+  if (num_points <= GDSTK_UNION_GROUP_POINTS) return false;
+
+  gdstk::TraceSpan span("boolean:balanced");
+  Array<Polygon *> polygons = {0};
+  polygons.ensure_slots(polys1.count + polys2.count);
+  polygons.extend(polys1);
+  polygons.extend(polys2);
+  gdstk::BalancedUnion tree = {};
+  tree.init(polygons, scaling);
+  polygons.clear();
+  if (tree.single_sweep) return false;
+  do {
+    utils::ThreadPool::instance().parallel_for(
+        tree.count(), [&](size_t i) { tree.run(i); });
+  } while (tree.next());
+  tree.finish(result);
+  tree.clear();
+  return true;
+}
+
+val make_boolean(const val &operand1, const val &operand2, const val &operation,
+                 double precision = 1e-3, int layer = 0, int datatype = 0,
+                 const val &options = val::null(),
+                 GeometryContext *context = NULL) {
+  Operation oper = parse_operation(operation);
+  double tile_size;
+  bool merge;
+  bool tiled = parse_tile_options(options, tile_size, merge);
 
   Array<Polygon *> polygon_array1 = {0};
   Array<Polygon *> polygon_array2 = {0};
@@ -311,7 +444,15 @@ val make_boolean(const val &operand1, const val &operand2, const val &operation,
   parse_polygons(operand2, polygon_array2);
 
   Array<Polygon *> result_array = {0};
-  boolean(polygon_array1, polygon_array2, oper, 1 / precision, result_array);
+  if (tiled) {
+    tiled_boolean(polygon_array1, polygon_array2, oper, 1 / precision,
+                  tile_size, merge, result_array);
+  } else if (oper != Operation::Or || context ||
+             !parallel_union(polygon_array1, polygon_array2, 1 / precision,
+                             result_array)) {
+    boolean(polygon_array1, polygon_array2, oper, 1 / precision, result_array,
+            context);
+  }
 
   for (size_t i = 0; i < polygon_array1.count; i++) {
     polygon_array1[i]->clear();
@@ -333,9 +474,163 @@ val make_boolean(const val &operand1, const val &operand2, const val &operation,
   return r;
 }
 
+// Without a context, polygons are sliced concurrently.  A context is not
+// thread safe, so with one they are sliced in sequence.
+val make_slice(const val &polygons, const val &position, const val &axis,
+               double precision, GeometryContext *context = NULL) {
+  auto axis_str = axis.as<std::string>();
+  bool x_axis;
+  if (axis_str == "x")
+    x_axis = true;
+  else if (axis_str == "y")
+    x_axis = false;
+  else {
+    throw std::runtime_error("Argument axis must be 'x' or 'y'.");
+  }
+
+  std::shared_ptr<Array<double>> positions = utils::make_gdstk_array<double>();
+  if (position.isArray()) {
+    positions = utils::js_array2gdstk_array<double>(position);
+  } else if (position.isNumber()) {
+    positions->append(position.as<double>());
+  } else {
+    throw std::runtime_error(
+        "Argument position must be number or array of number");
+  }
+  // slice cuts at all positions in a single pass, in ascending order
+  std::sort(positions->items, positions->items + positions->count);
+
+  Array<Polygon *> polygon_array = {0};
+  parse_polygons(polygons, polygon_array);
+
+  val result = val::array();
+
+  // Results go to js in input order
+  uint64_t num_slices = positions->count + 1;
+  Array<Polygon *> *all_slices = (Array<Polygon *> *)gdstk::allocate_clear(
+      polygon_array.count * num_slices * sizeof(Array<Polygon *>));
+  // NOTE: slice should never result in an error
+  if (context) {
+    for (uint64_t i = 0; i < polygon_array.count; i++) {
+      slice(*polygon_array[i], *positions, x_axis, 1 / precision,
+            all_slices + i * num_slices, context);
+    }
+  } else {
+    utils::ThreadPool::instance().parallel_for(
+        polygon_array.count, [&](size_t i) {
+          slice(*polygon_array[i], *positions, x_axis, 1 / precision,
+                all_slices + i * num_slices);
+        });
+  }
+
+  for (uint64_t i = 0; i < polygon_array.count; i++) {
+    Tag tag = polygon_array[i]->tag;
+    Array<Polygon *> *slice_array = all_slices + i * num_slices;
+    for (uint64_t s = 0; s < num_slices; s++, slice_array++) {
+      for (uint64_t j = 0; j < slice_array->count; j++) {
+        slice_array->items[j]->tag = tag;
+      }
+      result.call<void>("push", utils::gdstk_array2js_array_by_ref(
+                                    *slice_array, utils::PolygonDeleter()));
+      slice_array->clear();
+    }
+  }
+  gdstk::free_allocation(all_slices);
+
+  for (size_t i = 0; i < polygon_array.count; i++) {
+    polygon_array[i]->clear();
+  }
+  polygon_array.clear();
+
+  return result;
+}
+
+std::shared_ptr<GeometryContext> make_geometry_context() {
+  return std::shared_ptr<GeometryContext>(
+      (GeometryContext *)gdstk::allocate_clear(sizeof(GeometryContext)),
+      utils::GeometryContextDeleter());
+}
+
+// Native operands and result of a polygon operation run as utils::AsyncJob
+struct PolygonJob {
+  Array<Polygon *> operand1 = {0};
+  Array<Polygon *> operand2 = {0};
+  Array<Polygon *> result = {0};
+
+  ~PolygonJob() {
+    free_polygons(operand1);
+    free_polygons(operand2);
+    free_polygons(result);
+  }
+
+  static void free_polygons(Array<Polygon *> &array) {
+    for (uint64_t i = 0; i < array.count; i++) {
+      array[i]->clear();
+      gdstk::free_allocation(array[i]);
+    }
+    array.clear();
+  }
+
+  val take_result(Tag tag) {
+    for (uint64_t i = 0; i < result.count; i++) {
+      result[i]->tag = tag;
+    }
+    auto r =
+        utils::gdstk_array2js_array_by_ref(result, utils::PolygonDeleter());
+    result.clear();
+    return r;
+  }
+};
+
+val make_offset_async(const val &polygons, double distance,
+                      const val &join = val("miter"), double tolerance = 2,
+                      double precision = 1e-3, bool use_union = false,
+                      int layer = 0, int datatype = 0,
+                      const val &options = val::null()) {
+  OffsetJoin offset_join = parse_offset_join(join);
+
+  if (tolerance <= 0) {
+    throw std::runtime_error("Tolerance must be positive.");
+  }
+
+  if (precision <= 0) {
+    throw std::runtime_error("Precision must be positive.");
+  }
+
+  auto job = std::make_shared<PolygonJob>();
+  parse_polygons(polygons, job->operand1);
+  double scaling = 1 / precision;
+  Tag tag = gdstk::make_tag(layer, datatype);
+  return utils::AsyncJob::run(
+      [=]() {
+        return gdstk::offset(job->operand1, distance, offset_join, tolerance,
+                             scaling, use_union, job->result);
+      },
+      [=]() { return job->take_result(tag); }, options);
+}
+
+val make_boolean_async(const val &operand1, const val &operand2,
+                       const val &operation, double precision = 1e-3,
+                       int layer = 0, int datatype = 0,
+                       const val &options = val::null()) {
+  Operation oper = parse_operation(operation);
+
+  auto job = std::make_shared<PolygonJob>();
+  parse_polygons(operand1, job->operand1);
+  parse_polygons(operand2, job->operand2);
+  double scaling = 1 / precision;
+  Tag tag = gdstk::make_tag(layer, datatype);
+  return utils::AsyncJob::run(
+      [=]() {
+        return gdstk::boolean(job->operand1, job->operand2, oper, scaling,
+                              job->result);
+      },
+      [=]() { return job->take_result(tag); }, options);
+}
+
 void parse_tag_sequence(const val &js_array, gdstk::Set<Tag> &dest) {
   assert(js_array.isArray());
-  int64_t count = js_array["length"].as<int64_t>();
+  uint64_t count = utils::js_length(js_array);
   for (size_t i = 0; i < count; i++) {
     auto item = js_array[i];
     assert(item.isArray());
@@ -362,43 +657,8 @@ void regist_reference(
   }
 }
 
-void regist_cell(Cell *cell) {
-  utils::CELL_KEEP_ALIVE_GEOM[cell];
-  auto &poly_array = cell->polygon_array;
-  for (size_t i = 0; i < poly_array.count; i++) {
-    utils::CELL_KEEP_ALIVE_GEOM[cell].polygons.insert(
-        {poly_array[i],
-         std::shared_ptr<Polygon>(poly_array[i], utils::PolygonDeleter())});
-  }
-
-  auto &ref_array = cell->reference_array;
-  for (size_t i = 0; i < ref_array.count; i++) {
-    utils::CELL_KEEP_ALIVE_GEOM[cell].references.insert(
-        {ref_array[i],
-         std::shared_ptr<Reference>(ref_array[i], utils::ReferenceDeleter())});
-  }
-
-  auto &flex_array = cell->flexpath_array;
-  for (size_t i = 0; i < flex_array.count; i++) {
-    utils::CELL_KEEP_ALIVE_GEOM[cell].flexpaths.insert(
-        {flex_array[i],
-         std::shared_ptr<FlexPath>(flex_array[i], utils::FlexPathDeleter())});
-  }
-
-  auto &robust_array = cell->robustpath_array;
-  for (size_t i = 0; i < robust_array.count; i++) {
-    utils::CELL_KEEP_ALIVE_GEOM[cell].robustpaths.insert(
-        {robust_array[i], std::shared_ptr<RobustPath>(
-                              robust_array[i], utils::RobustPathDeleter())});
-  }
-
-  auto &label_array = cell->label_array;
-  for (size_t i = 0; i < label_array.count; i++) {
-    utils::CELL_KEEP_ALIVE_GEOM[cell].labels.insert(
-        {label_array[i],
-         std::shared_ptr<Label>(label_array[i], utils::LabelDeleter())});
-  }
-}
+// Elements get their shared_ptr when handed to js (utils::keep_alive)
+void regist_cell(Cell *cell) { utils::CELL_KEEP_ALIVE_GEOM[cell]; }
 
 void regist_rawcell(RawCell *cell) {
   throw std::runtime_error("regits_rawcell not implemented");
@@ -428,8 +688,235 @@ void regist_lib(Library *library) {
     regist_reference(cell_array[i], cell_ptr_table);
   }
 }
+
+// Library parsed by a utils::AsyncJob, handed to js once complete
+struct ReadGdsJob {
+  std::string filename;
+  gdstk::Set<Tag> shape_tags = {0};
+  bool filter = false;
+  std::shared_ptr<Library> library;
+
+  ~ReadGdsJob() { shape_tags.clear(); }
+};
+
+val read_gds_async(const val &infile, double unit = 0, double tolerance = 1e-2,
+                   const val &filter = val::null(),
+                   const val &options = val::null()) {
+  if (tolerance <= 0) {
+    throw std::runtime_error("Tolerance must be positive.");
+  }
+
+  auto job = std::make_shared<ReadGdsJob>();
+  if (!filter.isNull()) {
+    parse_tag_sequence(filter, job->shape_tags);
+    job->filter = true;
+  }
+  job->filename = infile.as<std::string>();
+  job->library = std::shared_ptr<Library>(
+      (Library *)gdstk::allocate_clear(sizeof(Library)),
+      utils::LibraryDeleter());
+
+  return utils::AsyncJob::run(
+      [=]() {
+        ErrorCode error_code = ErrorCode::NoError;
+        utils::ArenaScope arena;
+        *job->library =
+            read_gds(job->filename.c_str(), unit, tolerance,
+                     job->filter ? &job->shape_tags : NULL, &error_code);
+        return error_code;
+      },
+      [=]() {
+        regist_lib(job->library.get());
+        return val(job->library);
+      },
+      options);
+}
+
+std::shared_ptr<Library> read_oas(const val &infile, double unit = 0,
+                                  double tolerance = 1e-2) {
+  auto filename = infile.as<std::string>();
+  std::shared_ptr<Library> library = std::shared_ptr<Library>(
+      (Library *)gdstk::allocate_clear(sizeof(Library)),
+      utils::LibraryDeleter());
+  ErrorCode error_code = ErrorCode::NoError;
+  {
+    utils::ArenaScope arena;
+    *library = gdstk::read_oas(filename.c_str(), unit, tolerance, &error_code);
+  }
+  regist_lib(library.get());
+  return library;
+}
+
+val memory_stats() {
+  // Default is never recorded: it resolves to geometry or bindings
+  static const char *names[] = {nullptr, "geometry", "library",
+                                "paths",  "clipper",  "bindings"};
+  utils::MemoryStats stats[(int)gdstk::MemoryCategory::Count];
+  bool enabled = utils::get_memory_stats(stats);
+  val result = val::object();
+  result.set("enabled", enabled);
+  // Doubles: byte counts may exceed 2^31 with MEMORY64
+  for (int i = 1; i < (int)gdstk::MemoryCategory::Count; i++) {
+    val category = val::object();
+    category.set("live_bytes", (double)stats[i].live_bytes);
+    category.set("peak_bytes", (double)stats[i].peak_bytes);
+    category.set("allocations", (double)stats[i].live_allocations);
+    category.set("total_allocations", (double)stats[i].total_allocations);
+    result.set(names[i], category);
+  }
+  result.set("reserved_bytes", (double)utils::get_reserved_bytes());
+  result.set("heap_size", (double)emscripten_get_heap_size());
+  return result;
+}
+
+// Points tested per thread pool task
+#define INSIDE_CHUNK_SIZE 4096
+
+// gdstk::inside on the thread pool: the index is built once and points are
+// tested in chunks
+void parallel_inside(const Array<Vec2> &points,
+                     const Array<Polygon *> &polygons, bool *result) {
+  gdstk::InsideIndex index = {};
+  index.init(polygons);
+  uint64_t num_chunks =
+      (points.count + INSIDE_CHUNK_SIZE - 1) / INSIDE_CHUNK_SIZE;
+  utils::ThreadPool::instance().parallel_for(num_chunks, [&](size_t chunk) {
+    uint64_t end = (chunk + 1) * INSIDE_CHUNK_SIZE;
+    if (end > points.count) end = points.count;
+    for (uint64_t i = chunk * INSIDE_CHUNK_SIZE; i < end; i++) {
+      result[i] = index.contain(points[i]);
+    }
+  });
+  index.clear();
+}
+
+Tag parse_layer_spec(const val &spec) {
+  if (!spec.isArray() || utils::js_length(spec) != 2) {
+    throw std::runtime_error("Layer specifications must be [layer, datatype].");
+  }
+  return gdstk::make_tag(spec[0].as<uint32_t>(), spec[1].as<uint32_t>());
+}
+
+// Option {hierarchical: boolean} of the layer operations
+bool parse_hierarchical_option(const val &options) {
+  if (options.isNull() || options.isUndefined()) return false;
+  const val hierarchical = options["hierarchical"];
+  return !hierarchical.isUndefined() && hierarchical.as<bool>();
+}
+
+// Run a hierarchical operation of gdstk::Cell on the union of cells: several
+// cells are referenced from a temporary (unnamed) cell
+template <class CellOperation>
+ErrorCode hierarchical_operation(const Array<Cell *> &cells,
+                                 CellOperation operation) {
+  if (cells.count == 1) return operation(*cells[0]);
+  static char root_name[] = "";
+  Cell root = {};
+  root.name = root_name;
+  Reference *references = (Reference *)gdstk::allocate_clear(
+      cells.count * sizeof(Reference));
+  root.reference_array.ensure_slots(cells.count);
+  for (uint64_t i = 0; i < cells.count; i++) {
+    references[i].init(cells[i]);
+    root.reference_array.append_unsafe(references + i);
+  }
+  ErrorCode error_code = operation(root);
+  root.reference_array.clear();
+  gdstk::free_allocation(references);
+  return error_code;
+}
+
+val layer_result(Array<Polygon *> &result_array, int layer, int datatype) {
+  Tag tag = gdstk::make_tag(layer, datatype);
+  for (uint64_t i = 0; i < result_array.count; i++) {
+    result_array[i]->tag = tag;
+  }
+  auto r =
+      utils::gdstk_array2js_array_by_ref(result_array, utils::PolygonDeleter());
+  result_array.clear();
+  return r;
+}
 }  // namespace
 
+val boolean_layers(const Array<Cell *> &cells, const val &spec1,
+                   const val &spec2, const val &operation, double precision,
+                   int layer, int datatype, const val &options) {
+  Operation oper = parse_operation(operation);
+  if (precision <= 0) {
+    throw std::runtime_error("Precision must be positive.");
+  }
+  const Tag tag1 = parse_layer_spec(spec1);
+  const Tag tag2 = parse_layer_spec(spec2);
+  Array<Polygon *> result_array = {0};
+  if (parse_hierarchical_option(options)) {
+    // NOTE: return ErrorCode ignored here
+    hierarchical_operation(cells, [&](const Cell &cell) {
+      return cell.boolean_tags(tag1, tag2, oper, 1 / precision, result_array);
+    });
+    return layer_result(result_array, layer, datatype);
+  }
+  double tile_size = 0;
+  bool merge = true;
+  parse_tile_options(options, tile_size, merge);
+
+  Array<Polygon *> polygon_array1 = {0};
+  Array<Polygon *> polygon_array2 = {0};
+  for (uint64_t i = 0; i < cells.count; i++) {
+    cells[i]->get_polygons(true, true, -1, true, tag1, polygon_array1);
+    cells[i]->get_polygons(true, true, -1, true, tag2, polygon_array2);
+  }
+
+  // NOTE: return ErrorCode ignored here
+  tiled_boolean(polygon_array1, polygon_array2, oper, 1 / precision, tile_size,
+                merge, result_array);
+
+  Array<Polygon *> *operands[] = {&polygon_array1, &polygon_array2};
+  for (auto operand : operands) {
+    for (uint64_t i = 0; i < operand->count; i++) {
+      (*operand)[i]->clear();
+      gdstk::free_allocation((*operand)[i]);
+    }
+    operand->clear();
+  }
+  return layer_result(result_array, layer, datatype);
+}
+
+val offset_layer(const Array<Cell *> &cells, const val &spec, double distance,
+                 const val &join, double tolerance, double precision,
+                 int layer, int datatype, const val &options) {
+  OffsetJoin offset_join = parse_offset_join(join);
+  if (tolerance <= 0) {
+    throw std::runtime_error("Tolerance must be positive.");
+  }
+  if (precision <= 0) {
+    throw std::runtime_error("Precision must be positive.");
+  }
+  const Tag tag = parse_layer_spec(spec);
+  Array<Polygon *> result_array = {0};
+  if (parse_hierarchical_option(options)) {
+    // NOTE: return ErrorCode ignored here
+    hierarchical_operation(cells, [&](const Cell &cell) {
+      return cell.offset_tag(tag, distance, offset_join, tolerance,
+                             1 / precision, result_array);
+    });
+    return layer_result(result_array, layer, datatype);
+  }
+
+  Array<Polygon *> polygon_array = {0};
+  for (uint64_t i = 0; i < cells.count; i++) {
+    cells[i]->get_polygons(true, true, -1, true, tag, polygon_array);
+  }
+  // NOTE: return ErrorCode ignored here
+  gdstk::offset(polygon_array, distance, offset_join, tolerance, 1 / precision,
+                true, result_array);
+  for (uint64_t i = 0; i < polygon_array.count; i++) {
+    polygon_array[i]->clear();
+    gdstk::free_allocation(polygon_array[i]);
+  }
+  polygon_array.clear();
+  return layer_result(result_array, layer, datatype);
+}
+
 // ----------------------------------------------------------------------------
 
 void gdstk_function_bind() {
@@ -528,62 +1015,61 @@ void gdstk_function_bind() {
                                 const val &operation) {
              return make_boolean(operand1, operand2, operation);
            }));
-  function(
-      "slice", optional_override([](const val &polygons, const val &position,
-                                    const val &axis, double precision) {
-        auto axis_str = axis.as<std::string>();
-        bool x_axis;
-        if (axis_str == "x")
-          x_axis = true;
-        else if (axis_str == "y")
-          x_axis = false;
-        else {
-          throw std::runtime_error("Argument axis must be 'x' or 'y'.");
-        }
-
-        double single_position;
-        std::shared_ptr<Array<double>> positions =
-            utils::make_gdstk_array<double>();
-        if (position.isArray()) {
-          positions = utils::js_array2gdstk_array<double>(position);
-        } else if (position.isNumber()) {
-          positions->append(position.as<double>());
-        } else {
-          throw std::runtime_error(
-              "Argument position must be number or array of number");
-        }
-
-        Array<Polygon *> polygon_array = {0};
-        parse_polygons(polygons, polygon_array);
-
-        val result = val::array();
-
-        for (uint64_t i = 0; i < polygon_array.count; i++) {
-          Tag tag = polygon_array[i]->tag;
-          Array<Polygon *> *slices = (Array<Polygon *> *)gdstk::allocate_clear(
-              (positions->count + 1) * sizeof(Array<Polygon *>));
-          // NOTE: slice should never result in an error
-          slice(*polygon_array[i], *positions, x_axis, 1 / precision, slices);
-          Array<Polygon *> *slice_array = slices;
-          for (uint64_t s = 0; s <= positions->count; s++, slice_array++) {
-            for (uint64_t j = 0; j < slice_array->count; j++) {
-              slice_array->items[j]->tag = tag;
-            }
-            result.call<void>("push",
-                              utils::gdstk_array2js_array_by_ref(
-                                  *slice_array, utils::PolygonDeleter()));
-            slice_array->clear();
-          }
-          gdstk::free_allocation(slices);
-        }
-
-        for (size_t i = 0; i < polygon_array.count; i++) {
-          polygon_array[i]->clear();
-        }
-        polygon_array.clear();
-
-        return result;
-      }));
+  function("boolean",
+           optional_override([](const val &operand1, const val &operand2,
+                                const val &operation, double precision,
+                                int layer, int datatype, const val &options) {
+             return make_boolean(operand1, operand2, operation, precision,
+                                 layer, datatype, options);
+           }));
+  function("boolean",
+           optional_override([](const val &operand1, const val &operand2,
+                                const val &operation, const val &options) {
+             return make_boolean(operand1, operand2, operation, 1e-3, 0, 0,
+                                 options);
+           }));
+  function("offset_async",
+           optional_override(
+               [](const val &polygons, double distance, const val &join,
+                  double tolerance, double precision, bool use_union,
+                  int layer, int datatype, const val &options) {
+                 return make_offset_async(polygons, distance, join, tolerance,
+                                          precision, use_union, layer,
+                                          datatype, options);
+               }));
+  function("offset_async",
+           optional_override([](const val &polygons, double distance) {
+             return make_offset_async(polygons, distance);
+           }));
+  function("offset_async", optional_override([](const val &polygons,
+                                                double distance,
+                                                const val &options) {
+             return make_offset_async(polygons, distance, val("miter"), 2,
+                                      1e-3, false, 0, 0, options);
+           }));
+  function("boolean_async",
+           optional_override([](const val &operand1, const val &operand2,
+                                const val &operation, double precision,
+                                int layer, int datatype, const val &options) {
+             return make_boolean_async(operand1, operand2, operation,
+                                       precision, layer, datatype, options);
+           }));
+  function("boolean_async",
+           optional_override([](const val &operand1, const val &operand2,
+                                const val &operation) {
+             return make_boolean_async(operand1, operand2, operation);
+           }));
+  function("boolean_async",
+           optional_override([](const val &operand1, const val &operand2,
+                                const val &operation, const val &options) {
+             return make_boolean_async(operand1, operand2, operation, 1e-3, 0,
+                                       0, options);
+           }));
+  function("slice",
+           optional_override([](const val &polygons, const val &position,
+                                const val &axis, double precision) {
+             return make_slice(polygons, position, axis, precision);
+           }));
   function("inside",
            optional_override([](const val &points, const val &polygons) {
              auto points_array = utils::js_array2gdstk_arrayvec2(points);
@@ -591,7 +1077,7 @@ void gdstk_function_bind() {
              parse_polygons(polygons, polygons_array);
              bool *values =
                  (bool *)gdstk::allocate(points_array->count * sizeof(bool));
-             gdstk::inside(*points_array, polygons_array, values);
+             parallel_inside(*points_array, polygons_array, values);
 
              val result = val::array();
              for (uint64_t i = 0; i < points_array->count; i++) {
@@ -656,8 +1142,11 @@ void gdstk_function_bind() {
                  (Library *)gdstk::allocate_clear(sizeof(Library)),
                  utils::LibraryDeleter());
              ErrorCode error_code = ErrorCode::NoError;
-             *library = read_gds(filename.c_str(), unit, tolerance,
-                                 shape_tags_ptr, &error_code);
+             {
+               utils::ArenaScope arena;
+               *library = read_gds(filename.c_str(), unit, tolerance,
+                                   shape_tags_ptr, &error_code);
+             }
 
              shape_tags.clear();
 
@@ -675,8 +1164,11 @@ void gdstk_function_bind() {
                  (Library *)gdstk::allocate_clear(sizeof(Library)),
                  utils::LibraryDeleter());
              ErrorCode error_code = ErrorCode::NoError;
-             *library = read_gds(filename.c_str(), unit, tolerance,
-                                 shape_tags_ptr, &error_code);
+             {
+               utils::ArenaScope arena;
+               *library = read_gds(filename.c_str(), unit, tolerance,
+                                   shape_tags_ptr, &error_code);
+             }
 
              regist_lib(library.get());
 
@@ -684,4 +1176,96 @@ void gdstk_function_bind() {
 
              return library;
            }));
+  function("read_oas", optional_override([](const val &infile, double unit,
+                                            double tolerance) {
+             if (tolerance <= 0) {
+               throw std::runtime_error("Tolerance must be positive.");
+             }
+             return read_oas(infile, unit, tolerance);
+           }));
+  function("read_oas", optional_override([](const val &infile) {
+             return read_oas(infile);
+           }));
+  function("read_gds_async",
+           optional_override([](const val &infile, double unit,
+                                double tolerance, const val &filter,
+                                const val &options) {
+             return read_gds_async(infile, unit, tolerance, filter, options);
+           }));
+  function("read_gds_async", optional_override([](const val &infile) {
+             return read_gds_async(infile);
+           }));
+  function("read_gds_async",
+           optional_override([](const val &infile, const val &options) {
+             return read_gds_async(infile, 0, 1e-2, val::null(), options);
+           }));
+  function("thread_count", optional_override([]() {
+             return (int)utils::ThreadPool::instance().size();
+           }));
+  function("set_thread_count", optional_override([](int count) {
+             if (count < 1) {
+               throw std::runtime_error("Thread count must be at least 1.");
+             }
+             utils::ThreadPool::instance().resize(count);
+           }));
+  function("memory_stats", &memory_stats);
+  function("trace_start", optional_override([](double capacity) {
+             if (capacity < 1) {
+               throw std::runtime_error("Trace capacity must be at least 1.");
+             }
+             utils::trace_start((uint64_t)capacity);
+           }));
+  function("trace_start",
+           optional_override([]() { utils::trace_start(1 << 16); }));
+  function("trace_stop", &utils::trace_stop);
+  function("trace_dump", &utils::trace_dump);
+
+  // Scratch storage kept warm across boolean, offset and slice calls, for
+  // batches of many small operations.  The storage grows to the largest
+  // operation seen and is released by clear or when the context is deleted.
+  class_<GeometryContext>("GeometryContext")
+      .smart_ptr<std::shared_ptr<GeometryContext>>(
+          "GeometryContext_shared_ptr")
+      .constructor(&make_geometry_context)
+      .function("boolean", optional_override([](GeometryContext &self,
+                                                const val &operand1,
+                                                const val &operand2,
+                                                const val &operation) {
+                  return make_boolean(operand1, operand2, operation, 1e-3, 0,
+                                      0, val::null(), &self);
+                }))
+      .function("boolean",
+                optional_override([](GeometryContext &self,
+                                     const val &operand1, const val &operand2,
+                                     const val &operation, double precision,
+                                     int layer, int datatype) {
+                  return make_boolean(operand1, operand2, operation, precision,
+                                      layer, datatype, val::null(), &self);
+                }))
+      .function("offset", optional_override([](GeometryContext &self,
+                                               const val &polygons,
+                                               double distance) {
+                  return make_offset(polygons, distance, val("miter"), 2,
+                                     1e-3, false, 0, 0, &self);
+                }))
+      .function("offset",
+                optional_override([](GeometryContext &self,
+                                     const val &polygons, double distance,
+                                     const val &join, double tolerance,
+                                     double precision, bool use_union,
+                                     int layer, int datatype) {
+                  return make_offset(polygons, distance, join, tolerance,
+                                     precision, use_union, layer, datatype,
+                                     &self);
+                }))
+      .function("slice",
+                optional_override([](GeometryContext &self,
+                                     const val &polygons, const val &position,
+                                     const val &axis, double precision) {
+                  return make_slice(polygons, position, axis, precision,
+                                    &self);
+                }))
+      .function("clear", optional_override([](GeometryContext &self) {
+                  self.clear();
+                }));
 }
@@ -255,6 +255,7 @@ void gdstk_label_bind() {
             return new_repetition;
           }),
           optional_override([](Label &self, const val &repetition) {
+            utils::geometry_modified(&self);
             if (repetition.isNull()) {
               self.repetition.clear();
             } else if (repetition["constructor"]["name"].as<std::string>() !=
@@ -272,6 +273,7 @@ void gdstk_label_bind() {
                   return label;
                 }))
       .function("apply_repetition", optional_override([](Label &self) {
+                  utils::geometry_modified(&self);
                   Array<Label *> array = {0};
                   self.apply_repetition(array);
                   auto result = utils::gdstk_array2js_array_by_ref(
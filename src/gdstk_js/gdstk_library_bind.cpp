@@ -1,13 +1,17 @@
+#include <cstdio>
 #include <ctime>
 #include <unordered_map>
 #include <unordered_set>
 
+#include "async_job.h"
 #include "binding_utils.h"
+#include "gdstk_base_bind.h"
 
-// js function for download gds file
+// js function for download gds file, no-op outside browsers (e.g. node)
 EM_JS(void, download_file, (const char* name), {
+  if (typeof document === "undefined") return;
   mime = "application/octet-stream";
-  let filename = name;
+  let filename = UTF8ToString(name);
   let content = FS.readFile(filename);
 
   var download_link = document.getElementById('download_gds');
@@ -44,11 +48,13 @@ static void library_replace_cell(Library* library, Cell* cell) {
           if (cell != reference->cell &&
               strcmp(cell->name, reference->cell->name) == 0) {
             reference->cell = cell;
+            utils::cell_modified(c);
           }
         } else if (reference->type == ReferenceType::RawCell) {
           if (strcmp(cell->name, reference->rawcell->name) == 0) {
             reference->type = ReferenceType::Cell;
             reference->cell = cell;
+            utils::cell_modified(c);
           }
         }
       }
@@ -89,11 +95,13 @@ static void library_replace_rawcell(Library* library, RawCell* rawcell) {
           if (strcmp(rawcell->name, reference->cell->name) == 0) {
             reference->rawcell = rawcell;
             reference->type = ReferenceType::RawCell;
+            utils::cell_modified(c);
           }
         } else if (reference->type == ReferenceType::RawCell) {
           if (rawcell != reference->rawcell &&
               strcmp(rawcell->name, reference->rawcell->name) == 0) {
             reference->rawcell = rawcell;
+            utils::cell_modified(c);
           }
         }
       }
@@ -132,6 +140,93 @@ static val build_tag_set(const gdstk::Set<Tag>& tags) {
   }
   return result;
 }
+
+static uint16_t oas_config_flags(bool detect_rectangles, bool detect_trapezoids,
+                                 bool standard_properties,
+                                 const val& validation,
+                                 bool fracture_trapezoids = false) {
+  uint16_t config_flags = 0;
+  if (detect_rectangles) config_flags |= OASIS_CONFIG_DETECT_RECTANGLES;
+  if (detect_trapezoids) config_flags |= OASIS_CONFIG_DETECT_TRAPEZOIDS;
+  if (fracture_trapezoids) config_flags |= OASIS_CONFIG_FRACTURE_TRAPEZOIDS;
+  if (standard_properties) config_flags |= OASIS_CONFIG_STANDARD_PROPERTIES;
+
+  if (!validation.isNull()) {
+    auto str = validation.as<std::string>();
+    if (str == "crc32") {
+      config_flags |= OASIS_CONFIG_INCLUDE_CRC32;
+    } else if (str == "checksum32") {
+      config_flags |= OASIS_CONFIG_INCLUDE_CHECKSUM32;
+    } else {
+      throw std::runtime_error(
+          "Argument validation must be \"crc32\", \"checksum32\", or None.");
+    }
+  }
+  return config_flags;
+}
+
+// The library is written from a worker: it must be kept alive and unchanged
+// until the returned Promise settles.  A cancelled write removes the partial
+// file.
+static val library_write_gds_async(Library& self, const std::string& filename,
+                                   int max_points, tm timestamp,
+                                   const val& options) {
+  Library* library = &self;
+  return utils::AsyncJob::run(
+      [=]() mutable {
+        ErrorCode error_code =
+            library->write_gds(filename.c_str(), max_points, &timestamp);
+        if (error_code == ErrorCode::Cancelled) std::remove(filename.c_str());
+        return error_code;
+      },
+      []() { return val::undefined(); }, options);
+}
+
+static val library_write_oas_async(Library& self, const std::string& filename,
+                                   int compression_level,
+                                   uint16_t config_flags,
+                                   double circletolerance,
+                                   const val& options) {
+  Library* library = &self;
+  return utils::AsyncJob::run(
+      [=]() {
+        ErrorCode error_code = library->write_oas(
+            filename.c_str(), circletolerance, compression_level, config_flags);
+        if (error_code == ErrorCode::Cancelled) std::remove(filename.c_str());
+        return error_code;
+      },
+      []() { return val::undefined(); }, options);
+}
+
+// boolean_layers over the shapes of all top level cells
+static val library_boolean_layers(Library& self, const val& spec1,
+                                  const val& spec2, const val& operation,
+                                  double precision, int layer, int datatype,
+                                  const val& options) {
+  Array<Cell*> top_cells = {0};
+  Array<RawCell*> top_rawcells = {0};
+  self.top_level(top_cells, top_rawcells);
+  val result = boolean_layers(top_cells, spec1, spec2, operation, precision,
+                              layer, datatype, options);
+  top_cells.clear();
+  top_rawcells.clear();
+  return result;
+}
+
+// offset_layer over the shapes of all top level cells
+static val library_offset_layer(Library& self, const val& spec,
+                                double distance, const val& join,
+                                double tolerance, double precision, int layer,
+                                int datatype, const val& options) {
+  Array<Cell*> top_cells = {0};
+  Array<RawCell*> top_rawcells = {0};
+  self.top_level(top_cells, top_rawcells);
+  val result = offset_layer(top_cells, spec, distance, join, tolerance,
+                            precision, layer, datatype, options);
+  top_cells.clear();
+  top_rawcells.clear();
+  return result;
+}
 }  // namespace
 
 void gdstk_library_bind() {
@@ -215,7 +310,7 @@ void gdstk_library_bind() {
               utils::LIB_KEEP_ALIVE_RAWCELL[&self].insert(
                   cells.as<std::shared_ptr<RawCell>>());
             } else if (cells.isArray()) {
-              auto len = cells["length"].as<int>();
+              auto len = utils::js_length(cells);
               for (size_t i = 0; i < len; i++) {
                 auto cons = cells[i]["constructor"]["name"].as<std::string>();
                 if (cons == "Cell") {
@@ -254,7 +349,7 @@ void gdstk_library_bind() {
                   cells.as<std::shared_ptr<RawCell>>());
             }
             assert(cells.isArray());
-            auto len = cells["length"].as<int>();
+            auto len = utils::js_length(cells);
             for (size_t i = 0; i < len; i++) {
               auto cons = cells[i]["constructor"]["name"].as<std::string>();
               if (cons == "Cell") {
@@ -303,7 +398,7 @@ void gdstk_library_bind() {
               utils::LIB_KEEP_ALIVE_RAWCELL[&self].insert(
                   cells.as<std::shared_ptr<RawCell>>());
             } else if (cells.isArray()) {
-              auto length = cells["length"].as<int>();
+              auto length = utils::js_length(cells);
               for (size_t i = 0; i < length; i++) {
                 auto cons = cells[i]["constructor"]["name"].as<std::string>();
                 if (cons == "Cell") {
@@ -338,6 +433,52 @@ void gdstk_library_bind() {
                   utils::LIB_KEEP_ALIVE_CELL[&self].insert(cell);
                   return cell;
                 }))
+      .function("boolean_layers",
+                optional_override([](Library& self, const val& spec1,
+                                     const val& spec2, const val& operation,
+                                     double precision, int layer, int datatype,
+                                     const val& options) {
+                  return library_boolean_layers(self, spec1, spec2, operation,
+                                                precision, layer, datatype,
+                                                options);
+                }))
+      .function("boolean_layers",
+                optional_override([](Library& self, const val& spec1,
+                                     const val& spec2, const val& operation,
+                                     const val& options) {
+                  return library_boolean_layers(self, spec1, spec2, operation,
+                                                1e-3, 0, 0, options);
+                }))
+      .function("boolean_layers",
+                optional_override([](Library& self, const val& spec1,
+                                     const val& spec2, const val& operation) {
+                  return library_boolean_layers(self, spec1, spec2, operation,
+                                                1e-3, 0, 0, val::null());
+                }))
+      .function("offset_layer",
+                optional_override([](Library& self, const val& spec,
+                                     double distance, const val& join,
+                                     double tolerance, double precision,
+                                     int layer, int datatype,
+                                     const val& options) {
+                  return library_offset_layer(self, spec, distance, join,
+                                              tolerance, precision, layer,
+                                              datatype, options);
+                }))
+      .function("offset_layer",
+                optional_override([](Library& self, const val& spec,
+                                     double distance, const val& options) {
+                  return library_offset_layer(self, spec, distance,
+                                              val("miter"), 2, 1e-3, 0, 0,
+                                              options);
+                }))
+      .function("offset_layer",
+                optional_override(
+                    [](Library& self, const val& spec, double distance) {
+                      return library_offset_layer(self, spec, distance,
+                                                  val("miter"), 2, 1e-3, 0, 0,
+                                                  val::null());
+                    }))
       .function(
           "top_level", optional_override([](Library& self) {
             auto top_cells = utils::make_gdstk_array<Cell*>();
@@ -421,26 +562,25 @@ void gdstk_library_bind() {
                        bool detect_rectangles, bool detect_trapezoids,
                        double circletolerance, bool standard_properties,
                        const val& validation) {
-                      uint8_t config_flags = 0;
-                      if (detect_rectangles == 1)
-                        config_flags |= OASIS_CONFIG_DETECT_RECTANGLES;
-                      if (detect_trapezoids == 1)
-                        config_flags |= OASIS_CONFIG_DETECT_TRAPEZOIDS;
-                      if (standard_properties == 1)
-                        config_flags |= OASIS_CONFIG_STANDARD_PROPERTIES;
-
-                      if (!validation.isNull()) {
-                        auto str = validation.as<std::string>();
-                        if (str == "crc32") {
-                          config_flags |= OASIS_CONFIG_INCLUDE_CRC32;
-                        } else if (str == "checksum32") {
-                          config_flags |= OASIS_CONFIG_INCLUDE_CHECKSUM32;
-                        } else {
-                          throw std::runtime_error(
-                              "Argument validation must be \"crc32\", "
-                              "\"checksum32\", or None.");
-                        }
-                      }
+                      uint16_t config_flags = oas_config_flags(
+                          detect_rectangles, detect_trapezoids,
+                          standard_properties, validation);
+
+                      auto filename = outfile.as<std::string>();
+                      self.write_oas(filename.c_str(), circletolerance,
+                                     compression_level, config_flags);
+
+                      download_file(filename.c_str());
+                    }))
+      .function("write_oas",
+                optional_override(
+                    [](Library& self, const val& outfile, int compression_level,
+                       bool detect_rectangles, bool detect_trapezoids,
+                       double circletolerance, bool standard_properties,
+                       const val& validation, bool fracture_trapezoids) {
+                      uint16_t config_flags = oas_config_flags(
+                          detect_rectangles, detect_trapezoids,
+                          standard_properties, validation, fracture_trapezoids);
 
                       auto filename = outfile.as<std::string>();
                       self.write_oas(filename.c_str(), circletolerance,
@@ -468,6 +608,73 @@ void gdstk_library_bind() {
                                  compression_level, config_flags);
 
                   download_file(filename.c_str());
+                }))
+      .function("write_gds_async",
+                optional_override([](Library& self, const val& outfile,
+                                     int max_points, tm timestamp,
+                                     const val& options) {
+                  return library_write_gds_async(self,
+                                                 outfile.as<std::string>(),
+                                                 max_points, timestamp, options);
+                }))
+      .function("write_gds_async",
+                optional_override([](Library& self, const val& outfile,
+                                     const val& options) {
+                  tm now = {};
+                  gdstk::get_now(now);
+                  return library_write_gds_async(
+                      self, outfile.as<std::string>(), 199, now, options);
+                }))
+      .function("write_gds_async",
+                optional_override([](Library& self, const val& outfile) {
+                  tm now = {};
+                  gdstk::get_now(now);
+                  return library_write_gds_async(
+                      self, outfile.as<std::string>(), 199, now, val::null());
+                }))
+      .function("write_oas_async",
+                optional_override(
+                    [](Library& self, const val& outfile, int compression_level,
+                       bool detect_rectangles, bool detect_trapezoids,
+                       double circletolerance, bool standard_properties,
+                       const val& validation, const val& options) {
+                      uint16_t config_flags = oas_config_flags(
+                          detect_rectangles, detect_trapezoids,
+                          standard_properties, validation);
+                      return library_write_oas_async(
+                          self, outfile.as<std::string>(), compression_level,
+                          config_flags, circletolerance, options);
+                    }))
+      .function("write_oas_async",
+                optional_override(
+                    [](Library& self, const val& outfile, int compression_level,
+                       bool detect_rectangles, bool detect_trapezoids,
+                       double circletolerance, bool standard_properties,
+                       const val& validation, bool fracture_trapezoids,
+                       const val& options) {
+                      uint16_t config_flags = oas_config_flags(
+                          detect_rectangles, detect_trapezoids,
+                          standard_properties, validation, fracture_trapezoids);
+                      return library_write_oas_async(
+                          self, outfile.as<std::string>(), compression_level,
+                          config_flags, circletolerance, options);
+                    }))
+      .function("write_oas_async",
+                optional_override([](Library& self, const val& outfile,
+                                     const val& options) {
+                  uint16_t config_flags =
+                      oas_config_flags(true, true, false, val::null());
+                  return library_write_oas_async(
+                      self, outfile.as<std::string>(), 6, config_flags, 0,
+                      options);
+                }))
+      .function("write_oas_async",
+                optional_override([](Library& self, const val& outfile) {
+                  uint16_t config_flags =
+                      oas_config_flags(true, true, false, val::null());
+                  return library_write_oas_async(
+                      self, outfile.as<std::string>(), 6, config_flags, 0,
+                      val::null());
                 }));
 
   // TODO:  write_oas, set_property, get_property, delete_property
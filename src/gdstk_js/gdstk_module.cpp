@@ -18,6 +18,8 @@ void gdstk_cell_bind();
 void gdstk_reference_bind();
 void gdstk_library_bind();
 void gdstk_function_bind();
+void gdstk_expression_bind();
+void gdstk_async_bind();
 
 #define GDSTK_JS_VERSION_MAJOR 0
 #define GDSTK_JS_VERSION_MINOR 9
@@ -36,5 +38,7 @@ EMSCRIPTEN_BINDINGS(Gdstk)
   gdstk_reference_bind();
   gdstk_library_bind();
   gdstk_function_bind();
+  gdstk_expression_bind();
+  gdstk_async_bind();
 }
 // #endif
\ No newline at end of file
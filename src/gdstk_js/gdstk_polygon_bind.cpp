@@ -44,6 +44,39 @@ namespace
     self.fillet(*radii_array, tolerance);
     return;
   }
+
+  gdstk::FractureMode parse_fracture_mode(const val &mode)
+  {
+    if (mode.isString())
+    {
+      auto mode_str = mode.as<std::string>();
+      if (mode_str == "max_points")
+        return gdstk::FractureMode::MaxPoints;
+      if (mode_str == "trapezoids")
+        return gdstk::FractureMode::Trapezoids;
+    }
+    throw std::runtime_error(
+        "Argument mode must be one of 'max_points' or 'trapezoids'.");
+  }
+
+  // max_points is ignored by the 'trapezoids' mode
+  val polygon_fracture(const Polygon &self, const val &max_points,
+                       double precision = 1e-3,
+                       const val &mode = val("max_points"))
+  {
+    if (precision <= 0)
+    {
+      throw std::runtime_error("Precision must be positive.");
+    }
+    auto fracture_mode = parse_fracture_mode(mode);
+    Array<Polygon *> result{0};
+    self.fracture(utils::js_count(max_points), precision, fracture_mode,
+                  result);
+    auto r = utils::gdstk_array2js_array_by_ref(result,
+                                                utils::PolygonDeleter());
+    result.clear();
+    return r;
+  }
 } // namespace
 
 // ----------------------------------------------------------------------------
@@ -80,6 +113,7 @@ void gdstk_polygon_bind()
 
                 optional_override([](Polygon &self, const val &new_points)
                                   {
+                  utils::geometry_modified(&self);
                   auto points_array =
                       utils::js_array2gdstk_arrayvec2(new_points);
                   self.point_array.clear();
@@ -93,7 +127,7 @@ void gdstk_polygon_bind()
                 optional_override([](Polygon &self, uint32_t datatype)
                                   { return gdstk::set_type(self.tag, datatype); }))
       .property("size", optional_override([](const Polygon &self)
-                                          { return int(self.point_array.count); }))
+                                          { return utils::js_size(self.point_array.count); }))
       .property(
           "repetition", optional_override([](const Polygon &self)
                                           {
@@ -104,6 +138,7 @@ void gdstk_polygon_bind()
             return new_repetition; }),
           optional_override([](Polygon &self, const val &repetition)
                             {
+            utils::geometry_modified(&self);
             if (repetition.isNull()) {
               self.repetition.clear();
             } else if (repetition["constructor"]["name"].as<std::string>() !=
@@ -137,19 +172,23 @@ void gdstk_polygon_bind()
       .function(
           "contain", optional_override([](Polygon &self, const val &points)
                                        {
-            assert(points["length"].as<int>() > 0);
-            if ((points.isArray() && points["length"].as<int>() == 2 &&
+            assert(utils::js_length(points) > 0);
+            if ((points.isArray() && utils::js_length(points) == 2 &&
                  points[0].isNumber() && points[1].isNumber()) ||
                 points["constructor"]["name"].as<std::string>() == "Point") {
               return val(self.contain(to_vec2(points)));
             } else if (points[0].isArray() ||
                        points["constructor"]["name"].as<std::string>() ==
                            "PointsArray") {
-              auto length = points["length"].as<int>();
+              auto points_array = utils::js_array2gdstk_arrayvec2(points);
+              bool *values =
+                  (bool *)gdstk::allocate(points_array->count * sizeof(bool));
+              self.contain(*points_array, values);
               auto result = val::array();
-              for (size_t i = 0; i < length; i++) {
-                result.call<void>("push", self.contain(to_vec2(points[i])));
+              for (uint64_t i = 0; i < points_array->count; i++) {
+                result.call<void>("push", values[i]);
               }
+              gdstk::free_allocation(values);
               return result;
             } else {
               throw std::runtime_error(
@@ -169,32 +208,36 @@ void gdstk_polygon_bind()
                   return result; }))
       .function("translate",
                 optional_override([](Polygon &self, double dx, double dy)
-                                  { return self.translate({dx, dy}); }))
+                                  { utils::geometry_modified(&self); return self.translate({dx, dy}); }))
       .function("translate",
                 optional_override([](Polygon &self, const val &dx)
-                                  { return self.translate(to_vec2(dx)); }))
+                                  { utils::geometry_modified(&self); return self.translate(to_vec2(dx)); }))
       .function("scale", optional_override([](Polygon &self, double sx,
                                               double sy, const val &center)
-                                           { return self.scale(Vec2{sx, sy}, to_vec2(center)); }))
+                                           { utils::geometry_modified(&self); return self.scale(Vec2{sx, sy}, to_vec2(center)); }))
       .function("scale",
                 optional_override([](Polygon &self, double sx, double sy)
                                   {
+                  utils::geometry_modified(&self);
                   Vec2 center{0, 0};
                   return self.scale(Vec2{sx, sy}, center); }))
       .function("mirror", optional_override(
                               [](Polygon &self, const val &p0, const val &p1)
                               {
+                                utils::geometry_modified(&self);
                                 return self.mirror(to_vec2(p0), to_vec2(p1));
                               }))
       .function("mirror", optional_override([](Polygon &self, const val &p0)
                                             {
+                  utils::geometry_modified(&self);
                   const Vec2 p1{0, 0};
                   return self.mirror(to_vec2(p0), p1); }))
       .function("rotate", optional_override([](Polygon &self, double angle,
                                                const val &center)
-                                            { return self.rotate(angle, to_vec2(center)); }))
+                                            { utils::geometry_modified(&self); return self.rotate(angle, to_vec2(center)); }))
       .function("rotate", optional_override([](Polygon &self, double angle)
                                             {
+                  utils::geometry_modified(&self);
                   Vec2 center{0, 0};
                   return self.rotate(angle, center); }))
       .function(
@@ -203,6 +246,7 @@ void gdstk_polygon_bind()
                                bool x_reflection, double rotation,
                                const val &translation, const val &matrix)
                             {
+            utils::geometry_modified(&self);
             Vec2 origin = {0, 0};
             if (!translation.isNull()) {
               origin = to_vec2(translation);
@@ -210,11 +254,11 @@ void gdstk_polygon_bind()
             self.transform(magnification, x_reflection, rotation, origin);
 
             if (!matrix.isNull()) {
-              auto rows = matrix["length"].as<int>();
+              int64_t rows = utils::js_length(matrix);
               double m[] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
               const bool homogeneous = rows == 3;
               for (rows--; rows >= 0; rows--) {
-                auto cols = matrix[rows]["length"].as<int>();
+                int64_t cols = utils::js_length(matrix[rows]);
                 for (cols--; cols >= 0; cols--) {
                   m[rows * 3 + cols] = matrix[rows][cols].as<double>();
                 }
@@ -241,6 +285,7 @@ void gdstk_polygon_bind()
             } }))
       .function("transform", optional_override([](Polygon &self)
                                                {
+                  utils::geometry_modified(&self);
                   double magnification = 1;
                   bool x_reflection = false;
                   double rotation = 0;
@@ -249,37 +294,23 @@ void gdstk_polygon_bind()
                                         origin); }))
       .function("fillet", optional_override([](Polygon &self, const val &radii,
                                                double tolerance)
-                                            { return polygon_fillet(self, radii, tolerance); }))
+                                            { utils::geometry_modified(&self); return polygon_fillet(self, radii, tolerance); }))
       .function("fillet",
                 optional_override([](Polygon &self, const val &radii)
-                                  { return polygon_fillet(self, radii); }))
+                                  { utils::geometry_modified(&self); return polygon_fillet(self, radii); }))
       .function("fracture",
-                optional_override(
-                    [](Polygon &self, uint64_t max_points, double precision)
-                    {
-                      if (precision <= 0)
-                      {
-                        throw std::runtime_error("Precision must be positive.");
-                      }
-                      Array<Polygon *> result{0};
-                      self.fracture(max_points, precision, result);
-                      auto r = utils::gdstk_array2js_array_by_ref(
-                          result, utils::PolygonDeleter());
-                      result.clear();
-                      return r;
-                    }))
+                optional_override([](Polygon &self, const val &max_points,
+                                     double precision, const val &mode)
+                                  { return polygon_fracture(self, max_points, precision, mode); }))
+      .function("fracture",
+                optional_override([](Polygon &self, const val &max_points,
+                                     double precision)
+                                  { return polygon_fracture(self, max_points, precision); }))
       .function("fracture", optional_override([](Polygon &self)
-                                              {
-                  uint64_t max_points = 199;
-                  double precision = 1e-3;
-                  Array<Polygon *> result{0};
-                  self.fracture(max_points, precision, result);
-                  auto r = utils::gdstk_array2js_array_by_ref(
-                      result, utils::PolygonDeleter());
-                  result.clear();
-                  return r; }))
+                                              { return polygon_fracture(self, val(199)); }))
       .function("apply_repetition", optional_override([](Polygon &self)
                                                       {
+                  utils::geometry_modified(&self);
                   Array<Polygon *> result{0};
                   self.apply_repetition(result);
                   auto r = utils::gdstk_array2js_array_by_ref(
@@ -102,6 +102,7 @@ void gdstk_reference_bind()
                   } }),
                 optional_override([](Reference &self, const val &cell)
                                   {
+                  utils::geometry_modified(&self);
                   ReferenceType new_type;
                   char* new_name = NULL;
 
@@ -128,11 +129,26 @@ void gdstk_reference_bind()
                 optional_override([](const Reference &self)
                                   { return vec2_to_js_array(self.origin); }),
                 optional_override([](Reference &self, const val &origin)
-                                  { self.origin = to_vec2(origin); 
+                                  { utils::geometry_modified(&self); self.origin = to_vec2(origin); 
                                   return vec2_to_js_array(self.origin); }))
-      .property("rotation", &Reference::rotation)
-      .property("magnification", &Reference::magnification)
-      .property("x_reflection", &Reference::x_reflection)
+      .property("rotation", optional_override([](const Reference &self)
+                                              { return self.rotation; }),
+                optional_override([](Reference &self, double rotation)
+                                  {
+                  utils::geometry_modified(&self);
+                  self.rotation = rotation; }))
+      .property("magnification", optional_override([](const Reference &self)
+                                                   { return self.magnification; }),
+                optional_override([](Reference &self, double magnification)
+                                  {
+                  utils::geometry_modified(&self);
+                  self.magnification = magnification; }))
+      .property("x_reflection", optional_override([](const Reference &self)
+                                                  { return self.x_reflection; }),
+                optional_override([](Reference &self, bool x_reflection)
+                                  {
+                  utils::geometry_modified(&self);
+                  self.x_reflection = x_reflection; }))
       .property(
           "repetition", optional_override([](const Reference &self)
                                           {
@@ -143,6 +159,7 @@ void gdstk_reference_bind()
             return new_repetition; }),
           optional_override([](Reference &self, const val &repetition)
                             {
+            utils::geometry_modified(&self);
             if (repetition.isNull()) {
               self.repetition.clear();
             } else if (repetition["constructor"]["name"].as<std::string>() !=
@@ -186,6 +203,7 @@ void gdstk_reference_bind()
                   return result; }))
       .function("apply_repetition", optional_override([](Reference &self)
                                                       {
+                  utils::geometry_modified(&self);
                   Array<Reference*> array = {0};
                   self.apply_repetition(array);
                   auto result = utils::gdstk_array2js_array_by_ref(
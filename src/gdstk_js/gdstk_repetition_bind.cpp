@@ -46,7 +46,7 @@ void gdstk_repetition_bind() {
         return repetition;
       }))
       .property("size", optional_override([](const Repetition& self) {
-                  return self.get_count();
+                  return utils::js_size(self.get_count());
                 }))
       .property("columns", optional_override([](const Repetition& self) {
                   if (self.type == RepetitionType::Rectangular ||
@@ -0,0 +1,91 @@
+#pragma once
+
+// Node-API stand in for <emscripten.h>, used by the native addon build (see
+// CMakeLists.txt in this directory).  Only what the bindings use is
+// provided.
+
+#include <node_api.h>
+
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Reference counted handle of a js value, see emscripten/wire.h
+typedef struct _EM_VAL *EM_VAL;
+
+#define EMSCRIPTEN_KEEPALIVE
+
+namespace emscripten {
+namespace internal {
+
+// Environment of the js thread (the only thread allowed to touch js values)
+napi_env env();
+
+// A js exception is pending: unwind to the binding entry point, which
+// returns to js with the exception still set
+struct JsException {};
+
+// Throw JsException (or an Error for other failures) unless status is ok
+void check(napi_status status);
+
+napi_value handle_value(EM_VAL handle);
+EM_VAL make_handle(napi_value value);
+
+// EM_JS: the js body is kept as source and compiled on first call.  As in
+// emscripten, EM_VAL arguments and results carry js values and const char*
+// arguments arrive as strings (UTF8ToString is the identity).
+class EmJsFunction {
+ public:
+  EmJsFunction(const char *params, const char *body)
+      : params_(params), body_(body) {}
+  napi_value call(std::vector<napi_value> &args);
+
+ private:
+  const char *params_;
+  const char *body_;
+  napi_ref function_ = nullptr;
+};
+
+inline napi_value em_js_arg(EM_VAL handle) { return handle_value(handle); }
+napi_value em_js_arg(const char *str);
+napi_value em_js_arg(double number);
+
+template <typename R>
+class EmJs : public EmJsFunction {
+ public:
+  using EmJsFunction::EmJsFunction;
+
+  template <typename... A>
+  R operator()(A... args) {
+    std::vector<napi_value> values{em_js_arg(args)...};
+    napi_value result = call(values);
+    if constexpr (std::is_same<R, EM_VAL>::value) {
+      return make_handle(result);
+    } else if constexpr (!std::is_void<R>::value) {
+      double number;
+      check(napi_get_value_double(env(), result, &number));
+      return (R)number;
+    }
+  }
+};
+
+}  // namespace internal
+}  // namespace emscripten
+
+#define EM_JS(ret, name, params, ...)                                \
+  static ::emscripten::internal::EmJs<ret> name(#params, #__VA_ARGS__)
+
+// Binding blocks run when the addon is loaded
+#define EMSCRIPTEN_BINDINGS(name)                                          \
+  static void name##_bindings();                                          \
+  static ::emscripten::internal::BindingsInitializer name##_initializer( \
+      name##_bindings);                                                   \
+  static void name##_bindings()
+
+namespace emscripten {
+namespace internal {
+struct BindingsInitializer {
+  explicit BindingsInitializer(void (*function)());
+};
+}  // namespace internal
+}  // namespace emscripten
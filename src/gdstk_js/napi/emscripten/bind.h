@@ -0,0 +1,179 @@
+#pragma once
+
+// Node-API implementation of the embind registration API (the subset used by
+// the bindings): class_ with constructors, methods and properties, free
+// functions and value_object.  Overloads are selected by argument count, as in
+// embind.  Bound objects keep embind's delete(), isDeleted() and clone().
+
+#include <string>
+#include <typeindex>
+#include <utility>
+
+#include "val.h"
+
+namespace emscripten {
+
+template <typename F>
+F optional_override(F f) {
+  return f;
+}
+
+namespace internal {
+
+// Overloads of one js function, selected by argument count.  For methods
+// argv[0] is the object.
+struct OverloadSet {
+  std::string name;
+  bool method;
+  std::vector<std::pair<size_t, Overload>> overloads;
+};
+
+// Constructor overloads return the holder and object pointer of the new
+// instance
+typedef std::function<std::pair<std::shared_ptr<void>, void *>(napi_value *)>
+    ConstructorOverload;
+
+struct ClassInfo {
+  std::string name;
+  const std::type_info *type;
+  napi_ref constructor;
+  napi_ref prototype;
+  std::vector<std::pair<size_t, ConstructorOverload>> constructors;
+  std::vector<OverloadSet *> functions;
+};
+
+ClassInfo *register_class(const std::type_info &type, const char *name);
+void add_method(ClassInfo *info, const char *name, size_t arity,
+                Overload overload);
+void add_property(ClassInfo *info, const char *name, Overload getter,
+                  Overload setter);
+void add_function(const char *name, size_t arity, Overload overload);
+void register_value_object(const std::type_info &type, const char *name);
+void add_field(const std::type_info &type, Field field);
+
+template <typename T, typename F, typename R, typename Args>
+struct ConstructorInvoker;
+
+template <typename T, typename F, typename R, typename... A>
+struct ConstructorInvoker<T, F, R, std::tuple<A...>> {
+  static constexpr size_t arity = sizeof...(A);
+
+  template <size_t... I>
+  static std::pair<std::shared_ptr<void>, void *> call(
+      F &f, napi_value *argv, std::index_sequence<I...>) {
+    std::tuple<Arg<A>...> args{Arg<A>(argv[I])...};
+    (void)args;
+    std::shared_ptr<T> holder = f(std::get<I>(args).get()...);
+    void *ptr = holder.get();
+    return {std::move(holder), ptr};
+  }
+
+  static ConstructorOverload make(F f) {
+    return [f](napi_value *argv) mutable {
+      return call(f, argv, std::index_sequence_for<A...>{});
+    };
+  }
+};
+
+template <typename C, typename M>
+Overload make_getter(M C::*member) {
+  return [member](napi_value *argv) {
+    const C &self = Arg<const C &>(argv[0]).get();
+    return BindingType<M>::to_js(self.*member);
+  };
+}
+
+template <typename C, typename M>
+Overload make_setter(M C::*member) {
+  return [member](napi_value *argv) {
+    C &self = Arg<C &>(argv[0]).get();
+    self.*member = BindingType<M>::from_js(argv[1]);
+    return undefined_value();
+  };
+}
+
+}  // namespace internal
+
+template <typename T>
+class class_ {
+ public:
+  explicit class_(const char *name)
+      : info_(internal::register_class(typeid(T), name)) {}
+
+  // Objects are always held by shared_ptr
+  template <typename P>
+  const class_ &smart_ptr(const char *) const {
+    return *this;
+  }
+
+  template <typename F, typename... Policies>
+  const class_ &constructor(F f, Policies...) const {
+    typedef internal::Signature<F> S;
+    typedef internal::ConstructorInvoker<T, F, typename S::Result,
+                                         typename S::Args>
+        I;
+    info_->constructors.emplace_back(I::arity, I::make(f));
+    return *this;
+  }
+
+  template <typename F, typename... Policies>
+  const class_ &function(const char *name, F f, Policies...) const {
+    auto overload = internal::make_overload(f);
+    internal::add_method(info_, name, overload.first, overload.second);
+    return *this;
+  }
+
+  template <typename C, typename M>
+  const class_ &property(const char *name, M C::*member) const {
+    internal::add_property(info_, name, internal::make_getter(member),
+                           internal::make_setter(member));
+    return *this;
+  }
+
+  template <typename G>
+  const class_ &property(const char *name, G getter) const {
+    internal::add_property(info_, name, internal::make_overload(getter).second,
+                           nullptr);
+    return *this;
+  }
+
+  template <typename G, typename S>
+  const class_ &property(const char *name, G getter, S setter) const {
+    internal::add_property(info_, name, internal::make_overload(getter).second,
+                           internal::make_overload(setter).second);
+    return *this;
+  }
+
+ private:
+  internal::ClassInfo *info_;
+};
+
+template <typename F, typename... Policies>
+void function(const char *name, F f, Policies...) {
+  auto overload = internal::make_overload(f);
+  internal::add_function(name, overload.first, overload.second);
+}
+
+template <typename T>
+class value_object {
+ public:
+  explicit value_object(const char *name) {
+    internal::register_value_object(typeid(T), name);
+  }
+
+  template <typename M>
+  value_object &field(const char *name, M T::*member) {
+    internal::Field field;
+    field.name = name;
+    field.get = [member](const void *object) {
+      return internal::BindingType<M>::to_js(((const T *)object)->*member);
+    };
+    field.set = [member](void *object, napi_value value) {
+      ((T *)object)->*member = internal::BindingType<M>::from_js(value);
+    };
+    internal::add_field(typeid(T), std::move(field));
+    return *this;
+  }
+};
+
+}  // namespace emscripten
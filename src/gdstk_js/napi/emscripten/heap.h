@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stddef.h>
+
+// The native addon has no wasm heap
+inline size_t emscripten_get_heap_size() { return 0; }
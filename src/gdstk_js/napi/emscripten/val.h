@@ -0,0 +1,164 @@
+#pragma once
+
+// Node-API implementation of emscripten::val (the subset used by the
+// bindings).  val holds a reference counted EM_VAL handle, so copies are
+// cheap and values may be kept in native containers between calls, like in
+// embind.  vals must only be used on the js thread.
+
+#include <utility>
+
+#include "wire.h"
+
+namespace emscripten {
+
+class val {
+ public:
+  static val array();
+  static val object();
+  static val null();
+  static val undefined();
+  static val global(const char *name = nullptr);
+  // Property of the module exports, e.g. a bound class
+  static val module_property(const char *name);
+  static val u8string(const char *str) { return val(str); }
+  static val take_ownership(EM_VAL handle) { return val(handle, Adopt{}); }
+
+  val() : val(undefined()) {}
+
+  template <typename T,
+            typename = typename std::enable_if<!std::is_same<
+                typename std::decay<T>::type, val>::value>::type>
+  explicit val(T &&value)
+      : handle_(internal::make_handle(
+            internal::BindingType<typename std::decay<T>::type>::to_js(
+                value))) {}
+
+  val(const val &other) : handle_(other.handle_) {
+    internal::handle_incref(handle_);
+  }
+  val(val &&other) noexcept : handle_(other.handle_) { other.handle_ = nullptr; }
+  ~val() {
+    if (handle_) internal::handle_decref(handle_);
+  }
+
+  val &operator=(const val &other) {
+    internal::handle_incref(other.handle_);
+    if (handle_) internal::handle_decref(handle_);
+    handle_ = other.handle_;
+    return *this;
+  }
+  val &operator=(val &&other) noexcept {
+    std::swap(handle_, other.handle_);
+    return *this;
+  }
+
+  EM_VAL as_handle() const { return handle_; }
+  napi_value value() const { return internal::handle_value(handle_); }
+
+  template <typename K>
+  val operator[](const K &key) const {
+    return take_ownership(internal::make_handle(get(to_js(key))));
+  }
+
+  template <typename K, typename V>
+  void set(const K &key, const V &value) const {
+    internal::check(
+        napi_set_property(internal::env(), this->value(), to_js(key), to_js(value)));
+  }
+
+  template <typename T, typename... Policies>
+  T as(Policies...) const {
+    return internal::BindingType<T>::from_js(value());
+  }
+
+  template <typename R = val, typename... A>
+  R call(const char *name, A &&...args) const {
+    napi_value self = value();
+    napi_value function;
+    internal::check(napi_get_named_property(internal::env(), self, name, &function));
+    return result<R>(invoke(self, function, {to_js(args)...}));
+  }
+
+  template <typename... A>
+  val operator()(A &&...args) const {
+    napi_value undefined = internal::undefined_value();
+    return result<val>(invoke(undefined, value(), {to_js(args)...}));
+  }
+
+  template <typename... A>
+  val new_(A &&...args) const {
+    return result<val>(construct(value(), {to_js(args)...}));
+  }
+
+  bool isNull() const { return type() == napi_null; }
+  bool isUndefined() const { return type() == napi_undefined; }
+  bool isTrue() const { return type() == napi_boolean && handle_->boolean; }
+  bool isFalse() const { return type() == napi_boolean && !handle_->boolean; }
+  bool isNumber() const { return type() == napi_number; }
+  bool isString() const { return type() == napi_string; }
+  bool isArray() const;
+
+  val typeOf() const;
+  bool instanceof(const val &constructor) const;
+  bool strictlyEquals(const val &other) const;
+  bool operator==(const val &other) const { return strictlyEquals(other); }
+  bool operator!=(const val &other) const { return !strictlyEquals(other); }
+
+ private:
+  struct Adopt {};
+  val(EM_VAL handle, Adopt) : handle_(handle) {}
+
+  napi_valuetype type() const { return handle_->type; }
+
+  template <typename T>
+  static napi_value to_js(const T &value) {
+    return internal::BindingType<typename std::decay<T>::type>::to_js(value);
+  }
+  template <size_t N>
+  static napi_value to_js(const char (&str)[N]) {
+    return internal::BindingType<const char *>::to_js(str);
+  }
+
+  napi_value get(napi_value key) const;
+  static napi_value invoke(napi_value self, napi_value function,
+                           std::initializer_list<napi_value> args);
+  static napi_value construct(napi_value constructor,
+                              std::initializer_list<napi_value> args);
+
+  template <typename R>
+  static R result(napi_value value) {
+    if constexpr (std::is_void<R>::value) {
+      (void)value;
+    } else {
+      return internal::BindingType<R>::from_js(value);
+    }
+  }
+
+  EM_VAL handle_;
+};
+
+namespace internal {
+
+template <>
+struct BindingType<val> {
+  static val from_js(napi_value value) {
+    return val::take_ownership(make_handle(value));
+  }
+  static napi_value to_js(const val &value) { return value.value(); }
+};
+
+}  // namespace internal
+
+// Copy a js array of numbers (or bound objects) into a vector
+template <typename T>
+std::vector<T> vecFromJSArray(const val &array) {
+  uint32_t length = array["length"].as<uint32_t>();
+  std::vector<T> result;
+  result.reserve(length);
+  for (uint32_t i = 0; i < length; i++) {
+    result.push_back(array[i].as<T>());
+  }
+  return result;
+}
+
+}  // namespace emscripten
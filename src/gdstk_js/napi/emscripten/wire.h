@@ -0,0 +1,371 @@
+#pragma once
+
+// Conversions between C++ and js values for the Node-API implementation of
+// embind (emscripten/val.h and emscripten/bind.h in this directory).
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+#include "../emscripten.h"
+
+// Primitive values are stored inline, everything else through a napi_ref.
+// Handles are only created and released on the js thread.
+struct _EM_VAL {
+  napi_valuetype type;
+  double number;
+  bool boolean;
+  int64_t bigint;
+  std::string string;
+  napi_ref ref;
+  uint32_t count;
+};
+
+namespace emscripten {
+
+class val;
+
+struct allow_raw_pointers {};
+
+template <typename T>
+struct memory_view {
+  size_t size;
+  const T *data;
+};
+
+template <typename T>
+memory_view<T> typed_memory_view(size_t size, const T *data) {
+  return {size, data};
+}
+
+namespace internal {
+
+void handle_incref(EM_VAL handle);
+void handle_decref(EM_VAL handle);
+
+napi_value undefined_value();
+[[noreturn]] void throw_type_error(const std::string &message);
+
+// Registered classes ---------------------------------------------------------
+// Every js object of a bound class wraps a Wrapper.  Objects own a
+// shared_ptr, also when created from a raw pointer (with a no-op deleter),
+// which delete() releases like embind does.
+struct Wrapper {
+  const std::type_info *type;
+  std::shared_ptr<void> holder;
+  void *ptr;
+  bool deleted;
+};
+
+// Unwrap value as an instance of type, throwing a TypeError if it is not one.
+// null and undefined give nullptr when allow_null is set.
+Wrapper *unwrap(napi_value value, const std::type_info &type, bool allow_null);
+
+// New js object of the class bound to type owning holder
+napi_value wrap(const std::type_info &type, std::shared_ptr<void> holder,
+                void *ptr);
+
+// value_object<T> fields
+struct Field {
+  std::string name;
+  std::function<napi_value(const void *)> get;
+  std::function<void(void *, napi_value)> set;
+};
+
+// Fields of the value_object bound to type, nullptr if not a value_object
+const std::vector<Field> *value_object_fields(const std::type_info &type);
+
+napi_value make_object();
+napi_value get_named(napi_value object, const char *name);
+void set_named(napi_value object, const char *name, napi_value value);
+
+// BindingType<T>: from_js and to_js for every type crossing the boundary ---
+template <typename T, typename Enable = void>
+struct BindingType {
+  // class or value_object passed by value
+  static T from_js(napi_value value) {
+    if (auto fields = value_object_fields(typeid(T))) {
+      T result{};
+      for (const Field &field : *fields) {
+        field.set(&result, get_named(value, field.name.c_str()));
+      }
+      return result;
+    }
+    return *(T *)unwrap(value, typeid(T), false)->ptr;
+  }
+
+  static napi_value to_js(const T &value) {
+    if (auto fields = value_object_fields(typeid(T))) {
+      napi_value object = make_object();
+      for (const Field &field : *fields) {
+        set_named(object, field.name.c_str(), field.get(&value));
+      }
+      return object;
+    }
+    std::shared_ptr<T> holder = std::make_shared<T>(value);
+    return wrap(typeid(T), holder, holder.get());
+  }
+};
+
+double number_from_js(napi_value value);
+napi_value number_to_js(double number);
+bool bool_from_js(napi_value value);
+napi_value bool_to_js(bool value);
+int64_t int64_from_js(napi_value value);
+// Number truncated to an integer, 0 for NaN and infinities
+int64_t integer_from_js(napi_value value);
+std::string string_from_js(napi_value value);
+napi_value string_to_js(const char *str, size_t length);
+napi_value typed_array_to_js(const char *type, const void *data, size_t size,
+                             size_t element_size);
+
+// Numbers.  64 bit integers are accepted as Number or BigInt and returned
+// as Number, like size_t in wasm32 builds.
+template <typename T>
+struct BindingType<T, typename std::enable_if<std::is_arithmetic<T>::value &&
+                                              !std::is_same<T, bool>::value>::type> {
+  static T from_js(napi_value value) {
+    if constexpr (std::is_floating_point<T>::value) {
+      return (T)number_from_js(value);
+    } else if constexpr (sizeof(T) == 8) {
+      return (T)int64_from_js(value);
+    } else {
+      // wraps around like js ToInt32/ToUint32
+      return (T)integer_from_js(value);
+    }
+  }
+  static napi_value to_js(T value) { return number_to_js((double)value); }
+};
+
+template <typename T>
+struct BindingType<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+  static T from_js(napi_value value) { return (T)integer_from_js(value); }
+  static napi_value to_js(T value) { return number_to_js((double)value); }
+};
+
+template <>
+struct BindingType<bool> {
+  static bool from_js(napi_value value) { return bool_from_js(value); }
+  static napi_value to_js(bool value) { return bool_to_js(value); }
+};
+
+template <>
+struct BindingType<std::string> {
+  static std::string from_js(napi_value value) { return string_from_js(value); }
+  static napi_value to_js(const std::string &value) {
+    return string_to_js(value.data(), value.size());
+  }
+};
+
+template <>
+struct BindingType<const char *> {
+  static napi_value to_js(const char *value) {
+    return string_to_js(value, NAPI_AUTO_LENGTH);
+  }
+};
+
+template <>
+struct BindingType<char *> : BindingType<const char *> {};
+
+template <typename T>
+struct BindingType<memory_view<T>> {
+  static napi_value to_js(const memory_view<T> &view);
+};
+
+template <>
+inline napi_value BindingType<memory_view<double>>::to_js(
+    const memory_view<double> &view) {
+  return typed_array_to_js("Float64Array", view.data, view.size,
+                           sizeof(double));
+}
+
+template <>
+inline napi_value BindingType<memory_view<uint32_t>>::to_js(
+    const memory_view<uint32_t> &view) {
+  return typed_array_to_js("Uint32Array", view.data, view.size,
+                           sizeof(uint32_t));
+}
+
+template <typename T>
+struct BindingType<std::shared_ptr<T>> {
+  static std::shared_ptr<T> from_js(napi_value value) {
+    Wrapper *wrapper = unwrap(value, typeid(T), true);
+    if (!wrapper) return nullptr;
+    return std::shared_ptr<T>(wrapper->holder, (T *)wrapper->ptr);
+  }
+  static napi_value to_js(const std::shared_ptr<T> &value) {
+    return wrap(typeid(T), value, value.get());
+  }
+};
+
+// Raw pointers (allow_raw_pointers) never own their object
+template <typename T>
+struct BindingType<T *, typename std::enable_if<!std::is_same<
+                            typename std::remove_cv<T>::type, char>::value>::type> {
+  static T *from_js(napi_value value) {
+    Wrapper *wrapper = unwrap(value, typeid(typename std::remove_cv<T>::type), true);
+    return wrapper ? (T *)wrapper->ptr : nullptr;
+  }
+  static napi_value to_js(T *value) {
+    typedef typename std::remove_cv<T>::type U;
+    return wrap(typeid(U), std::shared_ptr<void>((U *)value, [](void *) {}),
+                (U *)value);
+  }
+};
+
+// Argument holders --------------------------------------------------------
+// Arg<A>::get() yields what a bound function taking A receives.
+template <typename T>
+struct is_plain_value
+    : std::integral_constant<bool, std::is_arithmetic<T>::value ||
+                                       std::is_enum<T>::value ||
+                                       std::is_same<T, std::string>::value ||
+                                       std::is_same<T, val>::value> {};
+
+template <typename T>
+struct is_shared_ptr : std::false_type {};
+template <typename T>
+struct is_shared_ptr<std::shared_ptr<T>> : std::true_type {};
+
+template <typename A, typename Enable = void>
+struct Arg {
+  typedef typename std::decay<A>::type D;
+  D value;
+  explicit Arg(napi_value js) : value(BindingType<D>::from_js(js)) {}
+  D &get() { return value; }
+};
+
+// References to bound classes point into the wrapped object
+template <typename A>
+struct Arg<A, typename std::enable_if<
+                  std::is_reference<A>::value &&
+                  !is_plain_value<typename std::decay<A>::type>::value &&
+                  !is_shared_ptr<typename std::decay<A>::type>::value>::type> {
+  typedef typename std::decay<A>::type D;
+  D *ptr;
+  std::unique_ptr<D> copy;
+  explicit Arg(napi_value js) {
+    if constexpr (std::is_copy_constructible<D>::value &&
+                  std::is_default_constructible<D>::value) {
+      if (value_object_fields(typeid(D))) {
+        copy.reset(new D(BindingType<D>::from_js(js)));
+        ptr = copy.get();
+        return;
+      }
+    }
+    ptr = (D *)unwrap(js, typeid(D), false)->ptr;
+  }
+  D &get() { return *ptr; }
+};
+
+// Callable signatures -----------------------------------------------------
+template <typename F>
+struct Signature : Signature<decltype(&F::operator())> {};
+
+template <typename R, typename... A>
+struct Signature<R (*)(A...)> {
+  typedef R Result;
+  typedef std::tuple<A...> Args;
+};
+
+template <typename R, typename... A>
+struct Signature<R(A...)> : Signature<R (*)(A...)> {};
+
+template <typename C, typename R, typename... A>
+struct Signature<R (C::*)(A...) const> : Signature<R (*)(A...)> {};
+
+template <typename C, typename R, typename... A>
+struct Signature<R (C::*)(A...)> : Signature<R (*)(A...)> {};
+
+// Call f with js arguments converted to its parameter types and convert the
+// result back
+template <typename R, typename... A, typename F, size_t... I>
+napi_value invoke(F &f, napi_value *argv, std::index_sequence<I...>) {
+  std::tuple<Arg<A>...> args{Arg<A>(argv[I])...};
+  (void)args;
+  if constexpr (std::is_void<R>::value) {
+    f(std::get<I>(args).get()...);
+    return undefined_value();
+  } else {
+    return BindingType<typename std::decay<R>::type>::to_js(
+        f(std::get<I>(args).get()...));
+  }
+}
+
+template <typename F, typename R, typename Args>
+struct Invoker;
+
+template <typename F, typename R, typename... A>
+struct Invoker<F, R, std::tuple<A...>> {
+  static constexpr size_t arity = sizeof...(A);
+  static napi_value call(F &f, napi_value *argv) {
+    return invoke<R, A...>(f, argv, std::index_sequence_for<A...>{});
+  }
+};
+
+// Member function pointer as a callable taking the object first
+template <typename M>
+struct MemberFunction;
+
+template <typename C, typename R, typename... A>
+struct MemberFunction<R (C::*)(A...)> {
+  R (C::*method)(A...);
+  R operator()(C &self, A... args) const { return (self.*method)(args...); }
+};
+
+template <typename C, typename R, typename... A>
+struct MemberFunction<R (C::*)(A...) const> {
+  R (C::*method)(A...) const;
+  R operator()(const C &self, A... args) const {
+    return (self.*method)(args...);
+  }
+};
+
+template <typename F>
+F as_callable(F f) {
+  return f;
+}
+
+template <typename C, typename R, typename... A>
+MemberFunction<R (C::*)(A...)> as_callable(R (C::*method)(A...)) {
+  return {method};
+}
+
+template <typename C, typename R, typename... A>
+MemberFunction<R (C::*)(A...) const> as_callable(R (C::*method)(A...) const) {
+  return {method};
+}
+
+template <typename C, typename R, typename... A>
+struct Signature<MemberFunction<R (C::*)(A...)>> {
+  typedef R Result;
+  typedef std::tuple<C &, A...> Args;
+};
+
+template <typename C, typename R, typename... A>
+struct Signature<MemberFunction<R (C::*)(A...) const>> {
+  typedef R Result;
+  typedef std::tuple<const C &, A...> Args;
+};
+
+// Type erased overload: receives this (for methods) followed by arguments
+typedef std::function<napi_value(napi_value *argv)> Overload;
+
+template <typename F>
+std::pair<size_t, Overload> make_overload(F function) {
+  auto callable = as_callable(function);
+  typedef decltype(callable) C;
+  typedef Invoker<C, typename Signature<C>::Result, typename Signature<C>::Args>
+      I;
+  return {I::arity, [callable](napi_value *argv) mutable {
+            return I::call(callable, argv);
+          }};
+}
+
+}  // namespace internal
+}  // namespace emscripten
@@ -0,0 +1,12 @@
+// Loader of the native addon with the same interface as the wasm package:
+//
+//   const Gdstk = require("./build-node");
+//   Gdstk().then((gdstk) => { ... });
+//
+// Files are read and written on the host filesystem directly (there is no FS
+// module), and memory_stats() reports no allocator accounting.
+const addon = require("./gdstk.node");
+
+module.exports = function Gdstk() {
+  return Promise.resolve(addon);
+};
@@ -0,0 +1,731 @@
+// Runtime of the Node-API implementation of embind (emscripten.h and
+// emscripten/*.h in this directory) and the addon entry point.
+
+#include <math.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <typeindex>
+#include <unordered_map>
+
+#include "emscripten.h"
+#include "emscripten/bind.h"
+#include "emscripten/val.h"
+
+namespace emscripten {
+namespace internal {
+
+namespace {
+
+napi_env g_env = nullptr;
+napi_ref g_exports = nullptr;
+// Set when the environment is torn down: handles released afterwards (from
+// static destructors) must not call into Node-API
+bool g_env_alive = false;
+
+// Marker passed to class constructors to adopt a Wrapper created by wrap()
+int g_wrap_token;
+Wrapper *g_pending_wrapper = nullptr;
+
+std::unordered_map<std::type_index, ClassInfo *> &classes() {
+  static std::unordered_map<std::type_index, ClassInfo *> map;
+  return map;
+}
+
+std::unordered_map<std::type_index, std::vector<Field>> &value_objects() {
+  static std::unordered_map<std::type_index, std::vector<Field>> map;
+  return map;
+}
+
+std::unordered_map<std::string, OverloadSet *> &functions() {
+  static std::unordered_map<std::string, OverloadSet *> map;
+  return map;
+}
+
+std::vector<void (*)()> &initializers() {
+  static std::vector<void (*)()> list;
+  return list;
+}
+
+struct PropertyInfo {
+  Overload getter;
+  Overload setter;
+};
+
+const size_t max_args = 16;
+
+// Run body as a js entry point: C++ exceptions become js Errors, JsException
+// returns with the js exception pending
+template <typename F>
+napi_value guarded(napi_env env, F body) {
+  try {
+    return body();
+  } catch (const JsException &) {
+  } catch (const std::exception &e) {
+    napi_throw_error(env, nullptr, e.what());
+  } catch (...) {
+    napi_throw_error(env, nullptr, "Unknown native exception.");
+  }
+  return nullptr;
+}
+
+ClassInfo *find_class(const std::type_info &type) {
+  auto it = classes().find(std::type_index(type));
+  return it == classes().end() ? nullptr : it->second;
+}
+
+std::string type_name(const std::type_info &type) {
+  ClassInfo *info = find_class(type);
+  return info ? info->name : std::string(type.name());
+}
+
+std::string arities(const std::vector<std::pair<size_t, Overload>> &overloads,
+                    size_t skip) {
+  std::string result;
+  for (size_t i = 0; i < overloads.size(); i++) {
+    if (i > 0) result += i + 1 < overloads.size() ? ", " : " or ";
+    result += std::to_string(overloads[i].first - skip);
+  }
+  return result;
+}
+
+void finalize_wrapper(napi_env, void *data, void *) {
+  delete (Wrapper *)data;
+}
+
+Wrapper *this_wrapper(napi_env env, napi_value self) {
+  Wrapper *wrapper = nullptr;
+  if (napi_unwrap(env, self, (void **)&wrapper) != napi_ok || !wrapper) {
+    throw_type_error("Method called on an incompatible object.");
+  }
+  return wrapper;
+}
+
+napi_value call_overloads(napi_env env, napi_callback_info info) {
+  return guarded(env, [&]() {
+    size_t argc = max_args;
+    napi_value argv[max_args + 1];
+    OverloadSet *set;
+    check(napi_get_cb_info(env, info, &argc, argv + 1, &argv[0],
+                           (void **)&set));
+    napi_value *args = set->method ? argv : argv + 1;
+    size_t count = set->method ? argc + 1 : argc;
+    for (auto &overload : set->overloads) {
+      if (overload.first == count) return overload.second(args);
+    }
+    size_t skip = set->method ? 1 : 0;
+    throw std::runtime_error("function " + set->name + " called with " +
+                             std::to_string(argc) +
+                             " arguments, expected " +
+                             arities(set->overloads, skip));
+  });
+}
+
+napi_value construct(napi_env env, napi_callback_info info) {
+  return guarded(env, [&]() {
+    size_t argc = max_args;
+    napi_value argv[max_args];
+    napi_value self;
+    ClassInfo *class_info;
+    check(napi_get_cb_info(env, info, &argc, argv, &self,
+                           (void **)&class_info));
+
+    Wrapper *wrapper = nullptr;
+    napi_valuetype type = napi_undefined;
+    if (argc == 1) check(napi_typeof(env, argv[0], &type));
+    void *token = nullptr;
+    if (type == napi_external) check(napi_get_value_external(env, argv[0], &token));
+    if (token == &g_wrap_token) {
+      wrapper = g_pending_wrapper;
+      g_pending_wrapper = nullptr;
+    } else {
+      const ConstructorOverload *constructor = nullptr;
+      for (auto &overload : class_info->constructors) {
+        if (overload.first == argc) constructor = &overload.second;
+      }
+      if (!constructor) {
+        std::string expected;
+        for (size_t i = 0; i < class_info->constructors.size(); i++) {
+          if (i > 0) expected += ", ";
+          expected += std::to_string(class_info->constructors[i].first);
+        }
+        throw std::runtime_error(
+            "Tried to invoke ctor of " + class_info->name +
+            " with invalid number of parameters (" + std::to_string(argc) +
+            ") - expected (" + expected + ") parameters instead!");
+      }
+      auto result = (*constructor)(argv);
+      wrapper = new Wrapper{class_info->type, std::move(result.first),
+                            result.second, false};
+    }
+    napi_status status =
+        napi_wrap(env, self, wrapper, finalize_wrapper, nullptr, nullptr);
+    if (status != napi_ok) {
+      delete wrapper;
+      check(status);
+    }
+    return self;
+  });
+}
+
+napi_value delete_method(napi_env env, napi_callback_info info) {
+  return guarded(env, [&]() {
+    napi_value self;
+    check(napi_get_cb_info(env, info, nullptr, nullptr, &self, nullptr));
+    Wrapper *wrapper = this_wrapper(env, self);
+    if (wrapper->deleted) {
+      throw std::runtime_error(type_name(*wrapper->type) +
+                               " instance already deleted");
+    }
+    wrapper->deleted = true;
+    wrapper->holder.reset();
+    wrapper->ptr = nullptr;
+    return undefined_value();
+  });
+}
+
+napi_value is_deleted_method(napi_env env, napi_callback_info info) {
+  return guarded(env, [&]() {
+    napi_value self;
+    check(napi_get_cb_info(env, info, nullptr, nullptr, &self, nullptr));
+    return bool_to_js(this_wrapper(env, self)->deleted);
+  });
+}
+
+napi_value clone_method(napi_env env, napi_callback_info info) {
+  return guarded(env, [&]() {
+    napi_value self;
+    check(napi_get_cb_info(env, info, nullptr, nullptr, &self, nullptr));
+    Wrapper *wrapper = this_wrapper(env, self);
+    if (wrapper->deleted) {
+      throw std::runtime_error(type_name(*wrapper->type) +
+                               " instance already deleted");
+    }
+    return wrap(*wrapper->type, wrapper->holder, wrapper->ptr);
+  });
+}
+
+napi_value get_property(napi_env env, napi_callback_info info) {
+  return guarded(env, [&]() {
+    napi_value self;
+    PropertyInfo *property;
+    check(napi_get_cb_info(env, info, nullptr, nullptr, &self,
+                           (void **)&property));
+    return property->getter(&self);
+  });
+}
+
+napi_value set_property(napi_env env, napi_callback_info info) {
+  return guarded(env, [&]() {
+    size_t argc = 1;
+    napi_value argv[2];
+    PropertyInfo *property;
+    check(napi_get_cb_info(env, info, &argc, argv + 1, &argv[0],
+                           (void **)&property));
+    if (argc < 1) argv[1] = undefined_value();
+    property->setter(argv);
+    return undefined_value();
+  });
+}
+
+napi_value exports() {
+  napi_value result;
+  check(napi_get_reference_value(g_env, g_exports, &result));
+  return result;
+}
+
+napi_value reference_value(napi_ref ref) {
+  napi_value result;
+  check(napi_get_reference_value(g_env, ref, &result));
+  return result;
+}
+
+void define_property(napi_value object, const napi_property_descriptor &desc) {
+  check(napi_define_properties(g_env, object, 1, &desc));
+}
+
+void env_cleanup(void *) { g_env_alive = false; }
+
+}  // namespace
+
+// Environment and errors -----------------------------------------------------
+
+napi_env env() { return g_env; }
+
+void check(napi_status status) {
+  if (status == napi_ok) return;
+  bool pending = false;
+  napi_is_exception_pending(g_env, &pending);
+  if (pending || status == napi_pending_exception) throw JsException();
+  const napi_extended_error_info *info = nullptr;
+  napi_get_last_error_info(g_env, &info);
+  throw std::runtime_error(info && info->error_message ? info->error_message
+                                                       : "Node-API call failed.");
+}
+
+void throw_type_error(const std::string &message) {
+  napi_throw_type_error(g_env, nullptr, message.c_str());
+  throw JsException();
+}
+
+napi_value undefined_value() {
+  napi_value result;
+  check(napi_get_undefined(g_env, &result));
+  return result;
+}
+
+// Handles --------------------------------------------------------------------
+
+EM_VAL make_handle(napi_value value) {
+  EM_VAL handle = new _EM_VAL{};
+  handle->count = 1;
+  check(napi_typeof(g_env, value, &handle->type));
+  switch (handle->type) {
+    case napi_undefined:
+    case napi_null:
+      break;
+    case napi_boolean:
+      check(napi_get_value_bool(g_env, value, &handle->boolean));
+      break;
+    case napi_number:
+      check(napi_get_value_double(g_env, value, &handle->number));
+      break;
+    case napi_string:
+      handle->string = string_from_js(value);
+      break;
+    case napi_bigint: {
+      bool lossless;
+      check(napi_get_value_bigint_int64(g_env, value, &handle->bigint,
+                                        &lossless));
+    } break;
+    default:
+      check(napi_create_reference(g_env, value, 1, &handle->ref));
+  }
+  return handle;
+}
+
+napi_value handle_value(EM_VAL handle) {
+  napi_value result;
+  switch (handle->type) {
+    case napi_undefined:
+      return undefined_value();
+    case napi_null:
+      check(napi_get_null(g_env, &result));
+      return result;
+    case napi_boolean:
+      return bool_to_js(handle->boolean);
+    case napi_number:
+      return number_to_js(handle->number);
+    case napi_string:
+      return string_to_js(handle->string.data(), handle->string.size());
+    case napi_bigint:
+      check(napi_create_bigint_int64(g_env, handle->bigint, &result));
+      return result;
+    default:
+      return reference_value(handle->ref);
+  }
+}
+
+void handle_incref(EM_VAL handle) { handle->count++; }
+
+void handle_decref(EM_VAL handle) {
+  if (--handle->count > 0) return;
+  if (handle->ref && g_env_alive) napi_delete_reference(g_env, handle->ref);
+  delete handle;
+}
+
+// Conversions ----------------------------------------------------------------
+
+double number_from_js(napi_value value) {
+  double result;
+  if (napi_get_value_double(g_env, value, &result) == napi_ok) return result;
+  napi_valuetype type;
+  check(napi_typeof(g_env, value, &type));
+  if (type == napi_bigint) {
+    bool lossless;
+    int64_t integer;
+    check(napi_get_value_bigint_int64(g_env, value, &integer, &lossless));
+    return (double)integer;
+  }
+  napi_value number;
+  check(napi_coerce_to_number(g_env, value, &number));
+  check(napi_get_value_double(g_env, number, &result));
+  return result;
+}
+
+int64_t integer_from_js(napi_value value) {
+  double number = number_from_js(value);
+  if (!isfinite(number)) return 0;
+  if (number >= 9223372036854775808.0) return INT64_MAX;
+  if (number < -9223372036854775808.0) return INT64_MIN;
+  return (int64_t)number;
+}
+
+int64_t int64_from_js(napi_value value) {
+  napi_valuetype type;
+  check(napi_typeof(g_env, value, &type));
+  if (type == napi_bigint) {
+    bool lossless;
+    int64_t result;
+    check(napi_get_value_bigint_int64(g_env, value, &result, &lossless));
+    return result;
+  }
+  return integer_from_js(value);
+}
+
+napi_value number_to_js(double number) {
+  napi_value result;
+  check(napi_create_double(g_env, number, &result));
+  return result;
+}
+
+bool bool_from_js(napi_value value) {
+  bool result;
+  if (napi_get_value_bool(g_env, value, &result) == napi_ok) return result;
+  napi_value boolean;
+  check(napi_coerce_to_bool(g_env, value, &boolean));
+  check(napi_get_value_bool(g_env, boolean, &result));
+  return result;
+}
+
+napi_value bool_to_js(bool value) {
+  napi_value result;
+  check(napi_get_boolean(g_env, value, &result));
+  return result;
+}
+
+std::string string_from_js(napi_value value) {
+  size_t length;
+  if (napi_get_value_string_utf8(g_env, value, nullptr, 0, &length) !=
+      napi_ok) {
+    throw_type_error("Cannot pass non-string to std::string");
+  }
+  std::string result(length, '\0');
+  check(napi_get_value_string_utf8(g_env, value, &result[0], length + 1,
+                                   &length));
+  return result;
+}
+
+napi_value string_to_js(const char *str, size_t length) {
+  napi_value result;
+  check(napi_create_string_utf8(g_env, str, length, &result));
+  return result;
+}
+
+// Views of native memory, like typed_memory_view views of the wasm heap
+napi_value typed_array_to_js(const char *type, const void *data, size_t size,
+                             size_t element_size) {
+  napi_value buffer;
+  if (size == 0) {
+    // external buffers without data are created detached
+    void *unused;
+    check(napi_create_arraybuffer(g_env, 0, &unused, &buffer));
+  } else {
+    check(napi_create_external_arraybuffer(g_env, (void *)data,
+                                           size * element_size, nullptr,
+                                           nullptr, &buffer));
+  }
+  napi_value result;
+  napi_typedarray_type array_type;
+  if (strcmp(type, "Float64Array") == 0) {
+    array_type = napi_float64_array;
+  } else if (strcmp(type, "Uint32Array") == 0) {
+    array_type = napi_uint32_array;
+  } else {
+    throw std::runtime_error(std::string("Unsupported memory view ") + type);
+  }
+  check(napi_create_typedarray(g_env, array_type, size, buffer, 0, &result));
+  return result;
+}
+
+napi_value make_object() {
+  napi_value result;
+  check(napi_create_object(g_env, &result));
+  return result;
+}
+
+napi_value get_named(napi_value object, const char *name) {
+  napi_value result;
+  check(napi_get_named_property(g_env, object, name, &result));
+  return result;
+}
+
+void set_named(napi_value object, const char *name, napi_value value) {
+  check(napi_set_named_property(g_env, object, name, value));
+}
+
+// Classes --------------------------------------------------------------------
+
+Wrapper *unwrap(napi_value value, const std::type_info &type,
+                bool allow_null) {
+  napi_valuetype value_type;
+  check(napi_typeof(g_env, value, &value_type));
+  if (allow_null && (value_type == napi_null || value_type == napi_undefined)) {
+    return nullptr;
+  }
+  Wrapper *wrapper = nullptr;
+  if (value_type != napi_object ||
+      napi_unwrap(g_env, value, (void **)&wrapper) != napi_ok || !wrapper ||
+      *wrapper->type != type) {
+    throw_type_error("Expected " + type_name(type));
+  }
+  if (wrapper->deleted) {
+    throw std::runtime_error("Cannot pass deleted object as a pointer of type " +
+                             type_name(type));
+  }
+  return wrapper;
+}
+
+napi_value wrap(const std::type_info &type, std::shared_ptr<void> holder,
+                void *ptr) {
+  if (!ptr) {
+    napi_value result;
+    check(napi_get_null(g_env, &result));
+    return result;
+  }
+  ClassInfo *info = find_class(type);
+  if (!info) {
+    throw std::runtime_error(std::string("Unbound type ") + type.name());
+  }
+  napi_value token;
+  check(napi_create_external(g_env, &g_wrap_token, nullptr, nullptr, &token));
+  g_pending_wrapper = new Wrapper{info->type, std::move(holder), ptr, false};
+  napi_value result;
+  napi_status status = napi_new_instance(
+      g_env, reference_value(info->constructor), 1, &token, &result);
+  if (g_pending_wrapper) {
+    delete g_pending_wrapper;
+    g_pending_wrapper = nullptr;
+  }
+  check(status);
+  return result;
+}
+
+ClassInfo *register_class(const std::type_info &type, const char *name) {
+  ClassInfo *info = new ClassInfo{name, &type, nullptr, nullptr, {}, {}};
+  napi_value constructor;
+  check(napi_define_class(g_env, name, NAPI_AUTO_LENGTH, construct, info, 0,
+                          nullptr, &constructor));
+  napi_value prototype = get_named(constructor, "prototype");
+  check(napi_create_reference(g_env, constructor, 1, &info->constructor));
+  check(napi_create_reference(g_env, prototype, 1, &info->prototype));
+
+  napi_property_descriptor methods[] = {
+      {"delete", nullptr, delete_method, nullptr, nullptr, nullptr,
+       napi_default_method, nullptr},
+      {"isDeleted", nullptr, is_deleted_method, nullptr, nullptr, nullptr,
+       napi_default_method, nullptr},
+      {"clone", nullptr, clone_method, nullptr, nullptr, nullptr,
+       napi_default_method, nullptr},
+  };
+  check(napi_define_properties(g_env, prototype, 3, methods));
+  set_named(exports(), name, constructor);
+  classes()[std::type_index(type)] = info;
+  return info;
+}
+
+void add_method(ClassInfo *info, const char *name, size_t arity,
+                Overload overload) {
+  for (OverloadSet *set : info->functions) {
+    if (set->name == info->name + "." + name) {
+      set->overloads.emplace_back(arity, std::move(overload));
+      return;
+    }
+  }
+  OverloadSet *set = new OverloadSet{info->name + "." + name, true, {}};
+  set->overloads.emplace_back(arity, std::move(overload));
+  info->functions.push_back(set);
+  define_property(reference_value(info->prototype),
+                  {name, nullptr, call_overloads, nullptr, nullptr, nullptr,
+                   napi_default_method, set});
+}
+
+void add_property(ClassInfo *info, const char *name, Overload getter,
+                  Overload setter) {
+  PropertyInfo *property = new PropertyInfo{std::move(getter), std::move(setter)};
+  napi_property_attributes attributes = napi_configurable;
+  define_property(reference_value(info->prototype),
+                  {name, nullptr, nullptr, get_property,
+                   property->setter ? set_property : nullptr, nullptr,
+                   attributes, property});
+}
+
+void add_function(const char *name, size_t arity, Overload overload) {
+  auto it = functions().find(name);
+  if (it != functions().end()) {
+    it->second->overloads.emplace_back(arity, std::move(overload));
+    return;
+  }
+  OverloadSet *set = new OverloadSet{name, false, {}};
+  set->overloads.emplace_back(arity, std::move(overload));
+  functions()[name] = set;
+  napi_value function;
+  check(napi_create_function(g_env, name, NAPI_AUTO_LENGTH, call_overloads,
+                             set, &function));
+  set_named(exports(), name, function);
+}
+
+void register_value_object(const std::type_info &type, const char *) {
+  value_objects()[std::type_index(type)];
+}
+
+void add_field(const std::type_info &type, Field field) {
+  value_objects()[std::type_index(type)].push_back(std::move(field));
+}
+
+const std::vector<Field> *value_object_fields(const std::type_info &type) {
+  auto it = value_objects().find(std::type_index(type));
+  return it == value_objects().end() ? nullptr : &it->second;
+}
+
+// EM_JS ----------------------------------------------------------------------
+
+napi_value em_js_arg(const char *str) {
+  return string_to_js(str, NAPI_AUTO_LENGTH);
+}
+
+napi_value em_js_arg(double number) { return number_to_js(number); }
+
+napi_value EmJsFunction::call(std::vector<napi_value> &args) {
+  if (!function_) {
+    // "(EM_VAL a, const char* b)" -> "a, b"
+    std::string names;
+    std::string params(params_);
+    size_t start = 1;
+    while (start < params.size()) {
+      size_t end = params.find_first_of(",)", start);
+      if (end == std::string::npos) end = params.size();
+      size_t last = params.find_last_not_of(" \t\n", end - 1);
+      size_t first = params.find_last_of(" *&", last);
+      if (last != std::string::npos && last >= start) {
+        first = (first == std::string::npos || first < start) ? start : first + 1;
+        if (!names.empty()) names += ", ";
+        names += params.substr(first, last + 1 - first);
+      }
+      start = end + 1;
+    }
+    std::string source =
+        "(function() { const Emval = {toValue: (x) => x, toHandle: (x) => x};"
+        " const UTF8ToString = (s) => s; return function(" +
+        names + ") " + body_ + "; })()";
+    napi_value script = string_to_js(source.data(), source.size());
+    napi_value function;
+    check(napi_run_script(g_env, script, &function));
+    check(napi_create_reference(g_env, function, 1, &function_));
+  }
+  napi_value result;
+  check(napi_call_function(g_env, undefined_value(), reference_value(function_),
+                           args.size(), args.data(), &result));
+  return result;
+}
+
+BindingsInitializer::BindingsInitializer(void (*function)()) {
+  initializers().push_back(function);
+}
+
+}  // namespace internal
+
+// val ------------------------------------------------------------------------
+
+using internal::check;
+using internal::g_env;
+
+val val::array() {
+  napi_value result;
+  check(napi_create_array(g_env, &result));
+  return take_ownership(internal::make_handle(result));
+}
+
+val val::object() {
+  return take_ownership(internal::make_handle(internal::make_object()));
+}
+
+val val::null() {
+  napi_value result;
+  check(napi_get_null(g_env, &result));
+  return take_ownership(internal::make_handle(result));
+}
+
+val val::undefined() {
+  return take_ownership(internal::make_handle(internal::undefined_value()));
+}
+
+val val::global(const char *name) {
+  napi_value result;
+  check(napi_get_global(g_env, &result));
+  if (name) result = internal::get_named(result, name);
+  return take_ownership(internal::make_handle(result));
+}
+
+val val::module_property(const char *name) {
+  return take_ownership(
+      internal::make_handle(internal::get_named(internal::exports(), name)));
+}
+
+bool val::isArray() const {
+  if (type() != napi_object) return false;
+  bool result;
+  check(napi_is_array(g_env, value(), &result));
+  return result;
+}
+
+val val::typeOf() const {
+  static const char *names[] = {"undefined", "object", "boolean", "number",
+                                "string",    "symbol", "object",  "function",
+                                "object",    "bigint"};
+  return val(names[type()]);
+}
+
+bool val::instanceof(const val &constructor) const {
+  if (type() != napi_object && type() != napi_function) return false;
+  bool result;
+  check(napi_instanceof(g_env, value(), constructor.value(), &result));
+  return result;
+}
+
+bool val::strictlyEquals(const val &other) const {
+  bool result;
+  check(napi_strict_equals(g_env, value(), other.value(), &result));
+  return result;
+}
+
+napi_value val::get(napi_value key) const {
+  napi_value result;
+  check(napi_get_property(g_env, value(), key, &result));
+  return result;
+}
+
+napi_value val::invoke(napi_value self, napi_value function,
+                       std::initializer_list<napi_value> args) {
+  napi_value result;
+  check(napi_call_function(g_env, self, function, args.size(), args.begin(),
+                           &result));
+  return result;
+}
+
+napi_value val::construct(napi_value constructor,
+                          std::initializer_list<napi_value> args) {
+  napi_value result;
+  check(napi_new_instance(g_env, constructor, args.size(), args.begin(),
+                          &result));
+  return result;
+}
+
+}  // namespace emscripten
+
+NAPI_MODULE_INIT() {
+  using namespace emscripten::internal;
+  if (g_env) {
+    napi_throw_error(env, nullptr,
+                     "gdstk native addon can only be loaded once per process");
+    return nullptr;
+  }
+  g_env = env;
+  g_env_alive = true;
+  napi_add_env_cleanup_hook(env, env_cleanup, nullptr);
+  napi_create_reference(env, exports, 1, &g_exports);
+  return guarded(env, [&]() {
+    for (auto initializer : initializers()) initializer();
+    return exports;
+  });
+}
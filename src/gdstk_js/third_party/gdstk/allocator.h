@@ -16,8 +16,24 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 
 namespace gdstk {
 
+// Categories used by custom allocators to account for memory.  Allocations are
+// tagged with the category active on the allocating thread.
+enum struct MemoryCategory {
+    Default = 0,   // category not set: geometry for gdstk, bindings for operator new
+    Geometry,      // polygons, points and other gdstk objects
+    Library,       // libraries loaded from files
+    Paths,         // path tessellation
+    Clipper,       // clipper temporaries
+    Bindings,      // C++ heap outside gdstk (binding maps, containers)
+    Count,
+};
+
 #ifdef GDSTK_CUSTOM_ALLOCATOR
 
+// Set the category for allocations of the current thread and return the
+// previous one
+MemoryCategory set_memory_category(MemoryCategory category);
+
 void* allocate(uint64_t size);
 
 void* reallocate(void* ptr, uint64_t size);
@@ -36,8 +52,24 @@ inline void* allocate_clear(uint64_t size) { return calloc(1, size); };
 
 inline void free_allocation(void* ptr) { free(ptr); };
 
+inline MemoryCategory set_memory_category(MemoryCategory) { return MemoryCategory::Default; };
+
 #endif  // GDSTK_CUSTOM_ALLOCATOR
 
+// Tag allocations of the current thread with category until destruction (or
+// restore)
+struct MemoryCategoryScope {
+    MemoryCategory previous;
+    bool active;
+    explicit MemoryCategoryScope(MemoryCategory category)
+        : previous(set_memory_category(category)), active(true) {}
+    ~MemoryCategoryScope() { restore(); }
+    void restore() {
+        if (active) set_memory_category(previous);
+        active = false;
+    }
+};
+
 }  // namespace gdstk
 
 #endif
@@ -16,6 +16,7 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 
 #include "allocator.h"
 #include "cell.h"
+#include "clipper_tools.h"
 #include "rawcell.h"
 #include "sort.h"
 #include "utils.h"
@@ -72,6 +73,8 @@ void Cell::clear() {
     robustpath_array.clear();
     label_array.clear();
     properties_clear(properties);
+    clear_index();
+    clear_geometry_info();
 }
 
 void Cell::bounding_box(Vec2& min, Vec2& max) const {
@@ -296,6 +299,71 @@ GeometryInfo Cell::convex_hull(Map<GeometryInfo>& cache) const {
     return info;
 }
 
+// Seed cache with the persistent information of cell and its dependencies.
+// Convex hull arrays are shared with the cells, so cache must be released
+// with release_geometry_cache.
+static void seed_geometry_cache(Cell* cell, const Map<Cell*>& dependencies,
+                                Map<GeometryInfo>& cache) {
+    if (cell->geometry_info.bounding_box_valid || cell->geometry_info.convex_hull_valid)
+        cache.set(cell->name, cell->geometry_info);
+    for (MapItem<Cell*>* item = dependencies.next(NULL); item; item = dependencies.next(item)) {
+        const GeometryInfo info = item->value->geometry_info;
+        if (info.bounding_box_valid || info.convex_hull_valid) cache.set(item->key, info);
+    }
+}
+
+// Store the information computed in cache back into its cell.  A convex hull
+// array is either moved into the cell or already shared with it.
+static void store_geometry_info(Cell* cell, const Map<GeometryInfo>& cache) {
+    const GeometryInfo info = cache.get(cell->name);
+    GeometryInfo& target = cell->geometry_info;
+    if (info.bounding_box_valid && !target.bounding_box_valid) {
+        target.bounding_box_min = info.bounding_box_min;
+        target.bounding_box_max = info.bounding_box_max;
+        target.bounding_box_valid = true;
+    }
+    if (info.convex_hull_valid && !target.convex_hull_valid) {
+        target.convex_hull.clear();
+        target.convex_hull = info.convex_hull;
+        target.convex_hull_valid = true;
+    }
+}
+
+static void release_geometry_cache(Cell* cell, Map<Cell*>& dependencies,
+                                   Map<GeometryInfo>& cache) {
+    store_geometry_info(cell, cache);
+    for (MapItem<Cell*>* item = dependencies.next(NULL); item; item = dependencies.next(item)) {
+        if (item->value != cell) store_geometry_info(item->value, cache);
+    }
+    cache.clear();
+    dependencies.clear();
+}
+
+void Cell::cached_bounding_box(Vec2& min, Vec2& max) {
+    if (!geometry_info.bounding_box_valid) {
+        Map<Cell*> dependencies = {};
+        get_dependencies(true, dependencies);
+        Map<GeometryInfo> cache = {};
+        seed_geometry_cache(this, dependencies, cache);
+        bounding_box(cache);
+        release_geometry_cache(this, dependencies, cache);
+    }
+    min = geometry_info.bounding_box_min;
+    max = geometry_info.bounding_box_max;
+}
+
+void Cell::cached_convex_hull(Array<Vec2>& result) {
+    if (!geometry_info.convex_hull_valid) {
+        Map<Cell*> dependencies = {};
+        get_dependencies(true, dependencies);
+        Map<GeometryInfo> cache = {};
+        seed_geometry_cache(this, dependencies, cache);
+        convex_hull(cache);
+        release_geometry_cache(this, dependencies, cache);
+    }
+    result.extend(geometry_info.convex_hull);
+}
+
 void Cell::copy_from(const Cell& cell, const char* new_name, bool deep_copy) {
     name = copy_string(new_name ? new_name : cell.name, NULL);
     properties = properties_copy(cell.properties);
@@ -412,6 +480,119 @@ void Cell::get_polygons(bool apply_repetitions, bool include_paths, int64_t dept
     }
 }
 
+static void visit_polygon(const Polygon& polygon, bool apply_repetitions,
+                          const Transformation& transformation, PolygonVisitor visit,
+                          void* data) {
+    if (!apply_repetitions || polygon.repetition.type == RepetitionType::None) {
+        visit(polygon, transformation, data);
+        return;
+    }
+    Array<Vec2> offsets = {};
+    polygon.repetition.get_offsets(offsets);
+    Transformation copy = transformation;
+    for (uint64_t i = 0; i < offsets.count; i++) {
+        copy.origin = transformation.apply(offsets[i]);
+        visit(polygon, copy, data);
+    }
+    offsets.clear();
+}
+
+void Cell::visit_polygons(bool apply_repetitions, bool include_paths, int64_t depth, bool filter,
+                          Tag tag, const Transformation& transformation, PolygonVisitor visit,
+                          void* data) const {
+    for (uint64_t i = 0; i < polygon_array.count; i++) {
+        const Polygon* polygon = polygon_array[i];
+        if (filter && polygon->tag != tag) continue;
+        visit_polygon(*polygon, apply_repetitions, transformation, visit, data);
+    }
+
+    if (include_paths) {
+        Array<Polygon*> path_polygons = {};
+        for (uint64_t i = 0; i < flexpath_array.count; i++) {
+            // NOTE: return ErrorCode ignored here
+            flexpath_array[i]->to_polygons(filter, tag, path_polygons);
+        }
+        for (uint64_t i = 0; i < robustpath_array.count; i++) {
+            // NOTE: return ErrorCode ignored here
+            robustpath_array[i]->to_polygons(filter, tag, path_polygons);
+        }
+        for (uint64_t i = 0; i < path_polygons.count; i++) {
+            Polygon* polygon = path_polygons[i];
+            visit_polygon(*polygon, apply_repetitions, transformation, visit, data);
+            polygon->clear();
+            free_allocation(polygon);
+        }
+        path_polygons.clear();
+    }
+
+    if (depth != 0) {
+        for (uint64_t i = 0; i < reference_array.count; i++) {
+            reference_array[i]->visit_polygons(apply_repetitions, include_paths,
+                                               depth > 0 ? depth - 1 : -1, filter, tag,
+                                               transformation, visit, data);
+        }
+    }
+}
+
+// Move polygon to the coordinates given by transformation, combining
+// repetition (already in those coordinates) into its own
+static void transform_repeated_polygon(Polygon* polygon, const Transformation& transformation,
+                                       const Repetition& repetition) {
+    Vec2* point = polygon->point_array.items;
+    for (uint64_t i = polygon->point_array.count; i > 0; i--, point++) {
+        *point = transformation.apply(*point);
+    }
+    polygon->repetition.transform(transformation.magnification, transformation.x_reflection,
+                                  transformation.rotation);
+    polygon->repetition.combine(repetition);
+}
+
+void Cell::get_repeated_polygons(bool include_paths, int64_t depth, bool filter, Tag tag,
+                                 const Transformation& transformation,
+                                 const Repetition& repetition, Array<Polygon*>& result) const {
+    uint64_t start = result.count;
+
+    for (uint64_t i = 0; i < polygon_array.count; i++) {
+        const Polygon* psrc = polygon_array[i];
+        if (filter && psrc->tag != tag) continue;
+        Polygon* polygon = (Polygon*)allocate_clear(sizeof(Polygon));
+        polygon->copy_from(*psrc);
+        result.append(polygon);
+    }
+
+    if (include_paths) {
+        for (uint64_t i = 0; i < flexpath_array.count; i++) {
+            // NOTE: return ErrorCode ignored here
+            flexpath_array[i]->to_polygons(filter, tag, result);
+        }
+        for (uint64_t i = 0; i < robustpath_array.count; i++) {
+            // NOTE: return ErrorCode ignored here
+            robustpath_array[i]->to_polygons(filter, tag, result);
+        }
+    }
+
+    for (uint64_t i = start; i < result.count; i++) {
+        transform_repeated_polygon(result[i], transformation, repetition);
+    }
+
+    if (depth != 0) {
+        for (uint64_t i = 0; i < reference_array.count; i++) {
+            reference_array[i]->get_repeated_polygons(include_paths, depth > 0 ? depth - 1 : -1,
+                                                      filter, tag, transformation, repetition,
+                                                      result);
+        }
+    }
+}
+
+void Cell::visit_instances(int64_t depth, const Transformation& transformation,
+                           InstanceVisitor visit, void* data) const {
+    if (depth == 0) return;
+    for (uint64_t i = 0; i < reference_array.count; i++) {
+        reference_array[i]->visit_instances(depth > 0 ? depth - 1 : -1, transformation, visit,
+                                            data);
+    }
+}
+
 void Cell::get_flexpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
                          Array<FlexPath*>& result) const {
     uint64_t start = result.count;
@@ -579,8 +760,10 @@ void Cell::get_labels(bool apply_repetitions, int64_t depth, bool filter, Tag ta
 }
 
 void Cell::flatten(bool apply_repetitions, Array<Reference*>& result) {
+    const uint64_t total = reference_array.count;
     uint64_t i = 0;
     while (i < reference_array.count) {
+        if (update_progress(total - reference_array.count + i, total)) return;
         Reference* ref = reference_array[i];
         if (ref->type == ReferenceType::Cell) {
             reference_array.remove_unordered(i);
@@ -593,6 +776,7 @@ void Cell::flatten(bool apply_repetitions, Array<Reference*>& result) {
             ++i;
         }
     }
+    update_progress(total, total);
 }
 
 void Cell::get_dependencies(bool recursive, Map<Cell*>& result) const {
@@ -624,6 +808,1233 @@ void Cell::get_raw_dependencies(bool recursive, Map<RawCell*>& result) const {
     }
 }
 
+void CellIndex::clear() {
+    tree.clear();
+    for (uint64_t i = 0; i < path_polygons.count; i++) {
+        path_polygons[i]->clear();
+        free_allocation(path_polygons[i]);
+    }
+    path_polygons.clear();
+}
+
+#define GDSTK_CELL_INDEX_KIND_SHIFT 56
+#define GDSTK_CELL_INDEX_POSITION_MASK 0x00FFFFFFFFFFFFFF
+
+static inline bool boxes_intersect(const Vec2 min0, const Vec2 max0, const Vec2 min1,
+                                   const Vec2 max1) {
+    return min0.x <= max1.x && max0.x >= min1.x && min0.y <= max1.y && max0.y >= min1.y;
+}
+
+// Bounding box of the points, without repetitions
+static void points_bounding_box(const Array<Vec2>& point_array, Vec2& min, Vec2& max) {
+    min.x = min.y = DBL_MAX;
+    max.x = max.y = -DBL_MAX;
+    Vec2* p = point_array.items;
+    for (uint64_t num = point_array.count; num > 0; num--, p++) {
+        if (p->x < min.x) min.x = p->x;
+        if (p->x > max.x) max.x = p->x;
+        if (p->y < min.y) min.y = p->y;
+        if (p->y > max.y) max.y = p->y;
+    }
+}
+
+// Bounding box of the box [cmin, cmax] transformed by reference (without its
+// repetition)
+static void transform_box(const Reference* reference, const Vec2 cmin, const Vec2 cmax, Vec2& min,
+                          Vec2& max) {
+    const double ca = cos(reference->rotation);
+    const double sa = sin(reference->rotation);
+    const Vec2 corners[] = {cmin, cmax, Vec2{cmin.x, cmax.y}, Vec2{cmax.x, cmin.y}};
+    min.x = min.y = DBL_MAX;
+    max.x = max.y = -DBL_MAX;
+    for (uint64_t i = 0; i < COUNT(corners); i++) {
+        Vec2 q = corners[i] * reference->magnification;
+        if (reference->x_reflection) q.y = -q.y;
+        const Vec2 p = {q.x * ca - q.y * sa + reference->origin.x,
+                        q.x * sa + q.y * ca + reference->origin.y};
+        if (p.x < min.x) min.x = p.x;
+        if (p.x > max.x) max.x = p.x;
+        if (p.y < min.y) min.y = p.y;
+        if (p.y > max.y) max.y = p.y;
+    }
+}
+
+// Bounding box of the indexed cell of reference, transformed by the reference
+// (without its repetition).  Returns false if there is nothing to index.
+static bool reference_bounding_box(const Reference* reference, Vec2& min, Vec2& max) {
+    if (reference->type != ReferenceType::Cell || reference->magnification == 0) return false;
+    const CellIndex* index = reference->cell->spatial_index;
+    Vec2 cmin, cmax;
+    if (!index || !index->tree.bounding_box(cmin, cmax)) return false;
+    transform_box(reference, cmin, cmax, min, max);
+    return true;
+}
+
+// Bounding box of the rectangle [min, max] in the coordinates of the cell of
+// reference, translated by offset
+static void reference_inverse_box(const Reference* reference, const Vec2 offset, const Vec2 min,
+                                  const Vec2 max, Vec2& result_min, Vec2& result_max) {
+    const double ca = cos(reference->rotation);
+    const double sa = sin(reference->rotation);
+    const double inv_mag = 1 / reference->magnification;
+    const Vec2 origin = reference->origin + offset;
+    const Vec2 corners[] = {min, max, Vec2{min.x, max.y}, Vec2{max.x, min.y}};
+    result_min.x = result_min.y = DBL_MAX;
+    result_max.x = result_max.y = -DBL_MAX;
+    for (uint64_t i = 0; i < COUNT(corners); i++) {
+        const Vec2 v = corners[i] - origin;
+        Vec2 p = Vec2{v.x * ca + v.y * sa, v.y * ca - v.x * sa} * inv_mag;
+        if (reference->x_reflection) p.y = -p.y;
+        if (p.x < result_min.x) result_min.x = p.x;
+        if (p.x > result_max.x) result_max.x = p.x;
+        if (p.y < result_min.y) result_min.y = p.y;
+        if (p.y > result_max.y) result_max.y = p.y;
+    }
+}
+
+// Candidate range [first, last) of the instances i of a one-dimensional
+// repetition for which [lo + i * step, hi + i * step] intersects [qlo, qhi].
+// The range is widened by one instance on each side to absorb rounding, so
+// candidates must still be tested.
+static void instance_range(double lo, double hi, double step, uint64_t count, double qlo,
+                           double qhi, uint64_t& first, uint64_t& last) {
+    first = 0;
+    last = count;
+    if (step == 0 || count == 0) return;
+    double a = (qlo - hi) / step;
+    double b = (qhi - lo) / step;
+    if (step < 0) {
+        double temp = a;
+        a = b;
+        b = temp;
+    }
+    a = floor(a) - 1;
+    b = ceil(b) + 1;
+    if (b < 0 || a >= (double)count) {
+        last = 0;
+        return;
+    }
+    if (a > 0) first = (uint64_t)a;
+    if (b < (double)count - 1) last = (uint64_t)b + 1;
+}
+
+// Append to result the offsets of the instances of repetition for which the
+// box [min + offset, max + offset] intersects [qmin, qmax]
+static void intersecting_offsets(const Repetition& repetition, const Vec2 min, const Vec2 max,
+                                 const Vec2 qmin, const Vec2 qmax, Array<Vec2>& result) {
+    switch (repetition.type) {
+        case RepetitionType::None:
+            if (boxes_intersect(min, max, qmin, qmax)) result.append(Vec2{0, 0});
+            break;
+        case RepetitionType::Rectangular: {
+            uint64_t first_column, last_column, first_row, last_row;
+            instance_range(min.x, max.x, repetition.spacing.x, repetition.columns, qmin.x,
+                           qmax.x, first_column, last_column);
+            instance_range(min.y, max.y, repetition.spacing.y, repetition.rows, qmin.y, qmax.y,
+                           first_row, last_row);
+            for (uint64_t i = first_column; i < last_column; i++) {
+                double cx = i * repetition.spacing.x;
+                for (uint64_t j = first_row; j < last_row; j++) {
+                    const Vec2 offset = {cx, j * repetition.spacing.y};
+                    if (boxes_intersect(min + offset, max + offset, qmin, qmax))
+                        result.append(offset);
+                }
+            }
+        } break;
+        default: {
+            Array<Vec2> offsets = {};
+            repetition.get_offsets(offsets);
+            Vec2* offset = offsets.items;
+            for (uint64_t i = offsets.count; i > 0; i--, offset++) {
+                if (boxes_intersect(min + *offset, max + *offset, qmin, qmax))
+                    result.append(*offset);
+            }
+            offsets.clear();
+        }
+    }
+}
+
+void Cell::clear_index() {
+    if (!spatial_index) return;
+    spatial_index->clear();
+    free_allocation(spatial_index);
+    spatial_index = NULL;
+}
+
+const CellIndex* Cell::get_index() {
+    if (spatial_index) return spatial_index;
+    spatial_index = (CellIndex*)allocate_clear(sizeof(CellIndex));
+    TraceSpan span("cell:index");
+    CellIndex* index = spatial_index;
+
+    FlexPath** flexpath = flexpath_array.items;
+    for (uint64_t i = 0; i < flexpath_array.count; i++, flexpath++) {
+        // NOTE: return ErrorCode ignored here
+        (*flexpath)->to_polygons(false, 0, index->path_polygons);
+    }
+    RobustPath** robustpath = robustpath_array.items;
+    for (uint64_t i = 0; i < robustpath_array.count; i++, robustpath++) {
+        // NOTE: return ErrorCode ignored here
+        (*robustpath)->to_polygons(false, 0, index->path_polygons);
+    }
+
+    Array<RTreeEntry> entries = {};
+    entries.ensure_slots(polygon_array.count + index->path_polygons.count + label_array.count +
+                         reference_array.count);
+    RTreeEntry entry;
+    Vec2 pmin, pmax;
+    for (uint64_t i = 0; i < polygon_array.count; i++) {
+        polygon_array[i]->bounding_box(entry.min, entry.max);
+        if (entry.min.x > entry.max.x) continue;
+        entry.value = ((uint64_t)CellIndexKind::Polygon << GDSTK_CELL_INDEX_KIND_SHIFT) | i;
+        entries.append_unsafe(entry);
+        points_bounding_box(polygon_array[i]->point_array, pmin, pmax);
+        const double extent = (pmax - pmin).length();
+        if (extent > index->max_extent) index->max_extent = extent;
+    }
+    for (uint64_t i = 0; i < index->path_polygons.count; i++) {
+        index->path_polygons[i]->bounding_box(entry.min, entry.max);
+        if (entry.min.x > entry.max.x) continue;
+        entry.value = ((uint64_t)CellIndexKind::PathPolygon << GDSTK_CELL_INDEX_KIND_SHIFT) | i;
+        entries.append_unsafe(entry);
+        points_bounding_box(index->path_polygons[i]->point_array, pmin, pmax);
+        const double extent = (pmax - pmin).length();
+        if (extent > index->max_extent) index->max_extent = extent;
+    }
+    for (uint64_t i = 0; i < label_array.count; i++) {
+        label_array[i]->bounding_box(entry.min, entry.max);
+        entry.value = ((uint64_t)CellIndexKind::Label << GDSTK_CELL_INDEX_KIND_SHIFT) | i;
+        entries.append_unsafe(entry);
+    }
+    for (uint64_t i = 0; i < reference_array.count; i++) {
+        Reference* reference = reference_array[i];
+        if (reference->type == ReferenceType::Cell) reference->cell->get_index();
+        if (!reference_bounding_box(reference, entry.min, entry.max)) continue;
+        const double extent =
+            reference->cell->spatial_index->max_extent * fabs(reference->magnification);
+        if (extent > index->max_extent) index->max_extent = extent;
+        if (reference->repetition.type != RepetitionType::None) {
+            Array<Vec2> offsets = {};
+            reference->repetition.get_extrema(offsets);
+            const Vec2 min0 = entry.min;
+            const Vec2 max0 = entry.max;
+            Vec2* off = offsets.items;
+            for (uint64_t j = offsets.count; j > 0; j--, off++) {
+                if (min0.x + off->x < entry.min.x) entry.min.x = min0.x + off->x;
+                if (max0.x + off->x > entry.max.x) entry.max.x = max0.x + off->x;
+                if (min0.y + off->y < entry.min.y) entry.min.y = min0.y + off->y;
+                if (max0.y + off->y > entry.max.y) entry.max.y = max0.y + off->y;
+            }
+            offsets.clear();
+        }
+        entry.value = ((uint64_t)CellIndexKind::Reference << GDSTK_CELL_INDEX_KIND_SHIFT) | i;
+        entries.append_unsafe(entry);
+    }
+
+    index->tree.build(entries);
+    return index;
+}
+
+void Cell::query(const Vec2 min, const Vec2 max, const Set<Tag>* tags, int64_t depth,
+                 Array<Polygon*>& polygons, Array<Label*>& labels) {
+    const CellIndex* index = get_index();
+
+    Array<uint64_t> hits = {};
+    index->tree.search(min, max, hits);
+
+    Array<Vec2> offsets = {};
+    uint64_t* hit = hits.items;
+    for (uint64_t h = hits.count; h > 0; h--, hit++) {
+        const CellIndexKind kind = (CellIndexKind)(*hit >> GDSTK_CELL_INDEX_KIND_SHIFT);
+        const uint64_t position = *hit & GDSTK_CELL_INDEX_POSITION_MASK;
+        offsets.count = 0;
+        switch (kind) {
+            case CellIndexKind::Polygon:
+            case CellIndexKind::PathPolygon: {
+                const Polygon* src = kind == CellIndexKind::Polygon
+                                         ? polygon_array[position]
+                                         : index->path_polygons[position];
+                if (tags && !tags->has_value(src->tag)) continue;
+                Vec2 pmin, pmax;
+                points_bounding_box(src->point_array, pmin, pmax);
+                intersecting_offsets(src->repetition, pmin, pmax, min, max, offsets);
+                polygons.ensure_slots(offsets.count);
+                for (uint64_t i = 0; i < offsets.count; i++) {
+                    Polygon* poly = (Polygon*)allocate_clear(sizeof(Polygon));
+                    poly->copy_from(*src);
+                    poly->repetition.clear();
+                    poly->translate(offsets[i]);
+                    polygons.append_unsafe(poly);
+                }
+            } break;
+            case CellIndexKind::Label: {
+                const Label* src = label_array[position];
+                if (tags && !tags->has_value(src->tag)) continue;
+                intersecting_offsets(src->repetition, src->origin, src->origin, min, max,
+                                     offsets);
+                labels.ensure_slots(offsets.count);
+                for (uint64_t i = 0; i < offsets.count; i++) {
+                    Label* label = (Label*)allocate_clear(sizeof(Label));
+                    label->copy_from(*src);
+                    label->repetition.clear();
+                    label->origin += offsets[i];
+                    labels.append_unsafe(label);
+                }
+            } break;
+            case CellIndexKind::Reference: {
+                if (depth == 0) continue;
+                const Reference* reference = reference_array[position];
+                Vec2 rmin, rmax;
+                if (!reference_bounding_box(reference, rmin, rmax)) continue;
+                intersecting_offsets(reference->repetition, rmin, rmax, min, max, offsets);
+
+                // For arbitrary rotations, the bounding box of a transformed
+                // polygon can reach the window while its bounding box in cell
+                // coordinates misses the transformed window.  Such a polygon
+                // comes closer to the window than the diagonal of its
+                // transformed bounding box, at most sqrt(2) times its
+                // diameter, so the window is grown by that much and the
+                // results are tested again after transformation.
+                int64_t m;
+                const bool exact = is_multiple_of_pi_over_2(reference->rotation, m);
+                const double grow =
+                    exact ? 0 : M_SQRT2 * reference->cell->spatial_index->max_extent;
+                for (uint64_t i = 0; i < offsets.count; i++) {
+                    const Vec2 offset = offsets[i];
+                    Vec2 cmin, cmax;
+                    reference_inverse_box(reference, offset, min, max, cmin, cmax);
+                    cmin.x -= grow;
+                    cmin.y -= grow;
+                    cmax.x += grow;
+                    cmax.y += grow;
+                    const uint64_t polygons_start = polygons.count;
+                    const uint64_t labels_start = labels.count;
+                    reference->cell->query(cmin, cmax, tags, depth > 0 ? depth - 1 : -1, polygons,
+                                           labels);
+
+                    const Vec2 origin = reference->origin + offset;
+                    uint64_t count = polygons_start;
+                    for (uint64_t j = polygons_start; j < polygons.count; j++) {
+                        Polygon* poly = polygons[j];
+                        poly->transform(reference->magnification, reference->x_reflection,
+                                        reference->rotation, origin);
+                        if (!exact) {
+                            Vec2 pmin, pmax;
+                            points_bounding_box(poly->point_array, pmin, pmax);
+                            if (!boxes_intersect(pmin, pmax, min, max)) {
+                                poly->clear();
+                                free_allocation(poly);
+                                continue;
+                            }
+                        }
+                        polygons[count++] = poly;
+                    }
+                    polygons.count = count;
+
+                    count = labels_start;
+                    for (uint64_t j = labels_start; j < labels.count; j++) {
+                        Label* label = labels[j];
+                        label->transform(reference->magnification, reference->x_reflection,
+                                         reference->rotation, origin);
+                        if (!exact &&
+                            !boxes_intersect(label->origin, label->origin, min, max)) {
+                            label->clear();
+                            free_allocation(label);
+                            continue;
+                        }
+                        labels[count++] = label;
+                    }
+                    labels.count = count;
+                }
+            } break;
+        }
+    }
+    offsets.clear();
+    hits.clear();
+}
+
+// United shapes of a cell with a given tag, used by Cell::area
+struct TagPolygons {
+    Tag tag;
+    Array<Polygon*> polygons;
+};
+
+// Information about a cell gathered (once) by Cell::area
+struct CellArea {
+    // Polygonal representation of the cell paths
+    Array<Polygon*> path_polygons;
+    // Sum of the shape areas per tag, including referenced cells
+    Array<TagArea> areas;
+    // Area of the union of the shapes per tag (exact mode only)
+    Array<TagArea> exact_areas;
+    // United shapes per tag, in cell coordinates (exact mode only, when
+    // shapes overlap)
+    Array<TagPolygons> unions;
+};
+
+struct AreaContext {
+    Map<CellArea*> cells;
+    Map<GeometryInfo> geometry;
+    double scaling;
+    ErrorCode error;
+};
+
+static void add_tag_area(Array<TagArea>& areas, Tag tag, double area) {
+    TagArea* item = areas.items;
+    for (uint64_t i = areas.count; i > 0; i--, item++) {
+        if (item->tag == tag) {
+            item->area += area;
+            return;
+        }
+    }
+    areas.append(TagArea{tag, area});
+}
+
+static bool find_tag_area(const Array<TagArea>& areas, Tag tag, double& area) {
+    const TagArea* item = areas.items;
+    for (uint64_t i = areas.count; i > 0; i--, item++) {
+        if (item->tag == tag) {
+            area = item->area;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint64_t instance_count(const Repetition& repetition) {
+    return repetition.type == RepetitionType::None ? 1 : repetition.get_count();
+}
+
+static void instance_offsets(const Repetition& repetition, Array<Vec2>& offsets) {
+    if (repetition.type == RepetitionType::None) {
+        offsets.append(Vec2{0, 0});
+    } else {
+        repetition.get_offsets(offsets);
+    }
+}
+
+// Copy of the points of polygon translated by offset
+static Polygon* shape_copy(const Polygon* polygon, const Vec2 offset) {
+    Polygon* result = (Polygon*)allocate_clear(sizeof(Polygon));
+    result->point_array.ensure_slots(polygon->point_array.count);
+    const Vec2* src = polygon->point_array.items;
+    Vec2* dst = result->point_array.items;
+    for (uint64_t i = polygon->point_array.count; i > 0; i--) *dst++ = *src++ + offset;
+    result->point_array.count = polygon->point_array.count;
+    return result;
+}
+
+static CellArea* get_cell_area(const Cell* cell, AreaContext& context) {
+    CellArea* info = context.cells.get(cell->name);
+    if (info) return info;
+    info = (CellArea*)allocate_clear(sizeof(CellArea));
+    context.cells.set(cell->name, info);
+
+    FlexPath** flexpath = cell->flexpath_array.items;
+    for (uint64_t i = 0; i < cell->flexpath_array.count; i++, flexpath++) {
+        // NOTE: return ErrorCode ignored here
+        (*flexpath)->to_polygons(false, 0, info->path_polygons);
+    }
+    RobustPath** robustpath = cell->robustpath_array.items;
+    for (uint64_t i = 0; i < cell->robustpath_array.count; i++, robustpath++) {
+        // NOTE: return ErrorCode ignored here
+        (*robustpath)->to_polygons(false, 0, info->path_polygons);
+    }
+
+    for (uint64_t i = 0; i < cell->polygon_array.count; i++) {
+        const Polygon* polygon = cell->polygon_array[i];
+        // Polygon::area includes the repetition
+        add_tag_area(info->areas, polygon->tag, polygon->area());
+    }
+    for (uint64_t i = 0; i < info->path_polygons.count; i++) {
+        const Polygon* polygon = info->path_polygons[i];
+        // Polygon::area includes the repetition
+        add_tag_area(info->areas, polygon->tag, polygon->area());
+    }
+    for (uint64_t i = 0; i < cell->reference_array.count; i++) {
+        const Reference* reference = cell->reference_array[i];
+        if (reference->type != ReferenceType::Cell) continue;
+        const CellArea* child = get_cell_area(reference->cell, context);
+        const double factor = instance_count(reference->repetition) * reference->magnification *
+                              reference->magnification;
+        const TagArea* item = child->areas.items;
+        for (uint64_t j = child->areas.count; j > 0; j--, item++) {
+            add_tag_area(info->areas, item->tag, factor * item->area);
+        }
+    }
+    return info;
+}
+
+// Append the boxes of all instances of polygon to boxes
+static void polygon_instance_boxes(const Polygon* polygon, Array<Vec2>& offsets,
+                                   Array<RTreeEntry>& boxes) {
+    RTreeEntry entry;
+    polygon->bounding_box(entry.min, entry.max);
+    offsets.count = 0;
+    instance_offsets(polygon->repetition, offsets);
+    boxes.ensure_slots(offsets.count);
+    for (uint64_t i = 0; i < offsets.count; i++) {
+        const Vec2 offset = offsets[i];
+        boxes.append_unsafe(RTreeEntry{entry.min + offset, entry.max + offset, 0});
+    }
+}
+
+// Append the boxes of all instances of reference, whose cell has bounding box
+// [cmin, cmax], to boxes.  Rectangular repetitions are appended as a single
+// box, because their instances can be checked directly.  Return false if
+// instances overlap each other.
+static bool reference_instance_boxes(const Reference* reference, const Vec2 cmin,
+                                     const Vec2 cmax, Array<Vec2>& offsets,
+                                     Array<RTreeEntry>& boxes) {
+    RTreeEntry entry;
+    transform_box(reference, cmin, cmax, entry.min, entry.max);
+    const Repetition& repetition = reference->repetition;
+    offsets.count = 0;
+    if (repetition.type == RepetitionType::Rectangular) {
+        if ((repetition.columns > 1 && fabs(repetition.spacing.x) < entry.max.x - entry.min.x) ||
+            (repetition.rows > 1 && fabs(repetition.spacing.y) < entry.max.y - entry.min.y))
+            return false;
+        repetition.get_extrema(offsets);
+        const Vec2 min0 = entry.min;
+        const Vec2 max0 = entry.max;
+        Vec2* off = offsets.items;
+        for (uint64_t i = offsets.count; i > 0; i--, off++) {
+            if (min0.x + off->x < entry.min.x) entry.min.x = min0.x + off->x;
+            if (max0.x + off->x > entry.max.x) entry.max.x = max0.x + off->x;
+            if (min0.y + off->y < entry.min.y) entry.min.y = min0.y + off->y;
+            if (max0.y + off->y > entry.max.y) entry.max.y = max0.y + off->y;
+        }
+        boxes.append(entry);
+        return true;
+    }
+    instance_offsets(repetition, offsets);
+    boxes.ensure_slots(offsets.count);
+    for (uint64_t i = 0; i < offsets.count; i++) {
+        const Vec2 offset = offsets[i];
+        boxes.append_unsafe(RTreeEntry{entry.min + offset, entry.max + offset, 0});
+    }
+    return true;
+}
+
+// True if the interiors of any 2 boxes intersect (touching boxes do not
+// overlap)
+static bool boxes_overlap(const Array<RTreeEntry>& boxes) {
+    if (boxes.count < 2) return false;
+    Array<RTreeEntry> entries = {};
+    entries.copy_from(boxes);
+    for (uint64_t i = 0; i < entries.count; i++) entries[i].value = i;
+    RTree tree = {};
+    tree.build(entries);
+
+    bool result = false;
+    Array<uint64_t> candidates = {};
+    for (uint64_t i = 0; i < boxes.count && !result; i++) {
+        const RTreeEntry box = boxes[i];
+        candidates.count = 0;
+        tree.search(box.min, box.max, candidates);
+        for (uint64_t j = 0; j < candidates.count; j++) {
+            if (candidates[j] == i) continue;
+            const RTreeEntry other = boxes[candidates[j]];
+            if (other.min.x < box.max.x && other.max.x > box.min.x && other.min.y < box.max.y &&
+                other.max.y > box.min.y) {
+                result = true;
+                break;
+            }
+        }
+    }
+    candidates.clear();
+    tree.clear();
+    return result;
+}
+
+// Union of all shapes with tag in cell (including referenced cells)
+static Array<Polygon*> united_shapes(const Cell* cell, Tag tag, AreaContext& context) {
+    CellArea* info = get_cell_area(cell, context);
+    for (uint64_t i = 0; i < info->unions.count; i++) {
+        if (info->unions[i].tag == tag) return info->unions[i].polygons;
+    }
+
+    Array<Polygon*> shapes = {};
+    Array<Vec2> offsets = {};
+    const Array<Polygon*>* own[] = {&cell->polygon_array, &info->path_polygons};
+    for (uint64_t k = 0; k < COUNT(own); k++) {
+        for (uint64_t i = 0; i < own[k]->count; i++) {
+            const Polygon* polygon = own[k]->items[i];
+            if (polygon->tag != tag) continue;
+            offsets.count = 0;
+            instance_offsets(polygon->repetition, offsets);
+            shapes.ensure_slots(offsets.count);
+            for (uint64_t j = 0; j < offsets.count; j++) {
+                shapes.append_unsafe(shape_copy(polygon, offsets[j]));
+            }
+        }
+    }
+    for (uint64_t i = 0; i < cell->reference_array.count; i++) {
+        const Reference* reference = cell->reference_array[i];
+        if (reference->type != ReferenceType::Cell) continue;
+        double area;
+        if (!find_tag_area(get_cell_area(reference->cell, context)->areas, tag, area)) continue;
+        const Array<Polygon*> child_shapes = united_shapes(reference->cell, tag, context);
+        offsets.count = 0;
+        instance_offsets(reference->repetition, offsets);
+        shapes.ensure_slots(offsets.count * child_shapes.count);
+        for (uint64_t j = 0; j < offsets.count; j++) {
+            const Vec2 origin = reference->origin + offsets[j];
+            for (uint64_t h = 0; h < child_shapes.count; h++) {
+                Polygon* polygon = shape_copy(child_shapes[h], Vec2{0, 0});
+                polygon->transform(reference->magnification, reference->x_reflection,
+                                   reference->rotation, origin);
+                shapes.append_unsafe(polygon);
+            }
+        }
+    }
+    offsets.clear();
+
+    TagPolygons united = {tag, {}};
+    const Array<Polygon*> empty = {};
+    ErrorCode error_code = boolean(shapes, empty, Operation::Or, context.scaling, united.polygons);
+    if (error_code != ErrorCode::NoError) context.error = error_code;
+    for (uint64_t i = 0; i < shapes.count; i++) {
+        shapes[i]->clear();
+        free_allocation(shapes[i]);
+    }
+    shapes.clear();
+    info->unions.append(united);
+    return united.polygons;
+}
+
+// Area of the union of all shapes with tag in cell.  Shapes are only united
+// when they overlap; otherwise the exact areas of the referenced cells are
+// simply added up.
+static double exact_area(const Cell* cell, Tag tag, AreaContext& context) {
+    CellArea* info = get_cell_area(cell, context);
+    double area = 0;
+    if (find_tag_area(info->exact_areas, tag, area)) return area;
+    if (!find_tag_area(info->areas, tag, area)) return 0;
+
+    double sum = 0;
+    bool overlap = false;
+    Array<RTreeEntry> boxes = {};
+    Array<Vec2> offsets = {};
+    const Array<Polygon*>* own[] = {&cell->polygon_array, &info->path_polygons};
+    for (uint64_t k = 0; k < COUNT(own); k++) {
+        for (uint64_t i = 0; i < own[k]->count; i++) {
+            const Polygon* polygon = own[k]->items[i];
+            if (polygon->tag != tag) continue;
+            sum += polygon->area();
+            polygon_instance_boxes(polygon, offsets, boxes);
+        }
+    }
+    for (uint64_t i = 0; i < cell->reference_array.count; i++) {
+        const Reference* reference = cell->reference_array[i];
+        if (reference->type != ReferenceType::Cell) continue;
+        double child_area;
+        if (!find_tag_area(get_cell_area(reference->cell, context)->areas, tag, child_area))
+            continue;
+        child_area = exact_area(reference->cell, tag, context);
+        sum += child_area * instance_count(reference->repetition) * reference->magnification *
+               reference->magnification;
+        if (!overlap) {
+            GeometryInfo geometry = reference->cell->bounding_box(context.geometry);
+            overlap = !reference_instance_boxes(reference, geometry.bounding_box_min,
+                                                geometry.bounding_box_max, offsets, boxes);
+        }
+    }
+    offsets.clear();
+    if (!overlap) overlap = boxes_overlap(boxes);
+    boxes.clear();
+
+    if (overlap) {
+        const Array<Polygon*> shapes = united_shapes(cell, tag, context);
+        area = 0;
+        for (uint64_t i = 0; i < shapes.count; i++) area += shapes[i]->area();
+    } else {
+        area = sum;
+    }
+    info->exact_areas.append(TagArea{tag, area});
+    return area;
+}
+
+ErrorCode Cell::area(bool exact, double scaling, Array<TagArea>& result) const {
+    TraceSpan span("cell:area");
+    AreaContext context = {};
+    context.scaling = scaling;
+    const CellArea* info = get_cell_area(this, context);
+    if (exact) {
+        result.ensure_slots(info->areas.count);
+        for (uint64_t i = 0; i < info->areas.count; i++) {
+            const Tag tag = info->areas[i].tag;
+            result.append_unsafe(TagArea{tag, exact_area(this, tag, context)});
+        }
+    } else {
+        result.extend(info->areas);
+    }
+
+    for (MapItem<CellArea*>* item = context.cells.next(NULL); item;
+         item = context.cells.next(item)) {
+        CellArea* cell_area = item->value;
+        for (uint64_t i = 0; i < cell_area->path_polygons.count; i++) {
+            cell_area->path_polygons[i]->clear();
+            free_allocation(cell_area->path_polygons[i]);
+        }
+        cell_area->path_polygons.clear();
+        cell_area->areas.clear();
+        cell_area->exact_areas.clear();
+        for (uint64_t i = 0; i < cell_area->unions.count; i++) {
+            Array<Polygon*>& polygons = cell_area->unions[i].polygons;
+            for (uint64_t j = 0; j < polygons.count; j++) {
+                polygons[j]->clear();
+                free_allocation(polygons[j]);
+            }
+            polygons.clear();
+        }
+        cell_area->unions.clear();
+        free_allocation(cell_area);
+    }
+    context.cells.clear();
+    for (MapItem<GeometryInfo>* item = context.geometry.next(NULL); item;
+         item = context.geometry.next(item)) {
+        item->value.clear();
+    }
+    context.geometry.clear();
+    return context.error;
+}
+
+// Operation and intermediate results of Cell::boolean_tags and
+// Cell::offset_tag for a cell
+struct LayerResult {
+    // Polygonal representation of the cell paths with the operation tags
+    Array<Polygon*> path_polygons;
+    // Bounding box of the shapes with the operation tags, including
+    // referenced cells (empty if min.x > max.x)
+    Vec2 min;
+    Vec2 max;
+    // Result of the operation in cell coordinates, valid once computed
+    bool computed;
+    Array<Polygon*> polygons;
+};
+
+struct LayerContext {
+    Map<LayerResult*> cells;
+    Tag tag1;
+    Tag tag2;
+    // Offset of the shapes with tag1 instead of a boolean operation
+    bool offset;
+    Operation operation;
+    double distance;
+    OffsetJoin join;
+    double tolerance;
+    double scaling;
+    ErrorCode error;
+};
+
+// Part of a cell handled as a unit by layer_operation: the shapes of the cell
+// itself (reference == NULL) or a single instance of a reference
+struct LayerComponent {
+    const Reference* reference;
+    Vec2 offset;
+    // Union-find parent: components whose boxes overlap end up in the same
+    // group
+    uint64_t group;
+    // All instances of a rectangular array of disjoint instances (offset is
+    // not used)
+    bool array;
+};
+
+static inline bool has_layer_tag(Tag tag, const LayerContext& context) {
+    return tag == context.tag1 || (!context.offset && tag == context.tag2);
+}
+
+// The result of the referenced cell can be copied to the instances of
+// reference, unless the reference would scale the offset distance
+static inline bool reuse_result(const Reference* reference, const LayerContext& context) {
+    return !context.offset || reference->magnification == 1;
+}
+
+static inline void expand_box(const Vec2 min, const Vec2 max, Vec2& result_min, Vec2& result_max) {
+    if (min.x < result_min.x) result_min.x = min.x;
+    if (min.y < result_min.y) result_min.y = min.y;
+    if (max.x > result_max.x) result_max.x = max.x;
+    if (max.y > result_max.y) result_max.y = max.y;
+}
+
+static LayerResult* get_layer_result(const Cell* cell, LayerContext& context) {
+    LayerResult* info = context.cells.get(cell->name);
+    if (info) return info;
+    info = (LayerResult*)allocate_clear(sizeof(LayerResult));
+    context.cells.set(cell->name, info);
+
+    const Tag tags[] = {context.tag1, context.tag2};
+    const uint64_t num_tags = context.offset || context.tag1 == context.tag2 ? 1 : 2;
+    for (uint64_t k = 0; k < num_tags; k++) {
+        FlexPath** flexpath = cell->flexpath_array.items;
+        for (uint64_t i = 0; i < cell->flexpath_array.count; i++, flexpath++) {
+            // NOTE: return ErrorCode ignored here
+            (*flexpath)->to_polygons(true, tags[k], info->path_polygons);
+        }
+        RobustPath** robustpath = cell->robustpath_array.items;
+        for (uint64_t i = 0; i < cell->robustpath_array.count; i++, robustpath++) {
+            // NOTE: return ErrorCode ignored here
+            (*robustpath)->to_polygons(true, tags[k], info->path_polygons);
+        }
+    }
+
+    info->min.x = info->min.y = DBL_MAX;
+    info->max.x = info->max.y = -DBL_MAX;
+    Vec2 min, max;
+    const Array<Polygon*>* own[] = {&cell->polygon_array, &info->path_polygons};
+    for (uint64_t k = 0; k < COUNT(own); k++) {
+        for (uint64_t i = 0; i < own[k]->count; i++) {
+            const Polygon* polygon = own[k]->items[i];
+            if (!has_layer_tag(polygon->tag, context)) continue;
+            polygon->bounding_box(min, max);
+            expand_box(min, max, info->min, info->max);
+        }
+    }
+    Array<Vec2> offsets = {};
+    for (uint64_t i = 0; i < cell->reference_array.count; i++) {
+        const Reference* reference = cell->reference_array[i];
+        if (reference->type != ReferenceType::Cell) continue;
+        const LayerResult* child = get_layer_result(reference->cell, context);
+        if (child->min.x > child->max.x) continue;
+        transform_box(reference, child->min, child->max, min, max);
+        offsets.count = 0;
+        if (reference->repetition.type == RepetitionType::None) {
+            offsets.append(Vec2{0, 0});
+        } else {
+            reference->repetition.get_extrema(offsets);
+        }
+        for (uint64_t j = 0; j < offsets.count; j++) {
+            expand_box(min + offsets[j], max + offsets[j], info->min, info->max);
+        }
+    }
+    offsets.clear();
+    return info;
+}
+
+static uint64_t find_group(LayerComponent* components, uint64_t i) {
+    while (components[i].group != i) {
+        components[i].group = components[components[i].group].group;
+        i = components[i].group;
+    }
+    return i;
+}
+
+struct GroupMember {
+    uint64_t group;
+    uint64_t index;
+};
+
+static bool group_member_sorted(const GroupMember& a, const GroupMember& b) {
+    return a.group < b.group || (a.group == b.group && a.index < b.index);
+}
+
+// Append copies of the shapes of cell with tag to shapes
+static void append_own_shapes(const Cell* cell, const LayerResult* info, Tag tag,
+                              Array<Polygon*>& shapes) {
+    Array<Vec2> offsets = {};
+    const Array<Polygon*>* own[] = {&cell->polygon_array, &info->path_polygons};
+    for (uint64_t k = 0; k < COUNT(own); k++) {
+        for (uint64_t i = 0; i < own[k]->count; i++) {
+            const Polygon* polygon = own[k]->items[i];
+            if (polygon->tag != tag) continue;
+            offsets.count = 0;
+            instance_offsets(polygon->repetition, offsets);
+            shapes.ensure_slots(offsets.count);
+            for (uint64_t j = 0; j < offsets.count; j++) {
+                shapes.append_unsafe(shape_copy(polygon, offsets[j]));
+            }
+        }
+    }
+    offsets.clear();
+}
+
+// Append copies of polygons transformed to a component instance
+static void append_instance_copies(const LayerComponent& component,
+                                   const Array<Polygon*>& polygons, Array<Polygon*>& result) {
+    const Reference* reference = component.reference;
+    const Vec2 origin = reference->origin + component.offset;
+    result.ensure_slots(polygons.count);
+    for (uint64_t i = 0; i < polygons.count; i++) {
+        Polygon* polygon = shape_copy(polygons[i], Vec2{0, 0});
+        polygon->transform(reference->magnification, reference->x_reflection, reference->rotation,
+                           origin);
+        result.append_unsafe(polygon);
+    }
+}
+
+// Append the flattened shapes of a component instance with tag to shapes
+static void append_instance_shapes(const LayerComponent& component, Tag tag,
+                                   Array<Polygon*>& shapes) {
+    const Reference* reference = component.reference;
+    if (reference->type != ReferenceType::Cell) return;
+    const Transformation transformation =
+        identity_transformation().compose(*reference, component.offset);
+    reference->cell->visit_polygons(true, true, -1, true, tag, transformation,
+                                    append_transformed_polygon, &shapes);
+}
+
+static void free_polygons(Array<Polygon*>& polygons) {
+    for (uint64_t i = 0; i < polygons.count; i++) {
+        polygons[i]->clear();
+        free_allocation(polygons[i]);
+    }
+    polygons.clear();
+}
+
+static const Array<Polygon*>& layer_operation(const Cell* cell, LayerContext& context);
+
+// Apply the operation to the union of the components members[0, count) of
+// cell and append the polygons to result
+static void group_operation(const Cell* cell, const LayerResult* info,
+                            const LayerComponent* components, const GroupMember* members,
+                            uint64_t count, LayerContext& context, Array<Polygon*>& result) {
+    Array<Polygon*> operand1 = {};
+    Array<Polygon*> operand2 = {};
+    // A union can be assembled from the results of the referenced cells
+    const bool unite = !context.offset && context.operation == Operation::Or;
+    for (uint64_t i = 0; i < count; i++) {
+        const LayerComponent& component = components[members[i].index];
+        if (!component.reference) {
+            append_own_shapes(cell, info, context.tag1, operand1);
+            if (!context.offset && !(unite && context.tag2 == context.tag1))
+                append_own_shapes(cell, info, context.tag2, unite ? operand1 : operand2);
+        } else if (unite) {
+            append_instance_copies(component, layer_operation(component.reference->cell, context),
+                                   operand1);
+        } else {
+            append_instance_shapes(component, context.tag1, operand1);
+            if (!context.offset) append_instance_shapes(component, context.tag2, operand2);
+        }
+    }
+
+    ErrorCode error_code;
+    if (context.offset) {
+        error_code = offset(operand1, context.distance, context.join, context.tolerance,
+                            context.scaling, true, result);
+    } else {
+        error_code = boolean(operand1, operand2, context.operation, context.scaling, result);
+    }
+    if (error_code != ErrorCode::NoError) context.error = error_code;
+    free_polygons(operand1);
+    free_polygons(operand2);
+}
+
+// Append the components of cell to components and their boxes to boxes.
+// Rectangular arrays of disjoint instances are added as a single component,
+// unless their reference is marked in expand or their results are not reused.
+static void layer_components(const Cell* cell, const LayerResult* info, LayerContext& context, const Array<bool>& expand,
+                             Array<LayerComponent>& components, Array<RTreeEntry>& boxes) {
+    const double m = context.offset ? fabs(context.distance) : 0;
+    const Vec2 margin = {m, m};
+
+    Vec2 min = {DBL_MAX, DBL_MAX};
+    Vec2 max = {-DBL_MAX, -DBL_MAX};
+    Vec2 pmin, pmax;
+    const Array<Polygon*>* own[] = {&cell->polygon_array, &info->path_polygons};
+    for (uint64_t k = 0; k < COUNT(own); k++) {
+        for (uint64_t i = 0; i < own[k]->count; i++) {
+            const Polygon* polygon = own[k]->items[i];
+            if (!has_layer_tag(polygon->tag, context)) continue;
+            polygon->bounding_box(pmin, pmax);
+            expand_box(pmin, pmax, min, max);
+        }
+    }
+    if (min.x <= max.x) {
+        components.append(LayerComponent{NULL, Vec2{0, 0}, 0, false});
+        boxes.append(RTreeEntry{min - margin, max + margin, 0});
+    }
+
+    Array<Vec2> offsets = {};
+    for (uint64_t i = 0; i < cell->reference_array.count; i++) {
+        const Reference* reference = cell->reference_array[i];
+        if (reference->type != ReferenceType::Cell) continue;
+        const LayerResult* child = get_layer_result(reference->cell, context);
+        if (child->min.x > child->max.x) continue;
+        transform_box(reference, child->min, child->max, min, max);
+        min = min - margin;
+        max = max + margin;
+        const Repetition& repetition = reference->repetition;
+        if (!expand[i] && reuse_result(reference, context) &&
+            repetition.type == RepetitionType::Rectangular &&
+            (repetition.columns == 1 || fabs(repetition.spacing.x) >= max.x - min.x) &&
+            (repetition.rows == 1 || fabs(repetition.spacing.y) >= max.y - min.y)) {
+            offsets.count = 0;
+            repetition.get_extrema(offsets);
+            Vec2 amin = min;
+            Vec2 amax = max;
+            for (uint64_t j = 0; j < offsets.count; j++) {
+                expand_box(min + offsets[j], max + offsets[j], amin, amax);
+            }
+            const uint64_t index = components.count;
+            components.append(LayerComponent{reference, Vec2{0, 0}, index, true});
+            boxes.append(RTreeEntry{amin, amax, index});
+            continue;
+        }
+        offsets.count = 0;
+        instance_offsets(repetition, offsets);
+        components.ensure_slots(offsets.count);
+        boxes.ensure_slots(offsets.count);
+        for (uint64_t j = 0; j < offsets.count; j++) {
+            const uint64_t index = components.count;
+            components.append_unsafe(LayerComponent{reference, offsets[j], index, false});
+            boxes.append_unsafe(RTreeEntry{min + offsets[j], max + offsets[j], index});
+        }
+    }
+    offsets.clear();
+}
+
+// Merge the groups of components whose box interiors intersect
+static void group_components(Array<LayerComponent>& components, const Array<RTreeEntry>& boxes) {
+    if (components.count < 2) return;
+    Array<RTreeEntry> entries = {};
+    entries.copy_from(boxes);
+    RTree tree = {};
+    tree.build(entries);
+    Array<uint64_t> candidates = {};
+    for (uint64_t i = 0; i < boxes.count; i++) {
+        const RTreeEntry box = boxes[i];
+        candidates.count = 0;
+        tree.search(box.min, box.max, candidates);
+        for (uint64_t j = 0; j < candidates.count; j++) {
+            const RTreeEntry other = boxes[candidates[j]];
+            if (candidates[j] == i || other.min.x >= box.max.x || other.max.x <= box.min.x ||
+                other.min.y >= box.max.y || other.max.y <= box.min.y)
+                continue;
+            const uint64_t a = find_group(components.items, i);
+            const uint64_t b = find_group(components.items, candidates[j]);
+            if (a != b) components[a > b ? a : b].group = a < b ? a : b;
+        }
+    }
+    candidates.clear();
+    tree.clear();
+}
+
+// Part of the result of layer_operation that reaches the sides of the box of
+// the component (or instance) it comes from: only those can touch the
+// results of other components
+struct SeamPolygon {
+    uint64_t index;
+    uint64_t source;
+};
+
+// Append to border the polygons result[first, result.count) that reach the
+// sides of [min, max] (up to a grid unit)
+static void append_border(const Array<Polygon*>& result, uint64_t first, const Vec2 min,
+                          const Vec2 max, uint64_t source, double scaling,
+                          Array<SeamPolygon>& border) {
+    const double unit = 1 / scaling;
+    Vec2 pmin, pmax;
+    for (uint64_t i = first; i < result.count; i++) {
+        result[i]->bounding_box(pmin, pmax);
+        if (pmin.x <= min.x + unit || pmin.y <= min.y + unit || pmax.x >= max.x - unit ||
+            pmax.y >= max.y - unit)
+            border.append(SeamPolygon{i, source});
+    }
+}
+
+// Results of separate components cover disjoint box interiors, but their
+// polygons may touch across the box sides.  Unite the border polygons whose
+// boxes meet the box of a border polygon from another source; all others are
+// kept as they are.
+static void merge_seams(Array<Polygon*>& result, const Array<SeamPolygon>& border,
+                        LayerContext& context) {
+    if (border.count < 2) return;
+    Array<RTreeEntry> entries = {};
+    entries.ensure_slots(border.count);
+    for (uint64_t i = 0; i < border.count; i++) {
+        RTreeEntry entry = {};
+        result[border[i].index]->bounding_box(entry.min, entry.max);
+        entry.value = i;
+        entries.append_unsafe(entry);
+    }
+    Array<RTreeEntry> boxes = {};
+    boxes.copy_from(entries);
+    RTree tree = {};
+    tree.build(entries);
+
+    Array<bool> seam = {};
+    seam.ensure_slots(result.count);
+    seam.count = result.count;
+    memset(seam.items, 0, seam.count * sizeof(bool));
+    uint64_t num_seams = 0;
+    Array<uint64_t> candidates = {};
+    for (uint64_t i = 0; i < border.count; i++) {
+        candidates.count = 0;
+        tree.search(boxes[i].min, boxes[i].max, candidates);
+        for (uint64_t j = 0; j < candidates.count; j++) {
+            if (border[candidates[j]].source != border[i].source) {
+                seam[border[i].index] = true;
+                num_seams++;
+                break;
+            }
+        }
+    }
+    candidates.clear();
+    tree.clear();
+    boxes.clear();
+
+    if (num_seams > 0) {
+        Array<Polygon*> fragments = {};
+        fragments.ensure_slots(num_seams);
+        uint64_t kept = 0;
+        for (uint64_t i = 0; i < result.count; i++) {
+            if (seam[i]) {
+                fragments.append_unsafe(result[i]);
+            } else {
+                result[kept++] = result[i];
+            }
+        }
+        result.count = kept;
+        Array<Polygon*> empty = {};
+        ErrorCode error_code = boolean(fragments, empty, Operation::Or, context.scaling, result);
+        if (error_code != ErrorCode::NoError) context.error = error_code;
+        free_polygons(fragments);
+    }
+    seam.clear();
+}
+
+static const Array<Polygon*>& layer_operation(const Cell* cell, LayerContext& context) {
+    LayerResult* info = get_layer_result(cell, context);
+    if (info->computed) return info->polygons;
+    info->computed = true;
+    if (info->min.x > info->max.x) return info->polygons;
+
+    // Arrays that overlap other components are split into their instances,
+    // so that only the overlapping instances are flattened
+    Array<bool> expand = {};
+    expand.ensure_slots(cell->reference_array.count);
+    expand.count = cell->reference_array.count;
+    memset(expand.items, 0, expand.count * sizeof(bool));
+    Array<LayerComponent> components = {};
+    Array<RTreeEntry> boxes = {};
+    bool split;
+    do {
+        components.count = 0;
+        boxes.count = 0;
+        layer_components(cell, info, context, expand, components, boxes);
+        group_components(components, boxes);
+        split = false;
+        for (uint64_t i = 0; i < components.count; i++) {
+            const uint64_t group = find_group(components.items, i);
+            if (group == i) continue;
+            const LayerComponent* pair[] = {components.items + i, components.items + group};
+            for (uint64_t k = 0; k < COUNT(pair); k++) {
+                if (!pair[k]->array) continue;
+                expand[cell->reference_array.index((Reference*)pair[k]->reference)] = true;
+                split = true;
+            }
+        }
+    } while (split);
+    expand.clear();
+
+    Array<GroupMember> members = {};
+    members.ensure_slots(components.count);
+    for (uint64_t i = 0; i < components.count; i++) {
+        members.append_unsafe(GroupMember{find_group(components.items, i), i});
+    }
+    sort(members, group_member_sorted);
+
+    const double m = context.offset ? fabs(context.distance) : 0;
+    const Vec2 margin = {m, m};
+    Array<Polygon*> result = {};
+    Array<SeamPolygon> border = {};
+    uint64_t source = 0;
+    Array<Vec2> offsets = {};
+    for (uint64_t i = 0; i < members.count;) {
+        uint64_t count = 1;
+        while (i + count < members.count && members[i + count].group == members[i].group)
+            count++;
+        LayerComponent component = components[members[i].index];
+        const uint64_t first = result.count;
+        if (count == 1 && component.reference && reuse_result(component.reference, context)) {
+            const Array<Polygon*>& polygons = layer_operation(component.reference->cell, context);
+            if (component.array) {
+                const LayerResult* child = get_layer_result(component.reference->cell, context);
+                Vec2 min, max;
+                transform_box(component.reference, child->min, child->max, min, max);
+                offsets.count = 0;
+                component.reference->repetition.get_offsets(offsets);
+                for (uint64_t j = 0; j < offsets.count; j++) {
+                    const uint64_t instance_first = result.count;
+                    component.offset = offsets[j];
+                    append_instance_copies(component, polygons, result);
+                    append_border(result, instance_first, min - margin + offsets[j],
+                                  max + margin + offsets[j], source++, context.scaling, border);
+                }
+            } else {
+                append_instance_copies(component, polygons, result);
+                const RTreeEntry box = boxes[members[i].index];
+                append_border(result, first, box.min, box.max, source++, context.scaling,
+                              border);
+            }
+        } else {
+            group_operation(cell, info, components.items, members.items + i, count, context,
+                            result);
+            Vec2 min = {DBL_MAX, DBL_MAX};
+            Vec2 max = {-DBL_MAX, -DBL_MAX};
+            for (uint64_t j = 0; j < count; j++) {
+                const RTreeEntry box = boxes[members[i + j].index];
+                expand_box(box.min, box.max, min, max);
+            }
+            append_border(result, first, min, max, source++, context.scaling, border);
+        }
+        i += count;
+    }
+    offsets.clear();
+    members.clear();
+    components.clear();
+    boxes.clear();
+    merge_seams(result, border, context);
+    border.clear();
+
+    info->polygons = result;
+    return info->polygons;
+}
+
+static ErrorCode hierarchical_layer_operation(const Cell* cell, LayerContext& context,
+                                              Array<Polygon*>& result) {
+    layer_operation(cell, context);
+    Array<Polygon*>& polygons = get_layer_result(cell, context)->polygons;
+    result.extend(polygons);
+    polygons.count = 0;
+
+    for (MapItem<LayerResult*>* item = context.cells.next(NULL); item;
+         item = context.cells.next(item)) {
+        LayerResult* info = item->value;
+        free_polygons(info->path_polygons);
+        free_polygons(info->polygons);
+        free_allocation(info);
+    }
+    context.cells.clear();
+    return context.error;
+}
+
+ErrorCode Cell::boolean_tags(Tag tag1, Tag tag2, Operation operation, double scaling,
+                             Array<Polygon*>& result) const {
+    TraceSpan span("cell:boolean_tags");
+    LayerContext context = {};
+    context.tag1 = tag1;
+    context.tag2 = tag2;
+    context.operation = operation;
+    context.scaling = scaling;
+    return hierarchical_layer_operation(this, context, result);
+}
+
+ErrorCode Cell::offset_tag(Tag tag, double distance, OffsetJoin join, double tolerance,
+                           double scaling, Array<Polygon*>& result) const {
+    TraceSpan span("cell:offset_tag");
+    LayerContext context = {};
+    context.tag1 = tag;
+    context.tag2 = tag;
+    context.offset = true;
+    context.distance = distance;
+    context.join = join;
+    context.tolerance = tolerance;
+    context.scaling = scaling;
+    return hierarchical_layer_operation(this, context, result);
+}
+
 void Cell::get_shape_tags(Set<Tag>& result) const {
     for (uint64_t i = 0; i < polygon_array.count; i++) {
         result.add(polygon_array[i]->tag);
@@ -652,6 +2063,7 @@ void Cell::get_label_tags(Set<Tag>& result) const {
 
 ErrorCode Cell::to_gds(FILE* out, double scaling, uint64_t max_points, double precision,
                        const tm* timestamp) const {
+    TraceSpan span("Cell::to_gds");
     ErrorCode error_code = ErrorCode::NoError;
     uint64_t len = strlen(name);
     if (len % 2) len++;
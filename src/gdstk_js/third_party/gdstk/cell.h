@@ -16,12 +16,14 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 #include <time.h>
 
 #include "array.h"
+#include "clipper_tools.h"
 #include "flexpath.h"
 #include "label.h"
 #include "map.h"
 #include "polygon.h"
 #include "reference.h"
 #include "robustpath.h"
+#include "rtree.h"
 #include "set.h"
 #include "style.h"
 
@@ -52,6 +54,32 @@ struct GeometryInfo {
     }
 };
 
+// Total area of the shapes with a given tag
+struct TagArea {
+    Tag tag;
+    double area;
+};
+
+// Spatial index of the elements of a cell, used by Cell::query.  Like
+// GeometryInfo, it is a snapshot of the cell (and the cells it references) at
+// a specific point in time.  It must be cleared whenever the cell contents
+// changes.
+struct CellIndex {
+    // Entry values combine a CellIndexKind (top 8 bits) and the position of
+    // the element in its array
+    RTree tree;
+    // Polygonal representation of the cell paths
+    Array<Polygon*> path_polygons;
+    // Upper bound of the diameter of a single polygon (without repetition),
+    // including those of referenced cells, in the coordinates of this cell:
+    // the largest bounding box diagonal, which does not change with rotation
+    double max_extent;
+
+    void clear();
+};
+
+enum struct CellIndexKind : uint64_t { Polygon = 0, PathPolygon, Label, Reference };
+
 struct Cell {
     // NULL-terminated string with cell name.  The GDSII specification allows
     // only ASCII-encoded strings.  The OASIS specification restricts the
@@ -76,6 +104,14 @@ struct Cell {
     // No functions in gdstk namespace should touch this value!
     void* owner;
 
+    // Lazily built by get_index.  It is not copied by copy_from.
+    CellIndex* spatial_index;
+
+    // Persistent bounding box and convex hull of this cell, lazily computed
+    // by cached_bounding_box and cached_convex_hull.  It is not copied by
+    // copy_from.
+    GeometryInfo geometry_info;
+
     void init(const char* name_) {
         name = copy_string(name_, NULL);
     }
@@ -124,6 +160,17 @@ struct Cell {
     // Caching version of the convex hull calculation.
     GeometryInfo convex_hull(Map<GeometryInfo>& cache) const;
 
+    // Persistent versions of bounding_box and convex_hull: results are kept
+    // in the geometry_info of this cell and of all cells in its dependency
+    // tree, and reused by later calls until cleared by clear_geometry_info.
+    // Callers must clear the geometry information of a modified cell and of
+    // all cells that depend on it.
+    void cached_bounding_box(Vec2& min, Vec2& max);
+    void cached_convex_hull(Array<Vec2>& result);
+
+    // Discard the persistent geometry information of this cell
+    void clear_geometry_info() { geometry_info.clear(); }
+
     // This cell instance must be zeroed before copy_from.  If a new_name is
     // NULL, use the same name as the source cell.  If deep_copy == true, new
     // elements (polygons, paths, references, and labels) are allocated and
@@ -141,6 +188,42 @@ struct Cell {
     void get_polygons(bool apply_repetitions, bool include_paths, int64_t depth, bool filter,
                       Tag tag, Array<Polygon*>& result) const;
 
+    // Call visit for each polygon that get_polygons would append to result
+    // (with the same arguments), without copying or transforming it: the
+    // polygon is passed as stored in its cell, together with the
+    // transformation from its cell to this one, composed with argument
+    // transformation.  If apply_repetitions is true, visit is called once
+    // for each repetition copy, with the offset included in the
+    // transformation, and the repetition of the polygon must be ignored.
+    // Otherwise, the repetition is passed along in the coordinates of the
+    // polygon cell.  Paths are converted to temporary polygons.  The order
+    // of the visits is not the order of get_polygons.
+    void visit_polygons(bool apply_repetitions, bool include_paths, int64_t depth, bool filter,
+                        Tag tag, const Transformation& transformation, PolygonVisitor visit,
+                        void* data) const;
+
+    // Call visit for each instance of a cell referenced by this one down to
+    // depth levels of references (depth 1 visits only the references in this
+    // cell, negative depth means no limit).  The transformation passed to
+    // visit is from the coordinates of the instance cell to those of this
+    // one, composed with argument transformation.  Repetitions are expanded
+    // one offset at a time, without storing them.  References by name or to
+    // raw cells are skipped.
+    void visit_instances(int64_t depth, const Transformation& transformation,
+                         InstanceVisitor visit, void* data) const;
+
+    // Similar to get_polygons, but repetitions are kept instead of expanded:
+    // each polygon is appended once, transformed to the coordinates of this
+    // cell, with a repetition combining its own with those of the references
+    // above it (see Repetition::combine) and with argument repetition.
+    // Argument transformation is applied to all polygons and repetitions, so
+    // the result is in the coordinates of the cell that this one is
+    // referenced from (use identity_transformation and a None repetition for
+    // the coordinates of this cell).
+    void get_repeated_polygons(bool include_paths, int64_t depth, bool filter, Tag tag,
+                               const Transformation& transformation,
+                               const Repetition& repetition, Array<Polygon*>& result) const;
+
     // Similar to get_polygons, but for paths and labels.
     void get_flexpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
                        Array<FlexPath*>& result) const;
@@ -160,12 +243,70 @@ struct Cell {
     void get_shape_tags(Set<Tag>& result) const;
     void get_label_tags(Set<Tag>& result) const;
 
+    // Area of the cell contents (polygons and paths, including those in
+    // referenced cells) per tag.  One entry per tag is appended to result.
+    // References are not flattened: the areas of each referenced cell are
+    // calculated once and multiplied by the number of instances and the
+    // squared magnification.  Overlapping shapes are counted once per shape,
+    // unless exact is true, in which case the area of the union of all
+    // shapes with the same tag is calculated (with scaling as in boolean).
+    // In exact mode, cells are only flattened when their shapes and
+    // instances of the tag overlap: otherwise, areas are still summed.
+    ErrorCode area(bool exact, double scaling, Array<TagArea>& result) const;
+
+    // Boolean operation between the shapes (polygons and paths, including
+    // those in referenced cells) with tag1 and tag2, equivalent to a boolean
+    // of the flattened cell (with scaling as in boolean).  The result of each
+    // referenced cell is calculated once and copied to all of its instances.
+    // Only instances whose bounding boxes overlap other instances or the
+    // shapes of the parent cell are flattened.  Pieces of results that
+    // touch across instance boundaries are united afterwards.  The resulting
+    // polygons, in the coordinates of this cell and with tag 0, are appended
+    // to result.
+    ErrorCode boolean_tags(Tag tag1, Tag tag2, Operation operation, double scaling,
+                           Array<Polygon*>& result) const;
+
+    // Offset of the union of the shapes with tag, calculated hierarchically
+    // as in boolean_tags.  Bounding boxes are grown by the offset distance
+    // before checking for overlaps, and magnified instances are flattened,
+    // because their cells would be offset by a scaled distance.
+    ErrorCode offset_tag(Tag tag, double distance, OffsetJoin join, double tolerance,
+                         double scaling, Array<Polygon*>& result) const;
+
     // Transform a cell hierarchy into a flat cell, with no dependencies, by
     // inserting the elements from this cell's references directly into the
     // cell (with the corresponding transformations).  Removed references are
-    // appended to removed_references.
+    // appended to removed_references.  If the current Progress is cancelled,
+    // flattening stops early and the remaining references are kept.
     void flatten(bool apply_repetitions, Array<Reference*>& removed_references);
 
+    // Return the spatial index of this cell, building it first if needed.
+    // Referenced cells are indexed as well, because references are indexed
+    // by the bounding boxes of their cells.  As with cached_bounding_box,
+    // callers must clear the index of a modified cell and of all cells that
+    // depend on it.
+    const CellIndex* get_index();
+
+    // Free the spatial index (it will be rebuilt on the next use)
+    void clear_index();
+
+    // Append (newly allocated) copies of the polygons (including the
+    // polygonal representation of paths) and labels whose bounding boxes, in
+    // the coordinates of this cell, intersect the rectangle [min, max] to
+    // polygons and labels.  References are walked up to depth levels, as in
+    // get_polygons, by transforming the rectangle into the coordinates of the
+    // referenced cell, so only the parts of the hierarchy that reach the
+    // rectangle are visited.  For rotations that are not multiples of 90°,
+    // the transformed rectangle is grown by the size of the largest polygon of
+    // the referenced cell (see CellIndex::max_extent) and the copies are
+    // tested again after transformation.
+    // Repetitions are applied, keeping only the repeated copies that
+    // intersect the rectangle.  If tags is not NULL, only elements with a tag
+    // in the set are appended.  The spatial indices are built as needed (see
+    // get_index).
+    void query(const Vec2 min, const Vec2 max, const Set<Tag>* tags, int64_t depth,
+               Array<Polygon*>& polygons, Array<Label*>& labels);
+
     // These functions output the cell and its contents in the GDSII and SVG
     // formats.  They are not supposed to be called by the user.  Use
     // Library.write_gds and Cell.write_svg instead.
@@ -7,24 +7,30 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 
 #include "clipper_tools.h"
 
+#include <float.h>
 #include <math.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "allocator.h"
 #include "array.h"
 #include "clipperlib/clipper.hpp"
 #include "polygon.h"
+#include "rtree.h"
 #include "sort.h"
 #include "utils.h"
 #include "vec.h"
 
 namespace gdstk {
 
-static inline ClipperLib::Path polygon_to_path(const Polygon& polygon, double scaling) {
+// Paths are resized in place, so that they reuse their storage
+static inline void polygon_to_path(const Polygon& polygon, double scaling,
+                                   ClipperLib::Path& path) {
     bool reverse = polygon.signed_area() < 0;
     uint64_t num = polygon.point_array.count;
-    ClipperLib::Path path(num);
+    path.resize(num);
+    if (num == 0) return;
     const Vec2* p = reverse ? polygon.point_array.items + num - 1 : polygon.point_array.items;
     ClipperLib::IntPoint* q = &path[0];
     if (reverse) {
@@ -42,16 +48,13 @@ static inline ClipperLib::Path polygon_to_path(const Polygon& polygon, double sc
             q++;
         }
     }
-    return path;
 }
 
-static inline ClipperLib::Paths polygons_to_paths(const Array<Polygon*>& polygon_array,
-                                                  double scaling) {
+static inline void polygons_to_paths(const Array<Polygon*>& polygon_array, double scaling,
+                                     ClipperLib::Paths& paths) {
     uint64_t num = polygon_array.count;
-    ClipperLib::Paths paths;
-    paths.reserve(num);
-    for (uint64_t i = 0; i < num; i++) paths.push_back(polygon_to_path(*polygon_array[i], scaling));
-    return paths;
+    paths.resize(num);
+    for (uint64_t i = 0; i < num; i++) polygon_to_path(*polygon_array[i], scaling, paths[i]);
 }
 
 static inline Polygon* path_to_polygon(const ClipperLib::Path& path, double scaling) {
@@ -186,12 +189,12 @@ static void tree_to_polygons(const ClipperLib::PolyTree& tree, double scaling,
     }
 }
 
-static void bounding_box(ClipperLib::Path& points, ClipperLib::cInt* bb) {
+static void bounding_box(const ClipperLib::Path& points, ClipperLib::cInt* bb) {
     bb[0] = points[0].X;
     bb[1] = points[0].X;
     bb[2] = points[0].Y;
     bb[3] = points[0].Y;
-    for (ClipperLib::Path::iterator it = points.begin(); it != points.end(); it++) {
+    for (ClipperLib::Path::const_iterator it = points.begin(); it != points.end(); it++) {
         if (it->X < bb[0]) bb[0] = it->X;
         if (it->X > bb[1]) bb[1] = it->X;
         if (it->Y < bb[2]) bb[2] = it->Y;
@@ -199,44 +202,1095 @@ static void bounding_box(ClipperLib::Path& points, ClipperLib::cInt* bb) {
     }
 }
 
-ErrorCode boolean(const Array<Polygon*>& polys1, const Array<Polygon*>& polys2, Operation operation,
-                  double scaling, Array<Polygon*>& result) {
-    ClipperLib::ClipType ct_operation = ClipperLib::ctUnion;
+static ClipperLib::ClipType clip_type(Operation operation) {
     switch (operation) {
         case Operation::Or:
-            ct_operation = ClipperLib::ctUnion;
-            break;
+            return ClipperLib::ctUnion;
         case Operation::And:
-            ct_operation = ClipperLib::ctIntersection;
-            break;
+            return ClipperLib::ctIntersection;
         case Operation::Xor:
-            ct_operation = ClipperLib::ctXor;
-            break;
+            return ClipperLib::ctXor;
         case Operation::Not:
-            ct_operation = ClipperLib::ctDifference;
+            return ClipperLib::ctDifference;
+    }
+    return ClipperLib::ctUnion;
+}
+
+// Assign each hole (negative orientation) in contours to the smallest outer
+// contour that contains it, link them, and append the resulting polygons to
+// result.  Contours are consumed.  This does not depend on Clipper building a
+// PolyTree, which can attach holes to the wrong outer contour when contours
+// share edges.  The memory category is restored before allocating the result.
+static ErrorCode contours_to_polygons(ClipperLib::Paths& contours, double scaling,
+                                      Array<Polygon*>& result, MemoryCategoryScope& category) {
+    uint64_t num_outers = 0;
+    for (ClipperLib::Paths::iterator path = contours.begin(); path != contours.end(); path++) {
+        if (ClipperLib::Orientation(*path)) num_outers++;
+    }
+    const uint64_t num_holes = contours.size() - num_outers;
+    ClipperLib::PolyNode* outers = new ClipperLib::PolyNode[num_outers];
+    ClipperLib::PolyNode* holes = new ClipperLib::PolyNode[num_holes];
+    Array<double> areas = {};
+    Array<RTreeEntry> entries = {};
+    ClipperLib::PolyNode* outer = outers;
+    ClipperLib::PolyNode* hole = holes;
+    if (num_holes > 0) {
+        areas.ensure_slots(num_outers);
+        entries.ensure_slots(num_outers);
+    }
+    for (ClipperLib::Paths::iterator path = contours.begin(); path != contours.end(); path++) {
+        if (ClipperLib::Orientation(*path)) {
+            if (num_holes > 0) {
+                ClipperLib::cInt bb[4];
+                bounding_box(*path, bb);
+                RTreeEntry entry = {{(double)bb[0], (double)bb[2]},
+                                    {(double)bb[1], (double)bb[3]},
+                                    (uint64_t)(outer - outers)};
+                entries.append_unsafe(entry);
+                areas.append_unsafe(ClipperLib::Area(*path));
+            }
+            (outer++)->Contour.swap(*path);
+        } else {
+            (hole++)->Contour.swap(*path);
+        }
+    }
+    RTree rtree = {};
+    rtree.build(entries);
+
+    ErrorCode error_code = ErrorCode::NoError;
+    Array<uint64_t> candidates = {};
+    for (hole = holes; hole < holes + num_holes; hole++) {
+        ClipperLib::cInt bb[4];
+        bounding_box(hole->Contour, bb);
+        candidates.count = 0;
+        rtree.search(Vec2{(double)bb[0], (double)bb[2]}, Vec2{(double)bb[1], (double)bb[3]},
+                     candidates);
+        ClipperLib::PolyNode* parent = NULL;
+        double parent_area = 0;
+        for (uint64_t i = 0; i < candidates.count; i++) {
+            const uint64_t index = candidates[i];
+            if (parent && areas[index] >= parent_area) continue;
+            const ClipperLib::Path& contour = outers[index].Contour;
+            // Holes can touch their parents, so vertices on the contour are
+            // not conclusive
+            int inside = -1;
+            for (ClipperLib::Path::iterator point = hole->Contour.begin();
+                 inside < 0 && point != hole->Contour.end(); point++) {
+                inside = ClipperLib::PointInPolygon(*point, contour);
+            }
+            if (inside != 0) {
+                parent = outers + index;
+                parent_area = areas[index];
+            }
+        }
+        if (parent) {
+            parent->Childs.push_back(hole);
+        } else {
+            fprintf(stderr, "[GDSTK] Unable to link hole in boolean operation.\n");
+            error_code = ErrorCode::BooleanError;
+        }
+    }
+    candidates.clear();
+    rtree.clear();
+    areas.clear();
+
+    category.restore();
+    result.ensure_slots(num_outers);
+    for (outer = outers; outer < outers + num_outers; outer++) {
+        if (outer->ChildCount() > 0) link_holes(outer, error_code);
+        result.append_unsafe(path_to_polygon(outer->Contour, scaling));
+    }
+    delete[] outers;
+    delete[] holes;
+    return error_code;
+}
+
+// Manhattan engine: when all edges of all operands are horizontal or vertical
+// (after scaling), booleans and miter offsets are computed with a scanline
+// over the vertical edges instead of Clipper.  The winding numbers of both
+// operands are kept for the elementary intervals between consecutive edge
+// ordinates, and the boundary of the result is read from the intervals that
+// change state at each abscissa.  No intersections need to be computed, so
+// the result is exact.
+
+// Vertical edge spanning [y0, y1] (y0 < y1) that adds delta to the winding
+// number of operand (0 or 1) at its right side.  The range [k0, k1) of
+// elementary intervals covered by the edge is set by manhattan_sweep.
+struct ManhattanEdge {
+    ClipperLib::cInt x;
+    ClipperLib::cInt y0;
+    ClipperLib::cInt y1;
+    int32_t delta;
+    uint32_t operand;
+    uint64_t k0;
+    uint64_t k1;
+};
+
+// Vertical side of a result contour, from (x, y0) to (x, y1), with the
+// interior of the result to its left.  Ordinates y0 and y1 have indices k0
+// and k1 in the sorted ordinates of the sweep.
+struct ManhattanSide {
+    ClipperLib::cInt x;
+    ClipperLib::cInt y0;
+    ClipperLib::cInt y1;
+    uint64_t k0;
+    uint64_t k1;
+};
+
+// End of a ManhattanSide, where the contour arrives from or departs to a
+// horizontal edge
+struct ManhattanEnd {
+    ClipperLib::cInt x;
+    ClipperLib::cInt y;
+    uint64_t side;
+    bool up;
+    bool arrival;
+};
+
+// Buffers of the Manhattan engine.  They are emptied, not freed, between
+// uses, so that a GeometryContext keeps them.
+struct ManhattanBuffers {
+    Array<ManhattanEdge> edges;
+    Array<ManhattanSide> sides;
+    Array<ManhattanEnd> ends;
+    Array<ClipperLib::cInt> ordinates;
+    Array<int32_t> winding;
+    Array<uint64_t> indices;
+    Array<bool> flags;
+    ClipperLib::Path points;
+    ClipperLib::Path raw;
+    ClipperLib::Paths joined;
+
+    void clear() {
+        edges.clear();
+        sides.clear();
+        ends.clear();
+        ordinates.clear();
+        winding.clear();
+        indices.clear();
+        flags.clear();
     }
+};
+
+// Empty array with room for count zeroed items
+template <class T>
+static T* zeroed_slots(Array<T>& array, uint64_t count) {
+    array.count = 0;
+    array.ensure_slots(count);
+    memset(array.items, 0, count * sizeof(T));
+    return array.items;
+}
 
-    ClipperLib::Paths paths1 = polygons_to_paths(polys1, scaling);
-    ClipperLib::Paths paths2 = polygons_to_paths(polys2, scaling);
+static bool is_manhattan(const ClipperLib::Paths& paths) {
+    for (ClipperLib::Paths::const_iterator path = paths.begin(); path != paths.end(); path++) {
+        if (path->size() == 0) continue;
+        ClipperLib::IntPoint p0 = path->back();
+        for (ClipperLib::Path::const_iterator p1 = path->begin(); p1 != path->end(); p1++) {
+            if (p0.X != p1->X && p0.Y != p1->Y) return false;
+            p0 = *p1;
+        }
+    }
+    return true;
+}
+
+// Append the vertical edges of a Manhattan path to edges.  The interior of
+// the path must be at its left (positive orientation for outer contours).
+static void append_manhattan_path(const ClipperLib::Path& path, uint32_t operand,
+                                  Array<ManhattanEdge>& edges) {
+    if (path.size() == 0) return;
+    ClipperLib::IntPoint p0 = path.back();
+    for (ClipperLib::Path::const_iterator p1 = path.begin(); p1 != path.end(); p1++) {
+        if (p0.X == p1->X && p0.Y != p1->Y) {
+            if (p0.Y > p1->Y) {
+                edges.append(ManhattanEdge{p0.X, p1->Y, p0.Y, 1, operand, 0, 0});
+            } else {
+                edges.append(ManhattanEdge{p0.X, p0.Y, p1->Y, -1, operand, 0, 0});
+            }
+        }
+        p0 = *p1;
+    }
+}
+
+static bool cint_sorted(const ClipperLib::cInt& a, const ClipperLib::cInt& b) { return a < b; }
+
+static bool manhattan_edge_sorted(const ManhattanEdge& a, const ManhattanEdge& b) {
+    return a.x < b.x || (a.x == b.x && a.k0 < b.k0);
+}
+
+// Index of value in the sorted array of distinct values
+static inline uint64_t find_index(const Array<ClipperLib::cInt>& values, ClipperLib::cInt value) {
+    uint64_t lo = 0;
+    uint64_t hi = values.count;
+    while (lo < hi) {
+        const uint64_t mid = (lo + hi) / 2;
+        if (values[mid] < value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static inline bool manhattan_inside(Operation operation, bool positive, const int32_t* winding) {
+    const bool inside0 = positive ? winding[0] > 0 : winding[0] != 0;
+    const bool inside1 = positive ? winding[1] > 0 : winding[1] != 0;
+    switch (operation) {
+        case Operation::Or:
+            return inside0 || inside1;
+        case Operation::And:
+            return inside0 && inside1;
+        case Operation::Xor:
+            return inside0 != inside1;
+        case Operation::Not:
+            return inside0 && !inside1;
+    }
+    return false;
+}
+
+// Sweep edges (which are sorted in place) from left to right and append the
+// vertical sides of the result of operation to sides, in ascending abscissa.
+// Operands are filled with the non-zero rule, or the positive rule if
+// positive is true.  Return the number of distinct ordinates.
+static uint64_t manhattan_sweep(Array<ManhattanEdge>& edges, Operation operation, bool positive,
+                                Array<ManhattanSide>& sides, ManhattanBuffers& buffers) {
+    if (edges.count == 0) return 0;
+
+    Array<ClipperLib::cInt>& ys = buffers.ordinates;
+    ys.count = 0;
+    ys.ensure_slots(2 * edges.count);
+    for (uint64_t i = 0; i < edges.count; i++) {
+        ys.append_unsafe(edges[i].y0);
+        ys.append_unsafe(edges[i].y1);
+    }
+    sort(ys, cint_sorted);
+    uint64_t count = 1;
+    for (uint64_t i = 1; i < ys.count; i++) {
+        if (ys[i] != ys[count - 1]) ys[count++] = ys[i];
+    }
+    ys.count = count;
+    for (uint64_t i = 0; i < edges.count; i++) {
+        ManhattanEdge* edge = edges.items + i;
+        edge->k0 = find_index(ys, edge->y0);
+        edge->k1 = find_index(ys, edge->y1);
+    }
+    sort(edges, manhattan_edge_sorted);
+
+    // Interval k spans [ys[k], ys[k + 1]]
+    const uint64_t num_ordinates = ys.count;
+    const uint64_t num_intervals = num_ordinates - 1;
+    const uint64_t first_side = sides.count;
+    int32_t* winding = zeroed_slots(buffers.winding, 2 * num_intervals);
+    bool* inside = zeroed_slots(buffers.flags, num_intervals);
+
+    uint64_t i = 0;
+    while (i < edges.count) {
+        const ClipperLib::cInt x = edges[i].x;
+        uint64_t j = i;
+        for (; j < edges.count && edges[j].x == x; j++) {
+            const ManhattanEdge* edge = edges.items + j;
+            int32_t* w = winding + 2 * edge->k0 + edge->operand;
+            for (uint64_t k = edge->k1 - edge->k0; k > 0; k--, w += 2) *w += edge->delta;
+        }
+
+        // Only intervals covered by edges at x can change state.  They are
+        // visited once, in ascending order, so that contiguous sides with the
+        // same direction are joined.  Entering the result at x, sides go
+        // down; leaving it, up.
+        bool open = false;
+        ManhattanSide side = {x, 0, 0, 0, 0};
+        uint64_t k = 0;
+        for (; i < j; i++) {
+            if (k < edges[i].k0) k = edges[i].k0;
+            for (; k < edges[i].k1; k++) {
+                const bool now = manhattan_inside(operation, positive, winding + 2 * k);
+                if (now == inside[k]) continue;
+                inside[k] = now;
+                if (now) {
+                    if (open && side.k1 < side.k0 && side.k0 == k) {
+                        side.k0 = k + 1;
+                        continue;
+                    }
+                    if (open) sides.append(side);
+                    side.k0 = k + 1;
+                    side.k1 = k;
+                } else {
+                    if (open && side.k1 > side.k0 && side.k1 == k) {
+                        side.k1 = k + 1;
+                        continue;
+                    }
+                    if (open) sides.append(side);
+                    side.k0 = k;
+                    side.k1 = k + 1;
+                }
+                open = true;
+            }
+        }
+        if (open) sides.append(side);
+    }
+    for (uint64_t k = first_side; k < sides.count; k++) {
+        ManhattanSide* side = sides.items + k;
+        side->y0 = ys[side->k0];
+        side->y1 = ys[side->k1];
+    }
+    return num_ordinates;
+}
 
+// Close the sides from manhattan_sweep into contours (positive outer contours
+// and negative holes).  Consecutive side ends along each ordinate are joined
+// by horizontal edges.  Sides come in ascending abscissa, so a counting sort
+// over the ordinate indices is enough to order the ends.  Where contours
+// touch at a vertex, both ends are either arrivals or departures, and placing
+// the end of the upward side first keeps the contours apart.
+static void manhattan_contours(const Array<ManhattanSide>& sides, uint64_t num_ordinates,
+                               ManhattanBuffers& buffers, ClipperLib::Paths& contours) {
+    if (sides.count == 0) return;
+    uint64_t* position = zeroed_slots(buffers.indices, num_ordinates + 1);
+    for (uint64_t i = 0; i < sides.count; i++) {
+        position[sides[i].k0 + 1]++;
+        position[sides[i].k1 + 1]++;
+    }
+    for (uint64_t k = 1; k < num_ordinates; k++) position[k] += position[k - 1];
+    const uint64_t num_ends = 2 * sides.count;
+    buffers.ends.count = 0;
+    buffers.ends.ensure_slots(num_ends);
+    ManhattanEnd* ends = buffers.ends.items;
+    for (uint64_t i = 0; i < sides.count; i++) {
+        const ManhattanSide& side = sides[i];
+        const bool up = side.y1 > side.y0;
+        ends[position[side.k0]++] = ManhattanEnd{side.x, side.y0, i, up, false};
+        ends[position[side.k1]++] = ManhattanEnd{side.x, side.y1, i, up, true};
+    }
+    for (uint64_t i = 0; i + 1 < num_ends; i++) {
+        ManhattanEnd* end = ends + i;
+        if (end[0].x == end[1].x && end[0].y == end[1].y && !end[0].up && end[1].up) {
+            const ManhattanEnd tmp = end[0];
+            end[0] = end[1];
+            end[1] = tmp;
+        }
+    }
+
+    // The positions are no longer needed
+    buffers.indices.count = 0;
+    buffers.indices.ensure_slots(sides.count);
+    uint64_t* next = buffers.indices.items;
+    for (uint64_t i = 0; i < num_ends; i += 2) {
+        const ManhattanEnd& a = ends[i];
+        const ManhattanEnd& b = ends[i + 1];
+        if (a.arrival) {
+            next[a.side] = b.side;
+        } else {
+            next[b.side] = a.side;
+        }
+    }
+
+    bool* visited = zeroed_slots(buffers.flags, sides.count);
+    for (uint64_t i = 0; i < sides.count; i++) {
+        if (visited[i]) continue;
+        uint64_t count = 0;
+        uint64_t s = i;
+        do {
+            count += 2;
+            s = next[s];
+        } while (s != i);
+        contours.push_back(ClipperLib::Path(count));
+        ClipperLib::IntPoint* point = &contours.back()[0];
+        s = i;
+        do {
+            visited[s] = true;
+            point->X = sides[s].x;
+            (point++)->Y = sides[s].y0;
+            point->X = sides[s].x;
+            (point++)->Y = sides[s].y1;
+            s = next[s];
+        } while (s != i);
+    }
+}
+
+// Contours of the result are appended to contours
+static void manhattan_boolean(const ClipperLib::Paths& paths1, const ClipperLib::Paths& paths2,
+                              Operation operation, ManhattanBuffers& buffers,
+                              ClipperLib::Paths& contours) {
+    TraceSpan span("boolean:manhattan");
+    Array<ManhattanEdge>& edges = buffers.edges;
+    Array<ManhattanSide>& sides = buffers.sides;
+    edges.count = 0;
+    sides.count = 0;
+    for (ClipperLib::Paths::const_iterator path = paths1.begin(); path != paths1.end(); path++)
+        append_manhattan_path(*path, 0, edges);
+    for (ClipperLib::Paths::const_iterator path = paths2.begin(); path != paths2.end(); path++)
+        append_manhattan_path(*path, 1, edges);
+    const uint64_t num_ordinates = manhattan_sweep(edges, operation, false, sides, buffers);
+    manhattan_contours(sides, num_ordinates, buffers, contours);
+}
+
+static inline ClipperLib::cInt sign(ClipperLib::cInt value) { return (value > 0) - (value < 0); }
+
+// Miter offset of a Manhattan path by r before the clean up union, vertex by
+// vertex as in ClipperOffset (with integer unit normals): concave corners get
+// a loop through the original vertex, and reversals get square caps.
+// Duplicate vertices are skipped and paths with less than 3 distinct
+// vertices are ignored, as in ClipperOffset::AddPath.
+static void manhattan_offset_path(const ClipperLib::Path& path, ClipperLib::cInt r,
+                                  ClipperLib::Path& points, ClipperLib::Path& result) {
+    points.clear();
+    for (ClipperLib::Path::const_iterator p = path.begin(); p != path.end(); p++) {
+        if (points.empty() || points.back() != *p) points.push_back(*p);
+    }
+    while (points.size() > 1 && points.front() == points.back()) points.pop_back();
+    result.clear();
+    const uint64_t count = points.size();
+    if (count < 3) return;
+
+    result.reserve(3 * count);
+    ClipperLib::IntPoint prev = points[count - 1];
+    for (uint64_t j = 0; j < count; j++) {
+        const ClipperLib::IntPoint p = points[j];
+        const ClipperLib::IntPoint next = points[j + 1 < count ? j + 1 : 0];
+        // Right-hand normals of the incoming (k) and outgoing (j) edges
+        const ClipperLib::cInt kx = sign(p.Y - prev.Y);
+        const ClipperLib::cInt ky = -sign(p.X - prev.X);
+        const ClipperLib::cInt jx = sign(next.Y - p.Y);
+        const ClipperLib::cInt jy = -sign(next.X - p.X);
+        const ClipperLib::cInt sin_a = kx * jy - jx * ky;
+        if (sin_a == 0) {
+            if (kx == jx && ky == jy) {
+                result.push_back(ClipperLib::IntPoint(p.X + kx * r, p.Y + ky * r));
+            } else {
+                // ClipperOffset::DoSquare, where the sign of the cap depends
+                // on the sign of the zero sin_a: caps after upward or
+                // leftward edges point backwards.
+                const ClipperLib::cInt dx = kx > 0 || ky > 0 ? -1 : 1;
+                result.push_back(
+                    ClipperLib::IntPoint(p.X + (kx - ky * dx) * r, p.Y + (ky + kx * dx) * r));
+                result.push_back(
+                    ClipperLib::IntPoint(p.X + (jx + jy * dx) * r, p.Y + (jy - jx * dx) * r));
+            }
+        } else if (sin_a * r < 0) {
+            result.push_back(ClipperLib::IntPoint(p.X + kx * r, p.Y + ky * r));
+            result.push_back(p);
+            result.push_back(ClipperLib::IntPoint(p.X + jx * r, p.Y + jy * r));
+        } else {
+            result.push_back(ClipperLib::IntPoint(p.X + (kx + jx) * r, p.Y + (ky + jy) * r));
+        }
+        prev = p;
+    }
+}
+
+// Miter offset of Manhattan paths by r.  The raw offset paths are Manhattan,
+// so the clean up union with the positive fill rule (which is what
+// ClipperOffset does for either sign of r) is also a sweep.
+static void manhattan_offset(const ClipperLib::Paths& paths, ClipperLib::cInt r, bool use_union,
+                             ManhattanBuffers& buffers, ClipperLib::Paths& contours) {
+    TraceSpan span("offset:manhattan");
+    Array<ManhattanEdge>& edges = buffers.edges;
+    Array<ManhattanSide>& sides = buffers.sides;
+    edges.count = 0;
+    sides.count = 0;
+    const ClipperLib::Paths* sources = &paths;
+    if (use_union) {
+        for (ClipperLib::Paths::const_iterator path = paths.begin(); path != paths.end(); path++)
+            append_manhattan_path(*path, 0, edges);
+        const uint64_t num_ordinates = manhattan_sweep(edges, Operation::Or, false, sides, buffers);
+        buffers.joined.clear();
+        manhattan_contours(sides, num_ordinates, buffers, buffers.joined);
+        edges.count = 0;
+        sides.count = 0;
+        sources = &buffers.joined;
+    }
+
+    for (ClipperLib::Paths::const_iterator path = sources->begin(); path != sources->end();
+         path++) {
+        manhattan_offset_path(*path, r, buffers.points, buffers.raw);
+        append_manhattan_path(buffers.raw, 0, edges);
+    }
+    const uint64_t num_ordinates = manhattan_sweep(edges, Operation::Or, true, sides, buffers);
+    manhattan_contours(sides, num_ordinates, buffers, contours);
+}
+
+struct GeometryScratch {
+    ClipperLib::Paths paths1;
+    ClipperLib::Paths paths2;
+    ClipperLib::Paths contours;
     // NOTE: ioStrictlySimple seems to hang on complex layouts
-    // ClipperLib::Clipper clpr(ClipperLib::ioStrictlySimple);
+    // ClipperLib::Clipper clipper(ClipperLib::ioStrictlySimple);
+    ClipperLib::Clipper clipper;
+    ClipperLib::ClipperOffset clipper_offset;
+    ClipperLib::PolyTree tree;
+    ManhattanBuffers manhattan;
+
+    // Value-initialization of the buffers zeroes their arrays
+    GeometryScratch() : manhattan() {}
+    ~GeometryScratch() { manhattan.clear(); }
+};
+
+void GeometryContext::clear() {
+    delete scratch;
+    scratch = NULL;
+}
+
+// Scratch of context, created on first use, or local if there is no context
+static GeometryScratch& get_scratch(GeometryContext* context, GeometryScratch& local) {
+    if (!context) return local;
+    if (!context->scratch) context->scratch = new GeometryScratch;
+    return *context->scratch;
+}
+
+struct UnionPart {
+    ClipperLib::Paths paths;
+};
+
+struct MortonKey {
+    uint64_t code;
+    uint64_t index;
+};
+
+static bool morton_key_sorted(const MortonKey& a, const MortonKey& b) { return a.code < b.code; }
+
+// Spread the bits of value to the even bits of the result
+static inline uint64_t morton_spread(uint32_t value) {
+    uint64_t x = value;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFF;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FF;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0F;
+    x = (x | (x << 2)) & 0x3333333333333333;
+    x = (x | (x << 1)) & 0x5555555555555555;
+    return x;
+}
+
+// True if segments ab and cd cross or touch
+static inline bool segments_meet(const Vec2 a, const Vec2 b, const Vec2 c, const Vec2 d) {
+    if (fmax(a.x, b.x) < fmin(c.x, d.x) || fmax(c.x, d.x) < fmin(a.x, b.x) ||
+        fmax(a.y, b.y) < fmin(c.y, d.y) || fmax(c.y, d.y) < fmin(a.y, b.y))
+        return false;
+    const Vec2 ab = b - a;
+    const Vec2 cd = d - c;
+    return ab.cross(c - a) * ab.cross(d - a) <= 0 && cd.cross(a - c) * cd.cross(b - c) <= 0;
+}
+
+// Cheap tests for polygons that are certainly simple: convex ones (turning
+// once around), and small ones without meeting non-adjacent sides.  Others
+// may self intersect.
+static bool may_self_intersect(const Polygon& polygon) {
+    const uint64_t num = polygon.point_array.count;
+    if (num < 4) return false;
+    const Vec2* p = polygon.point_array.items;
+
+    double turning = 0;
+    double sign = 0;
+    bool convex = true;
+    for (uint64_t i = 0; i < num && convex; i++) {
+        const Vec2 v0 = p[(i + 1) % num] - p[i];
+        const Vec2 v1 = p[(i + 2) % num] - p[(i + 1) % num];
+        const double cross = v0.cross(v1);
+        if (cross != 0) {
+            if (sign == 0) sign = cross;
+            convex = sign * cross > 0;
+        }
+        turning += v0.angle(v1);
+    }
+    if (convex && fabs(fabs(turning) - 2 * M_PI) < 1e-6) return false;
+
+    if (num > GDSTK_UNION_SIMPLE_TEST_POINTS) return true;
+    for (uint64_t i = 0; i < num; i++) {
+        // Sides i and i - 1 (mod num) are adjacent
+        for (uint64_t j = i + 2; j < num && j + 1 < num + i; j++) {
+            if (segments_meet(p[i], p[i + 1], p[j], p[(j + 1) % num])) return true;
+        }
+    }
+    return false;
+}
+
+// True if some region of polygon, oriented with positive area as in the
+// unions, has a negative winding number
+static bool has_negative_winding(const Polygon& polygon, double scaling) {
+    if (!may_self_intersect(polygon)) return false;
+    ClipperLib::Paths paths(1);
+    polygon_to_path(polygon, scaling, paths[0]);
     ClipperLib::Clipper clpr;
+    clpr.AddPaths(paths, ClipperLib::ptSubject, true);
+    ClipperLib::Paths negative;
+    clpr.Execute(ClipperLib::ctUnion, negative, ClipperLib::pftNegative, ClipperLib::pftNegative);
+    return negative.size() > 0;
+}
+
+void BalancedUnion::init(const Array<Polygon*>& polygons, double scaling_) {
+    scaling = scaling_;
+    level = 0;
+    num_parts = 0;
+    parts = NULL;
+    single_sweep = false;
+    const uint64_t count = polygons.count;
+    if (count == 0) return;
+
+    MemoryCategoryScope category(MemoryCategory::Clipper);
+    for (uint64_t i = 0; i < count; i++) {
+        if (has_negative_winding(*polygons[i], scaling)) {
+            single_sweep = true;
+            return;
+        }
+    }
+
+    Vec2* centers = (Vec2*)allocate(count * sizeof(Vec2));
+    Vec2 min = {DBL_MAX, DBL_MAX};
+    Vec2 max = {-DBL_MAX, -DBL_MAX};
+    for (uint64_t i = 0; i < count; i++) {
+        Vec2 pmin, pmax;
+        polygons[i]->bounding_box(pmin, pmax);
+        const Vec2 center = 0.5 * (pmin + pmax);
+        centers[i] = center;
+        if (center.x < min.x) min.x = center.x;
+        if (center.y < min.y) min.y = center.y;
+        if (center.x > max.x) max.x = center.x;
+        if (center.y > max.y) max.y = center.y;
+    }
+
+    // Centers are quantized to 32 bits per axis
+    const double sx = max.x > min.x ? 4294967295.0 / (max.x - min.x) : 0;
+    const double sy = max.y > min.y ? 4294967295.0 / (max.y - min.y) : 0;
+    MortonKey* keys = (MortonKey*)allocate(count * sizeof(MortonKey));
+    for (uint64_t i = 0; i < count; i++) {
+        const uint32_t x = (uint32_t)(sx * (centers[i].x - min.x));
+        const uint32_t y = (uint32_t)(sy * (centers[i].y - min.y));
+        keys[i].code = morton_spread(x) | (morton_spread(y) << 1);
+        keys[i].index = i;
+    }
+    free_allocation(centers);
+    sort(keys, count, morton_key_sorted);
+
+    uint64_t points = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        points += polygons[keys[i].index]->point_array.count;
+        if (points >= GDSTK_UNION_GROUP_POINTS || i == count - 1) {
+            num_parts++;
+            points = 0;
+        }
+    }
+    parts = new UnionPart[num_parts];
+    UnionPart* part = parts;
+    points = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        const Polygon* polygon = polygons[keys[i].index];
+        part->paths.push_back(ClipperLib::Path());
+        polygon_to_path(*polygon, scaling, part->paths.back());
+        points += polygon->point_array.count;
+        if (points >= GDSTK_UNION_GROUP_POINTS) {
+            part++;
+            points = 0;
+        }
+    }
+    free_allocation(keys);
+}
+
+void BalancedUnion::clear() {
+    delete[] parts;
+    parts = NULL;
+    num_parts = 0;
+}
+
+// Union of paths1 and paths2, each filled with the non-zero rule
+static void unite(const ClipperLib::Paths& paths1, const ClipperLib::Paths& paths2,
+                  GeometryScratch& scratch, ClipperLib::Paths& solution) {
+    solution.clear();
+    if (is_manhattan(paths1) && is_manhattan(paths2)) {
+        manhattan_boolean(paths1, paths2, Operation::Or, scratch.manhattan, solution);
+        return;
+    }
+    ClipperLib::Clipper& clpr = scratch.clipper;
+    clpr.Clear();
+    clpr.AddPaths(paths1, ClipperLib::ptSubject, true);
+    clpr.AddPaths(paths2, ClipperLib::ptClip, true);
+    clpr.Execute(ClipperLib::ctUnion, solution, ClipperLib::pftNonZero, ClipperLib::pftNonZero);
+}
+
+static void contour_tree(const ClipperLib::Paths& paths, RTree& rtree) {
+    Array<RTreeEntry> entries = {};
+    entries.ensure_slots(paths.size());
+    for (uint64_t i = 0; i < paths.size(); i++) {
+        ClipperLib::cInt bb[4];
+        bounding_box(paths[i], bb);
+        RTreeEntry entry = {{(double)bb[0], (double)bb[2]}, {(double)bb[1], (double)bb[3]}, i};
+        entries.append_unsafe(entry);
+    }
+    rtree.build(entries);
+}
+
+// Move the contours in paths whose bounding boxes meet a box in other to
+// sent, and the rest to kept
+static void split_contours(ClipperLib::Paths& paths, const RTree& other, ClipperLib::Paths& sent,
+                           ClipperLib::Paths& kept) {
+    Array<uint64_t> candidates = {};
+    for (ClipperLib::Paths::iterator path = paths.begin(); path != paths.end(); path++) {
+        ClipperLib::cInt bb[4];
+        bounding_box(*path, bb);
+        candidates.count = 0;
+        other.search(Vec2{(double)bb[0], (double)bb[2]}, Vec2{(double)bb[1], (double)bb[3]},
+                     candidates);
+        ClipperLib::Paths& target = candidates.count > 0 ? sent : kept;
+        target.push_back(ClipperLib::Path());
+        target.back().swap(*path);
+    }
+    candidates.clear();
+}
+
+void BalancedUnion::run(uint64_t i) {
+    TraceSpan span("boolean:union");
+    MemoryCategoryScope category(MemoryCategory::Clipper);
+    GeometryScratch scratch;
+    if (level == 0) {
+        unite(parts[i].paths, scratch.paths2, scratch, scratch.contours);
+        parts[i].paths.swap(scratch.contours);
+        return;
+    }
+
+    // Parts are united into the first of the pair; the second is freed.
+    // Contours (outer or hole) whose bounding boxes do not meet any contour
+    // box of the other part cannot interact with it, so they are kept as
+    // they are and only the others are united.  Every contour around a sent
+    // one is also sent, so kept holes still cut the united region around
+    // them, and the sent contours of each part fill the same region with
+    // the non-zero rule as with all contours.
+    ClipperLib::Paths& paths1 = parts[2 * i].paths;
+    ClipperLib::Paths& paths2 = parts[2 * i + 1].paths;
+    RTree rtree1 = {};
+    RTree rtree2 = {};
+    contour_tree(paths1, rtree1);
+    contour_tree(paths2, rtree2);
+    ClipperLib::Paths kept;
+    split_contours(paths1, rtree2, scratch.paths1, kept);
+    split_contours(paths2, rtree1, scratch.paths2, kept);
+    rtree1.clear();
+    rtree2.clear();
+    ClipperLib::Paths().swap(paths2);
+
+    unite(scratch.paths1, scratch.paths2, scratch, scratch.contours);
+    paths1.swap(scratch.contours);
+    paths1.reserve(paths1.size() + kept.size());
+    for (ClipperLib::Paths::iterator path = kept.begin(); path != kept.end(); path++) {
+        paths1.push_back(ClipperLib::Path());
+        paths1.back().swap(*path);
+    }
+}
+
+bool BalancedUnion::next() {
+    if (level > 0) {
+        // Bring the results of the pairs to the front
+        for (uint64_t i = 1; 2 * i < num_parts; i++) parts[i].paths.swap(parts[2 * i].paths);
+        num_parts = (num_parts + 1) / 2;
+    }
+    level++;
+    return num_parts > 1;
+}
+
+ErrorCode BalancedUnion::finish(Array<Polygon*>& result) {
+    if (num_parts == 0) return ErrorCode::NoError;
+    MemoryCategoryScope category(MemoryCategory::Clipper);
+    return contours_to_polygons(parts[0].paths, scaling, result, category);
+}
+
+static uint64_t total_points(const Array<Polygon*>& polygons) {
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < polygons.count; i++) count += polygons[i]->point_array.count;
+    return count;
+}
+
+// BalancedUnion run in the current thread.  The contours of the result are
+// stored in solution.  Returns false, leaving solution untouched, if the
+// union needs a single sweep (see BalancedUnion::single_sweep).
+static bool balanced_union(const Array<Polygon*>& polygons, double scaling,
+                           ClipperLib::Paths& solution) {
+    BalancedUnion tree = {};
+    tree.init(polygons, scaling);
+    if (tree.single_sweep) return false;
+    do {
+        for (uint64_t i = 0; i < tree.count(); i++) tree.run(i);
+    } while (tree.next());
+    solution.clear();
+    if (tree.num_parts > 0) solution.swap(tree.parts[0].paths);
+    tree.clear();
+    return true;
+}
+
+ErrorCode boolean(const Array<Polygon*>& polys1, const Array<Polygon*>& polys2, Operation operation,
+                  double scaling, Array<Polygon*>& result, GeometryContext* context) {
+    TraceSpan span("boolean");
+    ClipperLib::ClipType ct_operation = clip_type(operation);
+
+    MemoryCategoryScope category(MemoryCategory::Clipper);
+    GeometryScratch local;
+    GeometryScratch& scratch = get_scratch(context, local);
+
+    if (operation == Operation::Or &&
+        total_points(polys1) + total_points(polys2) > GDSTK_UNION_GROUP_POINTS) {
+        Array<Polygon*> polygons = {};
+        polygons.ensure_slots(polys1.count + polys2.count);
+        polygons.extend(polys1);
+        polygons.extend(polys2);
+        ClipperLib::Paths& contours = scratch.contours;
+        const bool united = balanced_union(polygons, scaling, contours);
+        polygons.clear();
+        if (united) {
+            if (update_progress(2, 3)) return ErrorCode::Cancelled;
+            ErrorCode error_code = contours_to_polygons(contours, scaling, result, category);
+            update_progress(3, 3);
+            return error_code;
+        }
+    }
+
+    ClipperLib::Paths& paths1 = scratch.paths1;
+    ClipperLib::Paths& paths2 = scratch.paths2;
+    polygons_to_paths(polys1, scaling, paths1);
+    polygons_to_paths(polys2, scaling, paths2);
+    if (update_progress(1, 3)) return ErrorCode::Cancelled;
+
+    if (is_manhattan(paths1) && is_manhattan(paths2)) {
+        ClipperLib::Paths& contours = scratch.contours;
+        contours.clear();
+        manhattan_boolean(paths1, paths2, operation, scratch.manhattan, contours);
+        if (update_progress(2, 3)) return ErrorCode::Cancelled;
+        ErrorCode error_code = contours_to_polygons(contours, scaling, result, category);
+        update_progress(3, 3);
+        return error_code;
+    }
+
+    ClipperLib::Clipper& clpr = scratch.clipper;
+    clpr.Clear();
     clpr.AddPaths(paths1, ClipperLib::ptSubject, true);
     clpr.AddPaths(paths2, ClipperLib::ptClip, true);
 
-    ClipperLib::PolyTree solution;
+    // Execute leaves the tree untouched when there is nothing to clip
+    ClipperLib::PolyTree& solution = scratch.tree;
+    solution.Clear();
     clpr.Execute(ct_operation, solution, ClipperLib::pftNonZero, ClipperLib::pftNonZero);
+    if (update_progress(2, 3)) return ErrorCode::Cancelled;
 
+    category.restore();
     ErrorCode error_code = ErrorCode::NoError;
     tree_to_polygons(solution, scaling, result, error_code);
+    update_progress(3, 3);
     return error_code;
 }
 
+static void polygon_int_box(const Polygon& polygon, double scaling, int64_t* box) {
+    Vec2 min, max;
+    polygon.bounding_box(min, max);
+    box[0] = llround(scaling * min.x);
+    box[1] = llround(scaling * min.y);
+    box[2] = llround(scaling * max.x);
+    box[3] = llround(scaling * max.y);
+}
+
+void BooleanTiles::init(const Array<Polygon*>& polys1, const Array<Polygon*>& polys2,
+                        Operation operation_, double scaling_, double tile_size_) {
+    operand1 = &polys1;
+    operand2 = &polys2;
+    operation = operation_;
+    scaling = scaling_;
+    columns = 0;
+    rows = 0;
+    bins1 = NULL;
+    bins2 = NULL;
+
+    int64_t* boxes = (int64_t*)allocate(4 * sizeof(int64_t) * (polys1.count + polys2.count));
+    int64_t total[4] = {INT64_MAX, INT64_MAX, INT64_MIN, INT64_MIN};
+    int64_t* box = boxes;
+    const Array<Polygon*>* operands[] = {&polys1, &polys2};
+    for (uint64_t k = 0; k < COUNT(operands); k++) {
+        for (uint64_t i = 0; i < operands[k]->count; i++, box += 4) {
+            polygon_int_box(*operands[k]->items[i], scaling, box);
+            if (box[0] < total[0]) total[0] = box[0];
+            if (box[1] < total[1]) total[1] = box[1];
+            if (box[2] > total[2]) total[2] = box[2];
+            if (box[3] > total[3]) total[3] = box[3];
+        }
+    }
+    if (total[0] > total[2]) {
+        free_allocation(boxes);
+        return;
+    }
+
+    origin_x = total[0];
+    origin_y = total[1];
+    tile_size = llround(tile_size_ * scaling);
+    if (tile_size < 1) tile_size = 1;
+    columns = (uint64_t)((total[2] - total[0]) / tile_size) + 1;
+    rows = (uint64_t)((total[3] - total[1]) / tile_size) + 1;
+    while (columns * rows > GDSTK_BOOLEAN_MAX_TILES) {
+        tile_size *= 2;
+        columns = (uint64_t)((total[2] - total[0]) / tile_size) + 1;
+        rows = (uint64_t)((total[3] - total[1]) / tile_size) + 1;
+    }
+
+    bins1 = (Array<uint64_t>*)allocate_clear(sizeof(Array<uint64_t>) * columns * rows);
+    bins2 = (Array<uint64_t>*)allocate_clear(sizeof(Array<uint64_t>) * columns * rows);
+    Array<uint64_t>* bins[] = {bins1, bins2};
+    box = boxes;
+    for (uint64_t k = 0; k < COUNT(operands); k++) {
+        for (uint64_t i = 0; i < operands[k]->count; i++, box += 4) {
+            const uint64_t c0 = (uint64_t)((box[0] - origin_x) / tile_size);
+            const uint64_t r0 = (uint64_t)((box[1] - origin_y) / tile_size);
+            uint64_t c1 = (uint64_t)((box[2] - origin_x) / tile_size);
+            uint64_t r1 = (uint64_t)((box[3] - origin_y) / tile_size);
+            if (c1 >= columns) c1 = columns - 1;
+            if (r1 >= rows) r1 = rows - 1;
+            for (uint64_t r = r0; r <= r1; r++) {
+                for (uint64_t c = c0; c <= c1; c++) {
+                    bins[k][r * columns + c].append(i);
+                }
+            }
+        }
+    }
+    free_allocation(boxes);
+}
+
+void BooleanTiles::clear() {
+    for (uint64_t i = 0; i < columns * rows; i++) {
+        bins1[i].clear();
+        bins2[i].clear();
+    }
+    if (bins1) free_allocation(bins1);
+    if (bins2) free_allocation(bins2);
+    bins1 = NULL;
+    bins2 = NULL;
+    columns = 0;
+    rows = 0;
+}
+
+ErrorCode BooleanTiles::run(uint64_t tile, Array<Polygon*>& result, Array<Polygon*>* border) const {
+    const Array<uint64_t>& bin1 = bins1[tile];
+    const Array<uint64_t>& bin2 = bins2[tile];
+    switch (operation) {
+        case Operation::And:
+            if (bin1.count == 0 || bin2.count == 0) return ErrorCode::NoError;
+            break;
+        case Operation::Not:
+            if (bin1.count == 0) return ErrorCode::NoError;
+            break;
+        default:
+            if (bin1.count == 0 && bin2.count == 0) return ErrorCode::NoError;
+    }
+
+    MemoryCategoryScope category(MemoryCategory::Clipper);
+    GeometryScratch scratch;
+    ClipperLib::Paths& paths1 = scratch.paths1;
+    paths1.resize(bin1.count);
+    for (uint64_t i = 0; i < bin1.count; i++) {
+        polygon_to_path(*operand1->items[bin1[i]], scaling, paths1[i]);
+    }
+    ClipperLib::Paths& paths2 = scratch.paths2;
+    paths2.resize(bin2.count);
+    for (uint64_t i = 0; i < bin2.count; i++) {
+        polygon_to_path(*operand2->items[bin2[i]], scaling, paths2[i]);
+    }
+
+    ClipperLib::Clipper& clpr = scratch.clipper;
+    ClipperLib::Paths& solution = scratch.contours;
+    if (is_manhattan(paths1) && is_manhattan(paths2)) {
+        manhattan_boolean(paths1, paths2, operation, scratch.manhattan, solution);
+    } else {
+        clpr.AddPaths(paths1, ClipperLib::ptSubject, true);
+        clpr.AddPaths(paths2, ClipperLib::ptClip, true);
+        clpr.Execute(clip_type(operation), solution, ClipperLib::pftNonZero,
+                     ClipperLib::pftNonZero);
+    }
+    if (solution.size() == 0) return ErrorCode::NoError;
+
+    // Cut the solution at the tile boundary
+    const ClipperLib::cInt x0 = origin_x + (int64_t)(tile % columns) * tile_size;
+    const ClipperLib::cInt y0 = origin_y + (int64_t)(tile / columns) * tile_size;
+    const ClipperLib::cInt x1 = x0 + tile_size;
+    const ClipperLib::cInt y1 = y0 + tile_size;
+    ClipperLib::Path rectangle(4);
+    rectangle[0] = ClipperLib::IntPoint(x0, y0);
+    rectangle[1] = ClipperLib::IntPoint(x1, y0);
+    rectangle[2] = ClipperLib::IntPoint(x1, y1);
+    rectangle[3] = ClipperLib::IntPoint(x0, y1);
+    clpr.Clear();
+    clpr.AddPaths(solution, ClipperLib::ptSubject, true);
+    clpr.AddPath(rectangle, ClipperLib::ptClip, true);
+    ClipperLib::PolyTree& tree = scratch.tree;
+    tree.Clear();
+    clpr.Execute(ClipperLib::ctIntersection, tree, ClipperLib::pftNonZero,
+                 ClipperLib::pftNonZero);
+
+    category.restore();
+    ErrorCode error_code = ErrorCode::NoError;
+    if (!border) {
+        tree_to_polygons(tree, scaling, result, error_code);
+        return error_code;
+    }
+
+    // Pieces touching internal tile boundaries go to border unlinked: outer
+    // contours and holes keep their orientation for merge
+    const uint64_t column = tile % columns;
+    const uint64_t row = tile / columns;
+    ClipperLib::PolyNode* node = tree.GetFirst();
+    while (node) {
+        if (!node->IsHole()) {
+            ClipperLib::cInt bb[4];
+            bounding_box(node->Contour, bb);
+            if ((column > 0 && bb[0] <= x0) || (column < columns - 1 && bb[1] >= x1) ||
+                (row > 0 && bb[2] <= y0) || (row < rows - 1 && bb[3] >= y1)) {
+                border->append(path_to_polygon(node->Contour, scaling));
+                for (ClipperLib::PolyNodes::iterator child = node->Childs.begin();
+                     child != node->Childs.end(); child++) {
+                    border->append(path_to_polygon((*child)->Contour, scaling));
+                }
+            } else {
+                if (node->ChildCount() > 0) link_holes(node, error_code);
+                result.append(path_to_polygon(node->Contour, scaling));
+            }
+        }
+        node = node->GetNext();
+    }
+    return error_code;
+}
+
+ErrorCode BooleanTiles::merge(Array<Polygon*>* borders, Array<Polygon*>& result) const {
+    TraceSpan span("boolean:merge");
+    MemoryCategoryScope category(MemoryCategory::Clipper);
+    ClipperLib::Paths paths;
+    for (uint64_t tile = 0; tile < columns * rows; tile++) {
+        Array<Polygon*>& border = borders[tile];
+        for (uint64_t i = 0; i < border.count; i++) {
+            // Orientation must be preserved, so polygon_to_path is not used
+            const Array<Vec2>& points = border[i]->point_array;
+            ClipperLib::Path path(points.count);
+            for (uint64_t j = 0; j < points.count; j++) {
+                path[j].X = llround(scaling * points[j].x);
+                path[j].Y = llround(scaling * points[j].y);
+            }
+            paths.push_back(path);
+            border[i]->clear();
+            free_allocation(border[i]);
+        }
+        border.clear();
+    }
+    if (paths.size() == 0) return ErrorCode::NoError;
+
+    ClipperLib::Clipper clpr;
+    clpr.AddPaths(paths, ClipperLib::ptSubject, true);
+    ClipperLib::Paths solution;
+    clpr.Execute(ClipperLib::ctUnion, solution, ClipperLib::pftNonZero, ClipperLib::pftNonZero);
+
+    // Contours from different tiles share edges along the cuts, so holes are
+    // not assigned through a PolyTree
+    return contours_to_polygons(solution, scaling, result, category);
+}
+
 ErrorCode offset(const Array<Polygon*>& polygons, double distance, OffsetJoin join,
-                 double tolerance, double scaling, bool use_union, Array<Polygon*>& result) {
+                 double tolerance, double scaling, bool use_union, Array<Polygon*>& result,
+                 GeometryContext* context) {
+    TraceSpan span("offset");
+    MemoryCategoryScope category(MemoryCategory::Clipper);
+    GeometryScratch local;
+    GeometryScratch& scratch = get_scratch(context, local);
+
     ClipperLib::JoinType jt_join = ClipperLib::jtSquare;
-    ClipperLib::ClipperOffset clprof;
+    ClipperLib::ClipperOffset& clprof = scratch.clipper_offset;
+    clprof.Clear();
+    clprof.MiterLimit = 2.0;
+    clprof.ArcTolerance = 0.25;
     switch (join) {
         case OffsetJoin::Bevel:
             jt_join = ClipperLib::jtSquare;
@@ -250,69 +1304,399 @@ ErrorCode offset(const Array<Polygon*>& polygons, double distance, OffsetJoin jo
             clprof.ArcTolerance = distance * scaling * (1.0 - cos(M_PI / tolerance));
     }
 
-    ClipperLib::Paths original_polys = polygons_to_paths(polygons, scaling);
+    ClipperLib::Paths& original_polys = scratch.paths1;
+    polygons_to_paths(polygons, scaling, original_polys);
+    if (update_progress(1, 3)) return ErrorCode::Cancelled;
+
+    // Clipper rounds each offset vertex to the grid, which, for Manhattan
+    // paths with miter joins, is the same as rounding the distance (except
+    // at ties)
+    const double scaled_distance = distance * scaling;
+    const ClipperLib::cInt r = llround(scaled_distance);
+    if (join == OffsetJoin::Miter && fabs(fabs(scaled_distance - r) - 0.5) > 1e-6 &&
+        is_manhattan(original_polys)) {
+        ClipperLib::Paths& contours = scratch.contours;
+        contours.clear();
+        manhattan_offset(original_polys, r, use_union, scratch.manhattan, contours);
+        if (update_progress(2, 3)) return ErrorCode::Cancelled;
+        ErrorCode error_code = contours_to_polygons(contours, scaling, result, category);
+        update_progress(3, 3);
+        return error_code;
+    }
+    ClipperLib::PolyTree& solution = scratch.tree;
     if (use_union) {
-        ClipperLib::Clipper clpr;
-        clpr.AddPaths(original_polys, ClipperLib::ptSubject, true);
-        ClipperLib::PolyTree joined_tree;
-        clpr.Execute(ClipperLib::ctUnion, joined_tree, ClipperLib::pftNonZero,
-                     ClipperLib::pftNonZero);
-        ClipperLib::Paths joined_polys;
-        ClipperLib::PolyTreeToPaths(joined_tree, joined_polys);
+        ClipperLib::Paths& joined_polys = scratch.paths2;
+        if (!balanced_union(polygons, scaling, joined_polys)) {
+            ClipperLib::Clipper& clpr = scratch.clipper;
+            clpr.Clear();
+            clpr.AddPaths(original_polys, ClipperLib::ptSubject, true);
+            clpr.Execute(ClipperLib::ctUnion, joined_polys, ClipperLib::pftNonZero,
+                         ClipperLib::pftNonZero);
+        }
         clprof.AddPaths(joined_polys, jt_join, ClipperLib::etClosedPolygon);
     } else {
         clprof.AddPaths(original_polys, jt_join, ClipperLib::etClosedPolygon);
     }
 
-    ClipperLib::PolyTree solution;
     clprof.Execute(solution, distance * scaling);
+    if (update_progress(2, 3)) return ErrorCode::Cancelled;
 
+    category.restore();
     ErrorCode error_code = ErrorCode::NoError;
     tree_to_polygons(solution, scaling, result, error_code);
+    update_progress(3, 3);
     return error_code;
 }
 
+// Slabs containing coordinate x: slab i spans [cuts[i - 1], cuts[i]], with
+// the first and last slabs unbounded.  Coordinates on a cut belong to both
+// neighboring slabs.
+static void slab_range(const ClipperLib::cInt* cuts, uint64_t count, ClipperLib::cInt x,
+                       uint64_t& first, uint64_t& last) {
+    uint64_t lo = 0;
+    uint64_t hi = count;
+    while (lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        if (cuts[mid] < x)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    first = lo;
+    while (hi < count && cuts[hi] <= x) hi++;
+    last = hi;
+}
+
+// Crossing of segment p0-p1 with the vertical line at x
+static inline ClipperLib::IntPoint cut_point(const ClipperLib::IntPoint p0,
+                                             const ClipperLib::IntPoint p1, ClipperLib::cInt x) {
+    const double u = (double)(x - p0.X) / (double)(p1.X - p0.X);
+    return ClipperLib::IntPoint(x, p0.Y + llround(u * (double)(p1.Y - p0.Y)));
+}
+
 ErrorCode slice(const Polygon& polygon, const Array<double>& positions, bool x_axis, double scaling,
-                Array<Polygon*>* result) {
+                Array<Polygon*>* result, GeometryContext* context) {
     ErrorCode error_code = ErrorCode::NoError;
-    ClipperLib::Paths subj;
-    subj.push_back(polygon_to_path(polygon, scaling));
-
-    ClipperLib::cInt bb[4];
-    bounding_box(subj[0], bb);
-
-    ClipperLib::Paths clip(1, ClipperLib::Path(4));
-    clip[0][0].X = clip[0][3].X = bb[0];
-    clip[0][1].X = clip[0][2].X = bb[1];
-    clip[0][0].Y = clip[0][1].Y = bb[2];
-    clip[0][2].Y = clip[0][3].Y = bb[3];
-
-    ClipperLib::cInt pos = x_axis ? bb[0] : bb[2];
-    for (uint64_t i = 0; i <= positions.count; i++) {
-        if (x_axis) {
-            clip[0][0].X = clip[0][3].X = pos;
-            pos = i < positions.count ? llround(scaling * positions[i]) : bb[1];
-            clip[0][1].X = clip[0][2].X = pos;
-        } else {
-            clip[0][0].Y = clip[0][1].Y = pos;
-            pos = i < positions.count ? llround(scaling * positions[i]) : bb[3];
-            clip[0][2].Y = clip[0][3].Y = pos;
+    GeometryScratch local;
+    GeometryScratch& scratch = get_scratch(context, local);
+    scratch.paths1.resize(1);
+    ClipperLib::Path& path = scratch.paths1[0];
+    polygon_to_path(polygon, scaling, path);
+    if (path.size() == 0) return error_code;
+
+    // Work with cuts along X: swap the coordinates for horizontal cuts
+    if (!x_axis) {
+        for (ClipperLib::Path::iterator p = path.begin(); p != path.end(); p++) {
+            ClipperLib::cInt tmp = p->X;
+            p->X = p->Y;
+            p->Y = tmp;
         }
+    }
 
-        // NOTE: ioStrictlySimple seems to hang on complex layouts
-        // ClipperLib::Clipper clpr(ClipperLib::ioStrictlySimple);
-        ClipperLib::Clipper clpr;
-        clpr.AddPaths(subj, ClipperLib::ptSubject, true);
-        clpr.AddPaths(clip, ClipperLib::ptClip, true);
+    const uint64_t num_cuts = positions.count;
+    Array<ClipperLib::cInt>& cut_array = scratch.manhattan.ordinates;
+    cut_array.count = 0;
+    cut_array.ensure_slots(num_cuts);
+    ClipperLib::cInt* cuts = cut_array.items;
+    for (uint64_t i = 0; i < num_cuts; i++) cuts[i] = llround(scaling * positions[i]);
 
-        ClipperLib::PolyTree solution;
-        clpr.Execute(ClipperLib::ctIntersection, solution, ClipperLib::pftNonZero,
-                     ClipperLib::pftNonZero);
+    // Single sweep along the contour.  The intersection of the polygon with a
+    // slab is the polygon with every vertex clamped to the slab: clamped runs
+    // of vertices lie on a cut line and enclose no area.  After adding the
+    // crossings of every edge with the cuts, such runs start and end at a
+    // crossing, so the clamped contour of a slab is simply the subsequence of
+    // vertices within it.
+    ClipperLib::Paths& slabs = scratch.paths2;
+    slabs.resize(num_cuts + 1);
+    for (uint64_t i = 0; i <= num_cuts; i++) slabs[i].clear();
+    ClipperLib::IntPoint p0 = path.back();
+    uint64_t first0, last0;
+    slab_range(cuts, num_cuts, p0.X, first0, last0);
+    for (ClipperLib::Path::iterator p = path.begin(); p != path.end(); p++) {
+        const ClipperLib::IntPoint p1 = *p;
+        uint64_t first1, last1;
+        slab_range(cuts, num_cuts, p1.X, first1, last1);
+        if (last0 < first1) {
+            for (uint64_t i = last0; i < first1; i++) {
+                const ClipperLib::IntPoint c = cut_point(p0, p1, cuts[i]);
+                slabs[i].push_back(c);
+                slabs[i + 1].push_back(c);
+            }
+        } else if (last1 < first0) {
+            for (uint64_t i = first0; i > last1; i--) {
+                const ClipperLib::IntPoint c = cut_point(p0, p1, cuts[i - 1]);
+                slabs[i - 1].push_back(c);
+                slabs[i].push_back(c);
+            }
+        }
+        for (uint64_t i = first1; i <= last1; i++) slabs[i].push_back(p1);
+        p0 = p1;
+        first0 = first1;
+        last0 = last1;
+    }
+
+    for (uint64_t i = 0; i <= num_cuts; i++) {
+        ClipperLib::Path& slab = slabs[i];
+        if (slab.size() < 3) continue;
+        if (!x_axis) {
+            for (ClipperLib::Path::iterator p = slab.begin(); p != slab.end(); p++) {
+                ClipperLib::cInt tmp = p->X;
+                p->X = p->Y;
+                p->Y = tmp;
+            }
+        }
 
+        // Each slab only holds its own part of the polygon, so cleaning it
+        // up with Clipper does not revisit the whole contour
+        ClipperLib::Clipper& clpr = scratch.clipper;
+        clpr.Clear();
+        clpr.AddPath(slab, ClipperLib::ptSubject, true);
+        ClipperLib::PolyTree& solution = scratch.tree;
+        solution.Clear();
+        clpr.Execute(ClipperLib::ctUnion, solution, ClipperLib::pftNonZero,
+                     ClipperLib::pftNonZero);
         tree_to_polygons(solution, scaling, result[i], error_code);
     }
 
     return error_code;
 }
 
+// Trapezoid decomposition: a scanline over the ordinates of the vertices of
+// the united contours, which have no crossing edges.  In every slab between
+// consecutive ordinates the edges are sorted by abscissa and paired into
+// filled spans by the non-zero rule.  A span whose left and right sides lie
+// on the same lines as a span of the previous slab extends its trapezoid,
+// so trapezoids are only cut where one of their sides ends.
+
+// Non-horizontal edge from (x0, y0) to (x1, y1), with y0 < y1.  Consecutive
+// collinear edges of a contour share the same line.
+struct TrapezoidEdge {
+    ClipperLib::cInt x0;
+    ClipperLib::cInt y0;
+    ClipperLib::cInt x1;
+    ClipperLib::cInt y1;
+    int32_t winding;
+    uint64_t line;
+};
+
+// Trapezoid between edges left and right, from ordinate y (where its sides
+// are at x_left and x_right) up to the current scanline
+struct OpenTrapezoid {
+    uint64_t left;
+    uint64_t right;
+    ClipperLib::cInt y;
+    ClipperLib::cInt x_left;
+    ClipperLib::cInt x_right;
+    bool kept;
+};
+
+// Active edge with its abscissa in the middle of the current slab
+struct ActiveEdge {
+    double x;
+    uint64_t edge;
+};
+
+static bool trapezoid_edge_sorted(const TrapezoidEdge& a, const TrapezoidEdge& b) {
+    return a.y0 < b.y0;
+}
+
+static bool active_edge_sorted(const ActiveEdge& a, const ActiveEdge& b) { return a.x < b.x; }
+
+static inline ClipperLib::cInt edge_x(const TrapezoidEdge& edge, ClipperLib::cInt y) {
+    if (y == edge.y0) return edge.x0;
+    if (y == edge.y1) return edge.x1;
+    const double u = (double)(y - edge.y0) / (double)(edge.y1 - edge.y0);
+    return edge.x0 + llround(u * (double)(edge.x1 - edge.x0));
+}
+
+// Edge b follows edge a along the same line
+static inline bool edge_continues(const TrapezoidEdge& a, const TrapezoidEdge& b) {
+    return a.winding == b.winding &&
+           (double)(a.x1 - a.x0) * (double)(b.y1 - b.y0) ==
+               (double)(b.x1 - b.x0) * (double)(a.y1 - a.y0) &&
+           (a.winding > 0 ? (a.x1 == b.x0 && a.y1 == b.y0) : (b.x1 == a.x0 && b.y1 == a.y0));
+}
+
+static void append_trapezoid_edges(const ClipperLib::Path& path, bool swap,
+                                   Array<TrapezoidEdge>& edges) {
+    if (path.size() < 3) return;
+    const uint64_t first = edges.count;
+    ClipperLib::IntPoint p0 = path.back();
+    if (swap) p0 = ClipperLib::IntPoint(p0.Y, p0.X);
+    for (ClipperLib::Path::const_iterator p = path.begin(); p != path.end(); p++) {
+        const ClipperLib::IntPoint p1 = swap ? ClipperLib::IntPoint(p->Y, p->X) : *p;
+        if (p0.Y != p1.Y) {
+            if (p0.Y < p1.Y) {
+                edges.append(TrapezoidEdge{p0.X, p0.Y, p1.X, p1.Y, 1, edges.count});
+            } else {
+                edges.append(TrapezoidEdge{p1.X, p1.Y, p0.X, p0.Y, -1, edges.count});
+            }
+            TrapezoidEdge* edge = edges.items + edges.count - 1;
+            if (edges.count > first + 1 && edge_continues(edge[-1], edge[0]))
+                edge->line = edge[-1].line;
+        }
+        p0 = p1;
+    }
+    if (edges.count < first + 2) return;
+    // The contour may start in the middle of a line
+    const uint64_t last = edges.count - 1;
+    if (edge_continues(edges[last], edges[first])) {
+        const uint64_t line = edges[first].line;
+        for (uint64_t i = first; i <= last && edges[i].line == line; i++)
+            edges[i].line = edges[last].line;
+    }
+}
+
+static void close_trapezoid(const OpenTrapezoid& trapezoid, ClipperLib::cInt y, bool swap,
+                            const Array<TrapezoidEdge>& edges, Array<IntVec2>& result) {
+    const ClipperLib::cInt x_left = edge_x(edges[trapezoid.left], y);
+    const ClipperLib::cInt x_right = edge_x(edges[trapezoid.right], y);
+    if (trapezoid.x_left >= trapezoid.x_right && x_left >= x_right) return;
+    if (swap) {
+        // Mirrored coordinates: reverse the corners to keep the orientation
+        result.append(IntVec2{trapezoid.y, trapezoid.x_left});
+        result.append(IntVec2{y, x_left});
+        result.append(IntVec2{y, x_right});
+        result.append(IntVec2{trapezoid.y, trapezoid.x_right});
+    } else {
+        result.append(IntVec2{trapezoid.x_left, trapezoid.y});
+        result.append(IntVec2{trapezoid.x_right, trapezoid.y});
+        result.append(IntVec2{x_right, y});
+        result.append(IntVec2{x_left, y});
+    }
+}
+
+// Append the corners of the trapezoids of contours to result, with parallel
+// horizontal sides, or vertical if swap is true.  Return the number of
+// trapezoids.
+static uint64_t trapezoid_sweep(const ClipperLib::Paths& contours, bool swap,
+                                Array<IntVec2>& result) {
+    const uint64_t start = result.count;
+    Array<TrapezoidEdge> edges = {};
+    for (ClipperLib::Paths::const_iterator path = contours.begin(); path != contours.end(); path++)
+        append_trapezoid_edges(*path, swap, edges);
+    if (edges.count == 0) return 0;
+    sort(edges.items, edges.count, trapezoid_edge_sorted);
+
+    Array<ClipperLib::cInt> ys = {};
+    ys.ensure_slots(2 * edges.count);
+    for (uint64_t i = 0; i < edges.count; i++) {
+        ys.append_unsafe(edges[i].y0);
+        ys.append_unsafe(edges[i].y1);
+    }
+    sort(ys.items, ys.count, cint_sorted);
+    uint64_t num_ys = 1;
+    for (uint64_t i = 1; i < ys.count; i++)
+        if (ys[i] != ys[num_ys - 1]) ys[num_ys++] = ys[i];
+    ys.count = num_ys;
+
+    // Index in open of the trapezoid with its left side on each line
+    uint64_t* slot = (uint64_t*)allocate_clear(sizeof(uint64_t) * edges.count);
+    Array<ActiveEdge> active = {};
+    Array<OpenTrapezoid> open = {};
+    Array<OpenTrapezoid> next_open = {};
+    uint64_t next_edge = 0;
+    for (uint64_t k = 0; k < ys.count; k++) {
+        const ClipperLib::cInt y = ys[k];
+        uint64_t j = 0;
+        for (uint64_t i = 0; i < active.count; i++)
+            if (edges[active[i].edge].y1 > y) active[j++] = active[i];
+        active.count = j;
+        while (next_edge < edges.count && edges[next_edge].y0 == y)
+            active.append(ActiveEdge{0, next_edge++});
+
+        next_open.count = 0;
+        if (k + 1 < ys.count && active.count > 0) {
+            const double mid = 0.5 * ((double)y + (double)ys[k + 1]);
+            for (uint64_t i = 0; i < active.count; i++) {
+                const TrapezoidEdge& edge = edges[active[i].edge];
+                const double u = (mid - edge.y0) / (double)(edge.y1 - edge.y0);
+                active[i].x = edge.x0 + u * (double)(edge.x1 - edge.x0);
+            }
+            // The order only changes at vertices
+            insertion_sort(active.items, active.count, active_edge_sorted);
+
+            int32_t winding = 0;
+            uint64_t left = 0;
+            for (uint64_t i = 0; i < active.count; i++) {
+                const uint64_t e = active[i].edge;
+                if (winding == 0) left = e;
+                winding += edges[e].winding;
+                if (winding != 0) continue;
+                const uint64_t t = slot[edges[left].line];
+                if (t < open.count && !open[t].kept &&
+                    edges[open[t].left].line == edges[left].line &&
+                    edges[open[t].right].line == edges[e].line) {
+                    OpenTrapezoid trapezoid = open[t];
+                    open[t].kept = true;
+                    trapezoid.left = left;
+                    trapezoid.right = e;
+                    next_open.append(trapezoid);
+                } else {
+                    next_open.append(OpenTrapezoid{left, e, y, edge_x(edges[left], y),
+                                                   edge_x(edges[e], y), false});
+                }
+            }
+        }
+
+        for (uint64_t i = 0; i < open.count; i++)
+            if (!open[i].kept) close_trapezoid(open[i], y, swap, edges, result);
+
+        Array<OpenTrapezoid> swap_open = open;
+        open = next_open;
+        next_open = swap_open;
+        for (uint64_t i = 0; i < open.count; i++) slot[edges[open[i].left].line] = i;
+    }
+
+    free_allocation(slot);
+    active.clear();
+    open.clear();
+    next_open.clear();
+    ys.clear();
+    edges.clear();
+    return (result.count - start) / 4;
+}
+
+// Decompose the union of paths in whichever direction needs fewer trapezoids
+static void trapezoid_decomposition(const ClipperLib::Paths& paths, Array<IntVec2>& result) {
+    GeometryScratch scratch;
+    ClipperLib::Paths& contours = scratch.contours;
+    unite(paths, scratch.paths2, scratch, contours);
+
+    const uint64_t start = result.count;
+    const uint64_t horizontal = trapezoid_sweep(contours, false, result);
+    if (horizontal <= 1) return;
+    Array<IntVec2> vertical = {};
+    if (trapezoid_sweep(contours, true, vertical) < horizontal) {
+        result.count = start;
+        result.extend(vertical);
+    }
+    vertical.clear();
+}
+
+ErrorCode trapezoids(const Array<Polygon*>& polygons, double scaling, Array<Polygon*>& result) {
+    ClipperLib::Paths paths;
+    polygons_to_paths(polygons, scaling, paths);
+    Array<IntVec2> corners = {};
+    trapezoid_decomposition(paths, corners);
+
+    const double invscaling = 1 / scaling;
+    result.ensure_slots(corners.count / 4);
+    for (uint64_t i = 0; i < corners.count; i += 4) {
+        const IntVec2* corner = corners.items + i;
+        Polygon* polygon = (Polygon*)allocate_clear(sizeof(Polygon));
+        polygon->point_array.ensure_slots(4);
+        for (uint64_t j = 0; j < 4; j++) {
+            // Triangles repeat a corner
+            const IntVec2 c = corner[j];
+            const IntVec2 next = corner[(j + 1) % 4];
+            if (c.x == next.x && c.y == next.y) continue;
+            polygon->point_array.append_unsafe(Vec2{invscaling * c.x, invscaling * c.y});
+        }
+        result.append_unsafe(polygon);
+    }
+    corners.clear();
+    return ErrorCode::NoError;
+}
+
 }  // namespace gdstk
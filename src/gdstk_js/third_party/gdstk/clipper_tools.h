@@ -22,14 +22,49 @@ enum struct Operation { Or, And, Xor, Not };
 enum struct OffsetJoin { Miter, Bevel, Round };
 enum struct ShortCircuit { None, Any, All };
 
+// Upper bound on the number of tiles of a BooleanTiles grid: the tile size is
+// increased if needed
+#define GDSTK_BOOLEAN_MAX_TILES (1 << 20)
+
 // The following operations are executed in an integer grid of vertices, so the
 // geometry should be scaled by a large enough factor to garante a minimal
 // precision level.  However, if the scaling factor is too large, it may cause
 // overflow of coordinates.  Resulting polygons are appended to result.
-
-// Boolean (clipping) operations on polygons
+//
+// When all edges are horizontal or vertical after scaling (Manhattan
+// geometry), boolean and offset with miter joins use an exact scanline over
+// the vertical edges instead of Clipper.
+
+struct GeometryScratch;
+
+// Scratch storage for boolean, offset and slice (integer paths, clipper
+// engines and scanline buffers) that is kept between calls, so that a batch
+// of many small operations does not rebuild it from scratch every time.
+// Usage:
+//
+// GeometryContext context = {};
+// for (…) boolean(polys1, polys2, operation, scaling, result, &context);
+// context.clear();
+//
+// The storage is created by the first call and holds on to the largest
+// buffers used so far until clear.  A context must not be used by more than
+// one thread at a time.  Operations called without a context use temporary
+// storage.
+struct GeometryContext {
+    GeometryScratch* scratch;
+
+    void clear();
+};
+
+// Boolean (clipping) operations on polygons.  Unions of more than
+// GDSTK_UNION_GROUP_POINTS vertices go through BalancedUnion.
 ErrorCode boolean(const Array<Polygon*>& polys1, const Array<Polygon*>& polys2, Operation operation,
-                  double scaling, Array<Polygon*>& result);
+                  double scaling, Array<Polygon*>& result, GeometryContext* context);
+
+inline ErrorCode boolean(const Array<Polygon*>& polys1, const Array<Polygon*>& polys2,
+                         Operation operation, double scaling, Array<Polygon*>& result) {
+    return boolean(polys1, polys2, operation, scaling, result, NULL);
+}
 
 inline ErrorCode boolean(const Polygon& poly1, const Array<Polygon*>& polys2, Operation operation,
                          double scaling, Array<Polygon*>& result) {
@@ -60,12 +95,130 @@ inline ErrorCode merge(const Array<Polygon*>& polygons, double scaling, Array<Po
     return boolean(polygons, empty, Operation::Or, scaling, result);
 }
 
+// Boolean operation split into square tiles that can be processed
+// independently (concurrently, for example), so that each clipping sweep
+// only holds the geometry of a single tile.  Usage:
+//
+// BooleanTiles tiles = {};
+// tiles.init(polys1, polys2, operation, scaling, tile_size);
+// for (uint64_t i = 0; i < tiles.count(); i++) tiles.run(i, result, borders + i);
+// tiles.merge(borders, result);
+// tiles.clear();
+//
+// Polygons in the results of run are cut at the tile boundaries.  Pieces that
+// touch internal tile boundaries can be set aside in border arrays instead,
+// to be united by merge, so that the final result is equivalent to
+// boolean(polys1, polys2, operation, scaling, result).
+struct BooleanTiles {
+    const Array<Polygon*>* operand1;
+    const Array<Polygon*>* operand2;
+    Operation operation;
+    double scaling;
+
+    // Tile grid in scaled (integer) coordinates
+    int64_t origin_x;
+    int64_t origin_y;
+    int64_t tile_size;
+    uint64_t columns;
+    uint64_t rows;
+
+    // Indices of the polygons of each operand whose bounding boxes intersect
+    // each tile (columns * rows arrays, in row-major order)
+    Array<uint64_t>* bins1;
+    Array<uint64_t>* bins2;
+
+    // Operands must not be modified or freed before clear.  Tiles have
+    // tile_size side (in polygon coordinates, before scaling).
+    void init(const Array<Polygon*>& polys1, const Array<Polygon*>& polys2, Operation operation_,
+              double scaling_, double tile_size_);
+
+    void clear();
+
+    uint64_t count() const { return columns * rows; }
+
+    // Append the result of the operation within tile to result.  If border is
+    // not NULL, pieces that touch internal tile boundaries are appended to it
+    // instead, as separate outer contours and holes (with opposite
+    // orientations), which are only meant to be passed to merge.  Different
+    // tiles can run concurrently.
+    ErrorCode run(uint64_t tile, Array<Polygon*>& result, Array<Polygon*>* border) const;
+
+    // Unite the contours in all count() border arrays (filled by run) and
+    // append the resulting polygons to result.  Border arrays are emptied.
+    ErrorCode merge(Array<Polygon*>* borders, Array<Polygon*>& result) const;
+};
+
+// Groups of united polygons in BalancedUnion are closed once they hold this
+// many vertices
+#define GDSTK_UNION_GROUP_POINTS 4096
+
+// Non-convex polygons up to this many vertices are checked for self
+// intersections side by side; larger ones go through a sweep
+#define GDSTK_UNION_SIMPLE_TEST_POINTS 64
+
+struct UnionPart;
+
+// Union of many polygons by divide and conquer.  Polygons are sorted by the
+// Morton code of the centers of their bounding boxes and united in groups of
+// about GDSTK_UNION_GROUP_POINTS vertices, then the partial results are united
+// pairwise, level by level, until one is left.  Every union only holds
+// spatially close geometry, so sweeps keep short lists of active edges, and
+// contours of a pair that cannot touch the other part are not swept again.
+// Usage:
+//
+// BalancedUnion tree = {};
+// tree.init(polygons, scaling);
+// do {
+//     for (uint64_t i = 0; i < tree.count(); i++) tree.run(i);
+// } while (tree.next());
+// tree.finish(result);
+// tree.clear();
+//
+// Calls to run in the same level can be concurrent.  The result covers the
+// same area as merge(polygons, scaling, result).
+struct BalancedUnion {
+    double scaling;
+    uint64_t level;
+    uint64_t num_parts;
+    UnionPart* parts;
+    // Set by init, without building any part, if a self intersecting polygon
+    // has negatively wound regions.  Those cancel other polygons in a single
+    // non-zero sweep, but not across separate unions, so the caller must
+    // unite the polygons in one sweep instead.
+    bool single_sweep;
+
+    // Polygons are converted in init, so they can be modified or freed
+    // afterwards
+    void init(const Array<Polygon*>& polygons, double scaling_);
+
+    void clear();
+
+    // Number of unions in the current level
+    uint64_t count() const { return level == 0 ? num_parts : num_parts / 2; }
+
+    // Run union i of the current level
+    void run(uint64_t i);
+
+    // Advance to the next level.  Return false if there is none.
+    bool next();
+
+    // Append the polygons of the final union to result
+    ErrorCode finish(Array<Polygon*>& result);
+};
+
 // Dilates or erodes polygons acording to distance (negative distance results
 // in erosion).  The effects of internal polygon edges (in polygons with holes,
-// for example) can be suppressed by setting use_union to true.  Resulting
-// polygons are appended to result.
+// for example) can be suppressed by setting use_union to true (the union is
+// a BalancedUnion).  Resulting polygons are appended to result.
 ErrorCode offset(const Array<Polygon*>& polys, double distance, OffsetJoin join, double tolerance,
-                 double scaling, bool use_union, Array<Polygon*>& result);
+                 double scaling, bool use_union, Array<Polygon*>& result,
+                 GeometryContext* context);
+
+inline ErrorCode offset(const Array<Polygon*>& polys, double distance, OffsetJoin join,
+                        double tolerance, double scaling, bool use_union,
+                        Array<Polygon*>& result) {
+    return offset(polys, distance, join, tolerance, scaling, use_union, result, NULL);
+}
 
 inline ErrorCode offset(const Polygon& poly, double distance, OffsetJoin join, double tolerance,
                         double scaling, bool use_union, Array<Polygon*>& result) {
@@ -74,12 +227,28 @@ inline ErrorCode offset(const Polygon& poly, double distance, OffsetJoin join, d
     return offset(polys, distance, join, tolerance, scaling, use_union, result);
 }
 
-// Slice the given polygon along the coordinates in posiotions.  Cuts are
-// vertical (horizontal) when x_axis is set to true (false).  Argument result
-// must be an array with length at least positions.count + 1.  The resulting
-// slices are appendend to the arrays in their respective bins.
+// Slice the given polygon along the coordinates in posiotions, which must be
+// sorted in ascending order.  Cuts are vertical (horizontal) when x_axis is
+// set to true (false).  Argument result must be an array with length at least
+// positions.count + 1.  The resulting slices are appendend to the arrays in
+// their respective bins.  All cuts are made in a single pass over the polygon,
+// so the cost grows with the number of vertices plus crossings, not with the
+// number of vertices times the number of cuts.
 ErrorCode slice(const Polygon& polygon, const Array<double>& positions, bool x_axis, double scaling,
-                Array<Polygon*>* result);
+                Array<Polygon*>* result, GeometryContext* context);
+
+inline ErrorCode slice(const Polygon& polygon, const Array<double>& positions, bool x_axis,
+                       double scaling, Array<Polygon*>* result) {
+    return slice(polygon, positions, x_axis, scaling, result, NULL);
+}
+
+// Decompose polygons into trapezoids with 2 horizontal or 2 vertical sides
+// (including rectangles and triangles), following the non-zero fill rule.
+// The polygons are united first, and trapezoids are only cut where one of
+// their slanted sides ends, with the direction (horizontal or vertical
+// parallel sides) chosen to minimize the count.  Vertices are rounded to the
+// integer grid after scaling.  Resulting polygons are appended to result.
+ErrorCode trapezoids(const Array<Polygon*>& polygons, double scaling, Array<Polygon*>& result);
 
 }  // namespace gdstk
 
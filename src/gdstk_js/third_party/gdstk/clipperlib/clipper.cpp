@@ -1257,7 +1257,7 @@ void ClipperBase::Reset()
   if (m_CurrentLM == m_MinimaList.end()) return; //ie nothing to process
   std::sort(m_MinimaList.begin(), m_MinimaList.end(), LocMinSorter());
 
-  m_Scanbeam = ScanbeamList(); //clears/resets priority_queue
+  m_Scanbeam.clear(); //clears/resets priority_queue (keeping its storage)
   //reset all edges ...
   for (MinimaList::iterator lm = m_MinimaList.begin(); lm != m_MinimaList.end(); ++lm)
   {
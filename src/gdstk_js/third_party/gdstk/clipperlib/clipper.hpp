@@ -255,7 +255,11 @@ protected:
   PolyOutList       m_PolyOuts;
   TEdge           *m_ActiveEdges;
 
-  typedef std::priority_queue<cInt> ScanbeamList;
+  // priority_queue that can be emptied without releasing its storage, so a
+  // Clipper reused through Clear keeps its scanbeam capacity
+  struct ScanbeamList : public std::priority_queue<cInt> {
+    void clear() { c.clear(); }
+  };
   ScanbeamList     m_Scanbeam;
 };
 //------------------------------------------------------------------------------
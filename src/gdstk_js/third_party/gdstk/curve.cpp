@@ -459,13 +459,17 @@ void Curve::arc(double radius_x, double radius_y, double initial_angle, double f
     last_ctrl = point_array[point_array.count - 1] + v;
 }
 
-void Curve::parametric(ParametricVec2 curve_function, void* data, bool relative) {
+void Curve::parametric(ParametricVec2 curve_function, void* data, bool relative,
+                       Array<double>* parameters) {
     const Vec2 last_curve_point = point_array[point_array.count - 1];
     const Vec2 ref = relative ? last_curve_point : Vec2{0, 0};
     const double tolerance_sq = tolerance * tolerance;
     double u = 0;
     Vec2 last = (*curve_function)(0, data) + ref;
-    if ((last - last_curve_point).length_sq() > tolerance_sq) append(last);
+    if ((last - last_curve_point).length_sq() > tolerance_sq) {
+        append(last);
+        if (parameters) parameters->append(0);
+    }
     double du = 1.0 / GDSTK_MIN_POINTS;
     while (u < 1) {
         if (du > 1.0 / GDSTK_MIN_POINTS) du = 1.0 / GDSTK_MIN_POINTS;
@@ -488,12 +492,128 @@ void Curve::parametric(ParametricVec2 curve_function, void* data, bool relative)
             }
         }
         append(next);
+        if (parameters) parameters->append(u + du);
         last = next;
         u += du;
         du *= 2;
     }
 }
 
+// Interval [u0, u0 + du] of a batched parametric evaluation.  The test samples
+// at u0 + du / 2 and u0 + du / 3 are stored at index sample in the results of
+// the last batch, or sample is UINT64_MAX if the interval has been accepted.
+struct ParametricInterval {
+    double u0;
+    double du;
+    Vec2 p0;
+    Vec2 p1;
+    uint64_t sample;
+};
+
+void Curve::parametric(ParametricVec2Batch curve_function, void* data, bool relative,
+                       Array<double>* parameters) {
+    const Vec2 last_curve_point = point_array[point_array.count - 1];
+    const Vec2 ref = relative ? last_curve_point : Vec2{0, 0};
+    const double tolerance_sq = tolerance * tolerance;
+    const double du = 1.0 / GDSTK_MIN_POINTS;
+
+    Array<double> u_array = {};
+    Array<Vec2> v_array = {};
+    Array<ParametricInterval> intervals = {};
+    Array<ParametricInterval> next_intervals = {};
+
+    // First batch: the initial point, plus end point and test samples for each
+    // of the GDSTK_MIN_POINTS starting intervals.
+    u_array.ensure_slots(1 + 3 * GDSTK_MIN_POINTS);
+    u_array.append_unsafe(0);
+    for (uint64_t i = 0; i < GDSTK_MIN_POINTS; i++) {
+        const double u0 = i * du;
+        u_array.append_unsafe(i + 1 == GDSTK_MIN_POINTS ? 1.0 : u0 + du);
+        u_array.append_unsafe(u0 + 0.5 * du);
+        u_array.append_unsafe(u0 + du / 3);
+    }
+    v_array.ensure_slots(u_array.count);
+    (*curve_function)(u_array.items, u_array.count, v_array.items, data);
+    v_array.count = u_array.count;
+    Vec2* v = v_array.items;
+    for (uint64_t i = v_array.count; i > 0; i--) *v++ += ref;
+
+    Vec2 last = v_array[0];
+    if ((last - last_curve_point).length_sq() > tolerance_sq) {
+        append(last);
+        if (parameters) parameters->append(0);
+    }
+
+    intervals.ensure_slots(GDSTK_MIN_POINTS);
+    for (uint64_t i = 0; i < GDSTK_MIN_POINTS; i++) {
+        const Vec2 next = v_array[1 + 3 * i];
+        intervals.append_unsafe({i * du, du, last, next, 2 + 3 * i});
+        last = next;
+    }
+
+    // Each pass tests all pending intervals and requests the test samples for
+    // the halves of the rejected ones in a single batch.
+    while (true) {
+        u_array.count = 0;
+        next_intervals.count = 0;
+        ParametricInterval* interval = intervals.items;
+        for (uint64_t i = intervals.count; i > 0; i--, interval++) {
+            if (interval->sample == UINT64_MAX) {
+                next_intervals.append(*interval);
+                continue;
+            }
+            const Vec2 mid = v_array[interval->sample];
+            double err_sq = distance_to_line_sq(mid, interval->p0, interval->p1);
+            if (err_sq <= tolerance_sq) {
+                const Vec2 extra = v_array[interval->sample + 1];
+                err_sq = distance_to_line_sq(extra, interval->p0, interval->p1);
+            }
+            if (err_sq <= tolerance_sq) {
+                interval->sample = UINT64_MAX;
+                next_intervals.append(*interval);
+                continue;
+            }
+            const double half = 0.5 * interval->du;
+            const double u1 = interval->u0 + half;
+            next_intervals.append({interval->u0, half, interval->p0, mid, u_array.count});
+            u_array.append(interval->u0 + 0.5 * half);
+            u_array.append(interval->u0 + half / 3);
+            next_intervals.append({u1, half, mid, interval->p1, u_array.count});
+            u_array.append(u1 + 0.5 * half);
+            u_array.append(u1 + half / 3);
+        }
+
+        Array<ParametricInterval> temp = intervals;
+        intervals = next_intervals;
+        next_intervals = temp;
+
+        if (u_array.count == 0) break;
+
+        v_array.count = 0;
+        v_array.ensure_slots(u_array.count);
+        (*curve_function)(u_array.items, u_array.count, v_array.items, data);
+        v_array.count = u_array.count;
+        v = v_array.items;
+        for (uint64_t i = v_array.count; i > 0; i--) *v++ += ref;
+    }
+
+    ensure_slots(intervals.count);
+    ParametricInterval* interval = intervals.items;
+    for (uint64_t i = intervals.count; i > 0; i--) append_unsafe((interval++)->p1);
+    if (parameters) {
+        parameters->ensure_slots(intervals.count);
+        interval = intervals.items;
+        for (uint64_t i = intervals.count; i > 0; i--, interval++) {
+            parameters->append_unsafe(interval->u0 + interval->du);
+        }
+    }
+
+    u_array.clear();
+    v_array.clear();
+    intervals.clear();
+    next_intervals.clear();
+}
+
 uint64_t Curve::commands(const CurveInstruction* items, uint64_t count) {
     const CurveInstruction* item = items;
     const CurveInstruction* end = items + count;
@@ -138,7 +138,23 @@ struct Curve {
 
     // Add a parametric curve section to the curve.  If relative is true,
     // curve_function(0, data) should be (0, 0) for the curve to be continuous.
-    void parametric(ParametricVec2 curve_function, void* data, bool relative);
+    // If parameters is not NULL, the parameter of each appended point is
+    // appended to it, so that other quantities can be evaluated at the same
+    // positions.
+    void parametric(ParametricVec2 curve_function, void* data, bool relative,
+                    Array<double>* parameters);
+    void parametric(ParametricVec2 curve_function, void* data, bool relative) {
+        parametric(curve_function, data, relative, NULL);
+    }
+
+    // Same as above, but curve_function is called with all parameter values
+    // of a refinement pass at once, which is useful when each call is
+    // expensive (e.g. it crosses a language boundary).
+    void parametric(ParametricVec2Batch curve_function, void* data, bool relative,
+                    Array<double>* parameters);
+    void parametric(ParametricVec2Batch curve_function, void* data, bool relative) {
+        parametric(curve_function, data, relative, NULL);
+    }
 
     // Short-hand function for appending several sections at once.  Array items
     // must be formed by a series of instruction characters followed by the
@@ -233,6 +233,7 @@ void FlexPath::remove_overlapping_points() {
 }
 
 ErrorCode FlexPath::to_polygons(bool filter, Tag tag, Array<Polygon*>& result) {
+    MemoryCategoryScope category(MemoryCategory::Paths);
     remove_overlapping_points();
     if (spine.point_array.count < 2) return ErrorCode::NoError;
 
@@ -1079,8 +1080,14 @@ void FlexPath::turn(double radius, double angle, const double* width, const doub
 }
 
 void FlexPath::parametric(ParametricVec2 curve_function, void* data, const double* width,
-                          const double* offset, bool relative) {
-    spine.parametric(curve_function, data, relative);
+                          const double* offset, bool relative, Array<double>* parameters) {
+    spine.parametric(curve_function, data, relative, parameters);
+    fill_offsets_and_widths(width, offset);
+}
+
+void FlexPath::parametric(ParametricVec2Batch curve_function, void* data, const double* width,
+                          const double* offset, bool relative, Array<double>* parameters) {
+    spine.parametric(curve_function, data, relative, parameters);
     fill_offsets_and_widths(width, offset);
 }
 
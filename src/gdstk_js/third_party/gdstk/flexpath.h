@@ -141,8 +141,20 @@ struct FlexPath {
     void arc(double radius_x, double radius_y, double initial_angle, double final_angle,
              double rotation, const double* width, const double* offset);
     void turn(double radius, double angle, const double* width, const double* offset);
+    // If parameters is not NULL, the parameter of each new spine point is
+    // appended to it (see Curve::parametric).
     void parametric(ParametricVec2 curve_function, void* data, const double* width,
-                    const double* offset, bool relative);
+                    const double* offset, bool relative, Array<double>* parameters);
+    void parametric(ParametricVec2 curve_function, void* data, const double* width,
+                    const double* offset, bool relative) {
+        parametric(curve_function, data, width, offset, relative, NULL);
+    }
+    void parametric(ParametricVec2Batch curve_function, void* data, const double* width,
+                    const double* offset, bool relative, Array<double>* parameters);
+    void parametric(ParametricVec2Batch curve_function, void* data, const double* width,
+                    const double* offset, bool relative) {
+        parametric(curve_function, data, width, offset, relative, NULL);
+    }
     uint64_t commands(const CurveInstruction* items, uint64_t count);
 
     // Append the polygonal representation of this path to result.  If filter
@@ -317,12 +317,14 @@ void Library::replace_cell(RawCell* old_cell, RawCell* new_cell) {
 }
 
 ErrorCode Library::write_gds(const char* filename, uint64_t max_points, tm* timestamp) const {
+    TraceSpan span("Library::write_gds");
     ErrorCode error_code = ErrorCode::NoError;
     FILE* out = fopen(filename, "wb");
     if (out == NULL) {
         fputs("[GDSTK] Unable to open GDSII file for output.\n", stderr);
         return ErrorCode::OutputFileOpenError;
     }
+    FileBuffer out_buffer(out);
 
     tm now = {};
     if (!timestamp) timestamp = get_now(now);
@@ -362,17 +364,27 @@ ErrorCode Library::write_gds(const char* filename, uint64_t max_points, tm* time
     fwrite(units, sizeof(uint64_t), COUNT(units), out);
 
     double scaling = unit / precision;
+    const uint64_t total = cell_array.count + rawcell_array.count;
     Cell** cell = cell_array.items;
     for (uint64_t i = 0; i < cell_array.count; i++, cell++) {
+        if (update_progress(i, total)) {
+            fclose(out);
+            return ErrorCode::Cancelled;
+        }
         ErrorCode err = (*cell)->to_gds(out, scaling, max_points, precision, timestamp);
         if (err != ErrorCode::NoError) error_code = err;
     }
 
     RawCell** rawcell = rawcell_array.items;
     for (uint64_t i = 0; i < rawcell_array.count; i++, rawcell++) {
+        if (update_progress(cell_array.count + i, total)) {
+            fclose(out);
+            return ErrorCode::Cancelled;
+        }
         ErrorCode err = (*rawcell)->to_gds(out);
         if (err != ErrorCode::NoError) error_code = err;
     }
+    update_progress(total, total);
 
     uint16_t buffer_end[] = {4, 0x0400};
     big_endian_swap16(buffer_end, COUNT(buffer_end));
@@ -407,6 +419,7 @@ static void zfree(void*, void* ptr) { free_allocation(ptr); }
 
 ErrorCode Library::write_oas(const char* filename, double circle_tolerance,
                              uint8_t compression_level, uint16_t config_flags) {
+    TraceSpan span("Library::write_oas");
     ErrorCode error_code = ErrorCode::NoError;
     const uint64_t c_size = cell_array.count;
     OasisState state = {};
@@ -421,6 +434,7 @@ ErrorCode Library::write_oas(const char* filename, double circle_tolerance,
         fputs("[GDSTK] Unable to open OASIS file for output.\n", stderr);
         return ErrorCode::OutputFileOpenError;
     }
+    FileBuffer out_buffer(out.file);
     out.data_size = 1024 * 1024;
     out.data = (uint8_t*)allocate(out.data_size);
     out.cursor = NULL;
@@ -604,6 +618,16 @@ ErrorCode Library::write_oas(const char* filename, double circle_tolerance,
 
     cell_p = cell_array.items;
     for (uint64_t i = 0; i < c_size; i++) {
+        if (update_progress(i, c_size)) {
+            fclose(out.file);
+            free_allocation(out.data);
+            cell_name_map.clear();
+            cell_offset_map.clear();
+            text_string_map.clear();
+            state.property_name_map.clear();
+            state.property_value_array.clear();
+            return ErrorCode::Cancelled;
+        }
         Cell* cell = *cell_p++;
         if (write_cell_offsets) {
             cell_offset_map.set(cell->name, ftell(out.file));
@@ -758,6 +782,7 @@ ErrorCode Library::write_oas(const char* filename, double circle_tolerance,
 
             // Skip empty cells
             if (uncompressed_size > 0) {
+                TraceSpan deflate_span("oasis:deflate");
                 z_stream s = {};
                 s.zalloc = zalloc;
                 s.zfree = zfree;
@@ -900,6 +925,7 @@ ErrorCode Library::write_oas(const char* filename, double circle_tolerance,
 
     fclose(out.file);
     free_allocation(out.data);
+    update_progress(c_size, c_size);
 
     cell_name_map.clear();
     cell_offset_map.clear();
@@ -948,7 +974,14 @@ Library read_gds(const char* filename, double unit, double tolerance, const Set<
         if (error_code) *error_code = ErrorCode::InputFileOpenError;
         return library;
     }
+    FileBuffer in_buffer(in);
 
+    FSEEK64(in, 0, SEEK_END);
+    const uint64_t file_size = FTELL64(in);
+    FSEEK64(in, 0, SEEK_SET);
+    uint64_t bytes_read = 0;
+
+    TraceSpan decode_span("read_gds:decode");
     while (true) {
         uint64_t record_length = COUNT(buffer);
         ErrorCode err = gdsii_read_record(in, buffer, record_length);
@@ -956,6 +989,11 @@ Library read_gds(const char* filename, double unit, double tolerance, const Set<
             if (error_code) *error_code = err;
             break;
         }
+        bytes_read += record_length;
+        if (update_progress(bytes_read, file_size)) {
+            if (error_code) *error_code = ErrorCode::Cancelled;
+            break;
+        }
 
         // printf("0x%02X %s (%" PRIu32 " bytes)", buffer[2], gdsii_record_names[buffer[2]],
         //        record_length);
@@ -1014,6 +1052,8 @@ Library read_gds(const char* filename, double unit, double tolerance, const Set<
                 }
             } break;
             case GdsiiRecord::ENDLIB: {
+                decode_span.end();
+                TraceSpan resolve_span("read_gds:resolve_references");
                 Map<Cell*> map = {};
                 uint64_t c_size = library.cell_array.count;
                 map.resize((uint64_t)(2.0 + 10.0 / GDSTK_MAP_CAPACITY_THRESHOLD * c_size));
@@ -1324,6 +1364,7 @@ Library read_gds(const char* filename, double unit, double tolerance, const Set<
 
 // TODO: verify modal variables are correctly updated
 Library read_oas(const char* filename, double unit, double tolerance, ErrorCode* error_code) {
+    TraceSpan span("read_oas");
     Library library = {};
 
     OasisStream in = {};
@@ -1333,6 +1374,7 @@ Library read_oas(const char* filename, double unit, double tolerance, ErrorCode*
         if (error_code) *error_code = ErrorCode::InputFileOpenError;
         return library;
     }
+    FileBuffer in_buffer(in.file);
 
     // Check header bytes and START record
     char header[14];
@@ -2426,6 +2468,7 @@ Library read_oas(const char* filename, double unit, double tolerance, ErrorCode*
                     assert(len <= INT64_MAX);
                     FSEEK64(in.file, (int64_t)len, SEEK_SET);
                 } else {
+                    TraceSpan inflate_span("oasis:inflate");
                     z_stream s = {};
                     s.zalloc = zalloc;
                     s.zfree = zfree;
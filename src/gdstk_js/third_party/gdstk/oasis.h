@@ -33,6 +33,11 @@ namespace gdstk {
 #define OASIS_CONFIG_INCLUDE_CRC32 0x0040
 #define OASIS_CONFIG_INCLUDE_CHECKSUM32 0x0080
 
+// Polygons that are not written as any other shape are fractured into
+// trapezoids (Polygon::fracture with FractureMode::Trapezoids) and written as
+// RECTANGLE, TRAPEZOID and CTRAPEZOID records
+#define OASIS_CONFIG_FRACTURE_TRAPEZOIDS 0x0100
+
 #define OASIS_CONFIG_STANDARD_PROPERTIES                                  \
     (OASIS_CONFIG_PROPERTY_MAX_COUNTS | OASIS_CONFIG_PROPERTY_TOP_LEVEL | \
      OASIS_CONFIG_PROPERTY_BOUNDING_BOX | OASIS_CONFIG_PROPERTY_CELL_OFFSET)
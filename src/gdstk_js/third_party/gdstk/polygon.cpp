@@ -82,6 +82,40 @@ double Polygon::signed_area() const {
 // polygon problem for arbitrary polygons,” Computational Geometry, Volume 20,
 // Issue 3, 2001, Pages 131-144, ISSN 0925-7721.
 // https://doi.org/10.1016/S0925-7721(01)00012-8
+// Add the contribution of the edge from p0 to p1 to the winding number of
+// point.  Return true if point lies on the edge (p0 excluded).
+static inline bool edge_winding(const Vec2 p0, const Vec2 p1, const Vec2 point,
+                                int64_t& winding) {
+    if (p1.y == point.y &&
+        (p1.x == point.x || (p0.y == point.y && (p1.x > point.x) == (p0.x < point.x)))) {
+        return true;
+    }
+    if ((p0.y < point.y) != (p1.y < point.y)) {
+        if (p0.x >= point.x) {
+            if (p1.x > point.x) {
+                winding += p1.y > p0.y ? 1 : -1;
+            } else {
+                double det = (p0 - point).cross(p1 - point);
+                if (det == 0) {
+                    return true;
+                }
+                if ((det > 0) == (p1.y > p0.y)) {
+                    winding += p1.y > p0.y ? 1 : -1;
+                }
+            }
+        } else if (p1.x > point.x) {
+            double det = (p0 - point).cross(p1 - point);
+            if (det == 0) {
+                return true;
+            }
+            if ((det > 0) == (p1.y > p0.y)) {
+                winding += p1.y > p0.y ? 1 : -1;
+            }
+        }
+    }
+    return false;
+}
+
 bool Polygon::contain(const Vec2 point) const {
     if (point_array.count == 0) {
         return false;
@@ -95,62 +129,41 @@ bool Polygon::contain(const Vec2 point) const {
     int64_t winding = 0;
     Vec2* v = point_array.items;
     for (uint64_t i = point_array.count; i > 0; i--, v++) {
-        Vec2 p1 = *v;
-        if (p1.y == point.y &&
-            (p1.x == point.x || (p0.y == point.y && (p1.x > point.x) == (p0.x < point.x)))) {
-            return true;
-        }
-        if ((p0.y < point.y) != (p1.y < point.y)) {
-            if (p0.x >= point.x) {
-                if (p1.x > point.x) {
-                    winding += p1.y > p0.y ? 1 : -1;
-                } else {
-                    double det = (p0 - point).cross(p1 - point);
-                    if (det == 0) {
-                        return true;
-                    }
-                    if ((det > 0) == (p1.y > p0.y)) {
-                        winding += p1.y > p0.y ? 1 : -1;
-                    }
-                }
-            } else if (p1.x > point.x) {
-                double det = (p0 - point).cross(p1 - point);
-                if (det == 0) {
-                    return true;
-                }
-                if ((det > 0) == (p1.y > p0.y)) {
-                    winding += p1.y > p0.y ? 1 : -1;
-                }
-            }
-        }
-        p0 = p1;
+        if (edge_winding(p0, *v, point, winding)) return true;
+        p0 = *v;
     }
     return winding != 0;
 }
 
 bool Polygon::contain_all(const Array<Vec2>& points) const {
-    Vec2 min, max;
-    bounding_box(min, max);
-    for (uint64_t i = 0; i < points.count; i++) {
-        Vec2 point = points[i];
-        if (point.x < min.x || point.x > max.x || point.y < min.y || point.x > max.x) return false;
+    EdgeBuckets buckets = {};
+    buckets.init(this);
+    bool result = true;
+    for (uint64_t i = 0; i < points.count && result; i++) {
+        result = buckets.contain(points[i]);
     }
-    for (uint64_t i = 0; i < points.count; i++) {
-        if (!contain(points[i])) return false;
-    }
-    return true;
+    buckets.clear();
+    return result;
 }
 
 bool Polygon::contain_any(const Array<Vec2>& points) const {
-    Vec2 min, max;
-    bounding_box(min, max);
+    EdgeBuckets buckets = {};
+    buckets.init(this);
+    bool result = false;
+    for (uint64_t i = 0; i < points.count && !result; i++) {
+        result = buckets.contain(points[i]);
+    }
+    buckets.clear();
+    return result;
+}
+
+void Polygon::contain(const Array<Vec2>& points, bool* result) const {
+    EdgeBuckets buckets = {};
+    buckets.init(this);
     for (uint64_t i = 0; i < points.count; i++) {
-        Vec2 point = points[i];
-        if (point.x >= min.x && point.x <= max.x && point.y >= min.y && point.x <= max.x &&
-            contain(point))
-            return true;
+        result[i] = buckets.contain(points[i]);
     }
-    return false;
+    buckets.clear();
 }
 
 void Polygon::bounding_box(Vec2& min, Vec2& max) const {
@@ -312,7 +325,23 @@ void Polygon::fillet(const Array<double> radii, double tolerance) {
     old_pts.clear();
 }
 
-void Polygon::fracture(uint64_t max_points, double precision, Array<Polygon*>& result) const {
+void Polygon::fracture(uint64_t max_points, double precision, FractureMode mode,
+                       Array<Polygon*>& result) const {
+    TraceSpan span("Polygon::fracture");
+    if (mode == FractureMode::Trapezoids) {
+        const Polygon* self = this;
+        const Array<Polygon*> polygons = {1, 1, (Polygon**)&self};
+        const uint64_t start = result.count;
+        trapezoids(polygons, 1.0 / precision, result);
+        for (uint64_t i = start; i < result.count; i++) {
+            Polygon* poly = result[i];
+            poly->tag = tag;
+            poly->repetition.copy_from(repetition);
+            poly->properties = properties_copy(properties);
+        }
+        return;
+    }
+
     if (max_points <= 4) return;
     Polygon* poly = (Polygon*)allocate_clear(sizeof(Polygon));
     poly->point_array.copy_from(point_array);
@@ -812,18 +841,14 @@ static bool is_circle(const Array<Vec2> point_array, double tolerance, Vec2& cen
     return true;
 }
 
-ErrorCode Polygon::to_oas(OasisStream& out, OasisState& state) const {
-    ErrorCode error_code = ErrorCode::NoError;
-    Vec2 center;
-    double radius;
+// Write points as a RECTANGLE, TRAPEZOID or CTRAPEZOID record if they form one
+// of the shapes enabled in config_flags.  Return false otherwise.
+static bool trapezoid_to_oas(const Array<IntVec2> points, Tag tag, bool has_repetition,
+                             uint16_t config_flags, OasisStream& out) {
     IntVec2 corner, size;
     int64_t delta_a, delta_b;
     uint8_t type;
-    bool has_repetition = repetition.get_count() > 1;
-    Array<IntVec2> points = {};
-    scale_and_round_array(point_array, state.scaling, points);
-
-    if ((state.config_flags & OASIS_CONFIG_DETECT_RECTANGLES) &&
+    if ((config_flags & OASIS_CONFIG_DETECT_RECTANGLES) &&
         is_rectangle(points, corner, size)) {
         bool is_square = size.x == size.y;
         uint8_t info;
@@ -846,7 +871,7 @@ ErrorCode Polygon::to_oas(OasisStream& out, OasisState& state) const {
         // else
         //     printf("RECTANGLE @ (%ld, %ld) w %ld, h %ld\n", corner.x, corner.y, size.x,
         //     size.y);
-    } else if ((state.config_flags & OASIS_CONFIG_DETECT_TRAPEZOIDS) &&
+    } else if ((config_flags & OASIS_CONFIG_DETECT_TRAPEZOIDS) &&
                is_trapezoid(points, type, corner, size, delta_a, delta_b)) {
         if (type > 25) {
             uint8_t info = type == 26 ? 0x7B : 0xFB;
@@ -907,6 +932,65 @@ ErrorCode Polygon::to_oas(OasisStream& out, OasisState& state) const {
         }
         oasis_write_integer(out, corner.x);
         oasis_write_integer(out, corner.y);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Points are modified (converted to deltas)
+static void polygon_record_to_oas(Array<IntVec2>& points, Tag tag, bool has_repetition,
+                                  OasisStream& out) {
+    uint8_t info = 0x3B;
+    if (has_repetition) info |= 0x04;
+    oasis_putc((int)OasisRecord::POLYGON, out);
+    oasis_putc(info, out);
+    oasis_write_unsigned_integer(out, get_layer(tag));
+    oasis_write_unsigned_integer(out, get_type(tag));
+    oasis_write_point_list(out, points, true);
+    oasis_write_integer(out, points[0].x);
+    oasis_write_integer(out, points[0].y);
+    // printf("POLYGON @ (%ld, %ld)\n", points[0].x, points[0].y);
+}
+
+// Write a piece of FractureMode::Trapezoids (3 or 4 points, on the grid) with
+// the shape records of the OASIS format
+static void trapezoid_piece_to_oas(Array<IntVec2>& points, Tag tag, bool has_repetition,
+                                   OasisStream& out) {
+    if (trapezoid_to_oas(points, tag, has_repetition, OASIS_CONFIG_DETECT_ALL, out)) return;
+    if (points.count == 3) {
+        // Triangles are trapezoids with a parallel side of length 0, at the
+        // vertex opposite to the other parallel side
+        uint64_t lone = 0;
+        for (uint64_t k = 0; k < 3; k++) {
+            const IntVec2 a = points[(k + 1) % 3];
+            const IntVec2 b = points[(k + 2) % 3];
+            if (a.x == b.x || a.y == b.y) {
+                lone = k;
+                break;
+            }
+        }
+        IntVec2 corners[4];
+        for (uint64_t k = 0, j = 0; k < 3; k++) {
+            corners[j++] = points[k];
+            if (k == lone) corners[j++] = points[k];
+        }
+        const Array<IntVec2> trapezoid = {0, 4, corners};
+        if (trapezoid_to_oas(trapezoid, tag, has_repetition, OASIS_CONFIG_DETECT_ALL, out)) return;
+    }
+    polygon_record_to_oas(points, tag, has_repetition, out);
+}
+
+ErrorCode Polygon::to_oas(OasisStream& out, OasisState& state) const {
+    ErrorCode error_code = ErrorCode::NoError;
+    Vec2 center;
+    double radius;
+    bool has_repetition = repetition.get_count() > 1;
+    Array<IntVec2> points = {};
+    scale_and_round_array(point_array, state.scaling, points);
+
+    if (trapezoid_to_oas(points, tag, has_repetition, state.config_flags, out)) {
+        // Written as a rectangle or trapezoid
     } else if (state.circle_tolerance > 0 &&
                is_circle(point_array, state.circle_tolerance, center, radius)) {
         uint8_t info = 0x3B;
@@ -920,16 +1004,29 @@ ErrorCode Polygon::to_oas(OasisStream& out, OasisState& state) const {
         oasis_write_integer(out, (int64_t)llround(center.y * state.scaling));
         // printf("CIRCLE @ (%lf, %lf) r %lf\n", center.x, center.y, radius);
     } else {
-        uint8_t info = 0x3B;
-        if (has_repetition) info |= 0x04;
-        oasis_putc((int)OasisRecord::POLYGON, out);
-        oasis_putc(info, out);
-        oasis_write_unsigned_integer(out, get_layer(tag));
-        oasis_write_unsigned_integer(out, get_type(tag));
-        oasis_write_point_list(out, points, true);
-        oasis_write_integer(out, points[0].x);
-        oasis_write_integer(out, points[0].y);
-        // printf("POLYGON @ (%ld, %ld)\n", points[0].x, points[0].y);
+        Array<Polygon*> pieces = {};
+        if (state.config_flags & OASIS_CONFIG_FRACTURE_TRAPEZOIDS)
+            fracture(0, 1 / state.scaling, FractureMode::Trapezoids, pieces);
+        if (pieces.count == 0) {
+            polygon_record_to_oas(points, tag, has_repetition, out);
+        } else {
+            // Every piece is an element of its own, with the repetition and
+            // properties of the polygon (those of the last are written below)
+            Array<IntVec2> corners = {};
+            for (uint64_t i = 0; i < pieces.count; i++) {
+                if (i > 0) {
+                    if (has_repetition) oasis_write_repetition(out, repetition, state.scaling);
+                    ErrorCode err = properties_to_oas(properties, out, state);
+                    if (err != ErrorCode::NoError) error_code = err;
+                }
+                scale_and_round_array(pieces[i]->point_array, state.scaling, corners);
+                trapezoid_piece_to_oas(corners, tag, has_repetition, out);
+                pieces[i]->clear();
+                free_allocation(pieces[i]);
+            }
+            corners.clear();
+            pieces.clear();
+        }
     }
     if (has_repetition) oasis_write_repetition(out, repetition, state.scaling);
     ErrorCode err = properties_to_oas(properties, out, state);
@@ -1627,80 +1724,167 @@ ErrorCode contour(const double* data, uint64_t rows, uint64_t cols, double level
     return error_code;
 }
 
-void inside(const Array<Vec2>& points, const Array<Polygon*>& polygons, bool* result) {
-    Vec2 min = {DBL_MAX, DBL_MAX};
-    Vec2 max = {-DBL_MAX, -DBL_MAX};
-    for (uint64_t j = 0; j < polygons.count; j++) {
-        Vec2 a, b;
-        polygons[j]->bounding_box(a, b);
-        if (a.x < min.x) min.x = a.x;
-        if (a.y < min.y) min.y = a.y;
-        if (b.x > max.x) max.x = b.x;
-        if (b.y > max.y) max.y = b.y;
+static inline uint64_t edge_slab(double y, double min_y, double slab_scale, uint64_t slab_count) {
+    uint64_t slab = (uint64_t)((y - min_y) * slab_scale);
+    return slab < slab_count ? slab : slab_count - 1;
+}
+
+void EdgeBuckets::init(const Polygon* polygon_) {
+    polygon = polygon_;
+    const Array<Vec2>& point_array = polygon->point_array;
+    min.x = min.y = DBL_MAX;
+    max.x = max.y = -DBL_MAX;
+    Vec2* p = point_array.items;
+    for (uint64_t num = point_array.count; num > 0; num--, p++) {
+        if (p->x < min.x) min.x = p->x;
+        if (p->x > max.x) max.x = p->x;
+        if (p->y < min.y) min.y = p->y;
+        if (p->y > max.y) max.y = p->y;
     }
-    for (uint64_t i = 0; i < points.count; i++) {
-        Vec2 point = points[i];
-        result[i] = false;
-        if (point.x >= min.x && point.x <= max.x && point.y >= min.y && point.x <= max.x) {
-            for (uint64_t j = 0; j < polygons.count; j++) {
-                if (polygons[j]->contain(point)) {
-                    result[i] = true;
-                    break;
-                }
-            }
+
+    slab_count = 0;
+    const uint64_t num_edges = point_array.count;
+    if (num_edges < GDSTK_EDGE_BUCKETS_MIN_POINTS || !(max.y > min.y)) return;
+
+    // Edges spanning many slabs are stored in all of them, so the number of
+    // slabs is reduced until the buckets hold at most a few copies of each
+    // edge.  In the worst case (many tall edges), edges are not bucketed.
+    uint64_t total = 0;
+    slab_offsets = NULL;
+    for (uint64_t count = num_edges / GDSTK_EDGE_BUCKET_SIZE; count > 1; count /= 2) {
+        slab_count = count;
+        slab_scale = count / (max.y - min.y);
+        slab_offsets = (uint64_t*)allocate_clear((count + 1) * sizeof(uint64_t));
+        total = 0;
+        Vec2 p0 = point_array[num_edges - 1];
+        for (uint64_t j = 0; j < num_edges; j++) {
+            const Vec2 p1 = point_array[j];
+            uint64_t first = edge_slab(p0.y < p1.y ? p0.y : p1.y, min.y, slab_scale, count);
+            uint64_t last = edge_slab(p0.y < p1.y ? p1.y : p0.y, min.y, slab_scale, count);
+            for (uint64_t i = first; i <= last; i++) slab_offsets[i + 1]++;
+            total += last - first + 1;
+            p0 = p1;
         }
+        if (total <= 2 * GDSTK_EDGE_BUCKET_SIZE * num_edges) break;
+        free_allocation(slab_offsets);
+        slab_offsets = NULL;
+    }
+    if (!slab_offsets) {
+        slab_count = 0;
+        return;
+    }
+
+    for (uint64_t i = 0; i < slab_count; i++) slab_offsets[i + 1] += slab_offsets[i];
+    edges = (uint64_t*)allocate(total * sizeof(uint64_t));
+    uint64_t* next = (uint64_t*)allocate(slab_count * sizeof(uint64_t));
+    memcpy(next, slab_offsets, slab_count * sizeof(uint64_t));
+    Vec2 p0 = point_array[num_edges - 1];
+    for (uint64_t j = 0; j < num_edges; j++) {
+        const Vec2 p1 = point_array[j];
+        uint64_t first = edge_slab(p0.y < p1.y ? p0.y : p1.y, min.y, slab_scale, slab_count);
+        uint64_t last = edge_slab(p0.y < p1.y ? p1.y : p0.y, min.y, slab_scale, slab_count);
+        for (uint64_t i = first; i <= last; i++) edges[next[i]++] = j;
+        p0 = p1;
     }
+    free_allocation(next);
 }
 
-bool all_inside(const Array<Vec2>& points, const Array<Polygon*>& polygons) {
-    Vec2 min = {DBL_MAX, DBL_MAX};
-    Vec2 max = {-DBL_MAX, -DBL_MAX};
-    for (uint64_t j = 0; j < polygons.count; j++) {
-        Vec2 a, b;
-        polygons[j]->bounding_box(a, b);
-        if (a.x < min.x) min.x = a.x;
-        if (a.y < min.y) min.y = a.y;
-        if (b.x > max.x) max.x = b.x;
-        if (b.y > max.y) max.y = b.y;
+void EdgeBuckets::clear() {
+    if (slab_count > 0) {
+        free_allocation(slab_offsets);
+        free_allocation(edges);
     }
-    for (uint64_t i = 0; i < points.count; i++) {
-        Vec2 point = points[i];
-        if (point.x < min.x || point.x > max.x || point.y < min.y || point.x > max.x) return false;
+    slab_offsets = NULL;
+    edges = NULL;
+    slab_count = 0;
+}
+
+bool EdgeBuckets::contain(const Vec2 point) const {
+    if (point.x < min.x || point.x > max.x || point.y < min.y || point.y > max.y) return false;
+    if (slab_count == 0) return polygon->contain(point);
+
+    // Every edge that can cross or touch the horizontal line through point
+    // overlaps its slab
+    const uint64_t slab = edge_slab(point.y, min.y, slab_scale, slab_count);
+    const Vec2* points = polygon->point_array.items;
+    const uint64_t last = polygon->point_array.count - 1;
+    int64_t winding = 0;
+    const uint64_t* edge = edges + slab_offsets[slab];
+    for (uint64_t i = slab_offsets[slab + 1] - slab_offsets[slab]; i > 0; i--, edge++) {
+        const uint64_t j = *edge;
+        if (edge_winding(points[j == 0 ? last : j - 1], points[j], point, winding)) return true;
+    }
+    return winding != 0;
+}
+
+void InsideIndex::init(const Array<Polygon*>& polygons) {
+    count = polygons.count;
+    buckets = NULL;
+    if (count == 0) return;
+    buckets = (EdgeBuckets*)allocate_clear(count * sizeof(EdgeBuckets));
+    Array<RTreeEntry> entries = {};
+    entries.ensure_slots(count);
+    for (uint64_t i = 0; i < count; i++) {
+        EdgeBuckets* b = buckets + i;
+        b->init(polygons[i]);
+        if (b->min.x > b->max.x) continue;
+        entries.append_unsafe(RTreeEntry{b->min, b->max, i});
     }
+    tree.build(entries);
+}
+
+void InsideIndex::clear() {
+    for (uint64_t i = 0; i < count; i++) buckets[i].clear();
+    if (buckets) free_allocation(buckets);
+    buckets = NULL;
+    count = 0;
+    tree.clear();
+}
+
+struct InsideQuery {
+    const EdgeBuckets* buckets;
+    Vec2 point;
+};
+
+static bool inside_visit(uint64_t value, void* data) {
+    InsideQuery* query = (InsideQuery*)data;
+    return query->buckets[value].contain(query->point);
+}
+
+bool InsideIndex::contain(const Vec2 point) const {
+    InsideQuery query = {buckets, point};
+    return tree.find(point, inside_visit, &query);
+}
+
+void inside(const Array<Vec2>& points, const Array<Polygon*>& polygons, bool* result) {
+    InsideIndex index = {};
+    index.init(polygons);
     for (uint64_t i = 0; i < points.count; i++) {
-        Vec2 point = points[i];
-        bool inside = false;
-        for (uint64_t j = 0; j < polygons.count; j++) {
-            if (polygons[j]->contain(point)) {
-                inside = true;
-                break;
-            }
-        }
-        if (!inside) return false;
+        result[i] = index.contain(points[i]);
     }
-    return true;
+    index.clear();
 }
 
-bool any_inside(const Array<Vec2>& points, const Array<Polygon*>& polygons) {
-    Vec2 min = {DBL_MAX, DBL_MAX};
-    Vec2 max = {-DBL_MAX, -DBL_MAX};
-    for (uint64_t j = 0; j < polygons.count; j++) {
-        Vec2 a, b;
-        polygons[j]->bounding_box(a, b);
-        if (a.x < min.x) min.x = a.x;
-        if (a.y < min.y) min.y = a.y;
-        if (b.x > max.x) max.x = b.x;
-        if (b.y > max.y) max.y = b.y;
+bool all_inside(const Array<Vec2>& points, const Array<Polygon*>& polygons) {
+    InsideIndex index = {};
+    index.init(polygons);
+    bool result = true;
+    for (uint64_t i = 0; i < points.count && result; i++) {
+        result = index.contain(points[i]);
     }
-    for (uint64_t i = 0; i < points.count; i++) {
-        Vec2 point = points[i];
-        if (point.x >= min.x && point.x <= max.x && point.y >= min.y && point.x <= max.x) {
-            for (uint64_t j = 0; j < polygons.count; j++) {
-                if (polygons[j]->contain(point)) return true;
-            }
-        }
+    index.clear();
+    return result;
+}
+
+bool any_inside(const Array<Vec2>& points, const Array<Polygon*>& polygons) {
+    InsideIndex index = {};
+    index.init(polygons);
+    bool result = false;
+    for (uint64_t i = 0; i < points.count && !result; i++) {
+        result = index.contain(points[i]);
     }
-    return false;
+    index.clear();
+    return result;
 }
 
 }  // namespace gdstk
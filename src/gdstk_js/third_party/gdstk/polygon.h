@@ -18,11 +18,21 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 #include "oasis.h"
 #include "property.h"
 #include "repetition.h"
+#include "rtree.h"
 #include "utils.h"
 #include "vec.h"
 
 namespace gdstk {
 
+// Decomposition of Polygon::fracture
+enum struct FractureMode {
+    // Cut until every piece has at most max_points vertices
+    MaxPoints,
+    // Trapezoids with 2 horizontal or 2 vertical sides (see trapezoids in
+    // clipper_tools.h), for mask writers that only accept such shapes
+    Trapezoids,
+};
+
 struct Polygon {
     Tag tag;
     Array<Vec2> point_array;
@@ -51,6 +61,8 @@ struct Polygon {
     bool contain(const Vec2 point) const;
     bool contain_all(const Array<Vec2>& points) const;
     bool contain_any(const Array<Vec2>& points) const;
+    // Result must be an array with size for at least points.count bools.
+    void contain(const Array<Vec2>& points, bool* result) const;
 
     // Bounding box corners are returned in min and max.  If the polygons has
     // no vertices, return min.x > max.x.  Repetitions are taken into account
@@ -75,10 +87,18 @@ struct Polygon {
     // defined by tolerance.
     void fillet(const Array<double> radii, double tolerance);
 
-    // Fracture the polygon horizontally and vertically until all pieces have
-    // at most max_points vertices.  If max_points < 5, it doesn't do anything.
-    // Resulting pieces are appended to result.
-    void fracture(uint64_t max_points, double precision, Array<Polygon*>& result) const;
+    // Fracture the polygon.  With FractureMode::MaxPoints, it is cut
+    // horizontally and vertically until all pieces have at most max_points
+    // vertices (if max_points < 5, it doesn't do anything).  With
+    // FractureMode::Trapezoids, max_points is not used and corners on slanted
+    // sides are rounded to precision.  Resulting pieces are appended to
+    // result.
+    void fracture(uint64_t max_points, double precision, FractureMode mode,
+                  Array<Polygon*>& result) const;
+
+    void fracture(uint64_t max_points, double precision, Array<Polygon*>& result) const {
+        fracture(max_points, precision, FractureMode::MaxPoints, result);
+    }
 
     // Append the copies of this polygon defined by its repetition to result.
     void apply_repetition(Array<Polygon*>& result);
@@ -125,9 +145,60 @@ void text(const char* s, double size, const Vec2 position, bool vertical, Tag ta
 ErrorCode contour(const double* data, uint64_t rows, uint64_t cols, double level, double scaling,
                   Array<Polygon*>& result);
 
+// Polygons with fewer vertices are tested edge by edge
+#define GDSTK_EDGE_BUCKETS_MIN_POINTS 32
+// Average number of edges per bucket
+#define GDSTK_EDGE_BUCKET_SIZE 4
+
+// Accelerated Polygon::contain for testing many points against the same
+// polygon.  The edges of polygons with many vertices are bucketed in
+// horizontal slabs of the polygon bounding box, so each test only visits the
+// edges that overlap the slab of the point.  The polygon must not be modified
+// while the buckets are in use.  After init, contain can be called
+// concurrently from many threads.
+struct EdgeBuckets {
+    const Polygon* polygon;
+    // Polygon bounding box (without repetitions)
+    Vec2 min;
+    Vec2 max;
+    // Number of slabs (0 if the edges are not bucketed) and slabs per unit
+    // length along y
+    uint64_t slab_count;
+    double slab_scale;
+    // The edges overlapping slab i are edges[slab_offsets[i]] up to
+    // edges[slab_offsets[i + 1] - 1].  Edge j goes from vertex j - 1 (the
+    // last vertex, for j == 0) to vertex j.
+    uint64_t* slab_offsets;
+    uint64_t* edges;
+
+    void init(const Polygon* polygon_);
+    void clear();
+
+    // Same result as polygon->contain(point)
+    bool contain(const Vec2 point) const;
+};
+
+// Accelerated containment test of many points in a set of polygons: the
+// candidate polygons for each point come from an R-tree of their bounding
+// boxes and are tested through their EdgeBuckets.  The polygons must not be
+// modified while the index is in use.  After init, contain can be called
+// concurrently from many threads.
+struct InsideIndex {
+    RTree tree;
+    EdgeBuckets* buckets;
+    uint64_t count;
+
+    void init(const Array<Polygon*>& polygons);
+    void clear();
+
+    // True if point is inside any of the polygons
+    bool contain(const Vec2 point) const;
+};
+
 // Check if the points are inside a set of polygons (points lying on the edges
 // or coinciding with a vertex of the polygons are considered inside).  Result
-// must be an array with size for at least points.count bools.
+// must be an array with size for at least points.count bools.  For repeated
+// tests against the same polygons, InsideIndex can be used directly.
 void inside(const Array<Vec2>& points, const Array<Polygon*>& polygons, bool* result);
 bool all_inside(const Array<Vec2>& points, const Array<Polygon*>& polygons);
 bool any_inside(const Array<Vec2>& points, const Array<Polygon*>& polygons);
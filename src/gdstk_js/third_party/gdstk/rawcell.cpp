@@ -44,6 +44,7 @@ void RawCell::clear() {
         source->uses--;
         if (source->uses == 0) {
             fclose(source->file);
+            free(source->file_buffer);
             free_allocation(source);
         }
         source = NULL;
@@ -81,6 +82,7 @@ ErrorCode RawCell::to_gds(FILE* out) {
         source->uses--;
         if (source->uses == 0) {
             fclose(source->file);
+            free(source->file_buffer);
             free_allocation(source);
         }
         source = NULL;
@@ -102,6 +104,7 @@ Map<RawCell*> read_rawcells(const char* filename, ErrorCode* error_code) {
         if (error_code) *error_code = ErrorCode::InputFileOpenError;
         return result;
     }
+    source->file_buffer = set_file_buffer(source->file);
 
     RawCell* rawcell = NULL;
 
@@ -137,6 +140,7 @@ Map<RawCell*> read_rawcells(const char* filename, ErrorCode* error_code) {
                 }
                 if (source->uses == 0) {
                     fclose(source->file);
+                    free(source->file_buffer);
                     free_allocation(source);
                 }
                 return result;
@@ -192,6 +196,7 @@ Map<RawCell*> read_rawcells(const char* filename, ErrorCode* error_code) {
         rawcell->clear();
     }
     fclose(source->file);
+    free(source->file_buffer);
     free_allocation(source);
     result.clear();
     fprintf(stderr, "[GDSTK] Invalid GDSII file %s.\n", filename);
@@ -26,6 +26,7 @@ namespace gdstk {
 
 struct RawSource {
     FILE* file;
+    char* file_buffer;  // stdio buffer of file, freed after closing it
     uint32_t uses;
 
     // Read num_bytes into buffer from fd starting at offset
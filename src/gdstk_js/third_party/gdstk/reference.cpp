@@ -21,6 +21,45 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 
 namespace gdstk {
 
+void Transformation::init(double magnification_, bool x_reflection_, double rotation_,
+                          const Vec2 origin_) {
+    magnification = magnification_;
+    x_reflection = x_reflection_;
+    rotation = rotation_;
+    origin = origin_;
+    const double ca = magnification * cos(rotation);
+    const double sa = magnification * sin(rotation);
+    ux = Vec2{ca, sa};
+    uy = x_reflection ? Vec2{sa, -ca} : Vec2{-sa, ca};
+}
+
+Transformation Transformation::compose(const Reference& reference, const Vec2 offset) const {
+    Transformation result;
+    result.magnification = magnification * reference.magnification;
+    result.x_reflection = x_reflection ^ reference.x_reflection;
+    result.rotation = rotation + (x_reflection ? -reference.rotation : reference.rotation);
+    result.origin = apply(reference.origin + offset);
+    Transformation local;
+    local.init(reference.magnification, reference.x_reflection, reference.rotation, Vec2{0, 0});
+    result.ux = apply_linear(local.ux);
+    result.uy = apply_linear(local.uy);
+    return result;
+}
+
+void append_transformed_polygon(const Polygon& polygon, const Transformation& transformation,
+                                void* data) {
+    Array<Polygon*>* result = (Array<Polygon*>*)data;
+    Polygon* copy = (Polygon*)allocate_clear(sizeof(Polygon));
+    copy->tag = polygon.tag;
+    const uint64_t count = polygon.point_array.count;
+    copy->point_array.ensure_slots(count);
+    copy->point_array.count = count;
+    const Vec2* src = polygon.point_array.items;
+    Vec2* dst = copy->point_array.items;
+    for (uint64_t i = count; i > 0; i--) *dst++ = transformation.apply(*src++);
+    result->append(copy);
+}
+
 void Reference::print() const {
     switch (type) {
         case ReferenceType::Cell:
@@ -252,6 +291,58 @@ void Reference::get_polygons(bool apply_repetitions, bool include_paths, int64_t
     if (repetition.type != RepetitionType::None) offsets.clear();
 }
 
+void Reference::get_repeated_polygons(bool include_paths, int64_t depth, bool filter, Tag tag,
+                                      const Transformation& transformation,
+                                      const Repetition& repetition_,
+                                      Array<Polygon*>& result) const {
+    if (type != ReferenceType::Cell) return;
+
+    Repetition combined = {};
+    combined.copy_from(repetition);
+    combined.transform(transformation.magnification, transformation.x_reflection,
+                       transformation.rotation);
+    combined.combine(repetition_);
+    cell->get_repeated_polygons(include_paths, depth, filter, tag,
+                                transformation.compose(*this, Vec2{0, 0}), combined, result);
+    combined.clear();
+}
+
+void Reference::visit_polygons(bool apply_repetitions, bool include_paths, int64_t depth,
+                               bool filter, Tag tag, const Transformation& transformation,
+                               PolygonVisitor visit, void* data) const {
+    if (type != ReferenceType::Cell) return;
+
+    Vec2 zero = {0, 0};
+    Array<Vec2> offsets = {};
+    if (repetition.type != RepetitionType::None) {
+        repetition.get_offsets(offsets);
+    } else {
+        offsets.count = 1;
+        offsets.items = &zero;
+    }
+
+    Vec2* offset_p = offsets.items;
+    for (uint64_t offset_count = offsets.count; offset_count > 0; offset_count--) {
+        const Transformation instance = transformation.compose(*this, *offset_p++);
+        cell->visit_polygons(apply_repetitions, include_paths, depth, filter, tag, instance, visit,
+                             data);
+    }
+    if (repetition.type != RepetitionType::None) offsets.clear();
+}
+
+void Reference::visit_instances(int64_t depth, const Transformation& transformation,
+                                InstanceVisitor visit, void* data) const {
+    if (type != ReferenceType::Cell) return;
+
+    const uint64_t count =
+        repetition.type == RepetitionType::None ? 1 : repetition.get_count();
+    for (uint64_t i = 0; i < count; i++) {
+        const Transformation instance = transformation.compose(*this, repetition.get_offset(i));
+        visit(*this, instance, data);
+        if (depth != 0) cell->visit_instances(depth, instance, visit, data);
+    }
+}
+
 void Reference::get_flexpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
                               Array<FlexPath*>& result) const {
     if (type != ReferenceType::Cell) return;
@@ -29,6 +29,58 @@ struct GeometryInfo;
 
 enum struct ReferenceType { Cell = 0, RawCell, Name };
 
+struct Reference;
+
+// Transformation from the coordinates of a cell to those of a cell that
+// references it, directly or through a chain of references.  As in
+// Reference::transform, points are magnified, reflected across the x axis,
+// rotated and translated by origin, in this order.
+struct Transformation {
+    double magnification;
+    bool x_reflection;
+    double rotation;  // in radians
+    Vec2 origin;
+    // Images of the unit vectors along x and y (the linear part)
+    Vec2 ux;
+    Vec2 uy;
+
+    void init(double magnification_, bool x_reflection_, double rotation_, const Vec2 origin_);
+
+    Vec2 apply(const Vec2 point) const { return origin + ux * point.x + uy * point.y; }
+
+    // Transform a displacement (no translation)
+    Vec2 apply_linear(const Vec2 vector) const { return ux * vector.x + uy * vector.y; }
+
+    // Transformation of reference (with its origin moved by offset, one of
+    // its repetition offsets) followed by this one
+    Transformation compose(const Reference& reference, const Vec2 offset) const;
+};
+
+inline Transformation identity_transformation() {
+    Transformation transformation;
+    transformation.init(1, false, 0, Vec2{0, 0});
+    return transformation;
+}
+
+// Called for each polygon visited by Cell::visit_polygons with the
+// transformation from the coordinates of its cell to those of the visited
+// cell.  Polygons are passed as stored in their cells (or as temporary
+// polygonal representations of paths), so they must not be modified or
+// kept after the call.
+typedef void (*PolygonVisitor)(const Polygon& polygon, const Transformation& transformation,
+                               void* data);
+
+// PolygonVisitor that appends a transformed copy of polygon, with its tag but
+// without repetition or properties, to the Array<Polygon*> pointed by data
+void append_transformed_polygon(const Polygon& polygon, const Transformation& transformation,
+                                void* data);
+
+// Called for each instance visited by Cell::visit_instances: one for each
+// repetition offset of reference, with the transformation from the
+// coordinates of reference->cell to those of the visited cell.
+typedef void (*InstanceVisitor)(const Reference& reference, const Transformation& transformation,
+                                void* data);
+
 struct Reference {
     ReferenceType type;
     // References by name or rawcell are limited in their use.  Most cell
@@ -114,6 +166,29 @@ struct Reference {
     void get_labels(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
                     Array<Label*>& result) const;
 
+    // Append the polygons of the referenced cell, once each, with this
+    // reference repetition combined into theirs.  Arguments transformation
+    // and repetition are those of the cell holding this reference.  See
+    // Cell::get_repeated_polygons.
+    void get_repeated_polygons(bool include_paths, int64_t depth, bool filter, Tag tag,
+                               const Transformation& transformation,
+                               const Repetition& repetition, Array<Polygon*>& result) const;
+
+    // Visit the polygons that get_polygons would create, without creating
+    // them, once for each repetition offset of this reference.  See
+    // Cell::visit_polygons.  Argument transformation is the transformation
+    // from the coordinates of the cell holding this reference.
+    void visit_polygons(bool apply_repetitions, bool include_paths, int64_t depth, bool filter,
+                        Tag tag, const Transformation& transformation, PolygonVisitor visit,
+                        void* data) const;
+
+    // Visit each instance of this reference (one per repetition offset,
+    // generated on demand) and, if depth is not 0, the instances in its cell
+    // down to depth more levels (negative depth means no limit).  See
+    // Cell::visit_instances.
+    void visit_instances(int64_t depth, const Transformation& transformation,
+                         InstanceVisitor visit, void* data) const;
+
     // These functions output the reference in the GDSII and SVG formats.  They
     // are not supposed to be called by the user.
     ErrorCode to_gds(FILE* out, double scaling) const;
@@ -150,6 +150,25 @@ void Repetition::get_offsets(Array<Vec2>& result) const {
     }
 }
 
+Vec2 Repetition::get_offset(uint64_t index) const {
+    if (index == 0) return Vec2{0, 0};
+    switch (type) {
+        case RepetitionType::Rectangular:
+            return Vec2{(double)(index / rows) * spacing.x, (double)(index % rows) * spacing.y};
+        case RepetitionType::Regular:
+            return (double)(index / rows) * v1 + (double)(index % rows) * v2;
+        case RepetitionType::ExplicitX:
+            return Vec2{coords[index - 1], 0};
+        case RepetitionType::ExplicitY:
+            return Vec2{0, coords[index - 1]};
+        case RepetitionType::Explicit:
+            return offsets[index - 1];
+        case RepetitionType::None:
+            break;
+    }
+    return Vec2{0, 0};
+}
+
 void Repetition::get_extrema(Array<Vec2>& result) const {
     switch (type) {
         case RepetitionType::Rectangular:
@@ -272,6 +291,31 @@ void Repetition::get_extrema(Array<Vec2>& result) const {
     }
 }
 
+void Repetition::combine(const Repetition& other) {
+    if (other.type == RepetitionType::None) return;
+    if (type == RepetitionType::None) {
+        copy_from(other);
+        return;
+    }
+    Array<Vec2> inner = {};
+    Array<Vec2> outer = {};
+    get_offsets(inner);
+    other.get_offsets(outer);
+    Array<Vec2> sums = {};
+    sums.ensure_slots(inner.count * outer.count - 1);
+    for (uint64_t i = 0; i < outer.count; i++) {
+        // The first sum is the original, (0, 0)
+        for (uint64_t j = i == 0 ? 1 : 0; j < inner.count; j++) {
+            sums.append_unsafe(outer[i] + inner[j]);
+        }
+    }
+    inner.clear();
+    outer.clear();
+    clear();
+    type = RepetitionType::Explicit;
+    offsets = sums;
+}
+
 void Repetition::transform(double magnification, bool x_reflection, double rotation) {
     if (type == RepetitionType::None) return;
     switch (type) {
@@ -60,10 +60,19 @@ struct Repetition {
     // (0, 0), as first element, to result.
     void get_offsets(Array<Vec2>& result) const;
 
+    // Return offset number index (0 <= index < get_count()) in the order of
+    // get_offsets, without generating the others
+    Vec2 get_offset(uint64_t index) const;
+
     // Append the extrema offsets generated by this repetition, including the
     // original, to result.
     void get_extrema(Array<Vec2>& result) const;
 
+    // Replace this repetition by the one generating every sum of one of its
+    // offsets and one of the offsets of other (both in the same
+    // coordinates).  If neither is None, the result is Explicit.
+    void combine(const Repetition& other);
+
     // Transformations are applied in the order of arguments, starting with
     // magnification and rotating at the end.  This is equivalent to the
     // transformation defined by a Reference with the same arguments.
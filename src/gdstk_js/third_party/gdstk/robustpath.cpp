@@ -1264,6 +1264,7 @@ ErrorCode RobustPath::spine(Array<Vec2> &result) const {
 }
 
 ErrorCode RobustPath::to_polygons(bool filter, Tag tag, Array<Polygon *> &result) const {
+    MemoryCategoryScope category(MemoryCategory::Paths);
     ErrorCode error_code = ErrorCode::NoError;
     if (num_elements == 0 || subpath_array.count == 0) return error_code;
 
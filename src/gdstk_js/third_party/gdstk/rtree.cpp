@@ -0,0 +1,164 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#include "rtree.h"
+
+#include <float.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "allocator.h"
+#include "sort.h"
+#include "utils.h"
+
+namespace gdstk {
+
+template <class T>
+static bool center_x_sorted(const T& a, const T& b) {
+    return a.min.x + a.max.x < b.min.x + b.max.x;
+}
+
+template <class T>
+static bool center_y_sorted(const T& a, const T& b) {
+    return a.min.y + a.max.y < b.min.y + b.max.y;
+}
+
+// Sort-Tile-Recursive packing of one tree level: items are reordered in
+// vertical slices sorted by y, and a parent node is appended to nodes for
+// every GDSTK_RTREE_NODE_CAPACITY consecutive items.  Item i is child number
+// first + i of its parent.
+template <class T>
+static void pack_level(T* items, uint64_t count, uint64_t first, bool leaf,
+                       Array<RTreeNode>& nodes) {
+    const uint64_t num_parents =
+        (count + GDSTK_RTREE_NODE_CAPACITY - 1) / GDSTK_RTREE_NODE_CAPACITY;
+    const uint64_t num_slices = (uint64_t)ceil(sqrt((double)num_parents));
+    const uint64_t slice_count = num_slices * GDSTK_RTREE_NODE_CAPACITY;
+
+    sort(items, count, center_x_sorted<T>);
+    for (uint64_t i = 0; i < count; i += slice_count) {
+        uint64_t n = count - i < slice_count ? count - i : slice_count;
+        sort(items + i, n, center_y_sorted<T>);
+    }
+
+    nodes.ensure_slots(num_parents);
+    for (uint64_t i = 0; i < count; i += GDSTK_RTREE_NODE_CAPACITY) {
+        RTreeNode node;
+        node.min = Vec2{DBL_MAX, DBL_MAX};
+        node.max = Vec2{-DBL_MAX, -DBL_MAX};
+        node.first = first + i;
+        node.count =
+            count - i < GDSTK_RTREE_NODE_CAPACITY ? count - i : GDSTK_RTREE_NODE_CAPACITY;
+        node.leaf = leaf;
+        const T* item = items + i;
+        for (uint64_t j = node.count; j > 0; j--, item++) {
+            if (item->min.x < node.min.x) node.min.x = item->min.x;
+            if (item->min.y < node.min.y) node.min.y = item->min.y;
+            if (item->max.x > node.max.x) node.max.x = item->max.x;
+            if (item->max.y > node.max.y) node.max.y = item->max.y;
+        }
+        nodes.append_unsafe(node);
+    }
+}
+
+void RTree::print(bool all) const {
+    printf("RTree <%p>, %" PRIu64 " entries, %" PRIu64 " nodes\n", this, entries.count,
+           nodes.count);
+    if (all) {
+        for (uint64_t i = 0; i < nodes.count; i++) {
+            const RTreeNode* node = nodes.items + i;
+            printf("Node %" PRIu64 ": (%lg, %lg) - (%lg, %lg), %s [%" PRIu64 ", %" PRIu64 ")\n",
+                   i, node->min.x, node->min.y, node->max.x, node->max.y,
+                   node->leaf ? "entries" : "nodes", node->first, node->first + node->count);
+        }
+    }
+}
+
+void RTree::build(Array<RTreeEntry>& entry_array) {
+    clear();
+    entries = entry_array;
+    entry_array = Array<RTreeEntry>{};
+    if (entries.count == 0) return;
+
+    pack_level(entries.items, entries.count, 0, true, nodes);
+    uint64_t level_first = 0;
+    while (nodes.count - level_first > 1) {
+        uint64_t level_count = nodes.count - level_first;
+        // Parents are appended to nodes, so the level must be sorted in place
+        // before reallocation can happen.
+        nodes.ensure_slots(
+            (level_count + GDSTK_RTREE_NODE_CAPACITY - 1) / GDSTK_RTREE_NODE_CAPACITY);
+        pack_level(nodes.items + level_first, level_count, level_first, false, nodes);
+        level_first += level_count;
+    }
+}
+
+bool RTree::bounding_box(Vec2& min, Vec2& max) const {
+    if (nodes.count == 0) return false;
+    const RTreeNode* root = nodes.items + nodes.count - 1;
+    min = root->min;
+    max = root->max;
+    return true;
+}
+
+void RTree::search(const Vec2 min, const Vec2 max, Array<uint64_t>& result) const {
+    if (nodes.count == 0) return;
+
+    Array<uint64_t> stack = {};
+    stack.append(nodes.count - 1);
+    while (stack.count > 0) {
+        const RTreeNode* node = nodes.items + stack.items[--stack.count];
+        if (node->min.x > max.x || node->max.x < min.x || node->min.y > max.y ||
+            node->max.y < min.y)
+            continue;
+        if (node->leaf) {
+            const RTreeEntry* entry = entries.items + node->first;
+            for (uint64_t i = node->count; i > 0; i--, entry++) {
+                if (entry->min.x <= max.x && entry->max.x >= min.x && entry->min.y <= max.y &&
+                    entry->max.y >= min.y)
+                    result.append(entry->value);
+            }
+        } else {
+            stack.ensure_slots(node->count);
+            for (uint64_t i = 0; i < node->count; i++) {
+                stack.append_unsafe(node->first + i);
+            }
+        }
+    }
+    stack.clear();
+}
+
+bool RTree::find(const Vec2 point, bool (*visit)(uint64_t value, void* data), void* data) const {
+    if (nodes.count == 0) return false;
+
+    uint64_t stack[GDSTK_RTREE_STACK_SIZE];
+    uint64_t stack_count = 0;
+    stack[stack_count++] = nodes.count - 1;
+    while (stack_count > 0) {
+        const RTreeNode* node = nodes.items + stack[--stack_count];
+        if (node->leaf) {
+            const RTreeEntry* entry = entries.items + node->first;
+            for (uint64_t i = node->count; i > 0; i--, entry++) {
+                if (entry->min.x <= point.x && entry->max.x >= point.x &&
+                    entry->min.y <= point.y && entry->max.y >= point.y && visit(entry->value, data))
+                    return true;
+            }
+        } else {
+            const RTreeNode* child = nodes.items + node->first;
+            for (uint64_t i = 0; i < node->count; i++, child++) {
+                if (child->min.x <= point.x && child->max.x >= point.x &&
+                    child->min.y <= point.y && child->max.y >= point.y)
+                    stack[stack_count++] = node->first + i;
+            }
+        }
+    }
+    return false;
+}
+
+}  // namespace gdstk
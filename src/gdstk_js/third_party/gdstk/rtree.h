@@ -0,0 +1,83 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#ifndef GDSTK_HEADER_RTREE
+#define GDSTK_HEADER_RTREE
+
+#define __STDC_FORMAT_MACROS
+#define _USE_MATH_DEFINES
+
+#include <stdint.h>
+
+#include "array.h"
+#include "vec.h"
+
+namespace gdstk {
+
+// Maximal number of children of an R-tree node
+#define GDSTK_RTREE_NODE_CAPACITY 16
+
+// Bound on the depth-first search stack: 16 levels hold more than 2^64 entries
+#define GDSTK_RTREE_STACK_SIZE (16 * GDSTK_RTREE_NODE_CAPACITY)
+
+// Bounding box [min, max] with a user value
+struct RTreeEntry {
+    Vec2 min;
+    Vec2 max;
+    uint64_t value;
+};
+
+struct RTreeNode {
+    Vec2 min;
+    Vec2 max;
+    // Children are entries[first, first + count) in leaves, and
+    // nodes[first, first + count) otherwise
+    uint64_t first;
+    uint64_t count;
+    bool leaf;
+};
+
+// Static R-tree bulk-loaded with the Sort-Tile-Recursive algorithm:
+//
+// Scott T. Leutenegger, Mario A. Lopez, and Jeffrey Edgington.  “STR: a
+// simple and efficient algorithm for R-tree packing.”  Proceedings of the 13th
+// International Conference on Data Engineering, 497–506, 1997.
+//
+// The tree cannot be updated: it must be built again when the boxes change.
+struct RTree {
+    // Entries are stored in leaf order
+    Array<RTreeEntry> entries;
+    // The root is the last node
+    Array<RTreeNode> nodes;
+
+    void print(bool all) const;
+
+    void clear() {
+        entries.clear();
+        nodes.clear();
+    }
+
+    // Build the tree with the contents of entry_array, replacing any previous
+    // contents.  The array is moved into the tree (it is zeroed on return).
+    void build(Array<RTreeEntry>& entry_array);
+
+    // Bounding box of all entries.  Return false if the tree is empty.
+    bool bounding_box(Vec2& min, Vec2& max) const;
+
+    // Append to result the values of all entries whose boxes intersect
+    // [min, max] (boxes are closed, so touching boxes are included).
+    void search(const Vec2 min, const Vec2 max, Array<uint64_t>& result) const;
+
+    // Call visit with the value of every entry whose box contains point,
+    // until it returns true.  Return true if any call did.  It does not
+    // allocate, so it can be called concurrently from many threads.
+    bool find(const Vec2 point, bool (*visit)(uint64_t value, void* data), void* data) const;
+};
+
+}  // namespace gdstk
+
+#endif
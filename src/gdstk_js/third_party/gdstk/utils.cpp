@@ -15,6 +15,8 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 #include <string.h>
 #include <time.h>
 
+#include <chrono>
+
 #include "allocator.h"
 #include "vec.h"
 
@@ -654,8 +656,41 @@ inline static const char* default_color(Tag tag) {
     return colors[(2 + get_layer(tag) + get_type(tag) * 13) % COUNT(colors)];
 }
 
+static thread_local Progress* current_progress = NULL;
+
+void set_progress(Progress* progress) { current_progress = progress; }
+
+bool update_progress(uint64_t done, uint64_t total) {
+    Progress* progress = current_progress;
+    if (!progress) return false;
+    progress->done.store(done, std::memory_order_relaxed);
+    progress->total.store(total, std::memory_order_relaxed);
+    return progress->cancel.load(std::memory_order_relaxed);
+}
+
+static std::atomic<TraceHook> trace_hook(NULL);
+
+void set_trace_hook(TraceHook hook) { trace_hook.store(hook, std::memory_order_release); }
+
+TraceHook get_trace_hook() { return trace_hook.load(std::memory_order_acquire); }
+
+double trace_now() {
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+char* set_file_buffer(FILE* file) {
+    char* buffer = (char*)malloc(GDSTK_FILE_BUFFER_SIZE);
+    if (buffer && setvbuf(file, buffer, _IOFBF, GDSTK_FILE_BUFFER_SIZE) != 0) {
+        free(buffer);
+        return NULL;
+    }
+    return buffer;
+}
+
 const char* default_svg_shape_style(Tag tag) {
-    static char buffer[] = "stroke: #XXXXXX; fill: #XXXXXX; fill-opacity: 0.5;";
+    static thread_local char buffer[] = "stroke: #XXXXXX; fill: #XXXXXX; fill-opacity: 0.5;";
     const char* c = default_color(tag);
     memcpy(buffer + 9, c, 6);
     memcpy(buffer + 24, c, 6);
@@ -663,7 +698,7 @@ const char* default_svg_shape_style(Tag tag) {
 }
 
 const char* default_svg_label_style(Tag tag) {
-    static char buffer[] = "stroke: none; fill: #XXXXXX;";
+    static thread_local char buffer[] = "stroke: none; fill: #XXXXXX;";
     const char* c = default_color(tag);
     memcpy(buffer + 21, c, 6);
     return buffer;
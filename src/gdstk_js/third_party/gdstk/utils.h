@@ -51,15 +51,19 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 
 #ifdef _WIN32
 #define FSEEK64 _fseeki64
+#define FTELL64 _ftelli64
 #else
-// Assuming sizeof(long) == 8
-#define FSEEK64 fseek
+// off_t is 64 bits on wasm32 as well, where long is not
+#define FSEEK64 fseeko
+#define FTELL64 ftello
 #endif
 
 #include <math.h>
 #include <stdint.h>
 #include <time.h>
 
+#include <atomic>
+
 #include "array.h"
 #include "vec.h"
 
@@ -85,6 +89,7 @@ enum struct ErrorCode {
     InvalidFile,
     InsufficientMemory,
     ZlibError,
+    Cancelled,
 };
 
 // Tag encapsulates layer and data (text) type.  The implementation details
@@ -105,6 +110,10 @@ typedef double (*ParametricDouble)(double, void*);
 // Argument between 0 and 1, plus user data
 typedef Vec2 (*ParametricVec2)(double, void*);
 
+// Batched version of ParametricVec2.  Arguments: array of count parameters
+// between 0 and 1, count, output array with count slots, user data
+typedef void (*ParametricVec2Batch)(const double*, uint64_t, Vec2*, void*);
+
 // Arguments: first_point, first_direction, second_point, second_direction,
 // user data
 typedef Array<Vec2> (*EndFunction)(const Vec2, const Vec2, const Vec2, const Vec2, void*);
@@ -205,6 +214,70 @@ const char* default_svg_label_style(Tag tag);
 // Thread-safe version of localtime.
 tm* get_now(tm& result);
 
+// Progress of a long running operation (read_gds, write_gds, write_oas,
+// boolean, offset, Cell::flatten).  Operations report to the Progress
+// installed on the thread running them and stop early with
+// ErrorCode::Cancelled once cancel is set, possibly from another thread.
+struct Progress {
+    std::atomic<uint64_t> done;
+    std::atomic<uint64_t> total;
+    std::atomic<bool> cancel;
+};
+
+// Install progress (or NULL) for operations running on the current thread.
+void set_progress(Progress* progress);
+
+// Report done out of total units of work to the current thread's Progress.
+// Returns true if the operation has been cancelled.
+bool update_progress(uint64_t done, uint64_t total);
+
+// Called at the end of every TraceSpan with its name (a static string) and
+// its begin and end times from trace_now().  Called from the thread running
+// the span, so it must be thread safe.
+typedef void (*TraceHook)(const char* name, double begin, double end);
+
+// Install hook (or NULL) for spans started from now on, in all threads.
+void set_trace_hook(TraceHook hook);
+TraceHook get_trace_hook();
+
+// Monotonic time in microseconds
+double trace_now();
+
+// Scoped timer of a core phase, reported to the trace hook.  Without a hook
+// it costs a single atomic load.
+struct TraceSpan {
+    const char* name;
+    double begin;
+    explicit TraceSpan(const char* name_) : name(name_), begin(get_trace_hook() ? trace_now() : -1) {}
+    ~TraceSpan() { end(); }
+    // End the span before its scope does
+    void end() {
+        if (begin < 0) return;
+        TraceHook hook = get_trace_hook();
+        if (hook) hook(name, begin, trace_now());
+        begin = -1;
+    }
+};
+
+// Size of the stdio buffer of layout files.  The default buffer is small and
+// every refill is a system call (under emscripten's NODERAWFS, a call into
+// node's fs module), so layout files are streamed in large chunks.
+#define GDSTK_FILE_BUFFER_SIZE (1024 * 1024)
+
+// Install a GDSTK_FILE_BUFFER_SIZE buffer in file, which must not have been
+// read or written yet.  The buffer comes from malloc, not from allocate, so it
+// never ends up in the arena of the library being loaded.  It must be freed
+// with free after file is closed.
+char* set_file_buffer(FILE* file);
+
+// Scoped file buffer.  Declare it after opening file and close file before it
+// goes out of scope.
+struct FileBuffer {
+    char* data;
+    explicit FileBuffer(FILE* file) : data(set_file_buffer(file)) {}
+    ~FileBuffer() { free(data); }
+};
+
 // FNV-1a hash function (64 bits)
 #define HASH_FNV_PRIME 0x00000100000001b3
 #define HASH_FNV_OFFSET 0xcbf29ce484222325
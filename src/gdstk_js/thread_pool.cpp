@@ -0,0 +1,125 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+utils::ThreadPool &utils::ThreadPool::instance() {
+  static ThreadPool pool;
+  return pool;
+}
+
+utils::ThreadPool::ThreadPool() {
+#ifdef GDSTK_JS_USE_PTHREADS
+  size_t num_threads = std::thread::hardware_concurrency();
+  start(num_threads > 1 ? num_threads - 1 : 0);
+#endif
+}
+
+utils::ThreadPool::~ThreadPool() { stop(); }
+
+void utils::ThreadPool::resize(size_t num_threads) {
+  stop();
+#ifdef GDSTK_JS_USE_PTHREADS
+#ifdef __EMSCRIPTEN__
+  // Only the PTHREAD_POOL_SIZE workers (one per core) are prespawned
+  size_t max_threads = std::thread::hardware_concurrency();
+  if (max_threads > 0 && num_threads > max_threads) num_threads = max_threads;
+#endif
+  start(num_threads > 1 ? num_threads - 1 : 0);
+#endif
+}
+
+void utils::ThreadPool::start(size_t num_workers) {
+  stopping_ = false;
+  for (size_t i = 0; i < num_workers; i++) {
+    workers_.emplace_back([this]() { work(); });
+  }
+}
+
+void utils::ThreadPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  for (auto &worker : workers_) worker.join();
+  workers_.clear();
+}
+
+void utils::ThreadPool::work() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) return;
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+void utils::ThreadPool::submit(std::function<void()> task) {
+  if (workers_.empty()) {
+    task();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  condition_.notify_one();
+}
+
+void utils::ThreadPool::parallel_for(
+    size_t count, const std::function<void(size_t)> &function) {
+  if (count == 0) return;
+  if (workers_.empty() || count == 1) {
+    for (size_t i = 0; i < count; i++) function(i);
+    return;
+  }
+
+  // Shared with the helpers.  The caller takes indices like any helper and
+  // only waits for the ones other threads are running, never for helpers
+  // still queued: those may be stuck behind busy workers (nested calls from
+  // a worker), and start after everything is done.  They then find no index
+  // left and only touch this state, which they keep alive.
+  struct State {
+    std::atomic<size_t> next{0};
+    size_t completed = 0;
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::exception_ptr error;
+  };
+  auto state = std::make_shared<State>();
+  const std::function<void(size_t)> *body = &function;
+
+  auto run = [state, body, count]() {
+    size_t ran = 0;
+    size_t i;
+    while ((i = state->next.fetch_add(1)) < count) {
+      try {
+        (*body)(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (!state->error) state->error = std::current_exception();
+      }
+      ran++;
+    }
+    if (ran == 0) return;
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->completed += ran;
+    if (state->completed == count) state->finished.notify_all();
+  };
+
+  const size_t helpers = std::min(workers_.size(), count - 1);
+  for (size_t h = 0; h < helpers; h++) submit(run);
+  run();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->finished.wait(lock,
+                       [&state, count]() { return state->completed == count; });
+  if (state->error) std::rethrow_exception(state->error);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+// Fixed size pool of worker threads for gdstk core work.
+//
+// Tasks must only touch gdstk data (polygons, cells, arrays) and never
+// emscripten::val or the binding keep alive maps: those belong to the js
+// thread.  Without GDSTK_JS_USE_PTHREADS the pool has no workers and
+// everything runs inline on the calling thread.
+class ThreadPool {
+ public:
+  static ThreadPool &instance();
+
+  ~ThreadPool();
+
+  // Number of threads taking part in parallel_for, including the caller
+  size_t size() const { return workers_.size() + 1; }
+
+  // Restart the pool with num_threads - 1 workers (the caller is the last
+  // one).  Must not be called while tasks are running.  In wasm builds,
+  // num_threads is capped at the number of cores: workers beyond those
+  // prespawned with PTHREAD_POOL_SIZE would be started while the calling
+  // (browser main) thread blocks waiting for them.
+  void resize(size_t num_threads);
+
+  // Queue task to run on a worker (or run it inline without workers)
+  void submit(std::function<void()> task);
+
+  // Call function(i) for every i in [0, count), blocking until all calls
+  // return.  The calling thread works too, so calls from a worker (nested
+  // parallel_for, or a task of submit) cannot deadlock.  The first exception
+  // thrown by function is rethrown here.
+  void parallel_for(size_t count, const std::function<void(size_t)> &function);
+
+ private:
+  ThreadPool();
+  void start(size_t num_workers);
+  void stop();
+  void work();
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stopping_{false};
+};
+
+}  // namespace utils
@@ -0,0 +1,133 @@
+#include "trace.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "gdstk.h"
+
+namespace {
+
+struct Span {
+  const char *name;
+  double begin;
+  double end;
+  uint32_t thread;
+};
+
+// Ring of the spans of one thread.  Only its thread records into it; the
+// mutex is taken by trace_start and trace_dump, so recording never waits
+// on another thread.
+struct ThreadSpans {
+  std::mutex mutex;
+  std::vector<Span> spans;
+  uint64_t next_span = 0;  // total recorded since trace_start
+  uint32_t thread = 0;
+};
+
+// Rings of every thread that recorded since the module was loaded
+std::mutex registry_mutex;
+std::vector<std::shared_ptr<ThreadSpans>> registry;
+std::atomic<uint64_t> capacity{0};
+uint32_t main_thread = 0;
+
+std::atomic<uint32_t> thread_count{0};
+
+uint32_t thread_id() {
+  static thread_local uint32_t id = ++thread_count;
+  return id;
+}
+
+ThreadSpans &thread_spans() {
+  static thread_local std::shared_ptr<ThreadSpans> local = []() {
+    auto result = std::make_shared<ThreadSpans>();
+    result->thread = thread_id();
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry.push_back(result);
+    return result;
+  }();
+  return *local;
+}
+
+void record(const char *name, double begin, double end) {
+  ThreadSpans &local = thread_spans();
+  std::lock_guard<std::mutex> lock(local.mutex);
+  if (local.spans.empty()) {
+    uint64_t count = capacity.load(std::memory_order_relaxed);
+    if (count == 0) return;
+    local.spans.resize(count);
+  }
+  local.spans[local.next_span % local.spans.size()] = {name, begin, end,
+                                                       local.thread};
+  local.next_span++;
+}
+
+void append_event(std::string &json, const Span &span) {
+  // names are static identifiers, no escaping needed
+  char buffer[256];
+  snprintf(buffer, sizeof(buffer),
+           "{\"name\":\"%s\",\"cat\":\"gdstk\",\"ph\":\"X\",\"ts\":%.3f,"
+           "\"dur\":%.3f,\"pid\":1,\"tid\":%u},\n",
+           span.name, span.begin, span.end - span.begin, span.thread);
+  json += buffer;
+}
+
+}  // namespace
+
+void utils::trace_start(uint64_t capacity_) {
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    capacity = capacity_;
+    for (auto &local : registry) {
+      std::lock_guard<std::mutex> local_lock(local->mutex);
+      // rings are sized again on their next span
+      std::vector<Span>().swap(local->spans);
+      local->next_span = 0;
+    }
+    main_thread = thread_id();
+  }
+  gdstk::set_trace_hook(capacity_ > 0 ? record : NULL);
+}
+
+void utils::trace_stop() { gdstk::set_trace_hook(NULL); }
+
+bool utils::trace_enabled() { return gdstk::get_trace_hook() != NULL; }
+
+std::string utils::trace_dump() {
+  std::vector<Span> spans;
+  uint64_t recorded = 0;
+  uint32_t js_thread;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    js_thread = main_thread;
+    for (auto &local : registry) {
+      std::lock_guard<std::mutex> local_lock(local->mutex);
+      uint64_t size = local->spans.size();
+      uint64_t count = local->next_span < size ? local->next_span : size;
+      for (uint64_t i = local->next_span - count; i < local->next_span; i++) {
+        spans.push_back(local->spans[i % size]);
+      }
+      recorded += local->next_span;
+    }
+  }
+  std::stable_sort(
+      spans.begin(), spans.end(),
+      [](const Span &a, const Span &b) { return a.begin < b.begin; });
+
+  std::string json = "{\"traceEvents\":[\n";
+  for (const Span &span : spans) append_event(json, span);
+  char buffer[256];
+  snprintf(buffer, sizeof(buffer),
+           "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+           "\"args\":{\"name\":\"js\"}}\n],\n"
+           "\"displayTimeUnit\":\"ms\",\n"
+           "\"otherData\":{\"recorded\":%llu,\"dropped\":%llu}}\n",
+           js_thread, (unsigned long long)recorded,
+           (unsigned long long)(recorded - spans.size()));
+  json += buffer;
+  return json;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+namespace utils {
+
+// Per thread ring buffers of gdstk::TraceSpan records, merged and dumped as
+// Chrome trace_event JSON (load it in chrome://tracing or
+// https://ui.perfetto.dev).  When a ring is full, the oldest spans of its
+// thread are overwritten.
+
+// Start recording into rings of capacity spans per thread, dropping previous
+// ones
+void trace_start(uint64_t capacity);
+
+// Stop recording; recorded spans are kept until the next trace_start
+void trace_stop();
+
+bool trace_enabled();
+
+// Recorded spans, oldest first, as a Chrome trace JSON document
+std::string trace_dump();
+
+}  // namespace utils
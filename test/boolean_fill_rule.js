@@ -0,0 +1,52 @@
+// Unions keep the non-zero fill rule of a single sweep: the negatively wound
+// lobe of a self intersecting polygon cancels the polygons of its own operand
+// under it, also when the operands are large enough to be united in parts.
+//
+//   node test/boolean_fill_rule.js [path/to/gdstk.js]
+const assert = require("assert");
+const path = require("path");
+
+const Gdstk = require(process.argv[2] ||
+                      path.join(__dirname, "..", "packages", "gdstk.js"));
+
+function area(polygons) {
+  return polygons.reduce((sum, polygon) => sum + polygon.area(), 0);
+}
+
+// Rectangle with n points per side, so that it fills a union group alone
+function dense_rectangle(g, x0, y0, x1, y1, n) {
+  const points = [];
+  for (let i = 0; i < n; i++) points.push([x0 + (x1 - x0) * i / n, y0]);
+  for (let i = 0; i < n; i++) points.push([x1, y0 + (y1 - y0) * i / n]);
+  for (let i = 0; i < n; i++) points.push([x1 - (x1 - x0) * i / n, y1]);
+  for (let i = 0; i < n; i++) points.push([x0, y1 - (y1 - y0) * i / n]);
+  return new g.Polygon(points, 0, 0);
+}
+
+Gdstk().then((g) => {
+  // Lobes of area 1 crossing at (1, 1): the left one is wound
+  // counterclockwise, the right one clockwise
+  const bowtie = () => new g.Polygon([[0, 0], [2, 2], [2, 0], [0, 2]], 0, 0);
+
+  for (const n of [1, 1500]) {
+    // Covers both lobes, area 56
+    const rectangle = () => dense_rectangle(g, -5, -5, 3, 2, n);
+
+    // Same operand: the clockwise lobe cancels the rectangle under it
+    const same = g.boolean([rectangle(), bowtie()], [], "or", 1e-3, 0, 0);
+    assert(Math.abs(area(same) - 55) < 1e-6, `same operand, ${n}: ${area(same)}`);
+
+    // Operands are filled separately, so nothing cancels across them
+    const across = g.boolean([bowtie()], [rectangle()], "or", 1e-3, 0, 0);
+    assert(Math.abs(area(across) - 56) < 1e-6, `across operands, ${n}: ${area(across)}`);
+
+    // The pre-union of offset unites all polygons in one operand
+    const offset = g.offset([rectangle(), bowtie()], 0.01, "miter", 2, 1e-3,
+                            true, 0, 0);
+    assert(Math.abs(area(offset) - 55) < 0.5, `offset, ${n}: ${area(offset)}`);
+  }
+  console.log("ok");
+}).catch((e) => {
+  console.error(e);
+  process.exit(1);
+});
@@ -0,0 +1,65 @@
+// Cell.area counts every instance of repeated polygons, paths and references
+// once, as the flattened polygons from get_polygons do.
+//
+//   node test/cell_area.js [path/to/gdstk.js]
+const assert = require("assert");
+const path = require("path");
+
+const Gdstk = require(process.argv[2] ||
+                      path.join(__dirname, "..", "packages", "gdstk.js"));
+
+function area(polygons) {
+  return polygons.reduce((sum, polygon) => sum + polygon.area(), 0);
+}
+
+Gdstk().then((g) => {
+  const check = (name, cell, expected) => {
+    const flat = area(cell.get_polygons(true, true, null, null, null));
+    assert(Math.abs(flat - expected) < 1e-9, `${name}: flat ${flat}`);
+    for (const exact of [false, true]) {
+      const result = cell.area(false, exact);
+      assert(Math.abs(result - flat) < 1e-6,
+             `${name}: area ${result} (exact ${exact}), flat ${flat}`);
+    }
+  };
+
+  // Unit rectangle repeated 3x2
+  const rectangles = new g.Cell("rectangles");
+  const rectangle = g.rectangle([0, 0], [1, 1], 1, 0);
+  rectangle.repetition =
+      new g.Repetition(3, 2, [2, 2], null, null, null, null, null);
+  rectangles.add(rectangle);
+  check("polygon", rectangles, 6);
+
+  // Path of area 5 repeated twice
+  const paths = new g.Cell("paths");
+  const flexpath = new g.FlexPath([[0, 0], [5, 0]], 1, 0, "natural", "flush",
+                                  null, null, 0.01, false, true, 1, 0);
+  flexpath.repetition =
+      new g.Repetition(1, 2, [0, 3], null, null, null, null, null);
+  paths.add(flexpath);
+  check("path", paths, 10);
+
+  // Repeated and magnified references to both, nested
+  const middle = new g.Cell("middle");
+  const reference = new g.Reference(rectangles, [0, 0], 0, 2, false, 1, 1,
+                                    null);
+  reference.repetition =
+      new g.Repetition(2, 1, [10, 0], null, null, null, null, null);
+  middle.add(reference);
+  middle.add(new g.Reference(paths, [0, 10], Math.PI / 2, 1, false, 1, 1,
+                             null));
+  check("reference", middle, 2 * 4 * 6 + 10);
+
+  const top = new g.Cell("top");
+  const array = new g.Reference(middle, [0, 0], 0, 0.5, true, 1, 1, null);
+  array.repetition =
+      new g.Repetition(3, 3, [40, 40], null, null, null, null, null);
+  top.add(array);
+  top.add(new g.Reference(rectangles, [-10, -10], 0, 1, false, 1, 1, null));
+  check("nested", top, 9 * 0.25 * (2 * 4 * 6 + 10) + 6);
+  console.log("ok");
+}).catch((e) => {
+  console.error(e);
+  process.exit(1);
+});
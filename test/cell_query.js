@@ -0,0 +1,55 @@
+// Cell.query returns the flattened polygons whose bounding boxes intersect
+// the window, also through references rotated by arbitrary angles.
+//
+//   node test/cell_query.js [path/to/gdstk.js]
+const assert = require("assert");
+const path = require("path");
+
+const Gdstk = require(process.argv[2] ||
+                      path.join(__dirname, "..", "packages", "gdstk.js"));
+
+Gdstk().then((g) => {
+  let seed = 7;
+  const random = () =>
+      (seed = (seed * 1103515245 + 12345) % 2147483648) / 2147483648;
+
+  // Long thin diagonal polygons have bounding boxes much larger than
+  // themselves, which turn differently from the polygons
+  const leaf = new g.Cell("leaf");
+  for (let i = 0; i < 20; i++) {
+    const x = random() * 40, y = random() * 40, length = 2 + random() * 10;
+    const a = random() * Math.PI;
+    const dx = length * Math.cos(a), dy = length * Math.sin(a);
+    leaf.add(new g.Polygon([[x, y], [x + dx, y + dy],
+                            [x + dx + 0.1, y + dy], [x + 0.1, y]], 1, 0));
+  }
+  const middle = new g.Cell("middle");
+  middle.add(new g.Reference(leaf, [5, 5], Math.PI / 6, 1.5, true, 1, 1, null));
+  const array = new g.Reference(leaf, [100, 0], 0.3, 0.5, false, 1, 1, null);
+  array.repetition = new g.Repetition(3, 2, [30, 30], null, null, null, null,
+                                      null);
+  middle.add(array);
+  const top = new g.Cell("top");
+  top.add(new g.Reference(middle, [0, 0], 1.1, 1, false, 1, 1, null));
+  top.add(new g.Reference(middle, [-50, 80], -2, 0.8, true, 1, 1, null));
+  top.add(new g.Reference(leaf, [20, -60], Math.PI / 2, 1, false, 1, 1, null));
+
+  const flat = top.get_polygons(true, true, null, null, null)
+                   .map((polygon) => polygon.bounding_box());
+  for (let trial = 0; trial < 200; trial++) {
+    const x = -150 + random() * 300, y = -150 + random() * 300;
+    const w = random() * 30, h = random() * 30;
+    const window = [[x, y], [x + w, y + h]];
+    const expected =
+        flat.filter(([min, max]) => min[0] <= x + w && max[0] >= x &&
+                                    min[1] <= y + h && max[1] >= y)
+            .length;
+    const result = top.query(window).polygons.length;
+    assert.strictEqual(result, expected,
+                       `window ${JSON.stringify(window)}: ${result} polygons`);
+  }
+  console.log("ok");
+}).catch((e) => {
+  console.error(e);
+  process.exit(1);
+});
@@ -0,0 +1,79 @@
+// Hierarchical boolean_layers and offset_layer unite the pieces of results
+// that touch across instance boundaries, so abutting instances give the same
+// polygons as the flattened cell.
+//
+//   node test/hierarchical_seams.js [path/to/gdstk.js]
+const assert = require("assert");
+const path = require("path");
+
+const Gdstk = require(process.argv[2] ||
+                      path.join(__dirname, "..", "packages", "gdstk.js"));
+
+function area(polygons) {
+  return polygons.reduce((sum, polygon) => sum + polygon.area(), 0);
+}
+
+Gdstk().then((g) => {
+  // A bar on layer 1 crossed by a post on layer 2, 10 wide
+  const leaf = new g.Cell("leaf");
+  leaf.add(g.rectangle([0, 0], [10, 1], 1, 0));
+  leaf.add(g.rectangle([4, -1], [6, 2], 2, 0));
+
+  // Row of an array of 6 abutting instances and 2 more instances
+  const row = new g.Cell("row");
+  const array = new g.Reference(leaf, [0, 0], 0, 1, false, 1, 1, null);
+  array.repetition = new g.Repetition(6, 1, [10, 0], null, null, null, null, null);
+  row.add(array);
+  row.add(new g.Reference(leaf, [60, 0], 0, 1, false, 1, 1, null));
+  row.add(new g.Reference(leaf, [70, 0], 0, 1, false, 1, 1, null));
+
+  // A reflected row abutting the first one along the posts, and a rotated
+  // instance overlapping the end of the first row
+  const top = new g.Cell("top");
+  top.add(new g.Reference(row, [0, 0], 0, 1, false, 1, 1, null));
+  top.add(new g.Reference(row, [0, 4], 0, 1, true, 1, 1, null));
+  top.add(new g.Reference(leaf, [82, -6], Math.PI / 2, 1, false, 1, 1, null));
+
+  const hierarchical = {hierarchical: true};
+  const compare = (name, flat, hier) => {
+    assert.strictEqual(hier.length, flat.length,
+                       `${name}: ${hier.length} polygons, flat ${flat.length}`);
+    assert(Math.abs(area(hier) - area(flat)) < 1e-6,
+           `${name}: area ${area(hier)}, flat ${area(flat)}`);
+    assert(area(g.boolean(flat, hier, "xor")) < 1e-6, `${name}: xor`);
+  };
+  for (const operation of ["or", "and", "xor", "not"]) {
+    compare(operation,
+            top.boolean_layers([1, 0], [2, 0], operation, 1e-3, 0, 0, null),
+            top.boolean_layers([1, 0], [2, 0], operation, 1e-3, 0, 0,
+                               hierarchical));
+  }
+  for (const distance of [0.5, -0.25]) {
+    compare(`offset ${distance}`,
+            top.offset_layer([1, 0], distance, "miter", 2, 1e-3, 0, 0, null),
+            top.offset_layer([1, 0], distance, "miter", 2, 1e-3, 0, 0,
+                             hierarchical));
+  }
+
+  // Magnified instances, alone and in an array, would scale the distance
+  const square = new g.Cell("square");
+  square.add(g.rectangle([0, 0], [10, 10], 1, 0));
+  const scaled = new g.Cell("scaled");
+  scaled.add(new g.Reference(square, [0, 0], 0, 2, false, 1, 1, null));
+  const small = new g.Reference(square, [50, 0], 0, 0.5, false, 1, 1, null);
+  small.repetition = new g.Repetition(3, 1, [20, 0], null, null, null, null,
+                                      null);
+  scaled.add(small);
+  scaled.add(new g.Reference(square, [0, 50], Math.PI / 6, 1.5, true, 1, 1,
+                             null));
+  for (const distance of [1, -1]) {
+    compare(`magnified offset ${distance}`,
+            scaled.offset_layer([1, 0], distance, "miter", 2, 1e-3, 0, 0, null),
+            scaled.offset_layer([1, 0], distance, "miter", 2, 1e-3, 0, 0,
+                                hierarchical));
+  }
+  console.log("ok");
+}).catch((e) => {
+  console.error(e);
+  process.exit(1);
+});
@@ -0,0 +1,36 @@
+// Library.replace rewires references to the new cell, so the cached bounding
+// boxes and spatial indices of their parents must follow.
+//
+//   node test/library_replace.js [path/to/gdstk.js]
+const assert = require("assert");
+const path = require("path");
+
+const Gdstk = require(process.argv[2] ||
+                      path.join(__dirname, "..", "packages", "gdstk.js"));
+
+Gdstk().then((g) => {
+  const lib = new g.Library("library", 1e-6, 1e-9);
+  const b = lib.new_cell("b");
+  b.add(g.rectangle([0, 0], [1, 1], 1, 0));
+  const middle = lib.new_cell("middle");
+  middle.add(new g.Reference(b, [0, 0], 0, 1, false, 1, 1, null));
+  const top = lib.new_cell("top");
+  top.add(new g.Reference(middle, [0, 0], 0, 1, false, 1, 1, null));
+
+  const b2 = new g.Cell("b");
+  b2.add(g.rectangle([0, 0], [100, 100], 1, 0));
+
+  // Fill the caches before replacing
+  assert.deepStrictEqual(top.bounding_box(), [[0, 0], [1, 1]]);
+  const window = [[50, 50], [60, 60]];
+  assert.strictEqual(top.query(window).polygons.length, 0);
+
+  lib.replace(b2);
+  assert.deepStrictEqual(top.bounding_box(), [[0, 0], [100, 100]]);
+  assert.deepStrictEqual(middle.bounding_box(), [[0, 0], [100, 100]]);
+  assert.strictEqual(top.query(window).polygons.length, 1);
+  console.log("ok");
+}).catch((e) => {
+  console.error(e);
+  process.exit(1);
+});